@@ -5,7 +5,10 @@
 #include "ColdetModel.h"
 #include "ColdetModelInternalModel.h"
 #include "Opcode/Opcode.h"
+#include <cnoid/CollisionTreeCache>
 #include <map>
+#include <memory>
+#include <cstring>
 #include <iostream>
 
 using namespace std;
@@ -42,6 +45,15 @@ struct trianglePair {
 };
 
 typedef std::map< Edge, trianglePair > EdgeToTriangleMap;
+
+/*
+  The trees of the meshes with fewer triangles are always built because building them
+  is as fast as loading them.
+*/
+const size_t MinNumTrianglesToCacheTree = 10000;
+
+//! Increment this when the layout of the data exported by exportTreeData is changed
+const int TreeCacheFormatVersion = 1;
 }
 
 
@@ -258,21 +270,41 @@ bool ColdetModelInternalModel::build()
     
     if(triangles.size() > 0){
 
-        extractNeghiborTriangles();
-
-        Opcode::OPCODECREATE OPCC;
-
         iMesh.SetPointers(&triangles[0], &vertices[0]);
         iMesh.SetNbTriangles(triangles.size());
         iMesh.SetNbVertices(vertices.size());
+
+        bool isRestored = false;
+        std::unique_ptr<CollisionTreeCache::Key> cacheKey;
+        auto cache = CollisionTreeCache::instance();
+        if(triangles.size() >= MinNumTrianglesToCacheTree && cache->isEnabled()){
+            cacheKey.reset(new CollisionTreeCache::Key("AISTCollisionDetector", TreeCacheFormatVersion));
+            cacheKey->add(vertices);
+            cacheKey->add(triangles);
+            vector<char> data;
+            if(cache->load(*cacheKey, data)){
+                isRestored = restoreTreeData(data);
+            }
+        }
+
+        if(!isRestored){
+            extractNeghiborTriangles();
+
+            Opcode::OPCODECREATE OPCC;
+            OPCC.mIMesh = &iMesh;
+            OPCC.mNoLeaf = false;
+            OPCC.mQuantized = false;
+            OPCC.mKeepOriginal = false;
         
-        OPCC.mIMesh = &iMesh;
-        
-        OPCC.mNoLeaf = false;
-        OPCC.mQuantized = false;
-        OPCC.mKeepOriginal = false;
+            model.Build(OPCC);
+
+            if(cacheKey && model.GetTree()){
+                vector<char> data;
+                exportTreeData(data);
+                cache->store(*cacheKey, data);
+            }
+        }
         
-        model.Build(OPCC);
         if(model.GetTree()){
             AABBTreeMaxDepth = computeDepth(((Opcode::AABBCollisionTree*)model.GetTree())->GetNodes(), 0, -1) + 1;
             for(int i=0; i<AABBTreeMaxDepth; i++)
@@ -456,6 +488,109 @@ void ColdetModelInternalModel::extractNeghiborTriangles()
 }
 
 
+/*
+  The data consists of the number of the nodes, the box centers, the box extents and
+  the data of the nodes, followed by the neighbor triangles.
+  See Opcode::AABBCollisionTree::Restore for the node data.
+*/
+void ColdetModelInternalModel::exportTreeData(std::vector<char>& out_data)
+{
+    auto tree = static_cast<const Opcode::AABBCollisionTree*>(model.GetTree());
+    const Opcode::AABBCollisionNode* nodes = tree->GetNodes();
+    const udword numNodes = tree->GetNbNodes();
+
+    // The points are stored as float arrays because Point is not trivially copyable
+    vector<float> centers(numNodes * 3);
+    vector<float> extents(numNodes * 3);
+    vector<udword> nodeData(numNodes);
+    for(udword i=0; i < numNodes; ++i){
+        const Opcode::AABBCollisionNode& node = nodes[i];
+        const Point& center = node.mAABB.mCenter;
+        const Point& extent = node.mAABB.mExtents;
+        centers[i * 3] = center.x;
+        centers[i * 3 + 1] = center.y;
+        centers[i * 3 + 2] = center.z;
+        extents[i * 3] = extent.x;
+        extents[i * 3 + 1] = extent.y;
+        extents[i * 3 + 2] = extent.z;
+        if(node.IsLeaf()){
+            nodeData[i] = static_cast<udword>(node.mData);
+        } else {
+            nodeData[i] = static_cast<udword>(node.GetPos() - nodes) << 1;
+        }
+    }
+
+    const size_t pointsSize = numNodes * 3 * sizeof(float);
+    const size_t nodeDataSize = numNodes * sizeof(udword);
+    const size_t neighborsSize = neighbors.size() * sizeof(NeighborTriangleSet);
+    out_data.resize(sizeof(udword) + pointsSize * 2 + nodeDataSize + neighborsSize);
+    char* p = out_data.data();
+    memcpy(p, &numNodes, sizeof(udword));
+    p += sizeof(udword);
+    memcpy(p, centers.data(), pointsSize);
+    p += pointsSize;
+    memcpy(p, extents.data(), pointsSize);
+    p += pointsSize;
+    memcpy(p, nodeData.data(), nodeDataSize);
+    p += nodeDataSize;
+    memcpy(p, neighbors.data(), neighborsSize);
+}
+
+
+bool ColdetModelInternalModel::restoreTreeData(const std::vector<char>& data)
+{
+    const size_t numTriangles = triangles.size();
+    udword numNodes;
+    if(data.size() < sizeof(udword)){
+        return false;
+    }
+    memcpy(&numNodes, data.data(), sizeof(udword));
+    if(numNodes != numTriangles * 2 - 1){
+        return false;
+    }
+    const size_t pointsSize = numNodes * 3 * sizeof(float);
+    const size_t nodeDataSize = numNodes * sizeof(udword);
+    const size_t neighborsSize = numTriangles * sizeof(NeighborTriangleSet);
+    if(data.size() != sizeof(udword) + pointsSize * 2 + nodeDataSize + neighborsSize){
+        return false;
+    }
+
+    const char* p = data.data() + sizeof(udword);
+    vector<float> values(numNodes * 3);
+    vector<Point> centers;
+    vector<Point> extents;
+    centers.reserve(numNodes);
+    extents.reserve(numNodes);
+    memcpy(values.data(), p, pointsSize);
+    p += pointsSize;
+    for(udword i=0; i < numNodes; ++i){
+        centers.emplace_back(&values[i * 3]);
+    }
+    memcpy(values.data(), p, pointsSize);
+    p += pointsSize;
+    for(udword i=0; i < numNodes; ++i){
+        extents.emplace_back(&values[i * 3]);
+    }
+    vector<udword> nodeData(numNodes);
+    memcpy(nodeData.data(), p, nodeDataSize);
+    p += nodeDataSize;
+
+    for(auto& d : nodeData){
+        if((d & 1) && (d >> 1) >= numTriangles){
+            return false;
+        }
+    }
+    if(!model.Restore(&iMesh, numNodes, centers.data(), extents.data(), nodeData.data())){
+        return false;
+    }
+
+    neighbors.resize(numTriangles);
+    memcpy(neighbors.data(), p, neighborsSize);
+
+    return true;
+}
+
+
 int ColdetModelInternalModel::computeDepth(const Opcode::AABBCollisionNode* node, int currentDepth, int max)
 {
     /*
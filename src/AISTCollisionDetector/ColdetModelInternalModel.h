@@ -78,6 +78,8 @@ private:
 
     void extractNeghiborTriangles();
     int computeDepth(const Opcode::AABBCollisionNode* node, int currentDepth, int max );
+    void exportTreeData(std::vector<char>& out_data);
+    bool restoreTreeData(const std::vector<char>& data);
 
     friend class ColdetModel;
 };
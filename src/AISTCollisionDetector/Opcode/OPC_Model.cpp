@@ -213,6 +213,24 @@ bool Model::Build(const OPCODECREATE& create)
 }
 #pragma clang diagnostic pop
 
+// Added for the collision tree cache of Choreonoid
+bool Model::Restore(const MeshInterface* imesh, udword nb_nodes, const Point* centers, const Point* extents, const udword* data)
+{
+	if(!imesh || !imesh->IsValid())	return false;
+
+	Release();
+	SetMeshInterface(imesh);
+
+	if(!CreateTree(false, false))	return false;
+
+	if(!static_cast<AABBCollisionTree*>(mTree)->Restore(nb_nodes, centers, extents, data))
+	{
+		DELETESINGLE(mTree);
+		return false;
+	}
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Gets the number of bytes used by the tree.
@@ -36,6 +36,18 @@
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		override(BaseModel)	bool				Build(const OPCODECREATE& create);
 
+		// Added for the collision tree cache of Choreonoid
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		/**
+		 *	Restores a collision model with a normal (no quantized, with leaf) tree without building it.
+		 *	\param		imesh		[in] mesh interface
+		 *	\see		AABBCollisionTree::Restore
+		 *	\return		true if success
+		 */
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+							bool				Restore(const MeshInterface* imesh, udword nb_nodes,
+														const Point* centers, const Point* extents, const udword* data);
+
 #ifdef __MESHMERIZER_H__
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		/**
@@ -266,6 +266,63 @@ bool AABBCollisionTree::Build(AABBTree* tree)
 	return true;
 }
 
+// Added for the collision tree cache of Choreonoid
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Restores the collision tree from the linear node data exported from a built tree.
+ *	The data of a leaf node is the primitive index marked as leaf, which is the same as mData.
+ *	The data of the other nodes is the index of the positive child shifted by one bit.
+ *	\param		nb_nodes		[in] number of nodes
+ *	\param		centers			[in] box centers of the nodes
+ *	\param		extents			[in] box extents of the nodes
+ *	\param		data			[in] node data
+ *	\return		true if success
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool AABBCollisionTree::Restore(udword nb_nodes, const Point* centers, const Point* extents, const udword* data)
+{
+	if(!nb_nodes)	return false;
+
+	// Check the child indices before touching the nodes
+	for(udword i=0;i<nb_nodes;i++)
+	{
+		if(!(data[i]&1))
+		{
+			udword PosID = data[i]>>1;
+			if(PosID<=i || PosID+1>=nb_nodes)	return false;
+		}
+	}
+
+	if(mNbNodes!=nb_nodes)
+	{
+		mNbNodes = nb_nodes;
+		DELETEARRAY(mNodes);
+		mNodes = new AABBCollisionNode[mNbNodes];
+		CHECKALLOC(mNodes);
+	}
+
+	mNodes[0].mB = &mNodes[0];
+	for(udword i=0;i<nb_nodes;i++)
+	{
+		AABBCollisionNode& Node = mNodes[i];
+		Node.mAABB.mCenter = centers[i];
+		Node.mAABB.mExtents = extents[i];
+		Node.mAABB.CreateSSV();
+		if(data[i]&1)
+		{
+			Node.mData = data[i];
+		}
+		else
+		{
+			udword PosID = data[i]>>1;
+			Node.mData = (EXWORD)&mNodes[PosID];
+			mNodes[PosID].mB = &Node;
+			mNodes[PosID+1].mB = &Node;
+		}
+	}
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Refits the collision tree after vertices have been modified.
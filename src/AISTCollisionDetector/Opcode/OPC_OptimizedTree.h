@@ -188,6 +188,10 @@
 	class OPCODE_API AABBCollisionTree : public AABBOptimizedTree
 	{
 		IMPLEMENT_COLLISION_TREE(AABBCollisionTree, AABBCollisionNode)
+
+		// Added for the collision tree cache of Choreonoid
+		public:
+		bool		Restore(udword nb_nodes, const Point* centers, const Point* extents, const udword* data);
 	};
 
 	class OPCODE_API AABBNoLeafTree : public AABBOptimizedTree
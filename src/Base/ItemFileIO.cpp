@@ -4,9 +4,14 @@
 #include <cnoid/NullOut>
 #include <cnoid/ValueTree>
 #include <cnoid/FilePathVariableProcessor>
+#include <cnoid/ThreadPool>
 #include <cnoid/UTF8>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
+#include <future>
+#include <deque>
+#include <map>
+#include <sstream>
 #include "gettext.h"
 
 using namespace std;
@@ -36,6 +41,14 @@ public:
     MessageView* mv;
     std::string errorMessage;
 
+    struct PreloadResult
+    {
+        ReferencedPtr data;
+        std::string messages;
+    };
+    std::map<std::string, std::deque<std::future<PreloadResult>>> preloadResultMap;
+    ReferencedPtr preloadedData;
+
     // This variable actualy points a instance of the ClassInfo class defined in ItemManager.cpp
     mutable weak_ref_ptr<Referenced> itemClassInfo;
 
@@ -305,8 +318,23 @@ bool ItemFileIO::Impl::loadItem
     mv->notify(format(_("Loading {0} \"{1}\""), caption, filename));
     mv->flush();
 
+    auto p = preloadResultMap.find(filename);
+    if(p != preloadResultMap.end()){
+        auto& results = p->second;
+        auto result = results.front().get();
+        results.pop_front();
+        if(results.empty()){
+            preloadResultMap.erase(p);
+        }
+        preloadedData = result.data;
+        if(!result.messages.empty()){
+            *os << result.messages;
+        }
+    }
+
     actuallyLoadedItem = item;
     bool loaded = self->load(item, filename);
+    preloadedData.reset();
     mv->flush();
 
     if(!loaded){
@@ -346,6 +374,62 @@ bool ItemFileIO::load(Item* item, const std::string& filename)
 }
 
 
+ReferencedPtr ItemFileIO::preload(const std::string& /* filename */, std::ostream& /* os */)
+{
+    return nullptr;
+}
+
+
+bool ItemFileIO::startPreloading(const std::string& filename, ThreadPool& threadPool)
+{
+    if(!(impl->api & Preload)){
+        return false;
+    }
+    // The filename is expanded in the same way as the loadItem function
+    string expandedFilename = FilePathVariableProcessor::systemInstance()->expand(filename, true);
+    if(expandedFilename.empty()){
+        return false;
+    }
+
+    auto promise = make_shared<std::promise<Impl::PreloadResult>>();
+    impl->preloadResultMap[expandedFilename].push_back(promise->get_future());
+
+    ItemFileIOPtr self = this;
+    threadPool.start(
+        [self, expandedFilename, promise](){
+            Impl::PreloadResult result;
+            ostringstream os;
+            try {
+                result.data = self->preload(expandedFilename, os);
+            }
+            catch(const std::exception& ex){
+                os << ex.what() << endl;
+            }
+            result.messages = os.str();
+            promise->set_value(std::move(result));
+        });
+
+    return true;
+}
+
+
+void ItemFileIO::clearPreloadedData()
+{
+    for(auto& kv : impl->preloadResultMap){
+        for(auto& result : kv.second){
+            result.wait();
+        }
+    }
+    impl->preloadResultMap.clear();
+}
+
+
+Referenced* ItemFileIO::preloadedData()
+{
+    return impl->preloadedData;
+}
+
+
 void ItemFileIO::setActuallyLoadedItem(Item* item)
 {
     impl->actuallyLoadedItem = item;
@@ -16,6 +16,7 @@ class ItemManager;
 class ItemFileIOExtenderBase;
 class ItemFileDialog;
 class Mapping;
+class ThreadPool;
 
 class CNOID_EXPORT ItemFileIO : public Referenced
 {
@@ -26,6 +27,7 @@ public:
         OptionPanelForLoading = 1 << 2,
         Save = 1 << 3,
         OptionPanelForSaving = 1 << 4,
+        Preload = 1 << 5
     };
     enum InterfaceLevel { Standard, Conversion, Internal };
     enum InvocationType { Direct, Dialog, DragAndDrop };
@@ -81,6 +83,29 @@ public:
         const Mapping* options = nullptr);
 
     virtual bool load(Item* item, const std::string& filename);
+
+    // Preload API
+    /**
+       This function reads the file into the data which is used by the load function
+       later. The function is called from a worker thread, so it must not access any item,
+       GUI component or non thread-safe member of the file IO object. The options are not
+       applied to the data, so the options should be applied in the load function.
+       \param os The output stream for the messages, which are put when the item is loaded.
+       \return The preloaded data, or nullptr if the file cannot be preloaded.
+    */
+    virtual ReferencedPtr preload(const std::string& filename, std::ostream& os);
+
+    /**
+       This function starts preloading the file in the thread pool. The preloaded data is
+       passed to the load function when the loadItem function is called for the same file.
+       The preloading for the same file can be started multiple times to load multiple
+       items from the file.
+       \note This function must be called from the main thread.
+    */
+    bool startPreloading(const std::string& filename, ThreadPool& threadPool);
+
+    //! This function waits for the preloading in progress and discards the unused data.
+    void clearPreloadedData();
     
     // Save API
     bool saveItem(Item* item, const std::string& filename, const Mapping* options = nullptr);
@@ -126,6 +151,12 @@ protected:
        the following function must be called with the corresponding item.
     */
     void setActuallyLoadedItem(Item* item);
+
+    /**
+       This function returns the data given by the preload function when it is called in
+       the load function. nullptr is returned if the file has not been preloaded.
+    */
+    Referenced* preloadedData();
     
 private:
     Impl* impl;
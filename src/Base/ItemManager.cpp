@@ -477,6 +477,40 @@ Item* ItemManager::createItem(const std::string& moduleName, const std::string&
 }
 
 
+static ClassInfo* findClassInfo
+(const std::string& moduleName, const std::string& className, bool searchOtherModules)
+{
+    ClassInfo* info = nullptr;
+    
+    auto p = moduleNameToItemManagerImplMap.find(moduleName);
+    if(p == moduleNameToItemManagerImplMap.end()){
+        if(auto alias = PluginManager::instance()->guessActualPluginName(moduleName)){
+            p = moduleNameToItemManagerImplMap.find(alias);
+        }
+    }
+    if(p != moduleNameToItemManagerImplMap.end()){
+        auto& itemClassNameToInfoMap = p->second->itemClassNameToInfoMap;
+        auto q = itemClassNameToInfoMap.find(className);
+        if(q != itemClassNameToInfoMap.end()){
+            info = q->second;
+        }
+    }
+    if(!info && searchOtherModules){
+        auto r = aliasClassNameToAliasModuleNameToTrueNamePairMap.find(className);
+        if(r != aliasClassNameToAliasModuleNameToTrueNamePairMap.end()){
+            auto& aliasModuleNameToTrueNamePairMap = r->second;
+            auto s = aliasModuleNameToTrueNamePairMap.find(moduleName);
+            if(s != aliasModuleNameToTrueNamePairMap.end()){
+                auto& trueNamePair = s->second;
+                info = findClassInfo(trueNamePair.first, trueNamePair.second, false);
+            }
+        }
+    }
+
+    return info;
+}
+
+
 Item* ItemManager::createItemWithDialog_
 (const std::type_info& type, Item* parentItem, bool doAddition, Item* nextItem, Item* protoItem, const std::string& title)
 {
@@ -922,22 +956,10 @@ ItemFileIO* ItemManager::findFileIO(const std::type_info& type, const std::strin
 }
 
 
-ItemFileIO* ItemManager::Impl::findMatchedFileIO
-(const type_info& type, const string& filename, const string& formatId, int ioTypeFlag)
+static ItemFileIO* findMatchedFileIOIn
+(const vector<ItemFileIOPtr>& fileIOs, const string& filename, const string& formatId, int ioTypeFlag)
 {
     ItemFileIO* targetFileIO = nullptr;
-    
-    auto p = itemClassIdToInfoMap.find(itemClassRegistry->classId(type));
-    if(p == itemClassIdToInfoMap.end()){
-        messageView->putln(
-            format(_("\"{0}\" cannot be accessed because the specified item type \"{1}\" is not registered."),
-                   filename, type.name()),
-            MessageView::Error);
-        return targetFileIO;;
-    }
-    
-    ClassInfoPtr& classInfo = p->second;
-    auto& fileIOs = classInfo->fileIOs;
 
     if(!formatId.empty() || filename.empty()){
         for(auto& fileIO : fileIOs){
@@ -969,6 +991,27 @@ ItemFileIO* ItemManager::Impl::findMatchedFileIO
         }
     }
 
+    return targetFileIO;
+}
+
+
+ItemFileIO* ItemManager::Impl::findMatchedFileIO
+(const type_info& type, const string& filename, const string& formatId, int ioTypeFlag)
+{
+    ItemFileIO* targetFileIO = nullptr;
+    
+    auto p = itemClassIdToInfoMap.find(itemClassRegistry->classId(type));
+    if(p == itemClassIdToInfoMap.end()){
+        messageView->putln(
+            format(_("\"{0}\" cannot be accessed because the specified item type \"{1}\" is not registered."),
+                   filename, type.name()),
+            MessageView::Error);
+        return targetFileIO;;
+    }
+    
+    ClassInfoPtr& classInfo = p->second;
+    targetFileIO = findMatchedFileIOIn(classInfo->fileIOs, filename, formatId, ioTypeFlag);
+
     if(!targetFileIO){
         if(formatId.empty()){
             messageView->putln(
@@ -986,6 +1029,17 @@ ItemFileIO* ItemManager::Impl::findMatchedFileIO
 }
 
 
+ItemFileIO* ItemManager::findFileIOToLoad
+(const std::string& moduleName, const std::string& className,
+ const std::string& filename, const std::string& formatId)
+{
+    if(auto info = findClassInfo(moduleName, className, true)){
+        return findMatchedFileIOIn(info->fileIOs, filename, formatId, ItemFileIO::Load);
+    }
+    return nullptr;
+}
+
+
 namespace {
 
 // Defined to use existing loaders and savers based on FileFunctionBase for the backward compatiblity
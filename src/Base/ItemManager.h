@@ -181,6 +181,15 @@ public:
 
     static ItemFileIO* findFileIO(const std::type_info& type, const std::string& formatId);
 
+    /**
+       This function returns the file IO which is used to load the file into an item of
+       the class specified by the names without creating the item. nullptr is returned if
+       the file IO is not determined.
+    */
+    static ItemFileIO* findFileIOToLoad(
+        const std::string& moduleName, const std::string& className,
+        const std::string& filename, const std::string& formatId);
+
     template <class ItemType>
     ItemManager& addLoader(
         const std::string& caption, const std::string& formatId, const std::string& extensions, 
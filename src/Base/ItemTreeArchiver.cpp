@@ -7,11 +7,16 @@
 #include "RootItem.h"
 #include "SubProjectItem.h"
 #include "ItemManager.h"
+#include "ItemFileIO.h"
 #include "MessageView.h"
 #include "Archive.h"
 #include <cnoid/YAMLReader>
 #include <cnoid/YAMLWriter>
+#include <cnoid/FilePathVariableProcessor>
+#include <cnoid/ThreadPool>
 #include <set>
+#include <thread>
+#include <algorithm>
 #include <fmt/format.h>
 #include "gettext.h"
 
@@ -30,12 +35,15 @@ public:
     int numArchivedItems;
     int numRestoredItems;
     const std::set<std::string>* pOptionalPlugins;
+    bool isFilePreloadingEnabled;
+    std::set<ItemFileIOPtr> preloadingFileIOs;
 
     Impl();
     ArchivePtr store(Archive& parentArchive, Item* item);
     ArchivePtr storeIter(Archive& parentArchive, Item* item, bool& isComplete);
     void storeAddons(Archive& archive, Item* item);
     ItemList<> restore(Archive& archive, Item* parentItem, const std::set<std::string>& optionalPlugins);
+    void startFilePreloadingIter(Archive& archive, ThreadPool& threadPool);
     void restoreItemIter(Archive& archive, Item* parentItem, ItemList<>& restoredItems);
     ItemPtr restoreItem(
         Archive& archive, Item* parentItem, ItemList<>& restoredItems, string& out_itemName, bool& io_isOptional);
@@ -57,7 +65,7 @@ ItemTreeArchiver::Impl::Impl()
     : mv(MessageView::instance()),
       os(mv->cout())
 {
-    
+    isFilePreloadingEnabled = false;
 }
 
 
@@ -76,6 +84,18 @@ void ItemTreeArchiver::reset()
 }
 
 
+void ItemTreeArchiver::setFilePreloadingEnabled(bool on)
+{
+    impl->isFilePreloadingEnabled = on;
+}
+
+
+bool ItemTreeArchiver::isFilePreloadingEnabled() const
+{
+    return impl->isFilePreloadingEnabled;
+}
+
+
 int ItemTreeArchiver::numArchivedItems() const
 {
     return impl->numArchivedItems;
@@ -246,6 +266,16 @@ ItemList<> ItemTreeArchiver::Impl::restore
     pOptionalPlugins = &optionalPlugins;
     ItemList<> restoredItems;
 
+    unique_ptr<ThreadPool> threadPool;
+    if(isFilePreloadingEnabled){
+        threadPool.reset(new ThreadPool(std::max(1u, std::thread::hardware_concurrency())));
+        try {
+            startFilePreloadingIter(archive, *threadPool);
+        } catch (const ValueNode::Exception& ex){
+            // The error is reported in the restoration
+        }
+    }
+
     archive.setCurrentParentItem(nullptr);
     try {
         restoreItemIter(archive, parentItem, restoredItems);
@@ -254,11 +284,58 @@ ItemList<> ItemTreeArchiver::Impl::restore
     }
     archive.setCurrentParentItem(nullptr);
 
+    for(auto& fileIO : preloadingFileIOs){
+        fileIO->clearPreloadedData();
+    }
+    preloadingFileIOs.clear();
+
     numRestoredItems = restoredItems.size();
     return restoredItems;
 }
 
 
+/**
+   The items are not created in this function. The file IO to load the file of each item
+   is determined from the item class and the file information in the archive.
+*/
+void ItemTreeArchiver::Impl::startFilePreloadingIter(Archive& archive, ThreadPool& threadPool)
+{
+    string pluginName;
+    string className;
+    if(!archive.get("isSubItem", false) &&
+       archive.read("plugin", pluginName) && archive.read("class", className)){
+
+        ValueNode* dataNode = archive.find("data");
+        if(dataNode->isValid() && dataNode->isMapping()){
+            Archive* dataArchive = static_cast<Archive*>(dataNode->toMapping());
+            dataArchive->inheritSharedInfoFrom(archive);
+            string relocatable;
+            if(dataArchive->read("file", relocatable) || dataArchive->read("filename", relocatable)){
+                auto filename = archive.filePathVariableProcessor()->expand(relocatable, true);
+                if(!filename.empty()){
+                    string format;
+                    dataArchive->read("format", format);
+                    auto fileIO = ItemManager::findFileIOToLoad(pluginName, className, filename, format);
+                    if(fileIO && fileIO->startPreloading(filename, threadPool)){
+                        preloadingFileIOs.insert(fileIO);
+                    }
+                }
+            }
+        }
+    }
+
+    ListingPtr children = archive.findListing("children");
+    if(children->isValid()){
+        for(int i=0; i < children->size(); ++i){
+            if(auto childArchive = dynamic_cast<Archive*>(children->at(i)->toMapping())){
+                childArchive->inheritSharedInfoFrom(archive);
+                startFilePreloadingIter(*childArchive, threadPool);
+            }
+        }
+    }
+}
+
+
 void ItemTreeArchiver::Impl::restoreItemIter(Archive& archive, Item* parentItem, ItemList<>& restoredItems)
 {
     ItemPtr item;
@@ -20,6 +20,15 @@ public:
     ItemTreeArchiver();
     ~ItemTreeArchiver();
     void reset();
+
+    /**
+       When this option is enabled, the files of the items are preloaded by worker threads
+       before the items are restored in the original order. The files are preloaded only by
+       the file IOs that support the preload API.
+    */
+    void setFilePreloadingEnabled(bool on);
+    bool isFilePreloadingEnabled() const;
+    
     ArchivePtr store(Archive* parentArchive, Item* topItem);
     ItemList<> restore(Archive* archive, Item* parentItem, const std::set<std::string>& optionalPlugins);
     int numArchivedItems() const;
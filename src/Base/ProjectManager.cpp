@@ -44,6 +44,7 @@ ProjectManager* instance_ = nullptr;
 bool defaultOptionToSotreLayoutInProjectFile = true;
 int projectBeingLoadedCounter = 0;
 Action* perspectiveCheck = nullptr;
+Action* parallelFileLoadingCheck = nullptr;
 MainWindow* mainWindow = nullptr;
 MessageView* mv = nullptr;
 
@@ -186,6 +187,11 @@ ProjectManager::Impl::Impl(ProjectManager* self, ExtensionManager* ext)
     perspectiveCheck->setChecked(isPerspectiveChecked);
     perspectiveCheck->sigToggled().connect([&](bool on){ onPerspectiveCheckToggled(on); });
 
+    parallelFileLoadingCheck = mm.addCheckItem(_("Parallel File Loading"));
+    parallelFileLoadingCheck->setChecked(managerConfig->get("parallel_file_loading", true));
+    parallelFileLoadingCheck->sigToggled().connect(
+        [&](bool on){ managerConfig->write("parallel_file_loading", on); });
+
     mm.setPath("/File");
     mm.addSeparator();
 
@@ -470,6 +476,8 @@ ItemList<> ProjectManager::Impl::loadProject
             }
 
             itemTreeArchiver.reset();
+            itemTreeArchiver.setFilePreloadingEnabled(
+                parallelFileLoadingCheck && parallelFileLoadingCheck->isChecked());
             Archive* items = archive->findSubArchive("items");
             if(items->isValid()){
                 items->inheritSharedInfoFrom(*archive);
@@ -5,6 +5,7 @@
 
 #include "SceneItem.h"
 #include "ItemManager.h"
+#include "ItemFileIO.h"
 #include "Archive.h"
 #include "PutPropertyFunction.h"
 #include <cnoid/SceneLoader>
@@ -17,27 +18,49 @@ using namespace cnoid;
 
 namespace {
 
-bool loadScene(SceneItem* item, const std::string& filename, std::ostream& os)
+class SceneFileIO : public ItemFileIOBase<SceneItem>
 {
-    static SceneLoader* loader = 0;
-    if(!loader){
-        loader = new SceneLoader;
-        loader->setMessageSink(mvout(true));
+    unique_ptr<SceneLoader> sceneLoader;
+    
+public:
+    SceneFileIO(const std::string& caption, const std::string& formatId, InterfaceLevel level)
+        : ItemFileIOBase<SceneItem>(formatId, Load | Preload)
+    {
+        setCaption(caption);
+        setInterfaceLevel(level);
+    }
+
+    virtual ReferencedPtr preload(const std::string& filename, std::ostream& os) override
+    {
+        SceneLoader loader;
+        loader.setMessageSink(os);
+        return loader.load(filename);
     }
-    auto scene = loader->load(filename);
-    if(scene){
-        auto group = new SgInvariantGroup;
-        group->addChild(scene);
-        auto topNode = item->topNode();
-        topNode->clearChildren();
-        topNode->addChild(group);
-        if(item->isLightweightRenderingEnabled()){
-            item->setLightweightRenderingEnabled(true);
+
+    virtual bool load(SceneItem* item, const std::string& filename) override
+    {
+        SgNodePtr scene = dynamic_cast<SgNode*>(preloadedData());
+        if(!scene){
+            if(!sceneLoader){
+                sceneLoader.reset(new SceneLoader);
+                sceneLoader->setMessageSink(os());
+            }
+            scene = sceneLoader->load(filename);
         }
-        return true;
+        if(scene){
+            auto group = new SgInvariantGroup;
+            group->addChild(scene);
+            auto topNode = item->topNode();
+            topNode->clearChildren();
+            topNode->addChild(group);
+            if(item->isLightweightRenderingEnabled()){
+                item->setLightweightRenderingEnabled(true);
+            }
+            return true;
+        }
+        return false;
     }
-    return false;
-}
+};
 
 }
 
@@ -46,28 +69,20 @@ void SceneItem::initializeClass(ExtensionManager* ext)
 {
     static bool initialized = false;
     if(!initialized){
-        ext->itemManager().registerClass<SceneItem>(N_("SceneItem"));
-
-        ext->itemManager().addLoader<SceneItem>(
-            _("Scene"), "AVAILABLE-SCENE-FILE", SceneLoader::availableFileExtensions,
-            [&](SceneItem* item, const std::string& filename, std::ostream& os, Item* parentItem){
-                return ::loadScene(item, filename, os);
-            },
-            ItemManager::PRIORITY_CONVERSION);
-
-        ext->itemManager().addLoader<SceneItem>(
-            "VRML", "VRML-FILE", "wrl",
-            [&](SceneItem* item, const std::string& filename, std::ostream& os, Item* parentItem){
-                return ::loadScene(item, filename, os);
-            },
-            ItemManager::PRIORITY_COMPATIBILITY);
-
-        ext->itemManager().addLoader<SceneItem>(
-            "Stereolithography (STL)", "STL-FILE", "stl",
-            [&](SceneItem* item, const std::string& filename, std::ostream& os, Item* parentItem){
-                return ::loadScene(item, filename, os);
-            },
-            ItemManager::PRIORITY_COMPATIBILITY);
+        auto& im = ext->itemManager();
+        im.registerClass<SceneItem>(N_("SceneItem"));
+
+        auto sceneFileIO = new SceneFileIO(_("Scene"), "AVAILABLE-SCENE-FILE", ItemFileIO::Conversion);
+        sceneFileIO->setExtensionFunction(SceneLoader::availableFileExtensions);
+        im.registerFileIO<SceneItem>(sceneFileIO);
+
+        auto vrmlFileIO = new SceneFileIO("VRML", "VRML-FILE", ItemFileIO::Internal);
+        vrmlFileIO->setExtension("wrl");
+        im.registerFileIO<SceneItem>(vrmlFileIO);
+
+        auto stlFileIO = new SceneFileIO("Stereolithography (STL)", "STL-FILE", ItemFileIO::Internal);
+        stlFileIO->setExtension("stl");
+        im.registerFileIO<SceneItem>(stlFileIO);
 
         initialized = true;
     }
@@ -41,7 +41,7 @@ public:
     
     Impl();
     ~Impl();
-    SgNode* loadScene(SceneItemFileIO* self, const std::string& filename);
+    SgNode* loadScene(SceneItemFileIO* self, const std::string& filename, SgNode* preloadedScene);
     void createOptionPanel();    
 };
 
@@ -65,7 +65,7 @@ SceneItemFileIO::SceneItemFileIO(int api)
 
 
 SceneItemFileIO::SceneItemFileIO()
-    : SceneItemFileIO(Load | Options | OptionPanelForLoading)
+    : SceneItemFileIO(Load | Options | OptionPanelForLoading | Preload)
 {
 
 }
@@ -105,28 +105,41 @@ SceneItemFileIO::Impl::~Impl()
 }
 
 
-SgNode* SceneItemFileIO::loadScene(const std::string& filename)
+ReferencedPtr SceneItemFileIO::preload(const std::string& filename, std::ostream& os)
 {
-    return impl->loadScene(this, filename);
+    // The options are applied in the loadScene function
+    SceneLoader sceneLoader;
+    sceneLoader.setMessageSink(os);
+    return sceneLoader.load(filename);
 }
 
 
-SgNode* SceneItemFileIO::Impl::loadScene(SceneItemFileIO* self, const std::string& filename)
+SgNode* SceneItemFileIO::loadScene(const std::string& filename)
 {
-    if(!sceneLoader){
-        sceneLoader.reset(new SceneLoader);
-        sceneLoader->setMessageSink(self->os());
-    }
+    return impl->loadScene(this, filename, dynamic_cast<SgNode*>(preloadedData()));
+}
 
-    bool isSupported;
-    SgNode* scene = sceneLoader->load(filename, isSupported);
+
+SgNode* SceneItemFileIO::Impl::loadScene
+(SceneItemFileIO* self, const std::string& filename, SgNode* preloadedScene)
+{
+    SgNode* scene = preloadedScene;
 
     if(!scene){
-        if(!isSupported){
-            auto fname = toUTF8(stdx::filesystem::path(fromUTF8(filename)).filename().string());
-            self->putError(format(_("The file format of \"{}\" is not supported.\n"), fname));
+        if(!sceneLoader){
+            sceneLoader.reset(new SceneLoader);
+            sceneLoader->setMessageSink(self->os());
+        }
+        bool isSupported;
+        scene = sceneLoader->load(filename, isSupported);
+
+        if(!scene){
+            if(!isSupported){
+                auto fname = toUTF8(stdx::filesystem::path(fromUTF8(filename)).filename().string());
+                self->putError(format(_("The file format of \"{}\" is not supported.\n"), fname));
+            }
+            return nullptr;
         }
-        return nullptr;
     }
 
     SgNodePtr topNode = scene;
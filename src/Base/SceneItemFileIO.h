@@ -17,7 +17,8 @@ public:
 
 protected:
     SgNode* loadScene(const std::string& filename);
-    
+
+    virtual ReferencedPtr preload(const std::string& filename, std::ostream& os) override;
     virtual void resetOptions() override;
     virtual void storeOptions(Mapping* archive) override;
     virtual bool restoreOptions(const Mapping* archive) override;
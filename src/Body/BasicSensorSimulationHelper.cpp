@@ -202,3 +202,33 @@ void BasicSensorSimulationHelper::updateGyroAndAccelerationSensors()
         }
     }
 }
+
+
+int BasicSensorSimulationHelper::stateSize() const
+{
+    return impl->kfStates.size() * 6;
+}
+
+
+double* BasicSensorSimulationHelper::writeState(double* out_buf) const
+{
+    for(auto& s : impl->kfStates){
+        for(int i=0; i < 3; ++i){
+            Eigen::Map<Vector2>(out_buf) << s.x[i];
+            out_buf += 2;
+        }
+    }
+    return out_buf;
+}
+
+
+const double* BasicSensorSimulationHelper::readState(const double* buf)
+{
+    for(auto& s : impl->kfStates){
+        for(int i=0; i < 3; ++i){
+            s.x[i] = Eigen::Map<const Vector2>(buf);
+            buf += 2;
+        }
+    }
+    return buf;
+}
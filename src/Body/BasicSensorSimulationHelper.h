@@ -36,6 +36,11 @@ public:
         
     void updateGyroAndAccelerationSensors();
 
+    //! The internal state of the filter for the acceleration sensors in the old calculation mode
+    int stateSize() const;
+    double* writeState(double* out_buf) const;
+    const double* readState(const double* buf);
+
 private:
     BasicSensorSimulationHelperImpl* impl;
     bool isActive_;
@@ -13,6 +13,7 @@
 #include <cnoid/stdx/filesystem>
 #include <map>
 #include <set>
+#include <mutex>
 #include <cstdlib>
 #include <iostream>
 #include <fmt/format.h>
@@ -192,6 +193,8 @@ static int loadBodyCustomizers(BodyInterface* bodyInterface, std::ostream& os)
 int cnoid::loadDefaultBodyCustomizers(std::ostream& os)
 {
     static bool loaded = false;
+    static std::mutex loadingMutex; // Bodies may be loaded in multiple threads
+    std::lock_guard<std::mutex> lock(loadingMutex);
     int numLoaded = 0;
     if(!loaded){
         numLoaded = ::loadBodyCustomizers(Body::bodyInterface(), os);
@@ -6,6 +6,7 @@
 #include "BodyState.h"
 #include "Body.h"
 #include "Link.h"
+#include "BodyStateArena.h"
 
 using namespace std;
 using namespace cnoid;
@@ -70,6 +71,69 @@ void BodyState::storePositions(const Body& body)
 }
 
 
+void BodyState::storeStateArena(const Body& body)
+{
+    BodyStateArena arena(body);
+    arena.store(data(LINK_STATE_ARENA));
+}
+
+
+bool BodyState::restoreStateArena(Body& io_body) const
+{
+    BodyStateArena arena;
+    arena.resize(io_body.numLinks());
+    return arena.restore(data(LINK_STATE_ARENA)) && arena.scatter(io_body);
+}
+
+
+void BodyState::storeCompleteState(const Body& body)
+{
+    storeStateArena(body);
+
+    Data& deviceStates = data(DEVICE_STATES);
+    const auto& devices = body.devices();
+    int size = 0;
+    for(auto& device : devices){
+        size += device->stateSize();
+    }
+    deviceStates.resize(size);
+    double* p = deviceStates.data();
+    for(auto& device : devices){
+        p = device->writeState(p);
+    }
+}
+
+
+bool BodyState::checkCompleteState(const Body& body) const
+{
+    if(data(LINK_STATE_ARENA).size() != BodyStateArena::calcDataSize(body.numLinks())){
+        return false;
+    }
+    int size = 0;
+    for(auto& device : body.devices()){
+        size += device->stateSize();
+    }
+    return static_cast<int>(data(DEVICE_STATES).size()) == size;
+}
+
+
+bool BodyState::restoreCompleteState(Body& io_body) const
+{
+    if(!checkCompleteState(io_body)){
+        return false;
+    }
+
+    restoreStateArena(io_body);
+
+    const double* p = data(DEVICE_STATES).data();
+    for(auto& device : io_body.devices()){
+        p = device->readState(p);
+    }
+
+    return true;
+}
+
+
 void BodyState::setZMP(const Vector3& zmp)
 {
     Data& zmpData = data(ZMP);
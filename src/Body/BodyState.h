@@ -25,7 +25,9 @@ public:
         JOINT_POSITIONS,
         LINK_POSITIONS,
         JOINT_FORCE_OR_TORQUE,
-        ZMP
+        ZMP,
+        LINK_STATE_ARENA,
+        DEVICE_STATES
     };
 
     BodyState();
@@ -39,6 +41,25 @@ public:
     void storePositions(const Body& body);
     bool restorePositions(Body& io_body) const;
 
+    /**
+       These functions copy all the state variables of the links in the format of BodyStateArena.
+       restoreStateArena() returns false if the stored data does not match the body.
+    */
+    void storeStateArena(const Body& body);
+    bool restoreStateArena(Body& io_body) const;
+
+    /**
+       These functions copy all the state variables of the links and the states of the devices
+       so that the exact state of a body in a simulation can be restored.
+       \return false if the stored data does not match the body. The body is not modified
+       in that case.
+    */
+    void storeCompleteState(const Body& body);
+    bool restoreCompleteState(Body& io_body) const;
+
+    //! \return true if the stored data matches the body and can be restored by restoreCompleteState
+    bool checkCompleteState(const Body& body) const;
+
     void setRootLinkPosition(const Isometry3& T);
     void setRootLinkPosition(const SE3& position);
     bool getRootLinkPosition(Isometry3& out_T) const;
@@ -0,0 +1,176 @@
+#include "BodyStateArena.h"
+#include "Body.h"
+#include "Link.h"
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+template<class T> size_t getBlockSize(int numLinks)
+{
+    // The size is rounded up to a multiple of 64 bytes so that the offset of each block from the
+    // beginning of the buffer is a multiple of 64 bytes. The buffer itself is only aligned to
+    // EIGEN_MAX_ALIGN_BYTES by the allocator.
+    const size_t size = numLinks * sizeof(T) / sizeof(double);
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+}
+
+
+BodyStateArena::BodyStateArena()
+{
+    numLinks_ = 0;
+    setArrayPointers();
+}
+
+
+BodyStateArena::BodyStateArena(const Body& body)
+    : BodyStateArena()
+{
+    gather(body);
+}
+
+
+BodyStateArena::BodyStateArena(const BodyStateArena& org)
+    : buf(org.buf),
+      numLinks_(org.numLinks_)
+{
+    setArrayPointers();
+}
+
+
+BodyStateArena& BodyStateArena::operator=(const BodyStateArena& rhs)
+{
+    if(this != &rhs){
+        buf = rhs.buf;
+        numLinks_ = rhs.numLinks_;
+        setArrayPointers();
+    }
+    return *this;
+}
+
+
+size_t BodyStateArena::calcDataSize(int numLinks)
+{
+    return getBlockSize<Isometry3>(numLinks) + getBlockSize<Vector6>(numLinks) +
+        getBlockSize<Vector3>(numLinks) * 4 + getBlockSize<double>(numLinks) * 6;
+}
+
+
+void BodyStateArena::resize(int numLinks)
+{
+    if(numLinks != numLinks_){
+        numLinks_ = numLinks;
+        buf.resize(calcDataSize(numLinks));
+        setArrayPointers();
+    }
+}
+
+
+void BodyStateArena::setArrayPointers()
+{
+    const int n = numLinks_;
+    double* p = buf.data();
+    T_ = reinterpret_cast<Isometry3*>(p);
+    p += getBlockSize<Isometry3>(n);
+    F_ext_ = reinterpret_cast<Vector6*>(p);
+    p += getBlockSize<Vector6>(n);
+    const size_t size3 = getBlockSize<Vector3>(n);
+    v_ = reinterpret_cast<Vector3*>(p);
+    p += size3;
+    w_ = reinterpret_cast<Vector3*>(p);
+    p += size3;
+    dv_ = reinterpret_cast<Vector3*>(p);
+    p += size3;
+    dw_ = reinterpret_cast<Vector3*>(p);
+    p += size3;
+    const size_t size1 = getBlockSize<double>(n);
+    q_ = p;
+    p += size1;
+    dq_ = p;
+    p += size1;
+    ddq_ = p;
+    p += size1;
+    q_target_ = p;
+    p += size1;
+    dq_target_ = p;
+    p += size1;
+    u_ = p;
+}
+
+
+void BodyStateArena::gather(const Body& body)
+{
+    const int n = body.numLinks();
+    resize(n);
+    for(int i=0; i < n; ++i){
+        const Link* link = body.link(i);
+        T_[i] = link->T();
+        F_ext_[i] = link->F_ext();
+        v_[i] = link->v();
+        w_[i] = link->w();
+        dv_[i] = link->dv();
+        dw_[i] = link->dw();
+        q_[i] = link->q();
+        dq_[i] = link->dq();
+        ddq_[i] = link->ddq();
+        q_target_[i] = link->q_target();
+        dq_target_[i] = link->dq_target();
+        u_[i] = link->u();
+    }
+}
+
+
+bool BodyStateArena::scatter(Body& io_body) const
+{
+    const int n = io_body.numLinks();
+    if(n != numLinks_){
+        return false;
+    }
+    for(int i=0; i < n; ++i){
+        Link* link = io_body.link(i);
+        link->T() = T_[i];
+        link->F_ext() = F_ext_[i];
+        link->v() = v_[i];
+        link->w() = w_[i];
+        link->dv() = dv_[i];
+        link->dw() = dw_[i];
+        link->q() = q_[i];
+        link->dq() = dq_[i];
+        link->ddq() = ddq_[i];
+        link->q_target() = q_target_[i];
+        link->dq_target() = dq_target_[i];
+        link->u() = u_[i];
+    }
+    return true;
+}
+
+
+void BodyStateArena::store(std::vector<double>& out_data) const
+{
+    out_data.resize(buf.size());
+    if(!buf.empty()){
+        std::memcpy(out_data.data(), buf.data(), buf.size() * sizeof(double));
+    }
+}
+
+
+bool BodyStateArena::restore(const std::vector<double>& data)
+{
+    return restore(data.data(), data.size());
+}
+
+
+bool BodyStateArena::restore(const double* data, size_t size)
+{
+    if(size != buf.size()){
+        return false;
+    }
+    if(size > 0){
+        std::memcpy(buf.data(), data, size * sizeof(double));
+    }
+    return true;
+}
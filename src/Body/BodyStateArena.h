@@ -0,0 +1,105 @@
+#ifndef CNOID_BODY_BODY_STATE_ARENA_H
+#define CNOID_BODY_BODY_STATE_ARENA_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   This class holds a snapshot of the state variables of the links of a body in a contiguous
+   memory block.
+
+   Each state variable is stored in an array indexed by the link index, and the arrays are
+   placed one after another in the block. The values are copied from the links by gather() and
+   copied back by scatter(), so the links keep their own state variables and the arena does not
+   affect the access to them. The arrays can be processed for all the links at once, and the
+   whole snapshot can be stored and restored with a single memory copy.
+*/
+class CNOID_EXPORT BodyStateArena
+{
+public:
+    BodyStateArena();
+    BodyStateArena(const Body& body);
+    BodyStateArena(const BodyStateArena& org);
+    BodyStateArena& operator=(const BodyStateArena& rhs);
+
+    //! The size of the arrays is set for the given number of links. The values are not kept.
+    void resize(int numLinks);
+
+    int numLinks() const { return numLinks_; }
+
+    //! The state variables of the links of the body are copied into the arena
+    void gather(const Body& body);
+
+    /**
+       The state variables in the arena are copied into the links of the body.
+       \return false if the number of the links does not match the arena. The body is not
+       modified in that case.
+    */
+    bool scatter(Body& io_body) const;
+
+    Isometry3* T() { return T_; }
+    const Isometry3* T() const { return T_; }
+    Vector6* F_ext() { return F_ext_; }
+    const Vector6* F_ext() const { return F_ext_; }
+    Vector3* v() { return v_; }
+    const Vector3* v() const { return v_; }
+    Vector3* w() { return w_; }
+    const Vector3* w() const { return w_; }
+    Vector3* dv() { return dv_; }
+    const Vector3* dv() const { return dv_; }
+    Vector3* dw() { return dw_; }
+    const Vector3* dw() const { return dw_; }
+    double* q() { return q_; }
+    const double* q() const { return q_; }
+    double* dq() { return dq_; }
+    const double* dq() const { return dq_; }
+    double* ddq() { return ddq_; }
+    const double* ddq() const { return ddq_; }
+    double* q_target() { return q_target_; }
+    const double* q_target() const { return q_target_; }
+    double* dq_target() { return dq_target_; }
+    const double* dq_target() const { return dq_target_; }
+    double* u() { return u_; }
+    const double* u() const { return u_; }
+
+    //! The whole block of the state variables
+    const double* data() const { return buf.data(); }
+    size_t dataSize() const { return buf.size(); }
+
+    //! \return The size of the block for the given number of links
+    static size_t calcDataSize(int numLinks);
+
+    void store(std::vector<double>& out_data) const;
+
+    //! \return false if the size of the data does not match the arena
+    bool restore(const std::vector<double>& data);
+    bool restore(const double* data, size_t size);
+
+private:
+    std::vector<double, Eigen::aligned_allocator<double>> buf;
+    int numLinks_;
+
+    Isometry3* T_;
+    Vector6* F_ext_;
+    Vector3* v_;
+    Vector3* w_;
+    Vector3* dv_;
+    Vector3* dw_;
+    double* q_;
+    double* dq_;
+    double* ddq_;
+    double* q_target_;
+    double* dq_target_;
+    double* u_;
+
+    void setArrayPointers();
+};
+
+}
+
+#endif
@@ -0,0 +1,585 @@
+#include "CompiledKinematicModel.h"
+#include "Body.h"
+#include "Link.h"
+#include "LinkTraverse.h"
+#include "JointPath.h"
+#include <cnoid/EigenUtil>
+#include <fmt/format.h>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+using namespace cnoid;
+using Eigen::ArrayXd;
+using Eigen::VectorXi;
+typedef Eigen::Matrix<double, 6, 6> Matrix6;
+
+namespace {
+
+enum JointType { FIXED, ROTATIONAL, SLIDE };
+
+// The indices of the position elements in the state arrays of a link
+constexpr int P = 0;
+constexpr int R = 3; // The elements of the rotation matrix in the row-major order follow the translation
+constexpr int NumStateElements = 12;
+
+inline int r(int row, int col) { return R + row * 3 + col; }
+
+struct LinkModel
+{
+    int parent;
+    int jointId;
+    JointType jointType;
+    Matrix3 Rb;
+    Vector3 b;
+    // Rb * [a]x and Rb * [a]x^2, with which the local rotation is Rb + sin(q) * K1 + (1 - cos(q)) * K2
+    Matrix3 K1;
+    Matrix3 K2;
+    // The joint axis in the link frame
+    Vector3 axis;
+    // The slide axis in the parent link frame
+    Vector3 Rb_d;
+    double q_lower;
+    double q_upper;
+};
+
+}
+
+namespace cnoid {
+
+class CompiledKinematicModel::Impl
+{
+public:
+    vector<LinkModel> links;
+    vector<int> traversalOrder;
+    int numJoints;
+    Isometry3 T_root;
+    int batchSize;
+    vector<ArrayXd> states;
+    ArrayXd sinq;
+    ArrayXd cosq1;
+    ArrayXd L[9];
+
+    int maxIkIterations;
+    double maxIkErrorSqr;
+    double ikDampingConstantSqr;
+    double ikDeltaScale;
+
+    Impl();
+    void compile(Body* body);
+    void checkLinkIndex(int linkIndex) const;
+    void checkConfigurations(const MatrixXd& Q) const;
+    ArrayXd& state(int linkIndex, int element) { return states[linkIndex * NumStateElements + element]; }
+    const ArrayXd& state(int linkIndex, int element) const { return states[linkIndex * NumStateElements + element]; }
+    void resizeStates(int n);
+    void calcForwardKinematics(const MatrixXd& Q, const vector<int>& order);
+    void calcLinkPosition(int linkIndex, const MatrixXd& Q);
+    vector<int> pathLinks(int linkIndex) const;
+    void calcJacobians(int linkIndex, const vector<int>& pathLinks, MatrixXd& out_J);
+    int calcInverseKinematics(int linkIndex, const PositionArray& targets, MatrixXd& io_Q, VectorXi& out_solved);
+};
+
+}
+
+
+CompiledKinematicModel::CompiledKinematicModel()
+{
+    impl = new Impl;
+}
+
+
+CompiledKinematicModel::CompiledKinematicModel(Body* body)
+{
+    impl = new Impl;
+    impl->compile(body);
+}
+
+
+CompiledKinematicModel::Impl::Impl()
+{
+    numJoints = 0;
+    T_root.setIdentity();
+    batchSize = 0;
+    maxIkIterations = JointPath::numericalIKdefaultMaxIterations();
+    double e = JointPath::numericalIKdefaultMaxIKerror();
+    maxIkErrorSqr = e * e;
+    double d = JointPath::numericalIKdefaultDampingConstant();
+    ikDampingConstantSqr = d * d;
+    ikDeltaScale = JointPath::numericalIKdefaultDeltaScale();
+}
+
+
+CompiledKinematicModel::~CompiledKinematicModel()
+{
+    delete impl;
+}
+
+
+void CompiledKinematicModel::Impl::checkLinkIndex(int linkIndex) const
+{
+    if(linkIndex < 0 || linkIndex >= static_cast<int>(links.size())){
+        throw std::invalid_argument(
+            fmt::format("CompiledKinematicModel: The link index {0} is out of the range of {1} links.",
+                        linkIndex, links.size()));
+    }
+}
+
+
+void CompiledKinematicModel::Impl::checkConfigurations(const MatrixXd& Q) const
+{
+    if(Q.cols() != numJoints){
+        throw std::invalid_argument(
+            fmt::format("CompiledKinematicModel: The configuration matrix has {0} columns "
+                        "while the model has {1} joints.", Q.cols(), numJoints));
+    }
+}
+
+
+void CompiledKinematicModel::compile(Body* body)
+{
+    impl->compile(body);
+}
+
+
+void CompiledKinematicModel::Impl::compile(Body* body)
+{
+    const int numLinks = body->numLinks();
+    links.resize(numLinks);
+    numJoints = body->numJoints();
+    T_root = body->rootLink()->T();
+
+    for(int i=0; i < numLinks; ++i){
+        Link* link = body->link(i);
+        LinkModel& model = links[i];
+        model.parent = link->parent() ? link->parent()->index() : -1;
+        model.jointId = link->jointId();
+        model.Rb = link->Rb();
+        model.b = link->b();
+        model.q_lower = link->q_lower();
+        model.q_upper = link->q_upper();
+        model.K1.setZero();
+        model.K2.setZero();
+        model.axis.setZero();
+        model.Rb_d.setZero();
+
+        if(model.parent < 0 || model.jointId < 0 || model.jointId >= numJoints){
+            model.jointType = FIXED;
+            model.jointId = -1;
+        } else if(link->isRevoluteJoint()){
+            model.jointType = ROTATIONAL;
+            model.axis = link->a();
+            const Matrix3 S = hat(link->a());
+            model.K1 = model.Rb * S;
+            model.K2 = model.Rb * S * S;
+        } else if(link->isPrismaticJoint()){
+            model.jointType = SLIDE;
+            model.axis = link->d();
+            model.Rb_d = model.Rb * link->d();
+        } else {
+            model.jointType = FIXED;
+            model.jointId = -1;
+        }
+    }
+
+    traversalOrder.clear();
+    LinkTraverse traverse(body->rootLink());
+    for(auto& link : traverse){
+        traversalOrder.push_back(link->index());
+    }
+
+    states.clear();
+    states.resize(numLinks * NumStateElements);
+    batchSize = 0;
+}
+
+
+int CompiledKinematicModel::numLinks() const
+{
+    return impl->links.size();
+}
+
+
+int CompiledKinematicModel::numJoints() const
+{
+    return impl->numJoints;
+}
+
+
+void CompiledKinematicModel::setRootPosition(const Isometry3& T)
+{
+    impl->T_root = T;
+}
+
+
+void CompiledKinematicModel::Impl::resizeStates(int n)
+{
+    if(n != batchSize){
+        for(auto& a : states){
+            a.resize(n);
+        }
+        sinq.resize(n);
+        cosq1.resize(n);
+        for(int i=0; i < 9; ++i){
+            L[i].resize(n);
+        }
+        batchSize = n;
+    }
+}
+
+
+void CompiledKinematicModel::calcForwardKinematics(const MatrixXd& Q)
+{
+    impl->checkConfigurations(Q);
+    impl->resizeStates(Q.rows());
+    impl->calcForwardKinematics(Q, impl->traversalOrder);
+}
+
+
+void CompiledKinematicModel::Impl::calcForwardKinematics(const MatrixXd& Q, const vector<int>& order)
+{
+    for(auto& index : order){
+        calcLinkPosition(index, Q);
+    }
+}
+
+
+void CompiledKinematicModel::Impl::calcLinkPosition(int index, const MatrixXd& Q)
+{
+    const LinkModel& link = links[index];
+
+    if(link.parent < 0){
+        const Vector3 p = T_root.translation();
+        const Matrix3 R = T_root.linear();
+        for(int i=0; i < 3; ++i){
+            state(index, P + i).setConstant(p[i]);
+            for(int j=0; j < 3; ++j){
+                state(index, r(i, j)).setConstant(R(i, j));
+            }
+        }
+        return;
+    }
+
+    const int parent = link.parent;
+
+    switch(link.jointType){
+
+    case ROTATIONAL:
+    {
+        auto q = Q.col(link.jointId).array();
+        sinq = q.sin();
+        cosq1 = 1.0 - q.cos();
+        for(int k=0; k < 3; ++k){
+            for(int j=0; j < 3; ++j){
+                L[k * 3 + j] = link.Rb(k, j) + sinq * link.K1(k, j) + cosq1 * link.K2(k, j);
+            }
+        }
+        for(int i=0; i < 3; ++i){
+            const ArrayXd& Rp0 = state(parent, r(i, 0));
+            const ArrayXd& Rp1 = state(parent, r(i, 1));
+            const ArrayXd& Rp2 = state(parent, r(i, 2));
+            for(int j=0; j < 3; ++j){
+                state(index, r(i, j)) = Rp0 * L[j] + Rp1 * L[3 + j] + Rp2 * L[6 + j];
+            }
+            state(index, P + i) = state(parent, P + i) + Rp0 * link.b[0] + Rp1 * link.b[1] + Rp2 * link.b[2];
+        }
+        break;
+    }
+
+    case SLIDE:
+    case FIXED:
+    default:
+        for(int i=0; i < 3; ++i){
+            const ArrayXd& Rp0 = state(parent, r(i, 0));
+            const ArrayXd& Rp1 = state(parent, r(i, 1));
+            const ArrayXd& Rp2 = state(parent, r(i, 2));
+            for(int j=0; j < 3; ++j){
+                state(index, r(i, j)) = Rp0 * link.Rb(0, j) + Rp1 * link.Rb(1, j) + Rp2 * link.Rb(2, j);
+            }
+            state(index, P + i) = state(parent, P + i) + Rp0 * link.b[0] + Rp1 * link.b[1] + Rp2 * link.b[2];
+            if(link.jointType == SLIDE){
+                auto q = Q.col(link.jointId).array();
+                state(index, P + i) +=
+                    q * (Rp0 * link.Rb_d[0] + Rp1 * link.Rb_d[1] + Rp2 * link.Rb_d[2]);
+            }
+        }
+        break;
+    }
+}
+
+
+int CompiledKinematicModel::batchSize() const
+{
+    return impl->batchSize;
+}
+
+
+void CompiledKinematicModel::getLinkTranslations(int linkIndex, MatrixXd& out_p) const
+{
+    impl->checkLinkIndex(linkIndex);
+    out_p.resize(impl->batchSize, 3);
+    for(int i=0; i < 3; ++i){
+        out_p.col(i) = impl->state(linkIndex, P + i).matrix();
+    }
+}
+
+
+Isometry3 CompiledKinematicModel::linkPosition(int linkIndex, int configIndex) const
+{
+    impl->checkLinkIndex(linkIndex);
+    if(configIndex < 0 || configIndex >= impl->batchSize){
+        throw std::invalid_argument(
+            fmt::format("CompiledKinematicModel: The configuration index {0} is out of the range of "
+                        "the batch size {1}.", configIndex, impl->batchSize));
+    }
+    Isometry3 T;
+    T.makeAffine();
+    for(int i=0; i < 3; ++i){
+        T.translation()[i] = impl->state(linkIndex, P + i)[configIndex];
+        for(int j=0; j < 3; ++j){
+            T.linear()(i, j) = impl->state(linkIndex, r(i, j))[configIndex];
+        }
+    }
+    return T;
+}
+
+
+//! \return The links with the moving joints from the root to the link
+vector<int> CompiledKinematicModel::Impl::pathLinks(int linkIndex) const
+{
+    vector<int> path;
+    for(int index = linkIndex; index >= 0; index = links[index].parent){
+        if(links[index].jointType != FIXED){
+            path.push_back(index);
+        }
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+
+std::vector<int> CompiledKinematicModel::pathJointIds(int linkIndex) const
+{
+    impl->checkLinkIndex(linkIndex);
+    vector<int> ids;
+    for(auto& index : impl->pathLinks(linkIndex)){
+        ids.push_back(impl->links[index].jointId);
+    }
+    return ids;
+}
+
+
+void CompiledKinematicModel::calcJacobians(int linkIndex, MatrixXd& out_J)
+{
+    impl->checkLinkIndex(linkIndex);
+    impl->calcJacobians(linkIndex, impl->pathLinks(linkIndex), out_J);
+}
+
+
+void CompiledKinematicModel::Impl::calcJacobians(int linkIndex, const vector<int>& path, MatrixXd& out_J)
+{
+    const int n = path.size();
+    out_J.resize(batchSize, 6 * n);
+
+    for(int c=0; c < n; ++c){
+        const int index = path[c];
+        const LinkModel& link = links[index];
+        const int col = 6 * c;
+
+        if(link.jointType == ROTATIONAL){
+            for(int i=0; i < 3; ++i){
+                out_J.col(col + 3 + i) =
+                    (state(index, r(i, 0)) * link.axis[0] +
+                     state(index, r(i, 1)) * link.axis[1] +
+                     state(index, r(i, 2)) * link.axis[2]).matrix();
+            }
+            auto wx = out_J.col(col + 3).array();
+            auto wy = out_J.col(col + 4).array();
+            auto wz = out_J.col(col + 5).array();
+            // The arm from the joint to the link is kept in the work arrays
+            L[0] = state(linkIndex, P + 0) - state(index, P + 0);
+            L[1] = state(linkIndex, P + 1) - state(index, P + 1);
+            L[2] = state(linkIndex, P + 2) - state(index, P + 2);
+            out_J.col(col + 0) = (wy * L[2] - wz * L[1]).matrix();
+            out_J.col(col + 1) = (wz * L[0] - wx * L[2]).matrix();
+            out_J.col(col + 2) = (wx * L[1] - wy * L[0]).matrix();
+
+        } else { // SLIDE
+            for(int i=0; i < 3; ++i){
+                out_J.col(col + i) =
+                    (state(index, r(i, 0)) * link.axis[0] +
+                     state(index, r(i, 1)) * link.axis[1] +
+                     state(index, r(i, 2)) * link.axis[2]).matrix();
+                out_J.col(col + 3 + i).setZero();
+            }
+        }
+    }
+}
+
+
+void CompiledKinematicModel::setIkMaxIterations(int n)
+{
+    impl->maxIkIterations = n;
+}
+
+
+void CompiledKinematicModel::setIkMaxError(double e)
+{
+    impl->maxIkErrorSqr = e * e;
+}
+
+
+void CompiledKinematicModel::setIkDampingConstant(double lambda)
+{
+    impl->ikDampingConstantSqr = lambda * lambda;
+}
+
+
+void CompiledKinematicModel::setIkDeltaScale(double s)
+{
+    impl->ikDeltaScale = s;
+}
+
+
+int CompiledKinematicModel::calcInverseKinematics
+(int linkIndex, const PositionArray& targets, MatrixXd& io_Q, VectorXi& out_solved)
+{
+    impl->checkLinkIndex(linkIndex);
+    impl->checkConfigurations(io_Q);
+    if(static_cast<int>(targets.size()) != io_Q.rows()){
+        throw std::invalid_argument(
+            fmt::format("CompiledKinematicModel: The number of the targets {0} is different from "
+                        "the number of the configurations {1}.", targets.size(), io_Q.rows()));
+    }
+    return impl->calcInverseKinematics(linkIndex, targets, io_Q, out_solved);
+}
+
+
+/**
+   The iteration of each configuration follows the damped least squares method of JointPath.
+   The forward kinematics and the Jacobians are calculated for all the configurations together,
+   and the configurations that have converged or stalled are excluded from the updates.
+*/
+int CompiledKinematicModel::Impl::calcInverseKinematics
+(int linkIndex, const PositionArray& targets, MatrixXd& io_Q, VectorXi& out_solved)
+{
+    const int numConfigs = io_Q.rows();
+    out_solved.setZero(numConfigs);
+
+    const vector<int> path = pathLinks(linkIndex);
+    const int n = path.size();
+
+    // Only the ancestors of the target link are updated in the iterations
+    vector<int> order;
+    for(int index = linkIndex; index >= 0; index = links[index].parent){
+        order.push_back(index);
+    }
+    std::reverse(order.begin(), order.end());
+
+    const MatrixXd Q0 = io_Q;
+    vector<char> isActive(numConfigs, true);
+    vector<double> prevErrorSqr(numConfigs, std::numeric_limits<double>::max());
+    int numSolved = 0;
+
+    MatrixXd J;
+    Eigen::Matrix<double, 6, Eigen::Dynamic> Jk(6, n);
+    Vector6 dTask;
+    Matrix6 JJ;
+    VectorXd dq(n);
+
+    resizeStates(numConfigs);
+
+    for(int iteration = 0; iteration < maxIkIterations; ++iteration){
+
+        calcForwardKinematics(io_Q, order);
+        calcJacobians(linkIndex, path, J);
+
+        int numActive = 0;
+
+        for(int k=0; k < numConfigs; ++k){
+            if(!isActive[k]){
+                continue;
+            }
+            Vector3 p;
+            Matrix3 R;
+            for(int i=0; i < 3; ++i){
+                p[i] = state(linkIndex, P + i)[k];
+                for(int j=0; j < 3; ++j){
+                    R(i, j) = state(linkIndex, r(i, j))[k];
+                }
+            }
+            const Isometry3& T = targets[k];
+            dTask.head<3>() = T.translation() - p;
+            dTask.tail<3>() = R * omegaFromRot(R.transpose() * T.linear());
+            const double errorSqr = dTask.squaredNorm();
+
+            if(errorSqr < maxIkErrorSqr){
+                out_solved[k] = 1;
+                ++numSolved;
+                isActive[k] = false;
+                continue;
+            }
+            if(prevErrorSqr[k] - errorSqr < maxIkErrorSqr){
+                isActive[k] = false;
+                continue;
+            }
+            prevErrorSqr[k] = errorSqr;
+
+            for(int c=0; c < n; ++c){
+                for(int i=0; i < 6; ++i){
+                    Jk(i, c) = J(k, 6 * c + i);
+                }
+            }
+            JJ = Jk * Jk.transpose() + ikDampingConstantSqr * Matrix6::Identity();
+            dq = Jk.transpose() * JJ.ldlt().solve(dTask);
+
+            for(int c=0; c < n; ++c){
+                const LinkModel& link = links[path[c]];
+                double& q = io_Q(k, link.jointId);
+                q += ikDeltaScale * dq[c];
+                if(link.q_lower < link.q_upper){
+                    q = std::max(link.q_lower, std::min(link.q_upper, q));
+                }
+            }
+            ++numActive;
+        }
+
+        if(numActive == 0){
+            break;
+        }
+    }
+
+    // The configurations updated in the last iteration have not been checked yet
+    calcForwardKinematics(io_Q, order);
+    for(int k=0; k < numConfigs; ++k){
+        if(!isActive[k]){
+            continue;
+        }
+        Vector3 p;
+        Matrix3 R;
+        for(int i=0; i < 3; ++i){
+            p[i] = state(linkIndex, P + i)[k];
+            for(int j=0; j < 3; ++j){
+                R(i, j) = state(linkIndex, r(i, j))[k];
+            }
+        }
+        const Isometry3& T = targets[k];
+        const double errorSqr =
+            (T.translation() - p).squaredNorm() + omegaFromRot(R.transpose() * T.linear()).squaredNorm();
+        if(errorSqr < maxIkErrorSqr){
+            out_solved[k] = 1;
+            ++numSolved;
+        }
+    }
+
+    // The joint positions of the unsolved configurations are restored as JointPath does
+    for(int k=0; k < numConfigs; ++k){
+        if(!out_solved[k]){
+            io_Q.row(k) = Q0.row(k);
+        }
+    }
+
+    calcForwardKinematics(io_Q, traversalOrder);
+
+    return numSolved;
+}
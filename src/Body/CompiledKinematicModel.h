@@ -0,0 +1,100 @@
+#ifndef CNOID_BODY_COMPILED_KINEMATIC_MODEL_H
+#define CNOID_BODY_COMPILED_KINEMATIC_MODEL_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   This class evaluates the kinematics of many configurations of a body at once.
+   The link tree of a body is compiled into flat arrays of the parent indices, the joint types,
+   the offsets and the precomputed joint axis terms, and the forward kinematics, the Jacobians and
+   the damped least squares IK are calculated for a batch of the joint configurations.
+
+   A batch of the configurations is given as a matrix whose rows correspond to the configurations
+   and whose columns correspond to the joints. The link positions are also stored in the structure
+   of arrays where each element of the positions has an array over the configurations, so that the
+   calculations are vectorized over the configurations.
+
+   The root link is fixed at the position given by setRootPosition in all the configurations.
+   The free joints other than the root link are treated as fixed joints.
+
+   The functions throw std::invalid_argument when a link index is out of range or when the
+   number of the columns of a configuration matrix is different from numJoints().
+*/
+class CNOID_EXPORT CompiledKinematicModel
+{
+public:
+    typedef std::vector<Isometry3, Eigen::aligned_allocator<Isometry3>> PositionArray;
+
+    CompiledKinematicModel();
+    CompiledKinematicModel(Body* body);
+    ~CompiledKinematicModel();
+
+    CompiledKinematicModel(const CompiledKinematicModel&) = delete;
+    CompiledKinematicModel& operator=(const CompiledKinematicModel&) = delete;
+
+    //! The current root link position of the body is used as the root position
+    void compile(Body* body);
+
+    int numLinks() const;
+    int numJoints() const;
+
+    void setRootPosition(const Isometry3& T);
+
+    /**
+       \param Q The matrix of the size (number of configurations) x numJoints().
+    */
+    void calcForwardKinematics(const MatrixXd& Q);
+
+    //! The number of the configurations given in the last calcForwardKinematics
+    int batchSize() const;
+
+    //! \param out_p The translations of the link in the configurations as a batchSize() x 3 matrix
+    void getLinkTranslations(int linkIndex, MatrixXd& out_p) const;
+
+    Isometry3 linkPosition(int linkIndex, int configIndex) const;
+
+    /**
+       The joint ids of the joints which move the link, in the order from the root link.
+       The columns of the Jacobian of the link correspond to these joints.
+    */
+    std::vector<int> pathJointIds(int linkIndex) const;
+
+    /**
+       Calculate the Jacobians of a link for the configurations given in the last calcForwardKinematics.
+       \param out_J The matrix of the size batchSize() x (6 * number of the path joints).
+       Each row has the elements of the 6 x n Jacobian of a configuration in the column-major order.
+       The first three rows of the Jacobian correspond to the translation and the last three rows
+       correspond to the rotation as the Jacobian calculated by JointPath.
+    */
+    void calcJacobians(int linkIndex, MatrixXd& out_J);
+
+    void setIkMaxIterations(int n);
+    void setIkMaxError(double e);
+    void setIkDampingConstant(double lambda);
+    void setIkDeltaScale(double s);
+
+    /**
+       Solve the IK of a link with the damped least squares method for each configuration.
+       Only the joints of the path to the link are changed and they are limited in the joint ranges.
+       \param targets The target position of the link for each row of io_Q
+       \param io_Q The initial configurations which are replaced with the solutions
+       \param out_solved Non-zero elements indicate that the IK has been solved for the configurations
+       \return The number of the solved configurations
+    */
+    int calcInverseKinematics(
+        int linkIndex, const PositionArray& targets, MatrixXd& io_Q, Eigen::VectorXi& out_solved);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -15,6 +15,7 @@
 #include "ConstraintForceSolver.h"
 #include "BodyCollisionDetector.h"
 #include "MaterialTable.h"
+#include "SimulationProfiler.h"
 #include <cnoid/IdPair>
 #include <cnoid/EigenUtil>
 #include <cnoid/AISTCollisionDetector>
@@ -122,6 +123,10 @@ public:
     WorldBase& world;
 
     bool isConstraintForceOutputMode;
+
+    SimulationProfiler* profiler;
+    int collisionDetectionPhaseId;
+    int constraintSolvingPhaseId;
     vector<bool> isSelfCollisionDetectionEnabled;
         
     struct ConstraintPoint {
@@ -331,6 +336,8 @@ public:
     void putContactPoints();
     void solveImpactConstraints();
     void initMatrices();
+    void storeState(std::vector<double>& out_state) const;
+    bool restoreState(const std::vector<double>& state);
     void setAccelCalcSkipInformation();
     void setDefaultAccelerationVector();
     void setAccelerationMatrix();
@@ -434,6 +441,7 @@ CFSImpl::ConstraintForceSolverImpl(WorldBase& world) :
     contactCorrectionVelocityRatio = DEFAULT_CONTACT_CORRECTION_VELOCITY_RATIO;
 
     isConstraintForceOutputMode = false;
+    profiler = nullptr;
     isSelfCollisionDetectionEnabled.clear();
     is2Dmode = false;
 }
@@ -730,6 +738,10 @@ void CFSImpl::solve()
         os << "Time: " << world.currentTime() << std::endl;
     }
 
+    if(profiler){
+        profiler->beginPhase(collisionDetectionPhaseId);
+    }
+
     for(size_t i=0; i < bodiesData.size(); ++i){
         BodyData& data = bodiesData[i];
         data.hasConstrainedLinks = false;
@@ -750,6 +762,11 @@ void CFSImpl::solve()
 
     setConstraintPoints();
 
+    if(profiler){
+        profiler->endPhase(collisionDetectionPhaseId);
+        profiler->beginPhase(constraintSolvingPhaseId);
+    }
+
     if(CFS_PUT_NUM_CONTACT_POINTS){
         cout << globalNumContactNormalVectors;
     }
@@ -820,6 +837,10 @@ void CFSImpl::solve()
 
     prevGlobalNumConstraintVectors = globalNumConstraintVectors;
     prevGlobalNumFrictionVectors = globalNumFrictionVectors;
+
+    if(profiler){
+        profiler->endPhase(constraintSolvingPhaseId);
+    }
 }
 
 
@@ -1199,6 +1220,45 @@ void CFSImpl::initMatrices()
 }
 
 
+void CFSImpl::storeState(std::vector<double>& out_state) const
+{
+    /*
+      The state of the random engine is not stored because ENABLE_RANDOM_STATIC_FRICTION_BASE
+      is disabled. The matrices other than the solution are recalculated in every step.
+    */
+    const int n = solution.size();
+    out_state.resize(4 + n);
+    out_state[0] = prevGlobalNumConstraintVectors;
+    out_state[1] = prevGlobalNumFrictionVectors;
+    out_state[2] = globalNumContactNormalVectors;
+    out_state[3] = numUnconverged;
+    std::copy(solution.data(), solution.data() + n, out_state.begin() + 4);
+}
+
+
+bool CFSImpl::restoreState(const std::vector<double>& state)
+{
+    if(state.size() < 4){
+        return false;
+    }
+    const int n = state.size() - 4;
+    globalNumConstraintVectors = state[0];
+    globalNumFrictionVectors = state[1];
+    globalNumContactNormalVectors = state[2];
+    numUnconverged = state[3];
+
+    if(globalNumConstraintVectors > 0){
+        initMatrices();
+    }
+    solution = Eigen::Map<const VectorX>(state.data() + 4, n);
+
+    prevGlobalNumConstraintVectors = globalNumConstraintVectors;
+    prevGlobalNumFrictionVectors = globalNumFrictionVectors;
+
+    return true;
+}
+
+
 void CFSImpl::setAccelCalcSkipInformation()
 {
     // clear skip check numbers
@@ -2442,6 +2502,16 @@ void ConstraintForceSolver::enableConstraintForceOutput(bool on)
 }
 
 
+void ConstraintForceSolver::setProfiler(SimulationProfiler* profiler)
+{
+    impl->profiler = profiler;
+    if(profiler){
+        impl->collisionDetectionPhaseId = profiler->addPhase("Collision detection");
+        impl->constraintSolvingPhaseId = profiler->addPhase("Constraint solving");
+    }
+}
+
+
 void ConstraintForceSolver::set2Dmode(bool on)
 {
     impl->is2Dmode = on;
@@ -2466,6 +2536,18 @@ void ConstraintForceSolver::clearExternalForces()
 }
 
 
+void ConstraintForceSolver::storeState(std::vector<double>& out_state) const
+{
+    impl->storeState(out_state);
+}
+
+
+bool ConstraintForceSolver::restoreState(const std::vector<double>& state)
+{
+    return impl->restoreState(state);
+}
+
+
 shared_ptr<CollisionLinkPairList> ConstraintForceSolver::getCollisions()
 {
     return impl->getCollisions();
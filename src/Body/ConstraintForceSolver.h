@@ -16,6 +16,7 @@ class WorldBase;
 class CollisionDetector;
 class ContactMaterial;
 class MaterialTable;
+class SimulationProfiler;
 	
 class CNOID_EXPORT ConstraintForceSolver
 {
@@ -59,10 +60,24 @@ public:
     void set2Dmode(bool on);
     void enableConstraintForceOutput(bool on);
 
+    /**
+       The computation times of the collision detection and the constraint force solving
+       are recorded in the profiler when it is given.
+    */
+    void setProfiler(SimulationProfiler* profiler);
+
     void initialize(void);
     void solve();
     void clearExternalForces();
 
+    /**
+       The state kept between the steps, which is the solution of the previous step used as
+       the initial value of the iterative solver, is stored in or restored from a flat array.
+       \return false if the state does not match the solver
+    */
+    void storeState(std::vector<double>& out_state) const;
+    bool restoreState(const std::vector<double>& state);
+
     std::shared_ptr<CollisionLinkPairList> getCollisions();
 
     // experimental functions
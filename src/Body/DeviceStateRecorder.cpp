@@ -0,0 +1,151 @@
+#include "DeviceStateRecorder.h"
+#include "Camera.h"
+#include "RangeSensor.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+using namespace std;
+using namespace cnoid;
+
+
+DeviceStateRecorder::DeviceStateRecorder()
+{
+    recordSize_ = 0;
+    isDeltaEncodingEnabled_ = true;
+}
+
+
+void DeviceStateRecorder::clear()
+{
+    layouts.clear();
+    prototypes.clear();
+    statePools.clear();
+    lastData.clear();
+    hasLastData.clear();
+    recordSize_ = 0;
+}
+
+
+void DeviceStateRecorder::initialize(const DeviceList<>& devices)
+{
+    clear();
+
+    const int n = devices.size();
+    layouts.resize(n);
+    prototypes.resize(n);
+    statePools.resize(n);
+    hasLastData.resize(n, false);
+
+    // The devices of the same type are placed contiguously
+    vector<int> order(n);
+    for(int i=0; i < n; ++i){
+        order[i] = i;
+    }
+    std::stable_sort(
+        order.begin(), order.end(),
+        [&devices](int i1, int i2){
+            return strcmp(devices[i1]->typeName(), devices[i2]->typeName()) < 0; });
+
+    for(auto& index : order){
+        Device* device = devices[index];
+        Layout& layout = layouts[index];
+        layout.isCloned = dynamic_cast<Camera*>(device) || dynamic_cast<RangeSensor*>(device);
+        if(layout.isCloned){
+            layout.offset = 0;
+            layout.size = 0;
+        } else {
+            layout.offset = recordSize_;
+            layout.size = device->stateSize();
+            recordSize_ += layout.size;
+            prototypes[index] = device->cloneState();
+        }
+    }
+
+    lastData.resize(recordSize_);
+}
+
+
+void DeviceStateRecorder::initializeRecord(Record& record) const
+{
+    const int n = layouts.size();
+    record.data.resize(recordSize_);
+    record.changeFlags.assign(n, false);
+    record.clonedStates.clear();
+    record.clonedStates.resize(n);
+}
+
+
+void DeviceStateRecorder::record
+(const DeviceList<>& devices, std::vector<bool>& io_changeFlags, Record& out_record)
+{
+    const int n = layouts.size();
+
+    for(int i=0; i < n; ++i){
+        out_record.changeFlags[i] = false;
+        if(!io_changeFlags[i]){
+            continue;
+        }
+        io_changeFlags[i] = false;
+
+        const Layout& layout = layouts[i];
+        if(layout.isCloned){
+            out_record.clonedStates[i] = devices[i]->cloneState();
+            out_record.changeFlags[i] = true;
+            continue;
+        }
+
+        double* data = &out_record.data[layout.offset];
+        devices[i]->writeState(data);
+
+        if(isDeltaEncodingEnabled_){
+            double* last = &lastData[layout.offset];
+            // The bitwise comparison regards the same NaN values as unchanged
+            if(hasLastData[i] && memcmp(data, last, layout.size * sizeof(double)) == 0){
+                continue;
+            }
+            std::copy(data, data + layout.size, last);
+            hasLastData[i] = true;
+        }
+        out_record.changeFlags[i] = true;
+    }
+}
+
+
+void DeviceStateRecorder::restore(Record& record, std::vector<DeviceStatePtr>& io_states)
+{
+    const int n = layouts.size();
+    io_states.resize(n);
+
+    for(int i=0; i < n; ++i){
+        if(!record.changeFlags[i]){
+            continue;
+        }
+        record.changeFlags[i] = false;
+
+        const Layout& layout = layouts[i];
+        if(layout.isCloned){
+            // The state is released from the record, whose slot may be reused by the recording thread
+            if(record.clonedStates[i]){
+                io_states[i] = record.clonedStates[i];
+                record.clonedStates[i].reset();
+            }
+        } else {
+            /*
+              The frames holding the states are usually released in the restored order,
+              so only the oldest state in the pool is checked.
+            */
+            auto& pool = statePools[i];
+            DeviceStatePtr state;
+            if(!pool.empty() && pool.front()->refCount() == 1){
+                state = pool.front();
+                pool.pop_front();
+            } else {
+                state = prototypes[i]->cloneState();
+            }
+            state->readState(&record.data[layout.offset]);
+            io_states[i] = state;
+            pool.push_back(state);
+        }
+    }
+}
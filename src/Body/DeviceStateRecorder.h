@@ -0,0 +1,93 @@
+#ifndef CNOID_BODY_DEVICE_STATE_RECORDER_H
+#define CNOID_BODY_DEVICE_STATE_RECORDER_H
+
+#include "Device.h"
+#include "DeviceList.h"
+#include <vector>
+#include <deque>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class records the states of devices into preallocated records without creating a DeviceState
+   object for each state change. The state of a device is serialized by the writeState function into
+   a fixed-size region of a record, where the regions of the devices of the same type are placed
+   contiguously. When the delta encoding is enabled, a state which is the same as the previously
+   recorded state of the device is marked as unchanged in the record.
+
+   The devices whose states have payloads that are not serialized by the writeState function,
+   such as the range data of RangeSensor and the image of Camera, are recorded by cloning their
+   states. The payloads are shared with the devices by their copy-on-write buffers.
+
+   The record function and the restore function can be called by different threads as long as each
+   function is always called by the same thread and the records are restored in the recorded order.
+*/
+class CNOID_EXPORT DeviceStateRecorder
+{
+public:
+    class Record
+    {
+    public:
+        bool isChanged(int deviceIndex) const { return changeFlags[deviceIndex]; }
+    private:
+        std::vector<double> data;
+        std::vector<char> changeFlags;
+        std::vector<DeviceStatePtr> clonedStates;
+        friend class DeviceStateRecorder;
+    };
+
+    DeviceStateRecorder();
+    DeviceStateRecorder(const DeviceStateRecorder&) = delete;
+    DeviceStateRecorder& operator=(const DeviceStateRecorder&) = delete;
+
+    void initialize(const DeviceList<>& devices);
+    void clear();
+
+    int numDevices() const { return layouts.size(); }
+
+    //! The number of the elements of the serialized states in a record
+    int recordSize() const { return recordSize_; }
+
+    void setDeltaEncodingEnabled(bool on) { isDeltaEncodingEnabled_ = on; }
+    bool isDeltaEncodingEnabled() const { return isDeltaEncodingEnabled_; }
+
+    //! Allocate the buffers of a record. The record function does not allocate memory for the record after this.
+    void initializeRecord(Record& record) const;
+
+    /**
+       Record the states of the devices whose change flags are true.
+       The flags of the recorded devices are cleared.
+    */
+    void record(const DeviceList<>& devices, std::vector<bool>& io_changeFlags, Record& out_record);
+
+    /**
+       Update the states with the changed states in a record. The changed states are consumed, so
+       restoring the same record again does not change the states.
+
+       The previous state objects which may be shared by other frames are not modified. A changed
+       state is restored into a state object that has been released by all the other owners,
+       and a new object is only created when there is no such object.
+    */
+    void restore(Record& record, std::vector<DeviceStatePtr>& io_states);
+
+private:
+    struct Layout
+    {
+        int offset;
+        int size;
+        bool isCloned;
+    };
+    std::vector<Layout> layouts;
+    std::vector<DeviceStatePtr> prototypes;
+    // The restored states of each device in the restored order, which are recycled in that order
+    std::vector<std::deque<DeviceStatePtr>> statePools;
+    std::vector<double> lastData;
+    std::vector<char> hasLastData;
+    int recordSize_;
+    bool isDeltaEncodingEnabled_;
+};
+
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include "DyBody.h"
 #include "ForwardDynamicsABM.h"
 #include "ForwardDynamicsCBM.h"
+#include "SimulationProfiler.h"
 #include <cnoid/EigenUtil>
 #include <string>
 #include <iostream>
@@ -29,6 +30,8 @@ WorldBase::WorldBase()
     sensorsAreEnabled = false;
     isOldAccelSensorCalcMode = false;
     numRegisteredLinkPairs = 0;
+    profiler = nullptr;
+    integrationPhaseId = 0;
 }
 
 
@@ -138,6 +141,7 @@ void WorldBase::calcNextState()
     }
     const int n = bodyInfoArray.size();
 
+    SimulationProfiler::ScopedPhase phase(profiler, integrationPhaseId);
     for(int i=0; i < n; ++i){
         BodyInfo& info = bodyInfoArray[i];
         info.forwardDynamics->calcNextState();
@@ -146,6 +150,15 @@ void WorldBase::calcNextState()
 }
 
 
+void WorldBase::setProfiler(SimulationProfiler* profiler)
+{
+    this->profiler = profiler;
+    if(profiler){
+        integrationPhaseId = profiler->addPhase("Integration");
+    }
+}
+
+
 int WorldBase::addBody(DyBody* body)
 {
     if(!body->name().empty()){
@@ -17,6 +17,7 @@ namespace cnoid {
 class DyLink;
 class DyBody;
 typedef ref_ptr<DyBody> DyBodyPtr;
+class SimulationProfiler;
 
 class CNOID_EXPORT WorldBase
 {
@@ -152,6 +153,12 @@ public:
     */
     virtual void calcNextState();
 
+    /**
+       @brief set the profiler to record the time of the integration of the forward dynamics
+       @param profiler the profiler, or nullptr to stop recording
+    */
+    void setProfiler(SimulationProfiler* profiler);
+
     /**
        @brief get index of link pairs
        @param link1 link1
@@ -177,6 +184,9 @@ protected:
     bool sensorsAreEnabled;
     bool isOldAccelSensorCalcMode;
 
+    SimulationProfiler* profiler;
+    int integrationPhaseId;
+
 private:
     typedef std::map<std::string, int> NameToIndexMap;
     NameToIndexMap nameToBodyIndexMap;
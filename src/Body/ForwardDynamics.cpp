@@ -62,6 +62,74 @@ void ForwardDynamics::setOldAccelSensorCalcMode(bool on)
 }
 
 
+namespace {
+
+// vo, dvo, sw, sv, cv, cw, Iww, Iwv, Ivv, pf, ptau, hhv, hhw, uu, dd and wc
+const int DyLinkStateSize = 3 * 6 + 9 * 3 + 3 * 4 + 2 + 3;
+
+}
+
+
+int ForwardDynamics::stateSize() const
+{
+    return body->numLinks() * DyLinkStateSize + sensorHelper.stateSize();
+}
+
+
+double* ForwardDynamics::writeState(double* out_buf) const
+{
+    const int n = body->numLinks();
+    for(int i=0; i < n; ++i){
+        const DyLink* link = body->link(i);
+        Eigen::Map<Vector3>(out_buf) << link->vo();
+        Eigen::Map<Vector3>(out_buf + 3) << link->dvo();
+        Eigen::Map<Vector3>(out_buf + 6) << link->sw();
+        Eigen::Map<Vector3>(out_buf + 9) << link->sv();
+        Eigen::Map<Vector3>(out_buf + 12) << link->cv();
+        Eigen::Map<Vector3>(out_buf + 15) << link->cw();
+        Eigen::Map<Matrix3>(out_buf + 18) << link->Iww();
+        Eigen::Map<Matrix3>(out_buf + 27) << link->Iwv();
+        Eigen::Map<Matrix3>(out_buf + 36) << link->Ivv();
+        Eigen::Map<Vector3>(out_buf + 45) << link->pf();
+        Eigen::Map<Vector3>(out_buf + 48) << link->ptau();
+        Eigen::Map<Vector3>(out_buf + 51) << link->hhv();
+        Eigen::Map<Vector3>(out_buf + 54) << link->hhw();
+        out_buf[57] = link->uu();
+        out_buf[58] = link->dd();
+        Eigen::Map<Vector3>(out_buf + 59) << link->wc();
+        out_buf += DyLinkStateSize;
+    }
+    return sensorHelper.writeState(out_buf);
+}
+
+
+const double* ForwardDynamics::readState(const double* buf)
+{
+    const int n = body->numLinks();
+    for(int i=0; i < n; ++i){
+        DyLink* link = body->link(i);
+        link->vo() = Eigen::Map<const Vector3>(buf);
+        link->dvo() = Eigen::Map<const Vector3>(buf + 3);
+        link->sw() = Eigen::Map<const Vector3>(buf + 6);
+        link->sv() = Eigen::Map<const Vector3>(buf + 9);
+        link->cv() = Eigen::Map<const Vector3>(buf + 12);
+        link->cw() = Eigen::Map<const Vector3>(buf + 15);
+        link->Iww() = Eigen::Map<const Matrix3>(buf + 18);
+        link->Iwv() = Eigen::Map<const Matrix3>(buf + 27);
+        link->Ivv() = Eigen::Map<const Matrix3>(buf + 36);
+        link->pf() = Eigen::Map<const Vector3>(buf + 45);
+        link->ptau() = Eigen::Map<const Vector3>(buf + 48);
+        link->hhv() = Eigen::Map<const Vector3>(buf + 51);
+        link->hhw() = Eigen::Map<const Vector3>(buf + 54);
+        link->uu() = buf[57];
+        link->dd() = buf[58];
+        link->wc() = Eigen::Map<const Vector3>(buf + 59);
+        buf += DyLinkStateSize;
+    }
+    return sensorHelper.readState(buf);
+}
+
+
 /// function from Murray, Li and Sastry p.42
 void ForwardDynamics::SE3exp
 (Isometry3& out_T, const Isometry3& T0, const Vector3& w, const Vector3& vo, double dt)
@@ -38,6 +38,15 @@ public:
     virtual void initialize() = 0;
     virtual void calcNextState() = 0;
 
+    /**
+       The internal state kept between the steps, which includes the variables of the articulated
+       body algorithm stored in the DyLink objects. The functions are used to make a checkpoint of
+       a simulation and must be called after initialize() is called.
+    */
+    virtual int stateSize() const;
+    virtual double* writeState(double* out_buf) const;
+    virtual const double* readState(const double* buf);
+
 protected:
 
     virtual void initializeSensors();
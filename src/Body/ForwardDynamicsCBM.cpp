@@ -136,6 +136,81 @@ void ForwardDynamicsCBM::initialize()
 }
 
 
+int ForwardDynamicsCBM::stateSize() const
+{
+    return ForwardDynamics::stateSize()
+        + M11.size() + M12.size() + b1.size() + d1.size()
+        + qGivenPrev.size() + dqGivenPrev.size() + 21 + 2;
+}
+
+
+namespace {
+
+template<class Derived>
+double* writeMatrix(const Eigen::MatrixBase<Derived>& M, double* out_buf)
+{
+    for(int j=0; j < M.cols(); ++j){
+        for(int i=0; i < M.rows(); ++i){
+            *out_buf++ = M(i, j);
+        }
+    }
+    return out_buf;
+}
+
+template<class Derived>
+const double* readMatrix(Eigen::MatrixBase<Derived>& M, const double* buf)
+{
+    for(int j=0; j < M.cols(); ++j){
+        for(int i=0; i < M.rows(); ++i){
+            M(i, j) = *buf++;
+        }
+    }
+    return buf;
+}
+
+}
+
+
+double* ForwardDynamicsCBM::writeState(double* out_buf) const
+{
+    out_buf = ForwardDynamics::writeState(out_buf);
+    out_buf = writeMatrix(M11, out_buf);
+    out_buf = writeMatrix(M12, out_buf);
+    out_buf = writeMatrix(b1, out_buf);
+    out_buf = writeMatrix(d1, out_buf);
+    out_buf = writeMatrix(qGivenPrev, out_buf);
+    out_buf = writeMatrix(dqGivenPrev, out_buf);
+    out_buf = writeMatrix(pGivenPrev, out_buf);
+    out_buf = writeMatrix(RGivenPrev, out_buf);
+    out_buf = writeMatrix(voGivenPrev, out_buf);
+    out_buf = writeMatrix(wGivenPrev, out_buf);
+    out_buf = writeMatrix(root_w_x_v, out_buf);
+    *out_buf++ = accelSolverInitialized ? 1.0 : 0.0;
+    *out_buf++ = ddqGivenCopied ? 1.0 : 0.0;
+    return out_buf;
+}
+
+
+const double* ForwardDynamicsCBM::readState(const double* buf)
+{
+    buf = ForwardDynamics::readState(buf);
+    buf = readMatrix(M11, buf);
+    buf = readMatrix(M12, buf);
+    buf = readMatrix(b1, buf);
+    buf = readMatrix(d1, buf);
+    buf = readMatrix(qGivenPrev, buf);
+    buf = readMatrix(dqGivenPrev, buf);
+    buf = readMatrix(pGivenPrev, buf);
+    buf = readMatrix(RGivenPrev, buf);
+    buf = readMatrix(voGivenPrev, buf);
+    buf = readMatrix(wGivenPrev, buf);
+    buf = readMatrix(root_w_x_v, buf);
+    accelSolverInitialized = (*buf++ != 0.0);
+    ddqGivenCopied = (*buf++ != 0.0);
+    return buf;
+}
+
+
 void ForwardDynamicsCBM::complementHighGainModeCommandValues()
 {
     for(size_t i=0; i < highGainModeJoints.size(); ++i){
@@ -31,6 +31,9 @@ public:
 
     virtual void initialize();
     virtual void calcNextState();
+    virtual int stateSize() const override;
+    virtual double* writeState(double* out_buf) const override;
+    virtual const double* readState(const double* buf) override;
 
     void complementHighGainModeCommandValues();
 
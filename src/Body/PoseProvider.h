@@ -27,6 +27,13 @@ public:
     virtual void getJointPositions(std::vector<stdx::optional<double>>& out_q) const = 0;
     virtual stdx::optional<Vector3> ZMP() const = 0;
 
+    /**
+       Create another provider that gives the same poses independently of this provider.
+       This is used to evaluate the poses in multiple threads. The caller owns the created
+       provider. Nullptr is returned if the provider does not support it.
+    */
+    virtual PoseProvider* clone() const { return nullptr; }
+
 #ifdef CNOID_BACKWARD_COMPATIBILITY
     bool getBaseLinkPosition(Vector3& out_p, Matrix3& out_R) const {
         Isometry3 T;
@@ -9,15 +9,117 @@
 #include "BodyMotion.h"
 #include "ZMPSeq.h"
 #include "PoseProvider.h"
+#include <cnoid/ThreadPool>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 
 using namespace std;
 using namespace cnoid;
 
+namespace {
+
+class FrameConverter
+{
+public:
+    FrameConverter(Body* body, PoseProvider* provider, BodyMotion& motion, ZMPSeq& zmpseq, bool allLinkPositionOutputMode);
+    void convert(int frame);
+    bool isZmpValid() const { return isZmpValid_; }
+
+private:
+    Body* body;
+    PoseProvider* provider;
+    Link* rootLink;
+    Link* baseLink;
+    std::shared_ptr<LinkTraverse> fkTraverse;
+    bool allLinkPositionOutputMode;
+    int numLinksToPut;
+    double frameRate;
+    MultiValueSeq& qseq;
+    MultiSE3Seq& pseq;
+    ZMPSeq& zmpseq;
+    bool isZmpValid_;
+    std::vector<stdx::optional<double>> jointPositions;
+};
+
+}
+
+
+FrameConverter::FrameConverter
+(Body* body, PoseProvider* provider, BodyMotion& motion, ZMPSeq& zmpseq, bool allLinkPositionOutputMode)
+    : body(body),
+      provider(provider),
+      allLinkPositionOutputMode(allLinkPositionOutputMode),
+      qseq(*motion.jointPosSeq()),
+      pseq(*motion.linkPosSeq()),
+      zmpseq(zmpseq)
+{
+    rootLink = body->rootLink();
+    baseLink = rootLink;
+    numLinksToPut = (allLinkPositionOutputMode ? body->numLinks() : 1);
+    frameRate = motion.frameRate();
+    isZmpValid_ = false;
+    jointPositions.resize(body->numJoints());
+
+    if(allLinkPositionOutputMode){
+        fkTraverse = make_shared<LinkTraverse>(baseLink, true, true);
+    } else {
+        fkTraverse = make_shared<LinkPath>(baseLink, rootLink);
+    }
+}
+
+
+void FrameConverter::convert(int frame)
+{
+    provider->seek(frame / frameRate);
+
+    const int baseLinkIndex = provider->baseLinkIndex();
+    if(baseLinkIndex >= 0){
+        if(baseLinkIndex != baseLink->index()){
+            baseLink = body->link(baseLinkIndex);
+            if(allLinkPositionOutputMode){
+                fkTraverse->find(baseLink, true, true);
+            } else {
+                static_pointer_cast<LinkPath>(fkTraverse)->setPath(baseLink, rootLink);
+            }
+        }
+        provider->getBaseLinkPosition(baseLink->T());
+    }
+
+    MultiValueSeq::Frame qs = qseq.frame(frame);
+    provider->getJointPositions(jointPositions);
+    const int numJoints = body->numJoints();
+    for(int i=0; i < numJoints; ++i){
+        const auto& q = jointPositions[i];
+        qs[i] = q ? *q : 0.0;
+        body->joint(i)->q() = qs[i];
+    }
+
+    if(allLinkPositionOutputMode || baseLink != rootLink){
+        fkTraverse->calcForwardKinematics();
+    }
+
+    for(int i=0; i < numLinksToPut; ++i){
+        SE3& p = pseq(frame, i);
+        Link* link = body->link(i);
+        p.set(link->p(), link->R());
+    }
+
+    auto zmp = provider->ZMP();
+    if(zmp){
+        zmpseq[frame] = *zmp;
+        isZmpValid_ = true;
+    }
+}
+
 
 PoseProviderToBodyMotionConverter::PoseProviderToBodyMotionConverter()
 {
     setFullTimeRange();
     allLinkPositionOutputMode = true;
+    numThreads = 1;
 }
 
     
@@ -41,6 +143,18 @@ void PoseProviderToBodyMotionConverter::setAllLinkPositionOutput(bool on)
 }
 
 
+void PoseProviderToBodyMotionConverter::setNumThreads(int n)
+{
+    numThreads = n;
+}
+
+
+void PoseProviderToBodyMotionConverter::setProgressCallback(std::function<bool(double ratio)> callback)
+{
+    progressCallback = callback;
+}
+
+
 bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provider, BodyMotion& motion)
 {
     const double frameRate = motion.frameRate();
@@ -51,20 +165,17 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
     
     motion.setDimension(endingFrame + 1, numJoints, numLinksToPut, true);
 
-    MultiValueSeq& qseq = *motion.jointPosSeq();
-    MultiSE3Seq& pseq = *motion.linkPosSeq();
-    ZMPSeq& zmpseq = *getOrCreateZMPSeq(motion);
-    bool isZmpValid = false;
+    int n = numThreads;
+    if(n <= 0){
+        n = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // The parallel conversion does not pay for the cloned providers when the number of frames is small
+    if(n > 1 && endingFrame - beginningFrame >= 100){
+        return convertInParallel(body, provider, motion, beginningFrame, endingFrame, n);
+    }
 
+    ZMPSeq& zmpseq = *getOrCreateZMPSeq(motion);
     Link* rootLink = body->rootLink();
-    Link* baseLink = rootLink;
-
-    std::shared_ptr<LinkTraverse> fkTraverse;
-    if(allLinkPositionOutputMode){
-        fkTraverse = make_shared<LinkTraverse>(baseLink, true, true);
-    } else {
-        fkTraverse = make_shared<LinkPath>(baseLink, rootLink);
-    }
 
     // store the original state
     vector<double> orgq(numJoints);
@@ -74,52 +185,21 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
     Vector3 p0 = rootLink->p();
     Matrix3 R0 = rootLink->R();
 
-    std::vector<stdx::optional<double>> jointPositions(numJoints);
-
+    FrameConverter converter(body, provider, motion, zmpseq, allLinkPositionOutputMode);
+    const int numFrames = endingFrame - beginningFrame + 1;
+    bool isCanceled = false;
+    
     for(int frame = beginningFrame; frame <= endingFrame; ++frame){
-
-        provider->seek(frame / frameRate);
-
-        const int baseLinkIndex = provider->baseLinkIndex();
-        if(baseLinkIndex >= 0){
-            if(baseLinkIndex != baseLink->index()){
-                baseLink = body->link(baseLinkIndex);
-                if(allLinkPositionOutputMode){
-                    fkTraverse->find(baseLink, true, true);
-                } else {
-                    static_pointer_cast<LinkPath>(fkTraverse)->setPath(baseLink, rootLink);
-                }
+        converter.convert(frame);
+        if(progressCallback && (frame - beginningFrame) % 100 == 99){
+            if(!progressCallback(static_cast<double>(frame - beginningFrame + 1) / numFrames)){
+                isCanceled = true;
+                break;
             }
-            provider->getBaseLinkPosition(baseLink->T());
-        }
-
-        MultiValueSeq::Frame qs = qseq.frame(frame);
-        provider->getJointPositions(jointPositions);
-        for(int i=0; i < numJoints; ++i){
-            const auto& q = jointPositions[i];
-            qs[i] = q ? *q : 0.0;
-            body->joint(i)->q() = qs[i];
         }
-
-        if(allLinkPositionOutputMode || baseLink != rootLink){
-            fkTraverse->calcForwardKinematics();
-        }
-
-        for(int i=0; i < numLinksToPut; ++i){
-            SE3& p = pseq(frame, i);
-            Link* link = body->link(i);
-            p.set(link->p(), link->R());
-        }
-
-        auto zmp = provider->ZMP();
-        if(zmp){
-            zmpseq[frame] = *zmp;
-            isZmpValid = true;
-        }
-
     }
 
-    if(!isZmpValid){
+    if(!converter.isZmpValid()){
         //bodyMotionItem->clearRelativeZmpSeq();
     }
 
@@ -131,5 +211,82 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
     rootLink->R() = R0;
     body->calcForwardKinematics();
 
-    return true;
+    return !isCanceled;
+}
+
+
+/**
+   Each thread has its own clones of the body and the provider, and the threads take the chunks
+   of the consecutive frames in order. The frames are written directly into the motion because
+   the threads write different frames of the sequences which have already been allocated.
+*/
+bool PoseProviderToBodyMotionConverter::convertInParallel
+(Body* body, PoseProvider* provider, BodyMotion& motion, int beginningFrame, int endingFrame, int numThreads)
+{
+    vector<unique_ptr<PoseProvider>> providers;
+    vector<BodyPtr> bodies;
+    for(int i=0; i < numThreads; ++i){
+        PoseProvider* cloned = provider->clone();
+        if(!cloned){
+            break;
+        }
+        providers.emplace_back(cloned);
+        bodies.push_back(body->clone());
+    }
+    if(providers.empty()){
+        int orgNumThreads = this->numThreads;
+        this->numThreads = 1;
+        bool result = convert(body, provider, motion);
+        this->numThreads = orgNumThreads;
+        return result;
+    }
+    numThreads = providers.size();
+
+    ZMPSeq& zmpseq = *getOrCreateZMPSeq(motion);
+    const int numFrames = endingFrame - beginningFrame + 1;
+    const int chunkSize = std::max(1, numFrames / (numThreads * 16));
+    std::atomic<int> nextFrame(beginningFrame);
+    std::atomic<int> numConvertedFrames(0);
+    std::atomic<bool> isCanceled(false);
+    std::mutex mutex;
+    std::condition_variable finishCondition;
+
+    ThreadPool threadPool(numThreads);
+    for(int i=0; i < numThreads; ++i){
+        threadPool.start([&, i](){
+            FrameConverter converter(bodies[i], providers[i].get(), motion, zmpseq, allLinkPositionOutputMode);
+            while(!isCanceled){
+                const int frame0 = nextFrame.fetch_add(chunkSize);
+                if(frame0 > endingFrame){
+                    break;
+                }
+                const int frame1 = std::min(frame0 + chunkSize - 1, endingFrame);
+                for(int frame = frame0; frame <= frame1; ++frame){
+                    converter.convert(frame);
+                }
+                if(numConvertedFrames.fetch_add(frame1 - frame0 + 1) + frame1 - frame0 + 1 == numFrames){
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finishCondition.notify_all();
+                }
+            }
+        });
+    }
+
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finishCondition.wait_for(
+                lock, std::chrono::milliseconds(100), [&](){ return numConvertedFrames == numFrames; });
+        }
+        if(numConvertedFrames == numFrames){
+            break;
+        }
+        if(progressCallback && !progressCallback(static_cast<double>(numConvertedFrames) / numFrames)){
+            isCanceled = true;
+            break;
+        }
+    }
+    threadPool.wait();
+
+    return !isCanceled;
 }
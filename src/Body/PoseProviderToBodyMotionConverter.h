@@ -5,6 +5,7 @@
 #ifndef CNOID_BODY_POSE_PROVIDER_TO_BODY_MOTION_CONVERTER_H
 #define CNOID_BODY_POSE_PROVIDER_TO_BODY_MOTION_CONVERTER_H
 
+#include <functional>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -20,12 +21,31 @@ public:
     void setTimeRange(double lower, double upper);
     void setFullTimeRange();
     void setAllLinkPositionOutput(bool on);
+
+    /**
+       The frames are converted in multiple threads when the number is more than one and the
+       provider supports PoseProvider::clone. Zero means the number of the hardware threads.
+    */
+    void setNumThreads(int n);
+
+    /**
+       The function is called with the ratio of the converted frames in the thread calling
+       the convert function. The conversion is canceled when the function returns false.
+    */
+    void setProgressCallback(std::function<bool(double ratio)> callback);
+    
+    //! \return false if the conversion is canceled
     bool convert(Body* body, PoseProvider* provider, BodyMotion& motion);
 
 private:
     double lowerTime;
     double upperTime;
     bool allLinkPositionOutputMode;
+    int numThreads;
+    std::function<bool(double ratio)> progressCallback;
+
+    bool convertInParallel(
+        Body* body, PoseProvider* provider, BodyMotion& motion, int beginningFrame, int endingFrame, int numThreads);
 };
 
 }
@@ -104,3 +104,13 @@ void SimpleController::unconfigure()
 {
 
 }
+
+bool SimpleController::storeState(std::vector<char>&)
+{
+    return false;
+}
+
+bool SimpleController::restoreState(const std::vector<char>&)
+{
+    return false;
+}
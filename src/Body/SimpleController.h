@@ -6,6 +6,7 @@
 #define CNOID_BODY_SIMPLE_CONTROLLER_H
 
 #include "ControllerIO.h"
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -128,6 +129,20 @@ public:
     */
     virtual void unconfigure();
 
+    /**
+       The storeState function is called when a checkpoint of the simulation is captured.
+       The internal state of the controller which is not included in the IO body, such as the
+       count of the control steps, should be stored so that the restoreState function can
+       restore it when the simulation is rewound to the checkpoint.
+
+       The default implementations return false because the state of the controller is unknown.
+       A controller without any internal state should override them to return true.
+
+       \return Return false if the state cannot be stored or restored.
+    */
+    virtual bool storeState(std::vector<char>& out_state);
+    virtual bool restoreState(const std::vector<char>& state);
+
     enum StateType {
         StateNone            = Link::StateNone,
         JointDisplacement    = Link::JointDisplacement,
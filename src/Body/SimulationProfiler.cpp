@@ -0,0 +1,222 @@
+#include "SimulationProfiler.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <ostream>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+
+SimulationProfiler::SimulationProfiler()
+{
+    maxNumSteps_ = 0;
+    numTotalSteps_ = 0;
+    // Reserved so that beginPhase does not allocate memory
+    activePhaseStack.reserve(16);
+    setMaxNumSteps(100000);
+}
+
+
+void SimulationProfiler::setMaxNumSteps(int n)
+{
+    maxNumSteps_ = std::max(1, n);
+    stepTimes.resize(maxNumSteps_);
+    for(auto& phase : phases){
+        phase.times.resize(maxNumSteps_);
+    }
+    clearRecords();
+}
+
+
+int SimulationProfiler::addPhase(const std::string& name)
+{
+    int id = findPhase(name);
+    if(id < 0){
+        id = phases.size();
+        phases.emplace_back();
+        auto& phase = phases.back();
+        phase.name = name;
+        phase.currentTime = 0.0;
+        phase.times.resize(maxNumSteps_, 0.0);
+    }
+    return id;
+}
+
+
+int SimulationProfiler::findPhase(const std::string& name) const
+{
+    for(size_t i=0; i < phases.size(); ++i){
+        if(phases[i].name == name){
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+void SimulationProfiler::clearRecords()
+{
+    numTotalSteps_ = 0;
+    activePhaseStack.clear();
+    for(auto& phase : phases){
+        phase.currentTime = 0.0;
+    }
+}
+
+
+const std::vector<double>& SimulationProfiler::timeBuffer(int phaseId) const
+{
+    if(phaseId == StepTime){
+        return stepTimes;
+    }
+    return phases[phaseId].times;
+}
+
+
+double SimulationProfiler::time(int phaseId, int step) const
+{
+    int index = step;
+    if(numTotalSteps_ > maxNumSteps_){
+        index = (numTotalSteps_ + step) % maxNumSteps_;
+    }
+    return timeBuffer(phaseId)[index];
+}
+
+
+double SimulationProfiler::meanTime(int phaseId) const
+{
+    const int n = numSteps();
+    if(n == 0){
+        return 0.0;
+    }
+    auto& times = timeBuffer(phaseId);
+    return std::accumulate(times.begin(), times.begin() + n, 0.0) / n;
+}
+
+
+double SimulationProfiler::maxTime(int phaseId) const
+{
+    const int n = numSteps();
+    if(n == 0){
+        return 0.0;
+    }
+    auto& times = timeBuffer(phaseId);
+    return *std::max_element(times.begin(), times.begin() + n);
+}
+
+
+void SimulationProfiler::getSortedTimes(int phaseId, std::vector<double>& out_times) const
+{
+    auto& times = timeBuffer(phaseId);
+    out_times.assign(times.begin(), times.begin() + numSteps());
+    std::sort(out_times.begin(), out_times.end());
+}
+
+
+double SimulationProfiler::percentileTime(int phaseId, double percentage) const
+{
+    vector<double> sorted;
+    getSortedTimes(phaseId, sorted);
+    if(sorted.empty()){
+        return 0.0;
+    }
+    double r = std::max(0.0, std::min(100.0, percentage)) / 100.0;
+    int index = static_cast<int>(std::ceil(r * sorted.size())) - 1;
+    return sorted[std::max(0, index)];
+}
+
+
+void SimulationProfiler::calcHistogram
+(int phaseId, int numBins, std::vector<int>& out_counts, double& out_binWidth) const
+{
+    out_counts.assign(std::max(1, numBins), 0);
+    const double maxTime_ = maxTime(phaseId);
+    out_binWidth = (maxTime_ > 0.0) ? (maxTime_ / out_counts.size()) : 1.0;
+
+    const int n = numSteps();
+    const int lastBin = out_counts.size() - 1;
+    auto& times = timeBuffer(phaseId);
+    for(int i=0; i < n; ++i){
+        int bin = static_cast<int>(times[i] / out_binWidth);
+        ++out_counts[std::min(bin, lastBin)];
+    }
+}
+
+
+void SimulationProfiler::putSummary(std::ostream& os) const
+{
+    const int n = numSteps();
+    os << format("Profile of the latest {0} steps [ms]:\n", n);
+    if(n == 0){
+        return;
+    }
+
+    size_t nameWidth = 10;
+    for(auto& phase : phases){
+        nameWidth = std::max(nameWidth, phase.name.size());
+    }
+    os << format("{0:<{1}} {2:>9} {3:>9} {4:>9} {5:>9} {6:>9}\n",
+                 "Phase", nameWidth, "Mean", "Median", "90%", "99%", "Max");
+
+    auto putStatistics = [&](const std::string& name, int phaseId){
+        os << format("{0:<{1}} {2:9.4f} {3:9.4f} {4:9.4f} {5:9.4f} {6:9.4f}\n",
+                     name, nameWidth,
+                     meanTime(phaseId) * 1000.0,
+                     percentileTime(phaseId, 50.0) * 1000.0,
+                     percentileTime(phaseId, 90.0) * 1000.0,
+                     percentileTime(phaseId, 99.0) * 1000.0,
+                     maxTime(phaseId) * 1000.0);
+    };
+    for(size_t i=0; i < phases.size(); ++i){
+        putStatistics(phases[i].name, i);
+    }
+    putStatistics("Step", StepTime);
+
+    vector<int> counts;
+    double binWidth;
+    calcHistogram(StepTime, 10, counts, binWidth);
+    const int maxCount = *std::max_element(counts.begin(), counts.end());
+    const int barLength = 40;
+    os << "Histogram of the step time [ms]:\n";
+    for(size_t i=0; i < counts.size(); ++i){
+        int length = (maxCount > 0) ? (counts[i] * barLength / maxCount) : 0;
+        os << format("{0:9.4f} - {1:9.4f} {2:>8} {3}\n",
+                     i * binWidth * 1000.0, (i + 1) * binWidth * 1000.0, counts[i], string(length, '*'));
+    }
+    os.flush();
+}
+
+
+void SimulationProfiler::writeCsv(std::ostream& os) const
+{
+    os << "step";
+    for(auto& phase : phases){
+        os << "," << phase.name;
+    }
+    os << ",total\n";
+
+    const int n = numSteps();
+    const int firstStep = numTotalSteps_ - n;
+    for(int i=0; i < n; ++i){
+        os << (firstStep + i);
+        for(size_t j=0; j < phases.size(); ++j){
+            os << format(",{:.9f}", time(j, i));
+        }
+        os << format(",{:.9f}\n", time(StepTime, i));
+    }
+}
+
+
+bool SimulationProfiler::writeCsvFile(const std::string& filename) const
+{
+    ofstream ofs(filename.c_str());
+    if(!ofs){
+        return false;
+    }
+    writeCsv(ofs);
+    return !ofs.fail();
+}
@@ -0,0 +1,167 @@
+#ifndef CNOID_BODY_SIMULATION_PROFILER_H
+#define CNOID_BODY_SIMULATION_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iosfwd>
+#include <algorithm>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class records the computation time of each phase of simulation steps.
+
+   Phases are registered by name and identified by the returned ids. The time spent in
+   a phase is accumulated between beginStep() and endStep(), so a phase can be entered
+   several times in a step. The times of the latest steps are kept in a ring buffer of
+   maxNumSteps() steps.
+
+   A phase can be begun while another phase is active. The outer phase is paused until
+   the inner phase ends, so the recorded times of the phases never overlap and the time
+   of the outer phase is the part which is not covered by the inner phases.
+
+   \note The functions to record times must be called from the same thread.
+   Use addPhaseTime() to record the time measured in another thread.
+*/
+class CNOID_EXPORT SimulationProfiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    //! The id to specify the whole step in the functions to get the statistics
+    enum { StepTime = -1 };
+
+    SimulationProfiler();
+
+    void setMaxNumSteps(int n);
+    int maxNumSteps() const { return maxNumSteps_; }
+
+    /**
+       \return The id of the phase. The existing id is returned if the phase
+       with the same name has already been added.
+    */
+    int addPhase(const std::string& name);
+    int findPhase(const std::string& name) const;
+    int numPhases() const { return static_cast<int>(phases.size()); }
+    const std::string& phaseName(int phaseId) const { return phases[phaseId].name; }
+
+    //! Clear the recorded times. The registered phases are kept.
+    void clearRecords();
+
+    void beginStep() {
+        stepStartTime = Clock::now();
+    }
+
+    void endStep() {
+        const int index = numTotalSteps_ % maxNumSteps_;
+        stepTimes[index] = elapsedTime(stepStartTime);
+        for(auto& phase : phases){
+            phase.times[index] = phase.currentTime;
+            phase.currentTime = 0.0;
+        }
+        ++numTotalSteps_;
+    }
+
+    void beginPhase(int phaseId) {
+        const auto now = Clock::now();
+        if(!activePhaseStack.empty()){
+            auto& outerPhase = phases[activePhaseStack.back()];
+            outerPhase.currentTime += elapsedTime(outerPhase.startTime, now);
+        }
+        activePhaseStack.push_back(phaseId);
+        phases[phaseId].startTime = now;
+    }
+
+    void endPhase(int phaseId) {
+        const auto now = Clock::now();
+        auto& phase = phases[phaseId];
+        phase.currentTime += elapsedTime(phase.startTime, now);
+        if(!activePhaseStack.empty()){
+            activePhaseStack.pop_back();
+            if(!activePhaseStack.empty()){
+                phases[activePhaseStack.back()].startTime = now;
+            }
+        }
+    }
+
+    void addPhaseTime(int phaseId, double time) {
+        phases[phaseId].currentTime += time;
+    }
+
+    class ScopedPhase
+    {
+    public:
+        ScopedPhase(SimulationProfiler* profiler, int phaseId)
+            : profiler(profiler), phaseId(phaseId) {
+            if(profiler){
+                profiler->beginPhase(phaseId);
+            }
+        }
+        ~ScopedPhase() {
+            if(profiler){
+                profiler->endPhase(phaseId);
+            }
+        }
+    private:
+        SimulationProfiler* profiler;
+        int phaseId;
+    };
+
+    //! The number of the steps kept in the buffer
+    int numSteps() const { return std::min(numTotalSteps_, maxNumSteps_); }
+
+    //! The number of all the steps recorded after the last clear
+    int numTotalSteps() const { return numTotalSteps_; }
+
+    /**
+       \param phaseId The id of a phase or StepTime
+       \param step The index of the kept steps. Zero is the oldest one.
+       \return time in seconds
+    */
+    double time(int phaseId, int step) const;
+
+    double meanTime(int phaseId) const;
+    double maxTime(int phaseId) const;
+
+    //! \param percentage The value between 0 and 100
+    double percentileTime(int phaseId, double percentage) const;
+
+    void calcHistogram(
+        int phaseId, int numBins, std::vector<int>& out_counts, double& out_binWidth) const;
+
+    //! Output the statistics and the histogram of the step time in the text format
+    void putSummary(std::ostream& os) const;
+
+    //! Output the times of the kept steps in the CSV format
+    void writeCsv(std::ostream& os) const;
+    bool writeCsvFile(const std::string& filename) const;
+
+private:
+    struct Phase {
+        std::string name;
+        Clock::time_point startTime;
+        double currentTime;
+        std::vector<double> times;
+    };
+    std::vector<Phase> phases;
+    std::vector<int> activePhaseStack;
+    std::vector<double> stepTimes;
+    Clock::time_point stepStartTime;
+    int maxNumSteps_;
+    int numTotalSteps_;
+
+    static double elapsedTime(const Clock::time_point& startTime) {
+        return std::chrono::duration<double>(Clock::now() - startTime).count();
+    }
+    static double elapsedTime(const Clock::time_point& startTime, const Clock::time_point& endTime) {
+        return std::chrono::duration<double>(endTime - startTime).count();
+    }
+    const std::vector<double>& timeBuffer(int phaseId) const;
+    void getSortedTimes(int phaseId, std::vector<double>& out_times) const;
+};
+
+}
+
+#endif
@@ -22,6 +22,7 @@
 #include <cnoid/UTF8>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
+#include <mutex>
 #include "gettext.h"
 
 using namespace std;
@@ -141,6 +142,7 @@ struct ProtoInfo
     
 typedef map<string, ProtoInfo> ProtoInfoMap;
 ProtoInfoMap protoInfoMap;
+mutex staticMapMutex;
 
 void throwExceptionOfIllegalField(VRMLProto* proto, const std::string& name, const char* label)
 {
@@ -287,6 +289,9 @@ VRMLBodyLoaderImpl::VRMLBodyLoaderImpl()
     isVerbose = false;
     body = 0;
     os_ = &nullout();
+
+    // The loaders may be created in multiple threads
+    lock_guard<mutex> lock(staticMapMutex);
     
     if(protoInfoMap.empty()){
         protoInfoMap["Humanoid"] = ProtoInfo(PROTO_HUMANOID, &VRMLBodyLoaderImpl::checkHumanoidProto);
@@ -16,6 +16,7 @@
 #include "PointLight.h"
 #include "SpotLight.h"
 #include <cnoid/YAMLSceneReader>
+#include <cnoid/CollisionProxyGenerator>
 #include <cnoid/EigenArchive>
 #include <cnoid/Exception>
 #include <cnoid/YAMLReader>
@@ -280,6 +281,9 @@ public:
     bool isVerbose;
     bool isShapeLoadingEnabled;
 
+    CollisionProxyGenerator defaultProxyGenerator;
+    unique_ptr<CollisionProxyGenerator> bodyProxyGenerator;
+
     BodyHandlerManager bodyHandlerManager;
 
     YAMLBodyLoaderImpl(YAMLBodyLoader* self);
@@ -296,6 +300,8 @@ public:
     void setLinkName(Link* link, const string& name, ValueNode* node);
     void setJointName(Link* link, const string& jointName, ValueNode* node);
     LinkPtr readLinkContents(Mapping* linkNode, LinkPtr link = nullptr);
+    void readCollisionProxy(ValueNode& node, CollisionProxyGenerator& generator);
+    void addLinkShapes(Link* link, SceneGroupSet& sgs, CollisionProxyGenerator* proxyGenerator);
     void setJointId(Link* link, int id);
     void readJointContents(Link* link, Mapping* node);
     bool extractAxis(Mapping* node, const char* key, Vector3& out_axis);
@@ -563,6 +569,12 @@ void YAMLBodyLoader::setDefaultCreaseAngle(double theta)
 }
 
 
+CollisionProxyGenerator& YAMLBodyLoader::defaultCollisionProxyGenerator()
+{
+    return impl->defaultProxyGenerator;
+}
+
+
 void YAMLBodyLoaderImpl::updateCustomNodeFunctions()
 {
     std::lock_guard<std::mutex> guard(customNodeFunctionMutex);
@@ -633,6 +645,7 @@ bool YAMLBodyLoaderImpl::clear()
     numValidJointIds = 0;
     subBodyMap.clear();
     subBodies.clear();
+    bodyProxyGenerator.reset();
     return true;
 }    
 
@@ -820,6 +833,12 @@ bool YAMLBodyLoaderImpl::readBody(Mapping* topNode)
         body->setModelName(symbol);
     }
 
+    bodyProxyGenerator.reset(new CollisionProxyGenerator(defaultProxyGenerator));
+    auto proxyNode = topNode->extract("collisionProxy");
+    if(proxyNode){
+        readCollisionProxy(*proxyNode, *bodyProxyGenerator);
+    }
+
     transformStack.clear();
     transformStack.push_back(Affine3::Identity());
     auto links = topNode->extract("links");
@@ -1003,6 +1022,16 @@ LinkPtr YAMLBodyLoaderImpl::readLinkContents(Mapping* node, LinkPtr link)
         link->setMaterial(symbol);
     }
     
+    CollisionProxyGenerator* proxyGenerator =
+        bodyProxyGenerator ? bodyProxyGenerator.get() : &defaultProxyGenerator;
+    unique_ptr<CollisionProxyGenerator> linkProxyGenerator;
+    auto proxyNode = node->extract("collisionProxy");
+    if(proxyNode){
+        linkProxyGenerator.reset(new CollisionProxyGenerator(*proxyGenerator));
+        readCollisionProxy(*proxyNode, *linkProxyGenerator);
+        proxyGenerator = linkProxyGenerator.get();
+    }
+
     currentLink = link;
     rigidBodies.clear();
 
@@ -1017,18 +1046,7 @@ LinkPtr YAMLBodyLoaderImpl::readLinkContents(Mapping* node, LinkPtr link)
         if(readElementContents(*elements) && !isSubBodyNode){
             SceneGroupSet& sgs = currentSceneGroupSet();
             sgs.setName(link->name());
-            if(hasVisualOrCollisionNodes){
-                for(auto& node : *sgs.visual){
-                    link->addVisualShapeNode(node);
-                }
-                for(auto& node : *sgs.collision){
-                    link->addCollisionShapeNode(node);
-                }
-            } else {
-                for(auto& node : *sgs.visual){
-                    link->addShapeNode(node);
-                }
-            }
+            addLinkShapes(link, sgs, proxyGenerator);
         }
 
         sceneGroupSetStack.pop_back();
@@ -1080,6 +1098,74 @@ LinkPtr YAMLBodyLoaderImpl::readLinkContents(Mapping* node, LinkPtr link)
 }
 
 
+/**
+   The value is a proxy type symbol or a mapping such as
+   collisionProxy: { type: simplified, targetRatio: 0.05, maxTriangles: 2000, minTriangles: 500 }
+*/
+void YAMLBodyLoaderImpl::readCollisionProxy(ValueNode& node, CollisionProxyGenerator& generator)
+{
+    ValueNode* typeNode = &node;
+    Mapping* mapping = nullptr;
+    if(node.isMapping()){
+        mapping = node.toMapping();
+        typeNode = mapping->find("type");
+    }
+    if(typeNode->isValid()){
+        int type = CollisionProxyGenerator::findProxyType(typeNode->toString());
+        if(type < 0){
+            typeNode->throwException(
+                format(_("Collision proxy type \"{}\" is not supported"), typeNode->toString()));
+        }
+        generator.setProxyType(type);
+    }
+    if(mapping){
+        if(mapping->read("targetRatio", value)){
+            generator.setTargetRatio(value);
+        }
+        if(mapping->read("maxTriangles", id)){
+            generator.setMaxNumTriangles(id);
+        }
+        if(mapping->read("minTriangles", id)){
+            generator.setMinNumTriangles(id);
+        }
+        if(mapping->read("cache", on)){
+            generator.setCacheEnabled(on);
+        }
+    }
+}
+
+
+void YAMLBodyLoaderImpl::addLinkShapes
+(Link* link, SceneGroupSet& sgs, CollisionProxyGenerator* proxyGenerator)
+{
+    SgNodePtr collisionProxy;
+    bool hasCollisionProxy = (proxyGenerator->proxyType() != CollisionProxyGenerator::NO_PROXY);
+    if(hasCollisionProxy){
+        collisionProxy = proxyGenerator->generate(sgs.collision);
+        if(collisionProxy){
+            collisionProxy->setName(link->name());
+        }
+    }
+
+    if(hasVisualOrCollisionNodes || hasCollisionProxy){
+        for(auto& node : *sgs.visual){
+            link->addVisualShapeNode(node);
+        }
+        if(!hasCollisionProxy){
+            for(auto& node : *sgs.collision){
+                link->addCollisionShapeNode(node);
+            }
+        } else if(collisionProxy){
+            link->addCollisionShapeNode(collisionProxy);
+        }
+    } else {
+        for(auto& node : *sgs.visual){
+            link->addShapeNode(node);
+        }
+    }
+}
+
+
 void YAMLBodyLoaderImpl::setJointId(Link* link, int id)
 {
     link->setJointId(id);
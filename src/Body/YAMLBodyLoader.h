@@ -16,6 +16,7 @@ namespace cnoid {
 class Mapping;
 class Device;
 class YAMLSceneReader;
+class CollisionProxyGenerator;
 class YAMLBodyLoaderImpl;
   
 class CNOID_EXPORT YAMLBodyLoader : public AbstractBodyLoader
@@ -33,6 +34,12 @@ public:
 
     bool read(Body* body, Mapping* data);
 
+    /**
+       The generator of the collision shapes used for the bodies which do not specify
+       "collisionProxy". The collision shapes are the same as the visual shapes by default.
+    */
+    CollisionProxyGenerator& defaultCollisionProxyGenerator();
+
     // The following functions are used for defining new node types
     static void addNodeType(
         const std::string& typeName,
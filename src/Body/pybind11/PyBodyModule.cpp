@@ -7,6 +7,7 @@
 #include "../BodyMotion.h"
 #include "../InverseKinematics.h"
 #include "../JointPath.h"
+#include "../CompiledKinematicModel.h"
 #include <cnoid/PyEigenTypes>
 #include <pybind11/operators.h>
 
@@ -71,6 +72,41 @@ PYBIND11_MODULE(Body, m)
 
     m.def("getCustomJointPath", getCustomJointPath);
 
+    py::class_<CompiledKinematicModel>(m, "CompiledKinematicModel")
+        .def(py::init<>())
+        .def(py::init<Body*>())
+        .def("compile", &CompiledKinematicModel::compile)
+        .def_property_readonly("numLinks", &CompiledKinematicModel::numLinks)
+        .def_property_readonly("numJoints", &CompiledKinematicModel::numJoints)
+        .def_property_readonly("batchSize", &CompiledKinematicModel::batchSize)
+        .def("setRootPosition", &CompiledKinematicModel::setRootPosition)
+        .def("calcForwardKinematics", &CompiledKinematicModel::calcForwardKinematics)
+        .def("getLinkTranslations", [](CompiledKinematicModel& self, int linkIndex){
+                MatrixXd p; self.getLinkTranslations(linkIndex, p); return p; })
+        .def("linkPosition", &CompiledKinematicModel::linkPosition)
+        .def("pathJointIds", [](CompiledKinematicModel& self, int linkIndex){
+                py::list ids;
+                for(auto& id : self.pathJointIds(linkIndex)){
+                    ids.append(id);
+                }
+                return ids; })
+        .def("calcJacobians", [](CompiledKinematicModel& self, int linkIndex){
+                MatrixXd J; self.calcJacobians(linkIndex, J); return J; })
+        .def("setIkMaxIterations", &CompiledKinematicModel::setIkMaxIterations)
+        .def("setIkMaxError", &CompiledKinematicModel::setIkMaxError)
+        .def("setIkDampingConstant", &CompiledKinematicModel::setIkDampingConstant)
+        .def("setIkDeltaScale", &CompiledKinematicModel::setIkDeltaScale)
+        .def("calcInverseKinematics", [](CompiledKinematicModel& self, int linkIndex, py::list targets, MatrixXd Q){
+                CompiledKinematicModel::PositionArray positions;
+                positions.reserve(targets.size());
+                for(auto& target : targets){
+                    positions.push_back(target.cast<Isometry3>());
+                }
+                Eigen::VectorXi solved;
+                self.calcInverseKinematics(linkIndex, positions, Q, solved);
+                return py::make_tuple(Q, solved); })
+        ;
+
     py::class_<BodyMotion, shared_ptr<BodyMotion>> bodyMotion(m, "BodyMotion");
     bodyMotion
         .def_property("numJoints", &BodyMotion::numJoints, &BodyMotion::setNumParts)
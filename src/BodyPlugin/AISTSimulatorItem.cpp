@@ -14,6 +14,7 @@
 #include <cnoid/DyBody>
 #include <cnoid/ForwardDynamicsCBM>
 #include <cnoid/ConstraintForceSolver>
+#include <cnoid/SimulationProfiler>
 #include <cnoid/LeggedBodyHelper>
 #include <cnoid/CloneMap>
 #include <cnoid/FloatingNumberString>
@@ -22,6 +23,7 @@
 #include <cnoid/IdPair>
 #include <fmt/format.h>
 #include <mutex>
+#include <cstring>
 #include <iomanip>
 #include <fstream>
 #include "gettext.h"
@@ -107,12 +109,17 @@ public:
 
     MessageView* mv;
 
+    vector<double> checkpointBuf;
+    vector<double> cfsState;
+
     AISTSimulatorItemImpl(AISTSimulatorItem* self);
     AISTSimulatorItemImpl(AISTSimulatorItem* self, const AISTSimulatorItemImpl& org);
     bool initializeSimulation(const std::vector<SimulationBody*>& simBodies);
     void addBody(AISTSimBody* simBody);
     void clearExternalForces();
     void stepKinematicsSimulation(const std::vector<SimulationBody*>& activeSimBodies);
+    bool storeCheckpointState(vector<char>& out_state);
+    bool restoreCheckpointState(const vector<char>& state);
     void setForcedPosition(BodyItem* bodyItem, const Isometry3& T);
     void doSetForcedPosition();
     void doPutProperties(PutPropertyFunction& putProperty);
@@ -154,7 +161,6 @@ AISTSimulatorItemImpl::AISTSimulatorItemImpl(AISTSimulatorItem* self)
     integrationMode.setSymbol(AISTSimulatorItem::EULER_INTEGRATION,  N_("Euler"));
     integrationMode.setSymbol(AISTSimulatorItem::RUNGE_KUTTA_INTEGRATION,  N_("Runge Kutta"));
     integrationMode.select(AISTSimulatorItem::RUNGE_KUTTA_INTEGRATION);
-    
     gravity << 0.0, 0.0, -DEFAULT_GRAVITY_ACCELERATION;
 
     ConstraintForceSolver& cfs = world.constraintForceSolver;
@@ -429,6 +435,10 @@ bool AISTSimulatorItemImpl::initializeSimulation(const std::vector<SimulationBod
     cfs.setGaussSeidelErrorCriterion(errorCriterion.value());
     cfs.setGaussSeidelMaxNumIterations(maxNumIterations);
     cfs.setContactDepthCorrection(contactCorrectionDepth.value(), contactCorrectionVelocityRatio.value());
+
+    auto profiler = self->profiler();
+    cfs.setProfiler(profiler);
+    world.setProfiler(profiler);
     
     self->addPostDynamicsFunction([&](){ clearExternalForces(); });
 
@@ -641,6 +651,108 @@ std::shared_ptr<CollisionLinkPairList> AISTSimulatorItem::getCollisions()
 }
 
 
+bool AISTSimulatorItem::storeCheckpointState(std::vector<char>& out_state)
+{
+    return impl->storeCheckpointState(out_state);
+}
+
+
+/*
+  The state consists of the internal states of the forward dynamics calculators, the state of the
+  constraint force solver and the support foot indices of the bodies in the kinematic walking mode.
+  The world time is not stored because the simulation time is not rewound by the checkpoints.
+*/
+bool AISTSimulatorItemImpl::storeCheckpointState(vector<char>& out_state)
+{
+    world.constraintForceSolver.storeState(cfsState);
+
+    const int numBodies = world.numBodies();
+    int size = 1 + cfsState.size();
+    for(int i=0; i < numBodies; ++i){
+        size += world.forwardDynamics(i)->stateSize();
+    }
+    const auto& simBodies = self->simulationBodies();
+    size += simBodies.size();
+    checkpointBuf.resize(size);
+
+    double* p = checkpointBuf.data();
+    for(int i=0; i < numBodies; ++i){
+        p = world.forwardDynamics(i)->writeState(p);
+    }
+    *p++ = cfsState.size();
+    p = std::copy(cfsState.begin(), cfsState.end(), p);
+    for(auto& simBody : simBodies){
+        auto walkBody = dynamic_cast<KinematicWalkBody*>(simBody);
+        *p++ = walkBody ? walkBody->supportFootIndex : -1;
+    }
+
+    out_state.resize(size * sizeof(double));
+    std::memcpy(out_state.data(), checkpointBuf.data(), out_state.size());
+
+    return true;
+}
+
+
+bool AISTSimulatorItem::restoreCheckpointState(const std::vector<char>& state)
+{
+    return impl->restoreCheckpointState(state);
+}
+
+
+bool AISTSimulatorItemImpl::restoreCheckpointState(const vector<char>& state)
+{
+    const int numBodies = world.numBodies();
+    int size = 0;
+    for(int i=0; i < numBodies; ++i){
+        size += world.forwardDynamics(i)->stateSize();
+    }
+    const int bufSize = state.size() / sizeof(double);
+    if(bufSize < size + 1){
+        return false;
+    }
+    checkpointBuf.resize(bufSize);
+    std::memcpy(checkpointBuf.data(), state.data(), bufSize * sizeof(double));
+
+    const double* p = checkpointBuf.data();
+    const int cfsStateSize = p[size];
+    const auto& simBodies = self->simulationBodies();
+    if(cfsStateSize < 4 ||
+       bufSize != size + 1 + cfsStateSize + static_cast<int>(simBodies.size())){
+        return false;
+    }
+
+    // The support foot indices are checked before any state is modified
+    const double* supportFootIndices = p + size + 1 + cfsStateSize;
+    for(size_t i=0; i < simBodies.size(); ++i){
+        if(auto walkBody = dynamic_cast<KinematicWalkBody*>(simBodies[i])){
+            int supportFootIndex = supportFootIndices[i];
+            if(supportFootIndex < 0 || supportFootIndex >= walkBody->legged->numFeet()){
+                return false;
+            }
+        }
+    }
+
+    for(int i=0; i < numBodies; ++i){
+        p = world.forwardDynamics(i)->readState(p);
+    }
+    ++p;
+    cfsState.assign(p, p + cfsStateSize);
+    world.constraintForceSolver.restoreState(cfsState);
+    p += cfsStateSize;
+    for(auto& simBody : simBodies){
+        int supportFootIndex = *p++;
+        if(auto walkBody = dynamic_cast<KinematicWalkBody*>(simBody)){
+            if(supportFootIndex != walkBody->supportFootIndex){
+                walkBody->supportFootIndex = supportFootIndex;
+                walkBody->traverse.find(walkBody->legged->footLink(supportFootIndex), true, true);
+            }
+        }
+    }
+
+    return true;
+}
+
+
 Vector3 AISTSimulatorItem::getGravity() const
 {
     return impl->gravity;
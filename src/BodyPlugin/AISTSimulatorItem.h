@@ -72,6 +72,8 @@ protected:
     virtual bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies) override;
     virtual void finalizeSimulation() override;
     virtual std::shared_ptr<CollisionLinkPairList> getCollisions() override;
+    virtual bool storeCheckpointState(std::vector<char>& out_state) override;
+    virtual bool restoreCheckpointState(const std::vector<char>& state) override;
         
     virtual Item* doDuplicate() const override;
     virtual void doPutProperties(PutPropertyFunction& putProperty) override;
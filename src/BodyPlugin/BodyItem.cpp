@@ -209,7 +209,7 @@ class BodyFileIO : public ItemFileIOBase<BodyItem>
     
 public:
     BodyFileIO()
-        : ItemFileIOBase<BodyItem>("CHOREONOID-BODY", Load | Save)
+        : ItemFileIOBase<BodyItem>("CHOREONOID-BODY", Load | Save | Preload)
     {
         setCaption(_("Body"));
         setExtensions({ "body", "yaml", "yml", "wrl" });
@@ -218,11 +218,25 @@ public:
         bodyLoader.setMessageSink(os());
     }
 
+    virtual ReferencedPtr preload(const std::string& filename, std::ostream& os) override
+    {
+        BodyLoader loader;
+        loader.setMessageSink(os);
+        BodyPtr body = new Body;
+        if(!loader.load(body, filename)){
+            return nullptr;
+        }
+        return body;
+    }
+
     virtual bool load(BodyItem* item, const std::string& filename) override
     {
-        BodyPtr newBody = new Body;
-        if(!bodyLoader.load(newBody, filename)){
-            return false;
+        BodyPtr newBody = dynamic_cast<Body*>(preloadedData());
+        if(!newBody){
+            newBody = new Body;
+            if(!bodyLoader.load(newBody, filename)){
+                return false;
+            }
         }
         item->setBody(newBody);
 
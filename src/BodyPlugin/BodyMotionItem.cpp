@@ -7,6 +7,7 @@
 #include "BodyItem.h"
 #include <cnoid/MultiSeqItemCreationPanel>
 #include <cnoid/ItemManager>
+#include <cnoid/ItemFileIO>
 #include <cnoid/Archive>
 #include <cnoid/ZMPSeq>
 #include <cnoid/MessageView>
@@ -40,6 +41,46 @@ typedef ref_ptr<ExtraSeqItemInfo> ExtraSeqItemInfoPtr;
     
 typedef std::map<std::string, ExtraSeqItemInfoPtr> ExtraSeqItemInfoMap;
 
+
+class BodyMotionFileIO : public ItemFileIOBase<BodyMotionItem>
+{
+    struct PreloadedMotion : public Referenced
+    {
+        BodyMotion motion;
+    };
+    
+public:
+    BodyMotionFileIO()
+        : ItemFileIOBase<BodyMotionItem>("BODY-MOTION-YAML", Load | Save | Preload)
+    {
+        setCaption(_("Body Motion"));
+        setExtensions({ "seq", "yaml" });
+    }
+
+    virtual ReferencedPtr preload(const std::string& filename, std::ostream& os) override
+    {
+        ref_ptr<PreloadedMotion> preloaded = new PreloadedMotion;
+        if(!preloaded->motion.load(filename, os)){
+            return nullptr;
+        }
+        return preloaded;
+    }
+
+    virtual bool load(BodyMotionItem* item, const std::string& filename) override
+    {
+        if(auto preloaded = dynamic_cast<PreloadedMotion*>(preloadedData())){
+            *item->motion() = preloaded->motion;
+            return true;
+        }
+        return item->motion()->load(filename, os());
+    }
+
+    virtual bool save(BodyMotionItem* item, const std::string& filename) override
+    {
+        return item->motion()->save(filename, os());
+    }
+};
+
 }
 
 namespace cnoid {
@@ -123,14 +164,7 @@ void BodyMotionItem::initializeClass(ExtensionManager* ext)
     im.addCreationPanelPreFilter<BodyMotionItem>(bodyMotionItemPreFilter);
     im.addCreationPanelPostFilter<BodyMotionItem>(bodyMotionItemPostFilter);
 
-    im.addLoaderAndSaver<BodyMotionItem>(
-        _("Body Motion"), "BODY-MOTION-YAML", "seq;yaml",
-        [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
-            return item->motion()->load(filename, os);
-        },
-        [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
-            return item->motion()->save(filename, os);
-        });
+    im.registerFileIO<BodyMotionItem>(new BodyMotionFileIO);
 
     im.addSaver<BodyMotionItem>(
         _("Body Motion (version 1.0)"), "BODY-MOTION-YAML", "seq;yaml",
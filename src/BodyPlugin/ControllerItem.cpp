@@ -88,6 +88,18 @@ void ControllerItem::stop()
 }
 
 
+bool ControllerItem::storeCheckpointState(std::vector<char>& /* out_state */)
+{
+    return false;
+}
+
+
+bool ControllerItem::restoreCheckpointState(const std::vector<char>& /* state */)
+{
+    return false;
+}
+
+
 void ControllerItem::onOptionsChanged()
 {
 
@@ -74,6 +74,18 @@ public:
     */
     virtual void stop();
 
+    /**
+       These functions are called when a checkpoint of the simulation is captured or restored
+       to store and restore the internal state of the controller. The default implementations
+       return false, which means the controller does not support the checkpoints, so that a
+       checkpoint is not restored without the state of the controller. A controller without any
+       internal state should override them to return true. See SimulatorItem::captureCheckpoint().
+       @note These functions are called from the simulation thread or from the main thread
+       while the simulation is paused.
+    */
+    virtual bool storeCheckpointState(std::vector<char>& out_state);
+    virtual bool restoreCheckpointState(const std::vector<char>& state);
+
     //! \deprecated Use isNoDelayMode.
     bool isImmediateMode() const { return isNoDelayMode(); }
     //! \deprecated Use setsNoDelayMode.
@@ -27,6 +27,7 @@
 #include <cnoid/EigenUtil>
 #include <cnoid/StringUtil>
 #include <cnoid/Tokenizer>
+#include <cnoid/ImageStreamRecorder>
 #include <QThread>
 #include <QApplication>
 #include <QOpenGLContext>
@@ -207,6 +208,8 @@ public:
     bool needToClearVisionDataByTurningOff;
     std::shared_ptr<RangeSensor::RangeData> rangeData;
     FisheyeLensConverter fisheyeLensConverter;
+    int imageStreamId;
+    int pointStreamId;
 
     SensorRenderer(GLVisionSimulatorItemImpl* simImpl, Device* sensor, SimulationBody* simBody, int bodyIndex);
     ~SensorRenderer();
@@ -245,6 +248,7 @@ public:
     bool useThreadsForSensors;
     bool useThreadsForScreens;
     bool isVisionDataRecordingEnabled;
+    std::unique_ptr<ImageStreamRecorder> streamRecorder;
     bool isBestEffortMode;
     bool isQueueRenderingTerminationRequested;
 
@@ -262,6 +266,8 @@ public:
     vector<string> sensorNames;
     string sensorNameListString;
     Selection threadMode;
+    string visionDataStreamDirectory;
+    Selection visionDataStreamFormat;
     bool isBestEffortModeProperty;
     bool shootAllSceneObjects;
     bool isHeadLightEnabled;
@@ -275,6 +281,8 @@ public:
     GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self, const GLVisionSimulatorItemImpl& org);
     ~GLVisionSimulatorItemImpl();
     bool initializeSimulation(SimulatorItem* simulatorItem);
+    void startStreamRecording();
+    void finishStreamRecording();
     void onPreDynamics();
     void queueRenderingLoop();
     void onPostDynamics();
@@ -332,6 +340,11 @@ GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self
     threadMode.setSymbol(GLVisionSimulatorItem::SCREEN_THREAD_MODE, N_("Screen"));
     threadMode.select(GLVisionSimulatorItem::SENSOR_THREAD_MODE);
 
+    visionDataStreamFormat.setSymbol(ImageStreamRecorder::PNG_FORMAT, N_("PNG"));
+    visionDataStreamFormat.setSymbol(ImageStreamRecorder::JPEG_FORMAT, N_("JPEG"));
+    visionDataStreamFormat.setSymbol(ImageStreamRecorder::RAW_FORMAT, N_("Raw"));
+    visionDataStreamFormat.select(ImageStreamRecorder::PNG_FORMAT);
+
     isAntiAliasingEnabled = false;
 }
 
@@ -357,6 +370,8 @@ GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self
     bodyNameListString = getNameListString(bodyNames);
     sensorNameListString = getNameListString(sensorNames);
     threadMode = org.threadMode;
+    visionDataStreamDirectory = org.visionDataStreamDirectory;
+    visionDataStreamFormat = org.visionDataStreamFormat;
     isBestEffortModeProperty = org.isBestEffortModeProperty;
     shootAllSceneObjects = org.shootAllSceneObjects;
     isHeadLightEnabled = org.isHeadLightEnabled;
@@ -417,6 +432,21 @@ void GLVisionSimulatorItem::setVisionDataRecordingEnabled(bool on)
 }
 
 
+void GLVisionSimulatorItem::setVisionDataStreamDirectory(const std::string& directory)
+{
+    impl->setProperty(impl->visionDataStreamDirectory, directory);
+}
+
+
+void GLVisionSimulatorItem::setVisionDataStreamFormat(int format)
+{
+    if(format != impl->visionDataStreamFormat.which()){
+        impl->visionDataStreamFormat.select(format);
+        notifyUpdate();
+    }
+}
+
+
 void GLVisionSimulatorItem::setThreadMode(int mode)
 {
     if(mode != impl->threadMode.which()){
@@ -566,6 +596,9 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
     }
 
     if(!sensorRenderers.empty()){
+        if(!visionDataStreamDirectory.empty()){
+            startStreamRecording();
+        }
         simulatorItem->addPreDynamicsFunction([&](){ onPreDynamics(); });
         simulatorItem->addPostDynamicsFunction([&](){ onPostDynamics(); });
 
@@ -589,6 +622,39 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
 }
 
 
+/**
+   The camera images and the range camera points are written to the files in the encoder threads
+   so that the long recording does not keep the frames in memory.
+*/
+void GLVisionSimulatorItemImpl::startStreamRecording()
+{
+    streamRecorder.reset(new ImageStreamRecorder);
+    streamRecorder->setDirectory(visionDataStreamDirectory);
+    streamRecorder->setFormat(visionDataStreamFormat.which());
+
+    for(auto& renderer : sensorRenderers){
+        if(renderer->camera){
+            auto name = format("{0}-{1}", renderer->simBody->body()->name(), renderer->device->name());
+            if(renderer->camera->imageType() != Camera::NO_IMAGE){
+                renderer->imageStreamId = streamRecorder->addImageStream(name);
+            }
+            if(renderer->rangeCamera){
+                renderer->pointStreamId = streamRecorder->addPointStream(name + "-points");
+            }
+        }
+    }
+
+    if(streamRecorder->start()){
+        os << format(_("{0} records the vision data streams in \"{1}\"."),
+                     self->displayName(), visionDataStreamDirectory) << endl;
+    } else {
+        os << format(_("{0} cannot record the vision data streams: {1}"),
+                     self->displayName(), streamRecorder->errorMessage()) << endl;
+        streamRecorder.reset();
+    }
+}
+
+
 SensorRenderer::SensorRenderer(GLVisionSimulatorItemImpl* simImpl, Device* device, SimulationBody* simBody, int bodyIndex)
     : simImpl(simImpl),
       device(device),
@@ -596,6 +662,8 @@ SensorRenderer::SensorRenderer(GLVisionSimulatorItemImpl* simImpl, Device* devic
       bodyIndex(bodyIndex)
 {
     deviceForRendering = device->clone();
+    imageStreamId = -1;
+    pointStreamId = -1;
     camera = dynamic_cast<Camera*>(device);
     rangeCamera = dynamic_pointer_cast<RangeCamera>(camera);
     rangeSensor = dynamic_cast<RangeSensor*>(device);
@@ -1444,6 +1512,15 @@ void SensorRenderer::copyVisionData()
                 camera->setImage(image);
             }
             camera->setDelay(delay);
+
+            if(auto recorder = simImpl->streamRecorder.get()){
+                if(imageStreamId >= 0){
+                    recorder->pushImage(imageStreamId, simImpl->currentTime, camera->sharedImage());
+                }
+                if(pointStreamId >= 0){
+                    recorder->pushPoints(pointStreamId, simImpl->currentTime, rangeCamera->sharedPoints());
+                }
+            }
         } else if(rangeSensor){
             if(screens.empty()){
                 rangeData = std::make_shared<vector<double>>();
@@ -1711,11 +1788,33 @@ void GLVisionSimulatorItemImpl::finalizeSimulation()
             sensorQueue.pop();
         }
     }
+
+    if(streamRecorder){
+        finishStreamRecording();
+    }
         
     sensorRenderers.clear();
 }
 
 
+void GLVisionSimulatorItemImpl::finishStreamRecording()
+{
+    streamRecorder->finish();
+
+    auto message = streamRecorder->errorMessage();
+    if(!message.empty()){
+        os << format(_("{0}: An error occurred in recording the vision data streams: {1}"),
+                     self->displayName(), message) << endl;
+    }
+    int numDroppedFrames = streamRecorder->numDroppedFrames();
+    if(numDroppedFrames > 0){
+        os << format(_("{0}: {1} frames of the vision data streams were dropped."),
+                     self->displayName(), numDroppedFrames) << endl;
+    }
+    streamRecorder.reset();
+}
+
+
 SensorRenderer::~SensorRenderer()
 {
     if(simImpl->useThreadsForSensors){
@@ -1769,6 +1868,10 @@ void GLVisionSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty
     putProperty(_("Max frame rate"), maxFrameRate, changeProperty(maxFrameRate));
     putProperty(_("Max latency [s]"), maxLatency, changeProperty(maxLatency));
     putProperty(_("Record vision data"), isVisionDataRecordingEnabled, changeProperty(isVisionDataRecordingEnabled));
+    putProperty(_("Vision data stream directory"), visionDataStreamDirectory,
+                changeProperty(visionDataStreamDirectory));
+    putProperty(_("Vision data stream format"), visionDataStreamFormat,
+                [&](int index){ return visionDataStreamFormat.select(index); });
     putProperty(_("Thread mode"), threadMode, [&](int index){ return threadMode.select(index); });
     putProperty(_("Best effort"), isBestEffortModeProperty, changeProperty(isBestEffortModeProperty));
     putProperty(_("All scene objects"), shootAllSceneObjects, changeProperty(shootAllSceneObjects));
@@ -1795,6 +1898,10 @@ bool GLVisionSimulatorItemImpl::store(Archive& archive)
     archive.write("maxFrameRate", maxFrameRate);
     archive.write("maxLatency", maxLatency);
     archive.write("recordVisionData", isVisionDataRecordingEnabled);
+    if(!visionDataStreamDirectory.empty()){
+        archive.writeRelocatablePath("visionDataStreamDirectory", visionDataStreamDirectory);
+    }
+    archive.write("visionDataStreamFormat", visionDataStreamFormat.selectedSymbol());
     archive.write("threadMode", threadMode.selectedSymbol());
     archive.write("bestEffort", isBestEffortModeProperty);
     archive.write("allSceneObjects", shootAllSceneObjects);
@@ -1824,6 +1931,12 @@ bool GLVisionSimulatorItemImpl::restore(const Archive& archive)
     archive.read("maxFrameRate", maxFrameRate);
     archive.read("maxLatency", maxLatency);
     archive.read("recordVisionData", isVisionDataRecordingEnabled);
+    visionDataStreamDirectory.clear();
+    archive.readRelocatablePath("visionDataStreamDirectory", visionDataStreamDirectory);
+    string symbol;
+    if(archive.read("visionDataStreamFormat", symbol)){
+        visionDataStreamFormat.select(symbol);
+    }
     archive.read("bestEffort", isBestEffortModeProperty);
     archive.read("allSceneObjects", shootAllSceneObjects);
     archive.read("rangeSensorPrecisionRatio", rangeSensorPrecisionRatio);
@@ -1832,7 +1945,6 @@ bool GLVisionSimulatorItemImpl::restore(const Archive& archive)
     archive.read("enableAdditionalLights", areAdditionalLightsEnabled);
     archive.read("antiAliasing", isAntiAliasingEnabled);
 
-    string symbol;
     if(archive.read("threadMode", symbol)){
         threadMode.select(symbol);
     } else {
@@ -29,6 +29,14 @@ public:
     void setMaxFrameRate(double rate);
     void setMaxLatency(double latency);
     void setVisionDataRecordingEnabled(bool on);
+
+    /**
+       The camera images and the range camera points are written to the directory during the simulation
+       when the directory is specified. The format is one of the formats defined in ImageStreamRecorder.
+    */
+    void setVisionDataStreamDirectory(const std::string& directory);
+    void setVisionDataStreamFormat(int format);
+
     void setThreadMode(int mode);
     void setBestEffortMode(bool on);
     void setRangeSensorPrecisionRatio(double r);
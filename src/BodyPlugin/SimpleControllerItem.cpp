@@ -7,6 +7,7 @@
 #include <cnoid/BodyItem>
 #include <cnoid/Body>
 #include <cnoid/Link>
+#include <cnoid/BodyState>
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/Archive>
 #include <cnoid/MessageView>
@@ -21,6 +22,7 @@
 #include <fmt/format.h>
 #include <set>
 #include <bitset>
+#include <cstring>
 #include "gettext.h"
 
 using namespace std;
@@ -40,6 +42,34 @@ struct SharedInfo : public Referenced
 
 typedef ref_ptr<SharedInfo> SharedInfoPtr;
 
+template<class T>
+void appendArray(vector<char>& buf, const vector<T>& array)
+{
+    const uint64_t size = array.size();
+    const char* p = reinterpret_cast<const char*>(&size);
+    buf.insert(buf.end(), p, p + sizeof(size));
+    p = reinterpret_cast<const char*>(array.data());
+    buf.insert(buf.end(), p, p + size * sizeof(T));
+}
+
+template<class T>
+bool extractArray(const vector<char>& buf, size_t& io_pos, vector<T>& out_array)
+{
+    uint64_t size;
+    if(buf.size() - io_pos < sizeof(size)){
+        return false;
+    }
+    std::memcpy(&size, buf.data() + io_pos, sizeof(size));
+    io_pos += sizeof(size);
+    if((buf.size() - io_pos) / sizeof(T) < size){
+        return false;
+    }
+    out_array.resize(size);
+    std::memcpy(out_array.data(), buf.data() + io_pos, size * sizeof(T));
+    io_pos += size * sizeof(T);
+    return true;
+}
+
 }
 
 namespace cnoid {
@@ -969,6 +999,68 @@ void SimpleControllerItem::stop()
 }
 
 
+/*
+  The state consists of the states of the links and devices of the IO body shared with the child
+  controllers, and the states stored by this controller and the child controllers.
+*/
+bool SimpleControllerItem::storeCheckpointState(std::vector<char>& out_state)
+{
+    out_state.clear();
+
+    BodyState ioBodyState;
+    ioBodyState.storeCompleteState(*impl->ioBody);
+    appendArray(out_state, ioBodyState.data(BodyState::LINK_STATE_ARENA));
+    appendArray(out_state, ioBodyState.data(BodyState::DEVICE_STATES));
+
+    vector<char> controllerState;
+    if(!impl->controller->storeState(controllerState)){
+        return false;
+    }
+    appendArray(out_state, controllerState);
+    for(auto& childControllerItem : impl->childControllerItems){
+        if(!childControllerItem->impl->controller->storeState(controllerState)){
+            return false;
+        }
+        appendArray(out_state, controllerState);
+    }
+
+    return true;
+}
+
+
+bool SimpleControllerItem::restoreCheckpointState(const std::vector<char>& state)
+{
+    size_t pos = 0;
+    BodyState ioBodyState;
+    if(!extractArray(state, pos, ioBodyState.data(BodyState::LINK_STATE_ARENA)) ||
+       !extractArray(state, pos, ioBodyState.data(BodyState::DEVICE_STATES)) ||
+       !ioBodyState.checkCompleteState(*impl->ioBody)){
+        return false;
+    }
+
+    vector<vector<char>> controllerStates(impl->childControllerItems.size() + 1);
+    for(auto& controllerState : controllerStates){
+        if(!extractArray(state, pos, controllerState)){
+            return false;
+        }
+    }
+    if(pos != state.size()){
+        return false;
+    }
+
+    ioBodyState.restoreCompleteState(*impl->ioBody);
+    if(!impl->controller->restoreState(controllerStates[0])){
+        return false;
+    }
+    for(size_t i=0; i < impl->childControllerItems.size(); ++i){
+        if(!impl->childControllerItems[i]->impl->controller->restoreState(controllerStates[i + 1])){
+            return false;
+        }
+    }
+    return true;
+}
+
+
 bool SimpleControllerItem::Impl::onReloadingChanged(bool on)
 {
     doReloading = on;
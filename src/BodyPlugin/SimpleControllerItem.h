@@ -31,6 +31,8 @@ public:
     virtual bool control() override;
     virtual void output() override;
     virtual void stop() override;
+    virtual bool storeCheckpointState(std::vector<char>& out_state) override;
+    virtual bool restoreCheckpointState(const std::vector<char>& state) override;
 
 protected:
     virtual Item* doDuplicate() const override;
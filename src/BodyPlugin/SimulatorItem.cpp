@@ -27,18 +27,22 @@
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/Archive>
 #include <cnoid/MultiDeviceStateSeq>
+#include <cnoid/DeviceStateRecorder>
 #include <cnoid/ReferencedObjectSeqItem>
 #include <cnoid/Timer>
 #include <cnoid/Deque2D>
+#include <cnoid/LockFreeRingBuffer>
 #include <cnoid/ConnectionSet>
 #include <cnoid/FloatingNumberString>
 #include <cnoid/SceneGraph>
 #include <cnoid/CloneMap>
+#include <cnoid/SimulationProfiler>
 #include <QThread>
-#include <QMutex>
 #include <QElapsedTimer>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <cstring>
 #include <condition_variable>
 #include <set>
 #include <deque>
@@ -57,22 +61,93 @@ typedef Deque2D<SE3, Eigen::aligned_allocator<SE3> > MultiSE3Deque;
 
 typedef map<weak_ref_ptr<BodyItem>, SimulationBodyPtr> BodyItemToSimBodyMap;
 
+/*
+  The result frames are passed from the simulation thread to the main thread through
+  lock-free ring buffers with this time length. A frame is dropped when the main thread
+  does not flush the buffer before it becomes full.
+*/
+constexpr double ResultBufferTimeLength = 2.0;
+constexpr int MinResultBufferSize = 256;
+constexpr int MaxResultBufferSize = 8192;
+
+constexpr uint32_t CheckpointMagic = 0x434b5054; // "CKPT"
+constexpr int CheckpointVersion = 1;
+
+// The identifier of a simulation run, which is used for checking the checkpoints
+std::atomic<int> simulationIdCounter(0);
+
+template<class T>
+void writeCheckpointValue(vector<char>& buf, const T& value)
+{
+    const char* p = reinterpret_cast<const char*>(&value);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+template<class T>
+void writeCheckpointArray(vector<char>& buf, const vector<T>& array)
+{
+    writeCheckpointValue(buf, static_cast<uint64_t>(array.size()));
+    const char* p = reinterpret_cast<const char*>(array.data());
+    buf.insert(buf.end(), p, p + array.size() * sizeof(T));
+}
+
+class CheckpointReader
+{
+    const char* p;
+    const char* end;
+public:
+    CheckpointReader(const vector<char>& buf) : p(buf.data()), end(buf.data() + buf.size()) { }
+
+    template<class T> bool read(T& out_value) {
+        if(end - p < static_cast<ptrdiff_t>(sizeof(T))){
+            return false;
+        }
+        std::memcpy(&out_value, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    template<class T> bool readArray(vector<T>& out_array) {
+        uint64_t size;
+        if(!read(size) || static_cast<uint64_t>(end - p) / sizeof(T) < size){
+            return false;
+        }
+        out_array.resize(size);
+        std::memcpy(out_array.data(), p, size * sizeof(T));
+        p += size * sizeof(T);
+        return true;
+    }
+
+    bool isAtEnd() const { return p == end; }
+};
+
+struct WorldResultFrame
+{
+    int frame;
+    shared_ptr<CollisionLinkPairList> collisionPairs;
+};
+
 struct FunctionSet
 {
     struct FunctionInfo {
         int id;
         std::function<void()> function;
+        // The name of the item that added the function, which is used as the profiling phase name
+        string ownerName;
+        int profilingPhaseId;
     };
     vector<FunctionInfo> functions;
     std::mutex mutex;
     SimulatorItem::Impl* simImpl;
+    string profilingPhaseName;
     int idCounter;
     bool needToUpdate;
     vector<FunctionInfo> functionsToAdd;
     set<int> registerdIds;
     vector<int> idsToRemove;
         
-    FunctionSet(SimulatorItem::Impl* simImpl) : simImpl(simImpl) {
+    FunctionSet(SimulatorItem::Impl* simImpl, const char* profilingPhaseName)
+        : simImpl(simImpl), profilingPhaseName(profilingPhaseName) {
         clear();
     }
     void clear() {
@@ -84,13 +159,26 @@ struct FunctionSet
         idsToRemove.clear();
     }
 
-    void call(){
+    void call(SimulationProfiler* profiler){
         if(needToUpdate){
             updateFunctions();
         }
         const size_t n = functions.size();
-        for(size_t i=0; i < n; ++i){
-            functions[i].function();
+        if(!profiler){
+            for(size_t i=0; i < n; ++i){
+                functions[i].function();
+            }
+        } else {
+            for(size_t i=0; i < n; ++i){
+                auto& info = functions[i];
+                if(info.profilingPhaseId < 0){
+                    info.profilingPhaseId =
+                        profiler->addPhase(info.ownerName.empty() ? profilingPhaseName : info.ownerName);
+                }
+                profiler->beginPhase(info.profilingPhaseId);
+                info.function();
+                profiler->endPhase(info.profilingPhaseId);
+            }
         }
     }
 
@@ -144,12 +232,41 @@ public:
     bool isDynamic;
     bool areShapesCloned;
 
-    Deque2D<double> jointPosBuf;
-    MultiSE3Deque linkPosBuf;
-    vector<Device*> devicesToNotifyResults;
+    struct ResultFrame
+    {
+        int frame;
+        vector<double> jointPositions;
+        vector<SE3, Eigen::aligned_allocator<SE3>> linkPositions;
+        DeviceStateRecorder::Record deviceStateRecord;
+    };
+
+    // Accessed by both the simulation thread (producer) and the main thread (consumer)
+    LockFreeRingBuffer<ResultFrame> resultRing;
+    std::atomic<bool> isResultRingReady;
+    std::atomic<int> numDroppedFrames;
+    int numJointsToRecord;
+    int numLinksToRecord;
+    int numDevicesToRecord;
+
+    /*
+      The record function is called by the simulation thread and the restore function is called
+      by the main thread.
+    */
+    DeviceStateRecorder deviceStateRecorder;
+
+    // Accessed by the simulation thread only
     ScopedConnectionSet deviceStateConnections;
     vector<bool> deviceStateChangeFlag;
+
+    // Accessed by the main thread only
+    Deque2D<double> jointPosBuf;
+    MultiSE3Deque linkPosBuf;
     Deque2D<DeviceStatePtr> deviceStateBuf;
+    vector<DeviceStatePtr> currentDeviceStates;
+    int numStagedFrames;
+    ResultFrame lastStagedFrame;
+    bool hasLastStagedFrame;
+    vector<Device*> devicesToNotifyResults;
 
     ItemPtr parentOfResultItems;
     string resultItemPrefix;
@@ -172,7 +289,12 @@ public:
     void initializeResultItems();
     void setInitialStateOfBodyMotion(shared_ptr<BodyMotion> bodyMotion);
     void setActive(bool on);
+    void connectDeviceStateSignals();
     void bufferResults();
+    void stageResults(int firstFrame, int lastFrame);
+    void restoreDeviceStates(ResultFrame& result);
+    void appendStagedFrame(const ResultFrame& result);
+    void duplicateLastStagedFrame();
     void flushResults();
     void flushResultsToBodyMotionItems();
     void flushResultsToBody();
@@ -205,13 +327,33 @@ public:
     int currentFrame;
     double worldFrameRate;
     double worldTimeStep_;
-    int frameAtLastBufferWriting;
-    int numBufferedFrames;
+    std::atomic<int> frameAtLastBufferWriting;
     Timer flushTimer;
 
+    int resultBufferSize;
+    LockFreeRingBuffer<WorldResultFrame> worldResultRing;
+    std::atomic<int> numDroppedWorldFrames;
+    // The following variables are accessed by the main thread only
+    int lastFlushedFrame;
+    int numBufferedFrames;
+    shared_ptr<CollisionLinkPairList> lastCollisionPairs;
+    vector<SimulationBody*> loggedSimBodies;
+
     FunctionSet preDynamicsFunctions;
     FunctionSet midDynamicsFunctions;
     FunctionSet postDynamicsFunctions;
+    string functionOwnerName;
+
+    bool isProfilingEnabled;
+    string profilingCsvFile;
+    unique_ptr<SimulationProfiler> profiler;
+    SimulationProfiler* activeProfiler;
+    int controllerInputPhaseId;
+    int controllerControlPhaseId;
+    int controllerOutputPhaseId;
+    int simulatorStepPhaseId;
+    int resultBufferingPhaseId;
+    double concurrentControlTime;
     
     vector<SimulationBody::Impl*> simBodyImplsToNotifyResults;
     ItemList<SubSimulatorItem> subSimulatorItems;
@@ -224,6 +366,7 @@ public:
     bool isControlRequested;
     bool isControlFinished;
     bool isControlToBeContinued;
+    bool isControlInProgress; // The controllers may be running in the control thread
     bool doStopSimulationWhenNoActiveControllers;
     bool hasControllers; // Includes non-active controllers
 
@@ -255,7 +398,6 @@ public:
 
     TimeBar* timeBar;
     int fillLevelId;
-    QMutex resultBufMutex;
     double actualSimulationTime;
     double finishTime;
     MessageView* mv;
@@ -300,6 +442,18 @@ public:
     Connection aboutToQuitConnection;
 
     CloneMap cloneMap;
+
+    // The following variables are used for the checkpoints
+    int simulationId;
+    std::thread::id simulationThreadId;
+    std::mutex checkpointMutex;
+    bool isLoopPaused;
+    BodyState checkpointBodyState;
+    vector<char> checkpointBlob;
+    vector<BodyState> restoredBodyStates;
+    vector<char> restoredSimulatorState;
+    vector<vector<char>> restoredControllerStates;
+    vector<char> rollbackCheckpoint;
         
     void findTargetItems(Item* item, bool isUnderBodyItem, ItemList<Item>& out_targetItems);
     void clearSimulation();
@@ -309,12 +463,23 @@ public:
     void updateSimBodyLists();
     bool stepSimulationMain();
     void concurrentControlLoop();
+    void initializeProfiler();
+    void outputProfilingResults();
+    void bufferWorldResults(shared_ptr<CollisionLinkPairList> collisionPairs);
     void flushResults();
     int flushMainResults();
+    int numDroppedResultFrames() const;
     void stopSimulation(bool doSync);
     void pauseSimulation();
     void restartSimulation();
     void onSimulationLoopStopped();
+    void setLoopPaused(bool on);
+    bool captureCheckpoint(vector<char>& out_checkpoint);
+    bool isCheckpointAccessible();
+    bool writeCheckpoint(vector<char>& out_checkpoint);
+    bool restoreCheckpoint(const vector<char>& checkpoint);
+    bool readCheckpoint(const vector<char>& checkpoint);
+    bool applyCheckpoint();
     void setExternalForce(BodyItem* bodyItem, Link* link, const Vector3& point, const Vector3& f, double time);
     void doSetExternalForce();
     void setVirtualElasticString(
@@ -629,6 +794,13 @@ SimulationBody::Impl::Impl(SimulationBody* self, Body* body)
     areShapesCloned = false;
     isActive = false;
     isDynamic = false;
+    isResultRingReady = false;
+    numDroppedFrames = 0;
+    numJointsToRecord = 0;
+    numLinksToRecord = 0;
+    numDevicesToRecord = 0;
+    numStagedFrames = 0;
+    hasLastStagedFrame = false;
 }
 
 
@@ -706,6 +878,9 @@ bool SimulationBody::Impl::initialize(SimulatorItem* simulatorItem, BodyItem* bo
     body_->setCurrentTimeFunction([this](){ return this->simImpl->currentTime(); });
     body_->initializeState();
 
+    isResultRingReady = false;
+    numDroppedFrames = 0;
+
     isDynamic = !body_->isStaticModel();
     bool doReset = simImpl->doReset && isDynamic;
     extractAssociatedItems(doReset);
@@ -838,21 +1013,59 @@ void SimulationBody::initializeResultBuffers()
 
 void SimulationBody::Impl::initializeResultBuffers()
 {
-    jointPosBuf.resizeColumn(body_->numAllJoints());
-    int numLinksToRecord = 0;
+    const int numDevices = body_->numDevices();
+    deviceStateConnections.disconnect();
+    deviceStateChangeFlag.clear();
+    deviceStateChangeFlag.resize(numDevices, true); // set all the bits to store the initial states
+
+    if(isResultRingReady){
+        /*
+          This is the case where the body is re-activated in the simulation loop.
+          The buffers are not reallocated because the main thread may be flushing them.
+        */
+        connectDeviceStateSignals();
+        return;
+    }
+
+    // The following part is only executed in the main thread before the simulation thread starts
+
+    numJointsToRecord = body_->numAllJoints();
+    numLinksToRecord = 0;
     if(isDynamic){
         numLinksToRecord = simImpl->isAllLinkPositionOutputMode ? body_->numLinks() : 1;
     }
-    linkPosBuf.resizeColumn(numLinksToRecord);
+    if(numDevices == 0 || !simImpl->isDeviceStateOutputEnabled){
+        numDevicesToRecord = 0;
+    } else {
+        numDevicesToRecord = numDevices;
+    }
 
-    const DeviceList<>& devices = body_->devices();
-    const int numDevices = devices.size();
-    deviceStateConnections.disconnect();
-    deviceStateChangeFlag.clear();
-    deviceStateChangeFlag.resize(numDevices, true); // set all the bits to store the initial states
+    if(numDevicesToRecord > 0){
+        deviceStateRecorder.initialize(body_->devices());
+    } else {
+        deviceStateRecorder.clear();
+    }
+    currentDeviceStates.clear();
+    currentDeviceStates.resize(numDevicesToRecord);
+
+    resultRing.setCapacity(simImpl->resultBufferSize);
+    resultRing.initializeElements(
+        [&](ResultFrame& result){
+            result.frame = -1;
+            result.jointPositions.resize(numJointsToRecord);
+            result.linkPositions.resize(numLinksToRecord);
+            deviceStateRecorder.initializeRecord(result.deviceStateRecord);
+        });
+
+    jointPosBuf.resizeColumn(numJointsToRecord);
+    linkPosBuf.resizeColumn(numLinksToRecord);
+    jointPosBuf.resizeRow(0);
+    linkPosBuf.resizeRow(0);
+    numStagedFrames = 0;
+    hasLastStagedFrame = false;
     devicesToNotifyResults.clear();
     
-    if(devices.empty() || !simImpl->isDeviceStateOutputEnabled){
+    if(numDevicesToRecord == 0){
         deviceStateBuf.clear();
         prevFlushedDeviceStateInDirectMode.clear();
     } else {
@@ -864,17 +1077,27 @@ void SimulationBody::Impl::initializeResultBuffers()
         
         // This buf always has the first element to keep unchanged states
         deviceStateBuf.resize(1, numDevices); 
+        prevFlushedDeviceStateInDirectMode.clear();
         prevFlushedDeviceStateInDirectMode.resize(numDevices);
-        for(size_t i=0; i < devices.size(); ++i){
-            deviceStateConnections.add(
-                devices[i]->sigStateChanged().connect(
-                    [this, i](){
-                        /** \note This must be thread safe
-                            if notifyStateChange is called from several threads.
-                        */
-                        deviceStateChangeFlag[i] = true;
-                    }));
-        }
+        connectDeviceStateSignals();
+    }
+
+    isResultRingReady = true;
+}
+
+
+void SimulationBody::Impl::connectDeviceStateSignals()
+{
+    const DeviceList<>& devices = body_->devices();
+    for(int i=0; i < numDevicesToRecord; ++i){
+        deviceStateConnections.add(
+            devices[i]->sigStateChanged().connect(
+                [this, i](){
+                    /** \note This must be thread safe
+                        if notifyStateChange is called from several threads.
+                    */
+                    deviceStateChangeFlag[i] = true;
+                }));
     }
 }
 
@@ -967,10 +1190,14 @@ void SimulationBody::Impl::setActive(bool on)
     if(body_){
         if(on){
             if(!isActive){
-                simImpl->resultBufMutex.lock();
-                self->initializeResultBuffers();
-                self->bufferResults();
-                simImpl->resultBufMutex.unlock();
+                /*
+                  The result buffers are allocated in the main thread before the simulation
+                  thread starts. A body without them has nothing to record.
+                */
+                if(isResultRingReady){
+                    self->initializeResultBuffers();
+                    self->bufferResults();
+                }
                 isActive = true;
                 simImpl->needToUpdateSimBodyLists = true;
             }
@@ -1000,36 +1227,131 @@ void SimulationBody::bufferResults()
 
 void SimulationBody::Impl::bufferResults()
 {
-    if(jointPosBuf.colSize() > 0){
-        Deque2D<double>::Row q = jointPosBuf.append();
-        for(int i=0; i < q.size() ; ++i){
-            q[i] = body_->joint(i)->q();
-        }
+    ResultFrame* result = resultRing.beginWriting();
+    if(!result){
+        /*
+          The main thread has not flushed the buffer yet. The frame is dropped without
+          waiting for it, and the device state change flags are kept so that the changed
+          states can be recorded in the next frame.
+        */
+        ++numDroppedFrames;
+        return;
     }
-    if(linkPosBuf.colSize() > 0){
-        MultiSE3Deque::Row pos = linkPosBuf.append();
-        for(int i=0; i < linkPosBuf.colSize(); ++i){
-            Link* link = body_->link(i);
-            pos[i].set(link->p(), link->R());
+    result->frame = simImpl->currentFrame;
+    
+    for(int i=0; i < numJointsToRecord; ++i){
+        result->jointPositions[i] = body_->joint(i)->q();
+    }
+    for(int i=0; i < numLinksToRecord; ++i){
+        Link* link = body_->link(i);
+        result->linkPositions[i].set(link->p(), link->R());
+    }
+    if(numDevicesToRecord > 0){
+        // Only the changed states are serialized into the preallocated record
+        deviceStateRecorder.record(body_->devices(), deviceStateChangeFlag, result->deviceStateRecord);
+    }
+
+    resultRing.commitWriting();
+}
+
+
+/**
+   Move the frames from the ring buffer to the buffers used for flushing the results.
+   A frame dropped by the simulation thread is filled with the previous frame so that
+   the flushed frames are continuous.
+*/
+void SimulationBody::Impl::stageResults(int firstFrame, int lastFrame)
+{
+    if(!isResultRingReady){
+        return;
+    }
+    for(int frame = firstFrame; frame <= lastFrame; ++frame){
+        ResultFrame* result = resultRing.front();
+        while(result && result->frame < frame){
+            // The frame buffered more than once in the same step
+            restoreDeviceStates(*result);
+            resultRing.pop();
+            result = resultRing.front();
+        }
+        if(result && result->frame == frame){
+            restoreDeviceStates(*result);
+            appendStagedFrame(*result);
+            resultRing.pop();
+        } else if(numStagedFrames > 0){
+            duplicateLastStagedFrame();
+        } else if(hasLastStagedFrame){
+            appendStagedFrame(lastStagedFrame);
+        } else if(result){
+            // The record is consumed here, so it is not restored again when the frame is popped
+            restoreDeviceStates(*result);
+            appendStagedFrame(*result);
         }
     }
-    if(deviceStateBuf.colSize() > 0){
-        const int prevIndex = std::max(0, deviceStateBuf.rowSize() - 1);
-        Deque2D<DeviceStatePtr>::Row current = deviceStateBuf.append();
-        Deque2D<DeviceStatePtr>::Row prev = deviceStateBuf[prevIndex];
-        const DeviceList<>& devices = body_->devices();
-        for(size_t i=0; i < devices.size(); ++i){
-            if(deviceStateChangeFlag[i]){
-                current[i] = devices[i]->cloneState();
-                deviceStateChangeFlag[i] = false;
-            } else {
-                current[i] = prev[i];
-            }
+
+    if(numStagedFrames > 0){
+        // Keep the last frame for filling the frames dropped before the next flush
+        lastStagedFrame.frame = lastFrame;
+        if(numJointsToRecord > 0){
+            auto q = jointPosBuf.last();
+            lastStagedFrame.jointPositions.assign(q.begin(), q.end());
+        }
+        if(numLinksToRecord > 0){
+            auto pos = linkPosBuf.last();
+            lastStagedFrame.linkPositions.assign(pos.begin(), pos.end());
         }
+        hasLastStagedFrame = true;
     }
 }
 
 
+/**
+   The device state records must be restored in the recorded order because the unchanged states
+   are not stored in the records.
+*/
+void SimulationBody::Impl::restoreDeviceStates(ResultFrame& result)
+{
+    if(numDevicesToRecord > 0){
+        deviceStateRecorder.restore(result.deviceStateRecord, currentDeviceStates);
+    }
+}
+
+
+void SimulationBody::Impl::appendStagedFrame(const ResultFrame& result)
+{
+    if(numJointsToRecord > 0){
+        std::copy(result.jointPositions.begin(), result.jointPositions.end(), jointPosBuf.append().begin());
+    }
+    if(numLinksToRecord > 0){
+        std::copy(result.linkPositions.begin(), result.linkPositions.end(), linkPosBuf.append().begin());
+    }
+    if(numDevicesToRecord > 0){
+        std::copy(currentDeviceStates.begin(), currentDeviceStates.end(), deviceStateBuf.append().begin());
+    }
+    ++numStagedFrames;
+}
+
+
+void SimulationBody::Impl::duplicateLastStagedFrame()
+{
+    if(numJointsToRecord > 0){
+        jointPosBuf.append();
+        auto src = jointPosBuf.row(jointPosBuf.rowSize() - 2);
+        std::copy(src.begin(), src.end(), jointPosBuf.last().begin());
+    }
+    if(numLinksToRecord > 0){
+        linkPosBuf.append();
+        auto src = linkPosBuf.row(linkPosBuf.rowSize() - 2);
+        std::copy(src.begin(), src.end(), linkPosBuf.last().begin());
+    }
+    if(numDevicesToRecord > 0){
+        deviceStateBuf.append();
+        auto src = deviceStateBuf.row(deviceStateBuf.rowSize() - 2);
+        std::copy(src.begin(), src.end(), deviceStateBuf.last().begin());
+    }
+    ++numStagedFrames;
+}
+
+
 void SimulationBody::flushResults()
 {
     impl->flushResults();
@@ -1047,6 +1369,7 @@ void SimulationBody::Impl::flushResults()
     // clear buffers
     linkPosBuf.resizeRow(0);
     jointPosBuf.resizeRow(0);
+    numStagedFrames = 0;
 
     // keep the last state so that unchanged states can be shared
     const int numPops = (deviceStateBuf.rowSize() >= 2) ? (deviceStateBuf.rowSize() - 1) : 0;
@@ -1062,7 +1385,7 @@ void SimulationBody::Impl::flushResultsToBodyMotionItems()
 
     const int ringBufferSize = simImpl->ringBufferSize;
     const int numBufFrames = linkPosBuf.rowSize();
-    const int nextFrame = simImpl->currentFrame + 1;
+    const int nextFrame = simImpl->lastFlushedFrame + 1;
 
     if(linkPosBuf.colSize() > 0){
         bool offsetChanged = false;
@@ -1150,7 +1473,9 @@ void SimulationBody::Impl::flushResultsToBody()
 
 void SimulationBody::Impl::flushResultsToWorldLogFile(int bufferFrame)
 {
-    //if(bufferFrame < linkPosBuf.rowSize()){
+    if(bufferFrame >= numStagedFrames){
+        return;
+    }
     
     WorldLogFileItem* log = simImpl->worldLogFileItem;
     log->beginBodyStateOutput();
@@ -1174,8 +1499,6 @@ void SimulationBody::Impl::flushResultsToWorldLogFile(int bufferFrame)
     }
 
     log->endBodyStateOutput();
-
-    //}
 }
 
 
@@ -1205,9 +1528,9 @@ SimulatorItem::SimulatorItem()
 SimulatorItem::Impl::Impl(SimulatorItem* self)
     : self(self),
       temporalResolutionType(N_TEMPORARL_RESOLUTION_TYPES, CNOID_GETTEXT_DOMAIN_NAME),
-      preDynamicsFunctions(this),
-      midDynamicsFunctions(this),
-      postDynamicsFunctions(this),
+      preDynamicsFunctions(this, "Pre-dynamics functions"),
+      midDynamicsFunctions(this, "Mid-dynamics functions"),
+      postDynamicsFunctions(this, "Post-dynamics functions"),
       recordingMode(SimulatorItem::N_RECORDING_MODES, CNOID_GETTEXT_DOMAIN_NAME),
       timeRangeMode(SimulatorItem::N_TIME_RANGE_MODES, CNOID_GETTEXT_DOMAIN_NAME),
       mv(MessageView::instance())
@@ -1225,6 +1548,10 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
     worldTimeStep_ = 1.0;
     frameAtLastBufferWriting = 0;
     flushTimer.sigTimeout().connect([&](){ flushResults(); });
+    resultBufferSize = MinResultBufferSize;
+    numDroppedWorldFrames = 0;
+    lastFlushedFrame = -1;
+    numBufferedFrames = 0;
 
     recordingMode.setSymbol(SimulatorItem::REC_FULL, N_("full"));
     recordingMode.setSymbol(SimulatorItem::REC_TAIL, N_("tail"));
@@ -1244,6 +1571,10 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
     isDoingSimulationLoop = false;
     isRealtimeSyncMode = true;
     recordCollisionData = false;
+    simulationId = 0;
+    isLoopPaused = false;
+    isProfilingEnabled = false;
+    activeProfiler = nullptr;
 
     timeBar = TimeBar::instance();
 }
@@ -1273,6 +1604,8 @@ SimulatorItem::Impl::Impl(SimulatorItem* self, const Impl& org)
     isRealtimeSyncMode = org.isRealtimeSyncMode;
     recordCollisionData = org.recordCollisionData;
     controllerOptionString_ = org.controllerOptionString_;
+    isProfilingEnabled = org.isProfilingEnabled;
+    profilingCsvFile = org.profilingCsvFile;
 }
     
 
@@ -1504,6 +1837,8 @@ int FunctionSet::add(std::function<void()>& func)
     
     FunctionInfo info;
     info.function = func;
+    info.ownerName = simImpl->functionOwnerName;
+    info.profilingPhaseId = -1;
     while(true){
         if(registerdIds.insert(idCounter).second){
             break;
@@ -1567,6 +1902,7 @@ void SimulatorItem::Impl::clearSimulation()
     preDynamicsFunctions.clear();
     midDynamicsFunctions.clear();
     postDynamicsFunctions.clear();
+    activeProfiler = nullptr;
 
     subSimulatorItems.clear();
 
@@ -1624,6 +1960,10 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
     worldTimeStep_ = self->worldTimeStep();
     worldFrameRate = 1.0 / worldTimeStep_;
 
+    resultBufferSize =
+        std::max(MinResultBufferSize,
+                 std::min(MaxResultBufferSize, static_cast<int>(ResultBufferTimeLength * worldFrameRate)));
+
     if(recordingMode.is(SimulatorItem::REC_NONE)){
         isRecordingEnabled = false;
         isRingBufferMode = false;
@@ -1680,7 +2020,13 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
         }
     }
 
-    numBufferedFrames = 1;
+    // The initial frame buffered in the initialization of the simulation bodies
+    worldResultRing.setCapacity(resultBufferSize);
+    numDroppedWorldFrames = 0;
+    lastFlushedFrame = -1;
+    numBufferedFrames = 0;
+    lastCollisionPairs.reset();
+    bufferWorldResults(nullptr);
     
     if(isRecordingEnabled && recordCollisionData){
         collisionPairsBuf.clear();
@@ -1706,6 +2052,8 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
     virtualElasticStringFunctionId = stdx::nullopt;
 
     cloneMap.replacePendingObjects();
+
+    initializeProfiler();
     
     bool result = self->initializeSimulation(simBodiesWithBody);
 
@@ -1718,7 +2066,10 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
             bool initialized = false;
             if(item->isEnabled()){
                 mv->putln(format(_("SubSimulatorItem \"{}\" has been detected."), item->displayName()));
-                if(item->initializeSimulation(self)){
+                functionOwnerName = item->displayName();
+                bool isSubSimulatorInitialized = item->initializeSimulation(self);
+                functionOwnerName.clear();
+                if(isSubSimulatorInitialized){
                     initialized = true;
                 } else {
                     mv->putln(format(_("The initialization of \"{}\" failed."), item->displayName()),
@@ -1781,6 +2132,8 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
 
     if(result){
         frameAtLastBufferWriting = 0;
+        simulationId = ++simulationIdCounter;
+        isLoopPaused = false;
         isDoingSimulationLoop = true;
         isWaitingForSimulationToStop = false;
         stopRequested = false;
@@ -1804,6 +2157,7 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
             isExitingControlLoopRequested = false;
             isControlRequested = false;
             isControlFinished = false;
+            isControlInProgress = false;
             controlThread = std::thread([&](){ concurrentControlLoop(); });
         }
 
@@ -1829,8 +2183,9 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
 
                 worldLogFileItem->clearOutput();
                 worldLogFileItem->beginHeaderOutput();
-                for(size_t i=0; i < activeSimBodies.size(); ++i){
-                    worldLogFileItem->outputBodyHeader(activeSimBodies[i]->impl->body_->name());
+                loggedSimBodies = activeSimBodies;
+                for(auto& simBody : loggedSimBodies){
+                    worldLogFileItem->outputBodyHeader(simBody->impl->body_->name());
                 }
                 worldLogFileItem->endHeaderOutput();
                 worldLogFileItem->notifyUpdate();
@@ -1927,6 +2282,11 @@ SimulationBody* SimulatorItem::findSimulationBody(const std::string& name)
 // Simulation loop
 void SimulatorItem::Impl::run()
 {
+    {
+        std::lock_guard<std::mutex> lock(checkpointMutex);
+        simulationThreadId = std::this_thread::get_id();
+    }
+
     self->initializeSimulationThread();
 
     double elapsedTime = 0.0;
@@ -1949,6 +2309,7 @@ void SimulatorItem::Impl::run()
                 if(!isOnPause){
                     elapsedTime += timer.elapsed();
                     isOnPause = true;
+                    setLoopPaused(true);
                     sigSimulationPaused();
                 }
                 QThread::msleep(50);
@@ -1956,6 +2317,7 @@ void SimulatorItem::Impl::run()
                 if(isOnPause){
                     timer.start();
                     isOnPause = false;
+                    setLoopPaused(false);
                     sigSimulationResumed();
                 }
                 if(!stepSimulationMain() || stopRequested || frame >= maxFrame){
@@ -1986,6 +2348,7 @@ void SimulatorItem::Impl::run()
                 if(!isOnPause){
                     elapsedTime += timer.elapsed();
                     isOnPause = true;
+                    setLoopPaused(true);
                     sigSimulationPaused();
                 }
                 QThread::msleep(50);
@@ -1993,6 +2356,7 @@ void SimulatorItem::Impl::run()
                 if(isOnPause){
                     timer.start();
                     isOnPause = false;
+                    setLoopPaused(false);
                     sigSimulationResumed();
                 }
                 if(!stepSimulationMain() || stopRequested || frame++ >= maxFrame){
@@ -2004,6 +2368,8 @@ void SimulatorItem::Impl::run()
 
     if(!isOnPause){
     	elapsedTime += timer.elapsed();
+    } else {
+        setLoopPaused(false);
     }
     actualSimulationTime = (elapsedTime / 1000.0);
     finishTime = frame / worldFrameRate;
@@ -2027,6 +2393,13 @@ void SimulatorItem::Impl::run()
 }
 
 
+void SimulatorItem::Impl::setLoopPaused(bool on)
+{
+    std::lock_guard<std::mutex> lock(checkpointMutex);
+    isLoopPaused = on;
+}
+
+
 void SimulatorItem::Impl::updateSimBodyLists()
 {
     activeSimBodies.clear();
@@ -2056,41 +2429,60 @@ bool SimulatorItem::Impl::stepSimulationMain()
 {
     currentFrame++;
 
+    SimulationProfiler* profiler = activeProfiler;
+    if(profiler){
+        profiler->beginStep();
+    }
+
     if(needToUpdateSimBodyLists){
         updateSimBodyLists();
     }
     
     bool doContinue = !doStopSimulationWhenNoActiveControllers;
 
-    preDynamicsFunctions.call();
+    preDynamicsFunctions.call(profiler);
 
     if(useControllerThreads){
         if(activeControllers.empty()){
             isControlFinished = true;
         } else {
-            for(size_t i=0; i < activeControllers.size(); ++i){
-                activeControllers[i]->input();
+            {
+                SimulationProfiler::ScopedPhase phase(profiler, controllerInputPhaseId);
+                for(size_t i=0; i < activeControllers.size(); ++i){
+                    activeControllers[i]->input();
+                }
             }
             {
                 std::lock_guard<std::mutex> lock(controlMutex);                
                 isControlRequested = true;
+                isControlInProgress = true;
             }
             controlCondition.notify_all();
         }
     } else {
         for(size_t i=0; i < activeControllers.size(); ++i){
             ControllerItem* controller = activeControllers[i];
-            controller->input();
-            doContinue |= controller->control();
+            {
+                SimulationProfiler::ScopedPhase phase(profiler, controllerInputPhaseId);
+                controller->input();
+            }
+            {
+                SimulationProfiler::ScopedPhase phase(profiler, controllerControlPhaseId);
+                doContinue |= controller->control();
+            }
             if(controller->isNoDelayMode()){
+                SimulationProfiler::ScopedPhase phase(profiler, controllerOutputPhaseId);
                 controller->output();
             }
         }
     }
 
-    midDynamicsFunctions.call();
+    midDynamicsFunctions.call(profiler);
 
-    self->stepSimulation(activeSimBodies);
+    {
+        SimulationProfiler::ScopedPhase phase(profiler, simulatorStepPhaseId);
+        self->stepSimulation(activeSimBodies);
+    }
 
     shared_ptr<CollisionLinkPairList> collisionPairs;
     if(isRecordingEnabled && recordCollisionData){
@@ -2103,27 +2495,30 @@ bool SimulatorItem::Impl::stepSimulationMain()
             while(!isControlFinished){
                 controlCondition.wait(lock);
             }
+            isControlInProgress = false;
         }
         isControlFinished = false;
         doContinue |= isControlToBeContinued;
+        if(profiler){
+            profiler->addPhaseTime(controllerControlPhaseId, concurrentControlTime);
+        }
     }
 
-    postDynamicsFunctions.call();
-
-    {
-        resultBufMutex.lock();
-
-        ++numBufferedFrames;
-        for(size_t i=0; i < activeSimBodies.size(); ++i){
-            activeSimBodies[i]->bufferResults();
-        }
-        collisionPairsBuf.push_back(collisionPairs);
-        frameAtLastBufferWriting = currentFrame;
+    postDynamicsFunctions.call(profiler);
 
-        resultBufMutex.unlock();
+    if(profiler){
+        profiler->beginPhase(resultBufferingPhaseId);
+    }
+    for(size_t i=0; i < activeSimBodies.size(); ++i){
+        activeSimBodies[i]->bufferResults();
+    }
+    bufferWorldResults(collisionPairs);
+    if(profiler){
+        profiler->endPhase(resultBufferingPhaseId);
     }
 
     if(useControllerThreads){
+        SimulationProfiler::ScopedPhase phase(profiler, controllerOutputPhaseId);
         for(size_t i=0; i < activeControllers.size(); ++i){
             activeControllers[i]->output();
         }
@@ -2131,11 +2526,16 @@ bool SimulatorItem::Impl::stepSimulationMain()
         for(size_t i=0; i < activeControllers.size(); ++i){
             ControllerItem* controller = activeControllers[i];
             if(!controller->isNoDelayMode()){
+                SimulationProfiler::ScopedPhase phase(profiler, controllerOutputPhaseId);
                 controller->output(); 
             }
         }
     }
 
+    if(profiler){
+        profiler->endStep();
+    }
+
     return doContinue;
 }
 
@@ -2158,15 +2558,26 @@ void SimulatorItem::Impl::concurrentControlLoop()
             }
         }
 
+        SimulationProfiler::Clock::time_point controlStartTime;
+        if(activeProfiler){
+            controlStartTime = SimulationProfiler::Clock::now();
+        }
+
         bool doContinue = false;
         for(size_t i=0; i < activeControllers.size(); ++i){
             doContinue |= activeControllers[i]->control();
         }
+
+        double controlTime = 0.0;
+        if(activeProfiler){
+            controlTime = std::chrono::duration<double>(SimulationProfiler::Clock::now() - controlStartTime).count();
+        }
         
         {
             std::lock_guard<std::mutex> lock(controlMutex);
             isControlFinished = true;
             isControlToBeContinued = doContinue;
+            concurrentControlTime = controlTime;
         }
         controlCondition.notify_all();
     }
@@ -2176,6 +2587,61 @@ exitConcurrentControlLoop:
 }
 
 
+void SimulatorItem::Impl::initializeProfiler()
+{
+    activeProfiler = nullptr;
+    
+    if(!isProfilingEnabled){
+        profiler.reset();
+        return;
+    }
+
+    profiler.reset(new SimulationProfiler);
+    // The phases of the pre-dynamics functions are added when the functions are called
+    controllerInputPhaseId = profiler->addPhase("Controller input");
+    controllerControlPhaseId = profiler->addPhase("Controller control");
+    controllerOutputPhaseId = profiler->addPhase("Controller output");
+    // The phases recorded by the simulator itself are excluded from this phase
+    simulatorStepPhaseId = profiler->addPhase("Simulator step");
+    resultBufferingPhaseId = profiler->addPhase("Result buffering");
+    concurrentControlTime = 0.0;
+
+    activeProfiler = profiler.get();
+}
+
+
+void SimulatorItem::Impl::outputProfilingResults()
+{
+    if(!profiler || profiler->numSteps() == 0){
+        return;
+    }
+    
+    profiler->putSummary(mv->cout());
+
+    if(!profilingCsvFile.empty()){
+        if(profiler->writeCsvFile(profilingCsvFile)){
+            mv->putln(format(_("The profiling data has been written to \"{}\"."), profilingCsvFile));
+        } else {
+            mv->putln(format(_("The profiling data cannot be written to \"{}\"."), profilingCsvFile),
+                      MessageView::Error);
+        }
+    }
+}
+
+
+void SimulatorItem::Impl::bufferWorldResults(shared_ptr<CollisionLinkPairList> collisionPairs)
+{
+    if(auto result = worldResultRing.beginWriting()){
+        result->frame = currentFrame;
+        result->collisionPairs = collisionPairs;
+        worldResultRing.commitWriting();
+    } else {
+        ++numDroppedWorldFrames;
+    }
+    frameAtLastBufferWriting.store(currentFrame, std::memory_order_release);
+}
+
+
 void SimulatorItem::Impl::flushResults()
 {
     int frame = flushMainResults();
@@ -2189,41 +2655,75 @@ void SimulatorItem::Impl::flushResults()
         timeBar->updateFillLevel(fillLevelId, fillLevel);
     } else {
         const double time = frame / worldFrameRate;
-        for(size_t i=0; i < activeSimBodies.size(); ++i){
-            activeSimBodies[i]->impl->notifyResults(time);
+        for(auto& simBody : simBodiesWithBody){
+            if(simBody->impl->isResultRingReady){
+                simBody->impl->notifyResults(time);
+            }
         }
         timeBar->setTime(time);
     }
 }
 
 
+/**
+   This function is called from the main thread. The results are taken from the ring buffers
+   without blocking the simulation thread.
+*/
 int SimulatorItem::Impl::flushMainResults()
 {
-    resultBufMutex.lock();
+    const bool doRecordCollisions = isRecordingEnabled && recordCollisionData;
+    
+    int lastFrame = lastFlushedFrame;
+    while(auto result = worldResultRing.front()){
+        if(doRecordCollisions){
+            // The collisions of the initial frame are not recorded
+            for(int frame = std::max(lastFrame + 1, 1); frame <= result->frame; ++frame){
+                if(frame == result->frame){
+                    lastCollisionPairs = result->collisionPairs;
+                } else if(!lastCollisionPairs){
+                    // Filling a dropped frame
+                    lastCollisionPairs = std::make_shared<CollisionLinkPairList>();
+                }
+                collisionPairsBuf.push_back(lastCollisionPairs);
+            }
+        }
+        lastFrame = result->frame;
+        result->collisionPairs.reset();
+        worldResultRing.pop();
+    }
+
+    const int firstFrame = lastFlushedFrame + 1;
+    numBufferedFrames = lastFrame - lastFlushedFrame;
+
+    if(numBufferedFrames > 0){
+        for(auto& simBody : simBodiesWithBody){
+            simBody->impl->stageResults(firstFrame, lastFrame);
+        }
+    }
+    lastFlushedFrame = lastFrame;
 
     if(worldLogFileItem){
-        if(numBufferedFrames > 0){
-            int firstFrame = frameAtLastBufferWriting - (numBufferedFrames - 1);
-            for(int bufFrame = 0; bufFrame < numBufferedFrames; ++bufFrame){
-                double time = (firstFrame + bufFrame) * worldTimeStep_;
-                while(time >= nextLogTime){
-                    worldLogFileItem->beginFrameOutput(time);
-                    for(size_t i=0; i < activeSimBodies.size(); ++i){
-                        activeSimBodies[i]->impl->flushResultsToWorldLogFile(bufFrame);
-                    }
-                    worldLogFileItem->endFrameOutput();
-                    nextLogTime = ++nextLogFrame * logTimeStep;
+        for(int bufFrame = 0; bufFrame < numBufferedFrames; ++bufFrame){
+            double time = (firstFrame + bufFrame) * worldTimeStep_;
+            while(time >= nextLogTime){
+                worldLogFileItem->beginFrameOutput(time);
+                for(auto& simBody : loggedSimBodies){
+                    simBody->impl->flushResultsToWorldLogFile(bufFrame);
                 }
+                worldLogFileItem->endFrameOutput();
+                nextLogTime = ++nextLogFrame * logTimeStep;
             }
         }
     }
-    
-    for(auto& simBody : activeSimBodies){
-        simBody->flushResults();
+
+    for(auto& simBody : simBodiesWithBody){
+        if(simBody->impl->isResultRingReady){
+            simBody->flushResults();
+        }
     }
 
     bool offsetChanged;
-    if(isRecordingEnabled && recordCollisionData){
+    if(doRecordCollisions){
         offsetChanged = false;
         for(size_t i=0 ; i < collisionPairsBuf.size(); ++i){
             if(collisionSeq->numFrames() >= ringBufferSize){
@@ -2234,18 +2734,24 @@ int SimulatorItem::Impl::flushMainResults()
             collisionSeq0[0] = collisionPairsBuf[i];
         }
         if(offsetChanged){
-            collisionSeq->setOffsetTimeFrame(currentFrame + 1 - collisionSeq->numFrames());
+            collisionSeq->setOffsetTimeFrame(lastFrame + 1 - collisionSeq->numFrames());
         }
     }
     collisionPairsBuf.clear();
 
-    int frame = frameAtLastBufferWriting;
-    
     numBufferedFrames = 0;
-    
-    resultBufMutex.unlock();
 
-    return frame;
+    return lastFrame;
+}
+
+
+int SimulatorItem::Impl::numDroppedResultFrames() const
+{
+    int numDropped = numDroppedWorldFrames;
+    for(auto& simBody : simBodiesWithBody){
+        numDropped += simBody->impl->numDroppedFrames;
+    }
+    return numDropped;
 }
 
 
@@ -2326,6 +2832,13 @@ void SimulatorItem::Impl::onSimulationLoopStopped()
         timeBar->stopFillLevelUpdate(fillLevelId);
     }
 
+    int numDroppedFrames = numDroppedResultFrames();
+    if(numDroppedFrames > 0){
+        mv->putln(format(_("{0} result frames of {1} were dropped because they were not flushed in time."),
+                         numDroppedFrames, self->displayName()),
+                  MessageView::Warning);
+    }
+
     mv->notify(format(_("Simulation by {0} has finished at {1} [s]."), self->displayName(), finishTime));
 
     if(finishTime > 0.0){
@@ -2333,6 +2846,8 @@ void SimulatorItem::Impl::onSimulationLoopStopped()
                          actualSimulationTime, (actualSimulationTime / finishTime)));
     }
 
+    outputProfilingResults();
+
     clearSimulation();
 
     sigSimulationFinished();
@@ -2377,15 +2892,208 @@ double SimulatorItem::Impl::currentTime() const
 
 int SimulatorItem::simulationFrame() const
 {
-    QMutexLocker locker(&impl->resultBufMutex);
-    return impl->frameAtLastBufferWriting;
+    return impl->frameAtLastBufferWriting.load(std::memory_order_acquire);
 }
 
 
 double SimulatorItem::simulationTime() const
 {
-    QMutexLocker locker(&impl->resultBufMutex);
-    return impl->frameAtLastBufferWriting / impl->worldFrameRate;
+    return impl->frameAtLastBufferWriting.load(std::memory_order_acquire) / impl->worldFrameRate;
+}
+
+
+int SimulatorItem::numDroppedResultFrames() const
+{
+    return impl->numDroppedResultFrames();
+}
+
+
+bool SimulatorItem::captureCheckpoint(std::vector<char>& out_checkpoint)
+{
+    return impl->captureCheckpoint(out_checkpoint);
+}
+
+
+/*
+  The controllers running in the control thread modify their states and the IO bodies, so the
+  checkpoint is not accessed until the control thread finishes the control of the current step.
+*/
+bool SimulatorItem::Impl::isCheckpointAccessible()
+{
+    if(!isLoopPaused && std::this_thread::get_id() != simulationThreadId){
+        return false;
+    }
+    if(useControllerThreads){
+        std::lock_guard<std::mutex> lock(controlMutex);
+        if(isControlInProgress){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+  The checkpoint consists of the header, the link and device states of the bodies, the state of
+  the simulator and the states of the controllers. The states of the bodies are written as the
+  arrays of BodyState, and the states of the simulator and the controllers are written as the
+  byte arrays given by the storeCheckpointState functions.
+*/
+bool SimulatorItem::Impl::captureCheckpoint(vector<char>& out_checkpoint)
+{
+    if(!isDoingSimulationLoop){
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(checkpointMutex);
+    if(!isCheckpointAccessible()){
+        return false;
+    }
+    return writeCheckpoint(out_checkpoint);
+}
+
+
+bool SimulatorItem::Impl::writeCheckpoint(vector<char>& out_checkpoint)
+{
+    out_checkpoint.clear();
+    writeCheckpointValue(out_checkpoint, CheckpointMagic);
+    writeCheckpointValue(out_checkpoint, CheckpointVersion);
+    writeCheckpointValue(out_checkpoint, simulationId);
+    writeCheckpointValue(out_checkpoint, static_cast<int>(simBodiesWithBody.size()));
+
+    for(auto& simBody : simBodiesWithBody){
+        checkpointBodyState.storeCompleteState(*simBody->body());
+        writeCheckpointArray(out_checkpoint, checkpointBodyState.data(BodyState::LINK_STATE_ARENA));
+        writeCheckpointArray(out_checkpoint, checkpointBodyState.data(BodyState::DEVICE_STATES));
+    }
+
+    if(!self->storeCheckpointState(checkpointBlob)){
+        return false;
+    }
+    writeCheckpointArray(out_checkpoint, checkpointBlob);
+
+    for(auto& simBody : allSimBodies){
+        for(auto& info : simBody->impl->controllerInfos){
+            if(!info->controller->storeCheckpointState(checkpointBlob)){
+                return false;
+            }
+            writeCheckpointArray(out_checkpoint, checkpointBlob);
+        }
+    }
+
+    return true;
+}
+
+
+bool SimulatorItem::restoreCheckpoint(const std::vector<char>& checkpoint)
+{
+    return impl->restoreCheckpoint(checkpoint);
+}
+
+
+/*
+  The whole checkpoint is parsed and checked before any state is modified. The simulator and the
+  controllers may still reject their states, so the current state is captured beforehand and
+  restored when the checkpoint cannot be applied completely.
+*/
+bool SimulatorItem::Impl::restoreCheckpoint(const vector<char>& checkpoint)
+{
+    if(!isDoingSimulationLoop){
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(checkpointMutex);
+    if(!isCheckpointAccessible()){
+        return false;
+    }
+
+    if(!readCheckpoint(checkpoint) || !writeCheckpoint(rollbackCheckpoint)){
+        return false;
+    }
+
+    if(!applyCheckpoint()){
+        if(readCheckpoint(rollbackCheckpoint)){
+            applyCheckpoint();
+        }
+        return false;
+    }
+
+    // The restored states are recorded and passed to the controllers
+    for(auto& simBody : simBodiesWithBody){
+        for(auto& device : simBody->body()->devices()){
+            device->notifyStateChange();
+        }
+    }
+
+    return true;
+}
+
+
+bool SimulatorItem::Impl::readCheckpoint(const vector<char>& checkpoint)
+{
+    CheckpointReader reader(checkpoint);
+    uint32_t magic;
+    int version, id, numBodies;
+    if(!reader.read(magic) || magic != CheckpointMagic ||
+       !reader.read(version) || version != CheckpointVersion ||
+       !reader.read(id) || id != simulationId ||
+       !reader.read(numBodies) || numBodies != static_cast<int>(simBodiesWithBody.size())){
+        return false;
+    }
+
+    restoredBodyStates.resize(numBodies);
+    for(int i=0; i < numBodies; ++i){
+        auto& state = restoredBodyStates[i];
+        if(!reader.readArray(state.data(BodyState::LINK_STATE_ARENA)) ||
+           !reader.readArray(state.data(BodyState::DEVICE_STATES)) ||
+           !state.checkCompleteState(*simBodiesWithBody[i]->body())){
+            return false;
+        }
+    }
+
+    if(!reader.readArray(restoredSimulatorState)){
+        return false;
+    }
+
+    int numControllers = 0;
+    for(auto& simBody : allSimBodies){
+        numControllers += simBody->impl->controllerInfos.size();
+    }
+    restoredControllerStates.resize(numControllers);
+    for(auto& state : restoredControllerStates){
+        if(!reader.readArray(state)){
+            return false;
+        }
+    }
+
+    return reader.isAtEnd();
+}
+
+
+bool SimulatorItem::Impl::applyCheckpoint()
+{
+    for(size_t i=0; i < simBodiesWithBody.size(); ++i){
+        restoredBodyStates[i].restoreCompleteState(*simBodiesWithBody[i]->body());
+    }
+
+    if(!self->restoreCheckpointState(restoredSimulatorState)){
+        return false;
+    }
+
+    int index = 0;
+    for(auto& simBody : allSimBodies){
+        for(auto& info : simBody->impl->controllerInfos){
+            if(!info->controller->restoreCheckpointState(restoredControllerStates[index++])){
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+SimulationProfiler* SimulatorItem::profiler()
+{
+    return impl->profiler.get();
 }
 
 
@@ -2594,6 +3302,18 @@ std::shared_ptr<CollisionLinkPairList> SimulatorItem::getCollisions()
 }
 
 
+bool SimulatorItem::storeCheckpointState(std::vector<char>& /* out_state */)
+{
+    return false;
+}
+
+
+bool SimulatorItem::restoreCheckpointState(const std::vector<char>& /* state */)
+{
+    return false;
+}
+
+
 void SimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     impl->doPutProperties(putProperty);
@@ -2631,6 +3351,13 @@ void SimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(useControllerThreadsProperty));
     putProperty(_("Controller options"), controllerOptionString_,
                 changeProperty(controllerOptionString_));
+    putProperty(_("Profiling"), isProfilingEnabled, changeProperty(isProfilingEnabled));
+    if(isProfilingEnabled){
+        FilePathProperty csvFileProperty(profilingCsvFile, { _("CSV file (*.csv)") });
+        csvFileProperty.setExistingFileMode(false);
+        putProperty(_("Profiling CSV file"), csvFileProperty,
+                    [&](const string& filename){ profilingCsvFile = filename; return true; });
+    }
 }
 
 
@@ -2656,6 +3383,12 @@ bool SimulatorItem::Impl::store(Archive& archive)
     archive.write("controllerThreads", useControllerThreadsProperty);
     archive.write("recordCollisionData", recordCollisionData);
     archive.write("controllerOptions", controllerOptionString_, DOUBLE_QUOTED);
+    if(isProfilingEnabled){
+        archive.write("profiling", true);
+        if(!profilingCsvFile.empty()){
+            archive.writeRelocatablePath("profilingCsvFile", profilingCsvFile);
+        }
+    }
 
     ListingPtr idseq = new Listing();
     idseq->setFlowStyle(true);
@@ -2732,6 +3465,8 @@ bool SimulatorItem::Impl::restore(const Archive& archive)
     archive.read("recordCollisionData", recordCollisionData);
     archive.read("controllerThreads", useControllerThreadsProperty);
     archive.read("controllerOptions", controllerOptionString_);
+    archive.read("profiling", isProfilingEnabled);
+    archive.readRelocatablePath("profilingCsvFile", profilingCsvFile);
 
     archive.addPostProcess([&](){ restoreBodyMotionEngines(archive); });
     
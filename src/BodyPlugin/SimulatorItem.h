@@ -25,6 +25,7 @@ class ControllerItem;
 class SimulatorItem;
 class SimulatedMotionEngineManager;
 class CloneMap;
+class SimulationProfiler;
 
 class CNOID_EXPORT SimulationBody : public Referenced
 {
@@ -112,6 +113,35 @@ public:
 
     //! This can be called from non simulation threads
     double simulationTime() const;
+
+    /**
+       The number of the result frames discarded by the simulation thread because the
+       result buffers were full. The discarded frames are filled with the previous frames.
+    */
+    int numDroppedResultFrames() const;
+
+    /**
+       A checkpoint contains the complete state of the simulation world, which consists of the
+       states of the links and the devices of the bodies, the internal state of the simulator
+       such as the warm start data of the contact solver, and the states provided by the
+       controllers. The state is restored in place without initializing the simulation again,
+       so the simulation can be branched from a checkpoint any number of times.
+
+       These functions can be called from the simulation thread, typically in the functions
+       added by addPreDynamicsFunction or addPostDynamicsFunction, or from another thread while
+       the simulation is paused. When the controller threads are used, the functions cannot be
+       called while the controllers are running, that is, in the functions added by
+       addMidDynamicsFunction and in the simulation step of the simulator.
+       The simulation time and the recorded results are not rewound.
+
+       \return false if the simulator does not support the checkpoints, the simulation is not in
+       a state where the function can be executed, or the checkpoint was not captured in the
+       current simulation. The whole checkpoint is checked before the world is modified, and the
+       previous state is restored if the simulator or a controller rejects its state, so the
+       world is left unchanged when restoreCheckpoint returns false.
+    */
+    bool captureCheckpoint(std::vector<char>& out_checkpoint);
+    bool restoreCheckpoint(const std::vector<char>& checkpoint);
     
     SignalProxy<void()> sigSimulationStarted();
     SignalProxy<void()> sigSimulationPaused();
@@ -163,6 +193,13 @@ public:
 
     CloneMap& cloneMap();
 
+    /**
+       \return The profiler of the current or last simulation if the profiling is enabled.
+       Otherwise nullptr is returned. Simulator implementations can add their own phases in
+       initializeSimulation() and record the times in the simulation thread.
+    */
+    SimulationProfiler* profiler();
+
     /**
        \note This signal is emitted in the simulation thread
     */
@@ -241,6 +278,16 @@ protected:
 
     virtual std::shared_ptr<CollisionLinkPairList> getCollisions();
 
+    /**
+       These functions are called in captureCheckpoint and restoreCheckpoint to store and restore
+       the internal state of the simulator which is not included in the states of the bodies.
+       The default implementations return false, which means the simulator does not support
+       the checkpoints. restoreCheckpointState should check the given state before modifying
+       the simulator.
+    */
+    virtual bool storeCheckpointState(std::vector<char>& out_state);
+    virtual bool restoreCheckpointState(const std::vector<char>& state);
+
     virtual void doPutProperties(PutPropertyFunction& putProperty) override;
     virtual bool store(Archive& archive) override;
     virtual bool restore(const Archive& archive) override;
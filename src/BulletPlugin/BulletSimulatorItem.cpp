@@ -29,10 +29,20 @@
 #include <BulletDynamics/Featherstone/btMultiBodyJointMotor.h>
 #include <BulletDynamics/Featherstone/btMultiBodyPoint2Point.h>
 #include <BulletDynamics/Featherstone/btMultiBodyJointFeedback.h>
+#ifdef BT_VER_GT_287
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <LinearMath/btThreads.h>
+#endif
+#include <cnoid/MessageView>
+#include <fmt/format.h>
+#include <thread>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
+using fmt::format;
 
 #define DEBUG_OUT 0
 
@@ -48,6 +58,29 @@ const btScalar DEFAULT_SPLITIMPULSEPENETRATIONTHRESHOLD = -0.0001;
 const btScalar DEFAULT_COLLISION_MARGIN = 0.0001;
 const bool meshOnly = false;             // not use primitive Shape
 const bool mixedPrimitiveMesh = true;   // mixed of Primitive and Mesh on one link
+const btScalar DEFAULT_WARMSTARTING_FACTOR = 0.85;
+const btScalar DEFAULT_CONTACT_BREAKING_THRESHOLD = 0.02;
+
+#ifdef BT_VER_GT_287
+/*
+  The task scheduler of Bullet is a global object, so it is created only once
+  and shared by all the simulator items. Null is returned if the Bullet library
+  is built without BT_THREADSAFE.
+*/
+btITaskScheduler* getTaskScheduler()
+{
+    static btITaskScheduler* scheduler = nullptr;
+    static bool initialized = false;
+    if(!initialized){
+        scheduler = btCreateDefaultTaskScheduler();
+        if(scheduler){
+            btSetTaskScheduler(scheduler);
+        }
+        initialized = true;
+    }
+    return scheduler;
+}
+#endif
 
 void diagonalizeInertia(const Vector3& c, const Matrix3& I, btVector3& localInertia, btTransform& shift)
 {
@@ -147,6 +180,9 @@ public:
     btCollisionDispatcher* dispatcher;
     btBroadphaseInterface* broadphase;
     btConstraintSolver* solver;
+#ifdef BT_VER_GT_287
+    btConstraintSolverPoolMt* solverPool;
+#endif
     btDynamicsWorld* dynamicsWorld;
 
     Vector3 gravity;
@@ -160,6 +196,11 @@ public:
     bool useHACD;                           // Hierarchical Approximate Convex Decomposition
     double collisionMargin;
     bool usefeatherstoneAlgorithm;
+    int numThreads;
+    bool isWarmStartingEnabled;
+    double warmStartingFactor;
+    bool isFrictionDirectionCachingEnabled;
+    double contactBreakingThreshold;
 
     BulletSimulatorItemImpl(BulletSimulatorItem* self);
     BulletSimulatorItemImpl(BulletSimulatorItem* self, const BulletSimulatorItemImpl& org);
@@ -172,6 +213,8 @@ public:
     void initialize();
     void clear();
     void addBody(BulletBody* bulletBody, short group);
+    int getNumThreadsToUse() const;
+    bool createMultiThreadedWorld(int numThreadsToUse);
     void setSolverParameter();
 };
 
@@ -1314,7 +1357,11 @@ BulletSimulatorItemImpl::BulletSimulatorItemImpl(BulletSimulatorItem* self)
     useHACD = false;
     collisionMargin = DEFAULT_COLLISION_MARGIN;
     usefeatherstoneAlgorithm = true;
-
+    numThreads = 1;
+    isWarmStartingEnabled = true;
+    warmStartingFactor = DEFAULT_WARMSTARTING_FACTOR;
+    isFrictionDirectionCachingEnabled = true;
+    contactBreakingThreshold = DEFAULT_CONTACT_BREAKING_THRESHOLD;
 }
 
 
@@ -1339,7 +1386,11 @@ BulletSimulatorItemImpl::BulletSimulatorItemImpl(BulletSimulatorItem* self, cons
     useHACD = org.useHACD;
     collisionMargin = org.collisionMargin;
     usefeatherstoneAlgorithm = org.usefeatherstoneAlgorithm;
-
+    numThreads = org.numThreads;
+    isWarmStartingEnabled = org.isWarmStartingEnabled;
+    warmStartingFactor = org.warmStartingFactor;
+    isFrictionDirectionCachingEnabled = org.isFrictionDirectionCachingEnabled;
+    contactBreakingThreshold = org.contactBreakingThreshold;
 }
 
 void BulletSimulatorItemImpl::initialize()
@@ -1348,6 +1399,9 @@ void BulletSimulatorItemImpl::initialize()
     dispatcher = 0;
     broadphase = 0;
     solver =0;
+#ifdef BT_VER_GT_287
+    solverPool = 0;
+#endif
     dynamicsWorld = 0;
 
     gContactAddedCallback = 0;
@@ -1401,18 +1455,34 @@ bool BulletSimulatorItemImpl::initializeSimulation(const std::vector<SimulationB
 {
     clear();
 
-    collisionConfiguration = new btDefaultCollisionConfiguration();
-    dispatcher = new btCollisionDispatcher(collisionConfiguration);
-    broadphase = new btDbvtBroadphase();
+    gContactBreakingThreshold = contactBreakingThreshold;
 
-    if(usefeatherstoneAlgorithm){
-        btMultiBodyConstraintSolver* solver_ = new btMultiBodyConstraintSolver;
-        solver = solver_;
-        dynamicsWorld = new btMultiBodyDynamicsWorld(dispatcher,broadphase,solver_,collisionConfiguration);
-    }else{
-        solver = new btSequentialImpulseConstraintSolver();
-        dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher,broadphase,solver,collisionConfiguration);
+    int n = getNumThreadsToUse();
+    if(n > 1 && usefeatherstoneAlgorithm){
+        MessageView::instance()->putln(
+            format(_("{0}: The multithreaded dynamics world cannot be used with the Featherstone algorithm. "
+                     "The simulation is done in a single thread."), self->displayName()),
+            MessageView::Warning);
+        n = 1;
+    }
+
+    if(n > 1 && createMultiThreadedWorld(n)){
         self->setAllLinkPositionOutputMode(true);
+
+    } else {
+        collisionConfiguration = new btDefaultCollisionConfiguration();
+        dispatcher = new btCollisionDispatcher(collisionConfiguration);
+        broadphase = new btDbvtBroadphase();
+
+        if(usefeatherstoneAlgorithm){
+            btMultiBodyConstraintSolver* solver_ = new btMultiBodyConstraintSolver;
+            solver = solver_;
+            dynamicsWorld = new btMultiBodyDynamicsWorld(dispatcher,broadphase,solver_,collisionConfiguration);
+        }else{
+            solver = new btSequentialImpulseConstraintSolver();
+            dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher,broadphase,solver,collisionConfiguration);
+            self->setAllLinkPositionOutputMode(true);
+        }
     }
 
     btVector3 g(gravity.x(), gravity.y(), gravity.z());
@@ -1436,18 +1506,72 @@ bool BulletSimulatorItemImpl::initializeSimulation(const std::vector<SimulationB
     return true;
 }
 
+int BulletSimulatorItemImpl::getNumThreadsToUse() const
+{
+    if(numThreads == 0){
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+    return numThreads;
+}
+
+
+bool BulletSimulatorItemImpl::createMultiThreadedWorld(int numThreadsToUse)
+{
+#ifndef BT_VER_GT_287
+    MessageView::instance()->putln(
+        format(_("{0}: The multithreaded dynamics world requires Bullet 2.88 or later. "
+                 "The simulation is done in a single thread."), self->displayName()),
+        MessageView::Warning);
+    return false;
+#else
+    btITaskScheduler* scheduler = getTaskScheduler();
+    if(!scheduler){
+        MessageView::instance()->putln(
+            format(_("{0}: The Bullet library is built without the multithreading support. "
+                     "The simulation is done in a single thread."), self->displayName()),
+            MessageView::Warning);
+        return false;
+    }
+    scheduler->setNumThreads(std::min(numThreadsToUse, scheduler->getMaxNumThreads()));
+
+    btDefaultCollisionConstructionInfo info;
+    // The pools are shared by the threads, so they are enlarged to avoid the allocation during the step
+    info.m_defaultMaxPersistentManifoldPoolSize = 80000;
+    info.m_defaultMaxCollisionAlgorithmPoolSize = 80000;
+    collisionConfiguration = new btDefaultCollisionConfiguration(info);
+    dispatcher = new btCollisionDispatcherMt(collisionConfiguration, 40);
+    broadphase = new btDbvtBroadphase();
+    solverPool = new btConstraintSolverPoolMt(numThreadsToUse);
+    solver = new btSequentialImpulseConstraintSolverMt();
+    dynamicsWorld = new btDiscreteDynamicsWorldMt(dispatcher, broadphase, solverPool, solver, collisionConfiguration);
+    return true;
+#endif
+}
+
+
 void BulletSimulatorItemImpl::clear()
 {
     if(dynamicsWorld)
         delete dynamicsWorld;
     if(solver)
         delete solver;
+#ifdef BT_VER_GT_287
+    if(solverPool){
+        delete solverPool;
+        solverPool = 0;
+    }
+#endif
     if(dispatcher)
         delete dispatcher;
     if(collisionConfiguration)
         delete collisionConfiguration;
     if(broadphase)
         delete broadphase;
+    dynamicsWorld = 0;
+    solver = 0;
+    dispatcher = 0;
+    collisionConfiguration = 0;
+    broadphase = 0;
 }
 
 void BulletSimulatorItemImpl::addBody(BulletBody* bulletBody, short group)
@@ -1557,6 +1681,15 @@ void BulletSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(_("use HACD"), useHACD, changeProperty(useHACD));
     putProperty(_("Collision Margin"), collisionMargin, changeProperty(collisionMargin));
     putProperty(_("use Featherstone Algorithm"), usefeatherstoneAlgorithm, changeProperty(usefeatherstoneAlgorithm));
+    putProperty.min(0);
+    putProperty(_("Threads"), numThreads, changeProperty(numThreads));
+    putProperty(_("Warm Starting"), isWarmStartingEnabled, changeProperty(isWarmStartingEnabled));
+    putProperty.decimals(2).min(0.0).max(1.0);
+    putProperty(_("Warm Starting Factor"), warmStartingFactor, changeProperty(warmStartingFactor));
+    putProperty(_("Friction Direction Caching"), isFrictionDirectionCachingEnabled,
+                changeProperty(isFrictionDirectionCachingEnabled));
+    putProperty.decimals(4).min(0.0).max(1.0);
+    putProperty(_("Contact Breaking Threshold"), contactBreakingThreshold, changeProperty(contactBreakingThreshold));
 }
 
 
@@ -1579,6 +1712,11 @@ void BulletSimulatorItemImpl::store(Archive& archive)
     archive.write("useHACD", useHACD);
     archive.write("CollisionMargin", collisionMargin);
     archive.write("usefeatherstoneAlgorithm", usefeatherstoneAlgorithm);
+    archive.write("numThreads", numThreads);
+    archive.write("warmStarting", isWarmStartingEnabled);
+    archive.write("warmStartingFactor", warmStartingFactor);
+    archive.write("frictionDirectionCaching", isFrictionDirectionCachingEnabled);
+    archive.write("contactBreakingThreshold", contactBreakingThreshold);
 }
 
 
@@ -1601,6 +1739,11 @@ void BulletSimulatorItemImpl::restore(const Archive& archive)
     archive.read("useHACD", useHACD);
     archive.read("CollisionMargin", collisionMargin);
     archive.read("usefeatherstoneAlgorithm", usefeatherstoneAlgorithm);
+    archive.read("numThreads", numThreads);
+    archive.read("warmStarting", isWarmStartingEnabled);
+    archive.read("warmStartingFactor", warmStartingFactor);
+    archive.read("frictionDirectionCaching", isFrictionDirectionCachingEnabled);
+    archive.read("contactBreakingThreshold", contactBreakingThreshold);
 }
 
 void BulletSimulatorItemImpl::setSolverParameter()
@@ -1613,7 +1756,17 @@ void BulletSimulatorItemImpl::setSolverParameter()
         slvInfo.m_splitImpulsePenetrationThreshold = splitImpulsePenetrationThreshold;
         
         slvInfo.m_solverMode |= SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION + SOLVER_USE_2_FRICTION_DIRECTIONS;
-        slvInfo.m_solverMode |= SOLVER_ENABLE_FRICTION_DIRECTION_CACHING;
+        if(isFrictionDirectionCachingEnabled){
+            slvInfo.m_solverMode |= SOLVER_ENABLE_FRICTION_DIRECTION_CACHING;
+        } else {
+            slvInfo.m_solverMode &= ~SOLVER_ENABLE_FRICTION_DIRECTION_CACHING;
+        }
+        if(isWarmStartingEnabled){
+            slvInfo.m_solverMode |= SOLVER_USE_WARMSTARTING;
+            slvInfo.m_warmstartingFactor = warmStartingFactor;
+        } else {
+            slvInfo.m_solverMode &= ~SOLVER_USE_WARMSTARTING;
+        }
     }
 }
 
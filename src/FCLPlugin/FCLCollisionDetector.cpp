@@ -3,11 +3,18 @@
 #include <cnoid/IdPair>
 #include <cnoid/MeshExtractor>
 #include <cnoid/SceneDrawables>
+#include <cnoid/ThreadPool>
 #include <cnoid/stdx/optional>
 #include <fcl/collision.h>
 #include <fcl/BVH/BVH_model.h>
 #include <fcl/BV/BV.h>
 #include <fcl/narrowphase/gjk.h>
+#include <fcl/broadphase/broadphase_dynamic_AABB_tree.h>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
 #include <memory>
 
 using namespace std;
@@ -17,13 +24,30 @@ namespace {
 
 const bool USE_PRIMITIVE = true;
 
+// The narrow phase is done in a single thread when the number of the object pairs is smaller than this
+const int MIN_NUM_OBJECT_PAIRS_PER_THREAD = 4;
+
 typedef shared_ptr<fcl::CollisionObject> CollisionObjectPtr;
 typedef fcl::BVHModel<fcl::OBBRSS> MeshModel;
 typedef shared_ptr<MeshModel> MeshModelPtr;
 
+class CollisionModel;
+
+/**
+   The user data of an FCL collision object. The objects of a model are identified by
+   the local index, which is -1 for the mesh object and the index of the primitive object
+   for the primitive objects.
+*/
+struct ObjectInfo
+{
+    CollisionModel* model;
+    int localIndex;
+};
+
 class CollisionModel : public Referenced
 {
 public :
+    int index;
     CollisionObjectPtr meshObject;
     MeshModelPtr meshModel;
     vector<CollisionObjectPtr> primitiveObjects;
@@ -31,13 +55,38 @@ public :
     ReferencedPtr object;
     vector<fcl::Vec3f> points;
     vector<fcl::Triangle> tri_indices;
+    vector<ObjectInfo> objectInfos;
     bool isStatic;
 
     CollisionModel(){
+        index = -1;
         primitiveObjects.clear();
         primitiveLocalPositions.clear();
         isStatic = false;
     }
+
+    template<class Function>
+    void forEachObject(Function func){
+        if(meshObject){
+            func(meshObject.get());
+        }
+        for(auto& primitive : primitiveObjects){
+            func(primitive.get());
+        }
+    }
+
+    void setObjectInfos(){
+        objectInfos.clear();
+        objectInfos.reserve(primitiveObjects.size() + 1);
+        if(meshObject){
+            objectInfos.push_back({ this, -1 });
+            meshObject->setUserData(&objectInfos.back());
+        }
+        for(size_t i=0; i < primitiveObjects.size(); ++i){
+            objectInfos.push_back({ this, static_cast<int>(i) });
+            primitiveObjects[i]->setUserData(&objectInfos.back());
+        }
+    }
 };
 
 typedef ref_ptr<CollisionModel> CollisionModelPtr;
@@ -54,6 +103,46 @@ GeometryHandle getHandle(CollisionModel* model)
     return reinterpret_cast<GeometryHandle>(model);
 }
 
+inline int64_t getModelPairKey(int index1, int index2)
+{
+    return (static_cast<int64_t>(index1) << 32) | index2;
+}
+
+/**
+   A pair of the collision objects whose AABBs overlap. The object pairs are sorted by
+   the model pair index and the local object indices so that the collisions are output
+   in the same order regardless of the broad-phase traversal and the number of threads.
+*/
+struct ObjectPair
+{
+    int modelPairIndex;
+    int localIndex1;
+    int localIndex2;
+    fcl::CollisionObject* object1;
+    fcl::CollisionObject* object2;
+    vector<Collision> collisions;
+
+    bool operator<(const ObjectPair& rhs) const {
+        if(modelPairIndex != rhs.modelPairIndex){
+            return modelPairIndex < rhs.modelPairIndex;
+        }
+        if(localIndex1 != rhs.localIndex1){
+            return localIndex1 < rhs.localIndex1;
+        }
+        return localIndex2 < rhs.localIndex2;
+    }
+};
+
+//! The buffers used by a thread in the narrow phase, which are reused in every detection
+struct NarrowPhaseWorkspace
+{
+    fcl::CollisionRequest request;
+    fcl::CollisionResult result;
+
+    NarrowPhaseWorkspace()
+        : request(std::numeric_limits<int>::max(), true) { }
+};
+
 inline fcl::Transform3f convertToFclTransform(const Isometry3& T)
 {
     fcl::Transform3f T_fcl;
@@ -80,10 +169,23 @@ class FCLCollisionDetector::Impl
 public:
     vector<CollisionModelPtr> models;
     vector<pair<CollisionModelPtr, CollisionModelPtr>> modelPairs;
+    unordered_map<int64_t, int> modelPairIndexMap;
     set<IdPair<GeometryHandle>> ignoredPairs;
     MeshExtractor meshExtractor;
     bool isReady;
 
+    unique_ptr<fcl::DynamicAABBTreeCollisionManager> broadPhaseManager;
+    bool isBroadPhaseUpdateNeeded;
+    vector<ObjectPair> objectPairs;
+    int numObjectPairs;
+    CollisionPair collisionPair;
+
+    int maxNumThreads;
+    int numThreads;
+    unique_ptr<ThreadPool> threadPool;
+    vector<NarrowPhaseWorkspace> workspaces;
+    std::atomic<int> nextObjectPairIndex;
+
     Impl();
     stdx::optional<GeometryHandle> addGeometry(SgNode* geometry);
     void addMesh(CollisionModel* geometry, SgMesh* mesh);
@@ -91,8 +193,10 @@ public:
     void makeReady();
     void updatePosition(CollisionModel* model, const Isometry3& position);
     void detectCollisions(std::function<void(const CollisionPair&)> callback);
-    void detectObjectCollisions(
-        fcl::CollisionObject* object1, fcl::CollisionObject* object2, CollisionPair& collisionPair);
+    static bool collectObjectPair(fcl::CollisionObject* object1, fcl::CollisionObject* object2, void* data);
+    void addObjectPair(fcl::CollisionObject* object1, fcl::CollisionObject* object2);
+    void detectObjectPairCollisionsInParallel();
+    void detectObjectPairCollisions(ObjectPair& objectPair, NarrowPhaseWorkspace& workspace);
 };
 
 }
@@ -107,6 +211,11 @@ FCLCollisionDetector::FCLCollisionDetector()
 FCLCollisionDetector::Impl::Impl()
 {
     isReady = false;
+    isBroadPhaseUpdateNeeded = false;
+    numObjectPairs = 0;
+    maxNumThreads = 1;
+    numThreads = 0;
+    workspaces.resize(1);
 }    
 
 
@@ -124,7 +233,22 @@ const char* FCLCollisionDetector::name() const
 
 CollisionDetector* FCLCollisionDetector::clone() const
 {
-    return new FCLCollisionDetector;
+    auto detector = new FCLCollisionDetector;
+    detector->setNumThreads(impl->maxNumThreads);
+    return detector;
+}
+
+
+/**
+   \param n The maximum number of threads used in the narrow phase.
+   The narrow phase is done in the calling thread when n is zero or one, which is the default.
+   The threads are not shared with other detector instances or physics engines, so a larger
+   value should be given only when the hardware threads are not used by them.
+*/
+void FCLCollisionDetector::setNumThreads(int n)
+{
+    impl->maxNumThreads = n;
+    impl->isReady = false;
 }
 
         
@@ -132,7 +256,11 @@ void FCLCollisionDetector::clearGeometries()
 {
     impl->models.clear();
     impl->modelPairs.clear();
+    impl->modelPairIndexMap.clear();
     impl->ignoredPairs.clear();
+    impl->broadPhaseManager.reset();
+    impl->objectPairs.clear();
+    impl->numObjectPairs = 0;
     impl->isReady = false;
 }
 
@@ -177,6 +305,7 @@ stdx::optional<GeometryHandle> FCLCollisionDetector::Impl::addGeometry(SgNode* g
                 model->meshModel->endModel();
                 model->meshObject = make_shared<fcl::CollisionObject>(model->meshModel);
             }
+            model->setObjectInfos();
         }
     }
 
@@ -353,14 +482,17 @@ bool FCLCollisionDetector::makeReady()
 void FCLCollisionDetector::Impl::makeReady()
 {
     modelPairs.clear();
+    modelPairIndexMap.clear();
     const int n = models.size();
     for(int i=0; i < n; ++i){
         if(auto& model1 = models[i]){
+            model1->index = i;
             for(int j = i+1; j < n; ++j){
                 if(auto& model2 = models[j]){
                     if(!model1->isStatic || !model2->isStatic){
                         IdPair<GeometryHandle> handlePair(getHandle(model1), getHandle(model2));
                         if(ignoredPairs.find(handlePair) == ignoredPairs.end()){
+                            modelPairIndexMap[getModelPairKey(i, j)] = modelPairs.size();
                             modelPairs.push_back(make_pair(model1, model2));
                         }
                     }
@@ -369,6 +501,35 @@ void FCLCollisionDetector::Impl::makeReady()
         }
     }
 
+    vector<fcl::CollisionObject*> objects;
+    for(auto& model : models){
+        if(model){
+            model->forEachObject(
+                [&](fcl::CollisionObject* object){
+                    object->computeAABB();
+                    objects.push_back(object);
+                });
+        }
+    }
+    broadPhaseManager.reset(new fcl::DynamicAABBTreeCollisionManager);
+    broadPhaseManager->registerObjects(objects);
+    broadPhaseManager->setup();
+    isBroadPhaseUpdateNeeded = false;
+
+    const int numPairs = modelPairs.size();
+    if(maxNumThreads <= 1 || numPairs <= 1){
+        numThreads = 0;
+        threadPool.reset();
+        workspaces.resize(1);
+    } else {
+        int n = std::min(maxNumThreads, numPairs);
+        if(n != numThreads){
+            numThreads = n;
+            threadPool.reset(new ThreadPool(numThreads));
+            workspaces.resize(numThreads);
+        }
+    }
+
     isReady = true;
 }
 
@@ -386,15 +547,18 @@ void FCLCollisionDetector::Impl::updatePosition(CollisionModel* model, const Iso
     auto T = convertToFclTransform(position);
     if(model->meshObject){
         model->meshObject->setTransform(T);
+        model->meshObject->computeAABB();
     }
     auto pLocalPosition = model->primitiveLocalPositions.begin();
     for(auto& primitive : model->primitiveObjects){
         if(primitive){
             const auto& T_local = *pLocalPosition;
             primitive->setTransform(T * T_local);
+            primitive->computeAABB();
         }
         ++pLocalPosition;
     }
+    isBroadPhaseUpdateNeeded = true;
 }
 
 
@@ -408,6 +572,10 @@ void FCLCollisionDetector::updatePositions
             impl->updatePosition(model, *pPosition);
         }
     }
+    if(impl->broadPhaseManager && impl->isBroadPhaseUpdateNeeded){
+        impl->broadPhaseManager->update();
+        impl->isBroadPhaseUpdateNeeded = false;
+    }
 }
 
 
@@ -422,32 +590,45 @@ void FCLCollisionDetector::detectCollisions(std::function<void(const CollisionPa
 
 void FCLCollisionDetector::Impl::detectCollisions(std::function<void(const CollisionPair&)> callback)
 {
-    CollisionPair collisionPair;
-    auto& collisions = collisionPair.collisions();
+    if(isBroadPhaseUpdateNeeded){
+        broadPhaseManager->update();
+        isBroadPhaseUpdateNeeded = false;
+    }
 
-    for(auto& modelPair : modelPairs){
-        auto& model1 = modelPair.first;
-        auto& model2 = modelPair.second;
-        collisions.clear();
+    // Broad phase
+    numObjectPairs = 0;
+    broadPhaseManager->collide(this, &Impl::collectObjectPair);
+    if(numObjectPairs == 0){
+        return;
+    }
+    std::sort(objectPairs.begin(), objectPairs.begin() + numObjectPairs);
 
-        if(model1->meshObject){
-            if(model2->meshObject){
-                detectObjectCollisions(model1->meshObject.get(), model2->meshObject.get(), collisionPair);
-            }
-            for(auto& primitive : model2->primitiveObjects){
-                detectObjectCollisions(model1->meshObject.get(), primitive.get(), collisionPair);
-            }
-        }
-        for(auto& primitive1 : model1->primitiveObjects){
-            if(model2->meshObject){
-                detectObjectCollisions(primitive1.get(), model2->meshObject.get(), collisionPair);
-            }
-            for(auto& primitive2 : model2->primitiveObjects){
-                detectObjectCollisions(primitive1.get(), primitive2.get(), collisionPair);
-            }
+    // Narrow phase
+    if(numThreads > 0 && numObjectPairs >= numThreads * MIN_NUM_OBJECT_PAIRS_PER_THREAD){
+        detectObjectPairCollisionsInParallel();
+    } else {
+        auto& workspace = workspaces.front();
+        for(int i=0; i < numObjectPairs; ++i){
+            detectObjectPairCollisions(objectPairs[i], workspace);
         }
+    }
+
+    // Output the collisions of each model pair
+    auto& collisions = collisionPair.collisions();
+    int i = 0;
+    while(i < numObjectPairs){
+        const int modelPairIndex = objectPairs[i].modelPairIndex;
+        collisions.clear();
+        do {
+            auto& pairCollisions = objectPairs[i].collisions;
+            collisions.insert(collisions.end(), pairCollisions.begin(), pairCollisions.end());
+            ++i;
+        } while(i < numObjectPairs && objectPairs[i].modelPairIndex == modelPairIndex);
 
         if(!collisions.empty()){
+            auto& modelPair = modelPairs[modelPairIndex];
+            auto& model1 = modelPair.first;
+            auto& model2 = modelPair.second;
             collisionPair.geometry(0) = getHandle(model1);
             collisionPair.geometry(1) = getHandle(model2);
             collisionPair.object(0) = model1->object;
@@ -458,32 +639,86 @@ void FCLCollisionDetector::Impl::detectCollisions(std::function<void(const Colli
 }
 
 
-void FCLCollisionDetector::Impl::detectObjectCollisions
-(fcl::CollisionObject* object1, fcl::CollisionObject* object2, CollisionPair& collisionPair)
+bool FCLCollisionDetector::Impl::collectObjectPair
+(fcl::CollisionObject* object1, fcl::CollisionObject* object2, void* data)
 {
-    vector<Collision>& collisions = collisionPair.collisions();
+    static_cast<Impl*>(data)->addObjectPair(object1, object2);
+    return false; // continue the broad phase
+}
 
-    fcl::CollisionRequest request(std::numeric_limits<int>::max(), true);
-    fcl::CollisionResult result;
-    int numContacts = collide(object1, object2, request, result);
-    std::vector<fcl::Contact> contacts;
-    result.getContacts(contacts);
 
-    for(auto& contact : contacts){
-        if(contact.penetration_depth < 0.0){
-            contact.penetration_depth *= -1.0;
-        }
-        if(contact.penetration_depth < 1.0e-6){
+void FCLCollisionDetector::Impl::addObjectPair(fcl::CollisionObject* object1, fcl::CollisionObject* object2)
+{
+    auto info1 = static_cast<ObjectInfo*>(object1->getUserData());
+    auto info2 = static_cast<ObjectInfo*>(object2->getUserData());
+    if(info1->model == info2->model){
+        return;
+    }
+    if(info1->model->index > info2->model->index){
+        std::swap(object1, object2);
+        std::swap(info1, info2);
+    }
+    auto p = modelPairIndexMap.find(getModelPairKey(info1->model->index, info2->model->index));
+    if(p == modelPairIndexMap.end()){
+        return; // static or ignored pair
+    }
+
+    // The elements are reused to keep the capacity of the collision vectors
+    if(numObjectPairs == static_cast<int>(objectPairs.size())){
+        objectPairs.emplace_back();
+    }
+    auto& objectPair = objectPairs[numObjectPairs++];
+    objectPair.modelPairIndex = p->second;
+    objectPair.localIndex1 = info1->localIndex;
+    objectPair.localIndex2 = info2->localIndex;
+    objectPair.object1 = object1;
+    objectPair.object2 = object2;
+}
+
+
+void FCLCollisionDetector::Impl::detectObjectPairCollisionsInParallel()
+{
+    nextObjectPairIndex = 0;
+    for(int i=0; i < numThreads; ++i){
+        threadPool->start([this, i](){
+                auto& workspace = workspaces[i];
+                while(true){
+                    int index = nextObjectPairIndex.fetch_add(1);
+                    if(index >= numObjectPairs){
+                        break;
+                    }
+                    detectObjectPairCollisions(objectPairs[index], workspace);
+                }
+            });
+    }
+    threadPool->wait();
+}
+
+
+void FCLCollisionDetector::Impl::detectObjectPairCollisions
+(ObjectPair& objectPair, NarrowPhaseWorkspace& workspace)
+{
+    auto& collisions = objectPair.collisions;
+    collisions.clear();
+
+    auto& result = workspace.result;
+    result.clear();
+    fcl::collide(objectPair.object1, objectPair.object2, workspace.request, result);
+
+    const int numContacts = result.numContacts();
+    for(int i=0; i < numContacts; ++i){
+        const fcl::Contact& contact = result.getContact(i);
+        const double depth = std::abs(contact.penetration_depth);
+        if(depth < 1.0e-6){
             continue;
         }
-
         collisions.push_back(Collision());
         auto& collision = collisions.back();
         auto& p = contact.pos;
         collision.point << p[0], p[1], p[2];
         auto& n = contact.normal;
         collision.normal << n[0], n[1], n[2];
-        collision.depth = contact.penetration_depth;
+        collision.depth = depth;
     }
 }
 
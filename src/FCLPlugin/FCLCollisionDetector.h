@@ -24,6 +24,8 @@ public:
         std::function<void(Referenced* object, Isometry3*& out_position)> positionQuery) override;
     virtual void detectCollisions(std::function<void(const CollisionPair&)> callback) override;
 
+    void setNumThreads(int n);
+
 private:
     class Impl;
     Impl* impl;
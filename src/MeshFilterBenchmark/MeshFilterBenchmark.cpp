@@ -0,0 +1,303 @@
+#include <cnoid/MeshFilter>
+#include <cnoid/MeshExtractor>
+#include <cnoid/SceneLoader>
+#include <cnoid/SceneFileCache>
+#include <cnoid/SceneDrawables>
+#include <fmt/format.h>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <unordered_set>
+#include <cmath>
+
+#ifdef CNOID_MESH_FILTER_BENCHMARK_USE_ASSIMP
+#include <cnoid/AssimpSceneLoader>
+#endif
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+struct Result
+{
+    string name;
+    bool isValid;
+    int numMeshes;
+    int numOrgVertices;
+    int numOrgTriangles;
+    int numVertices;
+    int numTriangles;
+    int numNormals;
+    double loadingTime;
+    double vertexRemovalTime;
+    double faceRemovalTime;
+    double normalGenerationTime;
+    double normalRemovalTime;
+};
+
+const char* usage =
+    "Usage: cnoid-mesh-filter-bench [options] [mesh-file ...]\n"
+    "\n"
+    "Apply the mesh filters to the meshes of the given files and report the processing times.\n"
+    "A generated triangle soup is used if no file is given.\n"
+    "\n"
+    "Options:\n"
+    "  --triangles <n>         Number of the triangles of the generated mesh (default: 1000000)\n"
+    "  --merge-distance <d>    Distance within which vertices are merged (default: 0, relative precision)\n"
+    "  --crease-angle <angle>  Crease angle in radians used to generate normals (default: 0.5)\n"
+    "  --threads <n>           Maximum number of the threads used for the meshes of a scene (default: 0, hardware threads)\n"
+    "  --csv                   Output the result in the CSV format\n"
+    "  --help                  Show this message\n";
+
+
+//! \return false if the whole string is not a number
+template<class T>
+bool parseNumber(const char* str, T& out_value)
+{
+    istringstream is(str);
+    is >> out_value;
+    return is && (is >> std::ws).eof();
+}
+
+
+double elapsedTime(const chrono::steady_clock::time_point& startTime)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+
+/**
+   Generate a triangle soup of a wavy surface where each triangle has its own vertices
+   like the meshes of STL files.
+*/
+SgNode* generateTriangleSoup(int numTriangles)
+{
+    SgMeshPtr mesh = new SgMesh;
+    auto& vertices = *mesh->getOrCreateVertices();
+    const int n = std::max(1, static_cast<int>(std::sqrt(numTriangles / 2.0)));
+    vertices.reserve(n * n * 6);
+    mesh->reserveNumTriangles(n * n * 2);
+    auto point = [n](int i, int j){
+        const float x = static_cast<float>(i) / n;
+        const float y = static_cast<float>(j) / n;
+        return Vector3f(x, y, 0.05f * std::sin(20.0f * x) * std::cos(15.0f * y));
+    };
+    for(int i=0; i < n; ++i){
+        for(int j=0; j < n; ++j){
+            const int top = vertices.size();
+            vertices.push_back(point(i, j));
+            vertices.push_back(point(i + 1, j));
+            vertices.push_back(point(i + 1, j + 1));
+            vertices.push_back(point(i, j));
+            vertices.push_back(point(i + 1, j + 1));
+            vertices.push_back(point(i, j + 1));
+            mesh->addTriangle(top, top + 1, top + 2);
+            mesh->addTriangle(top + 3, top + 4, top + 5);
+        }
+    }
+    auto shape = new SgShape;
+    shape->setMesh(mesh);
+    return shape;
+}
+
+
+vector<SgMesh*> extractMeshes(SgNode* scene)
+{
+    vector<SgMesh*> meshes;
+    unordered_set<SgMesh*> extractedMeshes;
+    MeshExtractor extractor;
+    extractor.extract(
+        scene,
+        [&](SgMesh* mesh){
+            if(extractedMeshes.insert(mesh).second){
+                meshes.push_back(mesh);
+            }
+        });
+    return meshes;
+}
+
+
+void countElements(const vector<SgMesh*>& meshes, int& out_numVertices, int& out_numTriangles, int& out_numNormals)
+{
+    out_numVertices = 0;
+    out_numTriangles = 0;
+    out_numNormals = 0;
+    for(auto& mesh : meshes){
+        if(mesh->hasVertices()){
+            out_numVertices += mesh->vertices()->size();
+        }
+        out_numTriangles += mesh->numTriangles();
+        if(mesh->hasNormals()){
+            out_numNormals += mesh->normals()->size();
+        }
+    }
+}
+
+
+void runFilters(SgNode* scene, MeshFilter& filter, float creaseAngle, Result& result)
+{
+    auto meshes = extractMeshes(scene);
+    result.numMeshes = meshes.size();
+    int numNormals;
+    countElements(meshes, result.numOrgVertices, result.numOrgTriangles, numNormals);
+
+    auto startTime = chrono::steady_clock::now();
+    filter.removeRedundantVertices(scene);
+    result.vertexRemovalTime = elapsedTime(startTime);
+
+    startTime = chrono::steady_clock::now();
+    filter.removeRedundantFaces(scene);
+    result.faceRemovalTime = elapsedTime(startTime);
+
+    startTime = chrono::steady_clock::now();
+    for(auto& mesh : meshes){
+        filter.generateNormals(mesh, creaseAngle);
+    }
+    result.normalGenerationTime = elapsedTime(startTime);
+
+    startTime = chrono::steady_clock::now();
+    filter.removeRedundantNormals(scene);
+    result.normalRemovalTime = elapsedTime(startTime);
+
+    countElements(meshes, result.numVertices, result.numTriangles, result.numNormals);
+    result.isValid = true;
+}
+
+
+void putTextResults(ostream& os, const vector<Result>& results)
+{
+    os << format("{:<24} {:>6} {:>10} {:>10} {:>10} {:>10} {:>10} {:>9} {:>9} {:>9} {:>9} {:>9}\n",
+                 "Mesh", "Meshes", "Triangles", "Vertices", "Merged", "Faces", "Normals",
+                 "Load[s]", "Vert[s]", "Face[s]", "Gen[s]", "Norm[s]");
+    for(auto& r : results){
+        if(!r.isValid){
+            os << format("{:<24} failed\n", r.name);
+            continue;
+        }
+        os << format("{:<24} {:>6} {:>10} {:>10} {:>10} {:>10} {:>10} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f} {:>9.3f}\n",
+                     r.name, r.numMeshes, r.numOrgTriangles, r.numOrgVertices, r.numVertices, r.numTriangles,
+                     r.numNormals, r.loadingTime, r.vertexRemovalTime, r.faceRemovalTime,
+                     r.normalGenerationTime, r.normalRemovalTime);
+    }
+    os.flush();
+}
+
+
+void putCsvResults(ostream& os, const vector<Result>& results)
+{
+    os << "mesh,valid,meshes,triangles,vertices,merged_vertices,faces,normals,"
+        "loading_time,vertex_removal_time,face_removal_time,normal_generation_time,normal_removal_time\n";
+    for(auto& r : results){
+        if(!r.isValid){
+            os << format("{},0,,,,,,,,,,,\n", r.name);
+            continue;
+        }
+        os << format("{},1,{},{},{},{},{},{},{},{},{},{},{}\n",
+                     r.name, r.numMeshes, r.numOrgTriangles, r.numOrgVertices, r.numVertices, r.numTriangles,
+                     r.numNormals, r.loadingTime, r.vertexRemovalTime, r.faceRemovalTime,
+                     r.normalGenerationTime, r.normalRemovalTime);
+    }
+    os.flush();
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    vector<string> files;
+    int numTriangles = 1000000;
+    float mergeDistance = 0.0f;
+    float creaseAngle = 0.5f;
+    int maxNumThreads = 0;
+    bool isCsvMode = false;
+    bool isValueInvalid = false;
+
+    for(int i=1; i < argc; ++i){
+        string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if(arg == "--help" || arg == "-h"){
+            cout << usage;
+            return 0;
+        } else if(arg == "--triangles" && hasValue){
+            if(!parseNumber(argv[++i], numTriangles) || numTriangles <= 0){
+                isValueInvalid = true;
+            }
+        } else if(arg == "--merge-distance" && hasValue){
+            if(!parseNumber(argv[++i], mergeDistance) || !(mergeDistance >= 0.0f)){
+                isValueInvalid = true;
+            }
+        } else if(arg == "--crease-angle" && hasValue){
+            if(!parseNumber(argv[++i], creaseAngle) || !(creaseAngle >= 0.0f)){
+                isValueInvalid = true;
+            }
+        } else if(arg == "--threads" && hasValue){
+            if(!parseNumber(argv[++i], maxNumThreads) || maxNumThreads < 0){
+                isValueInvalid = true;
+            }
+        } else if(arg == "--csv"){
+            isCsvMode = true;
+        } else if(arg.compare(0, 1, "-") != 0){
+            files.push_back(arg);
+        } else {
+            cerr << format("Invalid argument: {}\n\n", arg) << usage;
+            return 1;
+        }
+        if(isValueInvalid){
+            cerr << format("Invalid value of {}: {}\n\n", arg, argv[i]) << usage;
+            return 1;
+        }
+    }
+
+#ifdef CNOID_MESH_FILTER_BENCHMARK_USE_ASSIMP
+    AssimpSceneLoader::initializeClass();
+#endif
+
+    MeshFilter filter;
+    filter.setNormalOverwritingEnabled(true);
+    filter.setVertexMergeDistance(mergeDistance);
+    filter.setMaxNumThreads(maxNumThreads);
+
+    vector<Result> results;
+    bool failed = false;
+
+    if(files.empty()){
+        Result result;
+        result.name = format("soup-{}", numTriangles);
+        auto startTime = chrono::steady_clock::now();
+        SgNodePtr scene = generateTriangleSoup(numTriangles);
+        result.loadingTime = elapsedTime(startTime);
+        runFilters(scene, filter, creaseAngle, result);
+        results.push_back(result);
+    }
+
+    // The loading time must be the one of parsing the files even if the cache is enabled by the environment
+    SceneFileCache::instance()->setEnabled(false);
+    SceneLoader loader;
+    loader.setMessageSink(cerr);
+    for(auto& file : files){
+        Result result;
+        result.name = file;
+        result.isValid = false;
+        cerr << format("Loading {} ...", file) << endl;
+        auto startTime = chrono::steady_clock::now();
+        SgNodePtr scene = loader.load(file);
+        result.loadingTime = elapsedTime(startTime);
+        if(scene){
+            runFilters(scene, filter, creaseAngle, result);
+        } else {
+            failed = true;
+        }
+        results.push_back(result);
+    }
+
+    if(isCsvMode){
+        putCsvResults(cout, results);
+    } else {
+        putTextResults(cout, results);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -96,76 +96,15 @@ void FFCalculator::calcAddMass (LinkForce* pLinkForceT, LinkForce* pLinkForceR)
 
 void FFCalculator::calcSurfaceGeneral(LinkForce* pLinkForceN, LinkForce* pLinkForceT,int degreeNumber)
 {
+    SurfaceBatch batch;
+    batch.build (_triAttrAry, degreeNumber);
+    calcSurfaceGeneral (batch, pLinkForceN, pLinkForceT);
+    return;
+}
 
-    const int numIP = degreeNumber;
-
-    for (const auto& triAttr : _triAttrAry)
-    {
-        const GaussTriangle3d tri (triAttr.triangle(), _linkState.trans());
-
-        for (int iIP=0; iIP<numIP; ++iIP)
-        {
-
-            const double cutCoef = triAttr.cutoffCoefficient(iIP);
-            if (cutCoef < 1.0e-12)
-                continue;
-
-            const Vector3 posIP = tri.getGaussPoint(iIP,numIP);
-
-            FluidEnvironment::FluidValue fluid;
-            bool inBounds = _fluidEnv.get (posIP, fluid);
-
-            if ( inBounds==false  && _fluidEnvAll.isFluid ==false)
-                continue;
-
-            if(inBounds==true){
-                if(fluid.isFluid ==true){
-                }else continue;
-            }else if(_fluidEnvAll.isFluid == true){
-                fluid=_fluidEnvAll;
-            }else continue;
-
-            const double coefIP = cutCoef * tri.getGaussWeight(iIP,numIP) * tri.area();
-
-            double velPerp;
-            double velPara;
-            Vector3 vePara;
-
-            Vector3 velRelative = fluid.velocity - _linkState.translationalVelocityAt(posIP);
-            _calcVectorDecomp (velRelative, -tri.normal(), &velPerp, &velPara, &vePara);
-
-            if (velPerp >= TINY_VELOCITY)
-            {
-                double pressure = 0.5 * fluid.density * std::pow (std::max (0.0, velPerp), 2);
-                Vector3 force = -tri.normal() * pressure;
-                pLinkForceN->addForce (coefIP * force, posIP);
-            }
-
-            if (velPara >= TINY_VELOCITY)
-            {
-
-                double repLength = std::pow (_linkVolume, 1.0/3.0);
-
-                double coefReynolds = fluid.density * velPara * repLength / fluid.viscosity;
-
-                if (coefReynolds < 4.0e5)
-                {
-                    Vector3 forceT = 0.664 * velPara * vePara *
-                                     std::sqrt (fluid.viscosity * fluid.density * velPara / repLength);
-                    pLinkForceT->addForce (coefIP * forceT, posIP);
-                }
-                else
-                {
-                    double coefResist = 0.455 / std::pow (std::log10(coefReynolds), 2.58) - 1700.0 / coefReynolds;
-                    if (coefReynolds < 6.0e5)
-                        coefResist = std::max (coefResist, 1.328 / std::sqrt(coefReynolds));
-
-                    Vector3 forceT = coefResist * 0.5 * fluid.density * velPara * velPara * vePara;
-                    pLinkForceT->addForce (coefIP * forceT, posIP);
-                }
-            }
-        }
-    }
+void FFCalculator::calcSurfaceGeneral(SurfaceBatch& batch, LinkForce* pLinkForceN, LinkForce* pLinkForceT)
+{
+    batch.calc (_fluidEnv, _fluidEnvAll, _linkState, _linkVolume, pLinkForceN, pLinkForceT);
     return;
 }
 
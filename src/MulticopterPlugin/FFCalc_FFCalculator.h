@@ -53,6 +53,9 @@ public:
 
     void calcSurfaceGeneral (LinkForce* pLinkForceN, LinkForce* pLinkForceT,int);
 
+    //! The batch must be built from the triangles given to the constructor
+    void calcSurfaceGeneral (SurfaceBatch& batch, LinkForce* pLinkForceN, LinkForce* pLinkForceT);
+
     void calcGravity_forDebug (LinkForce* pLinkForce);
 
 private:
@@ -0,0 +1,232 @@
+#include "MulticopterPluginHeader.h"
+
+namespace Multicopter {
+namespace FFCalc {
+
+namespace {
+
+const double TINY_VELOCITY = 1.0e-12;
+
+}
+
+void SurfaceBatch::build (const std::vector<LinkTriangleAttribute>& triAttrAry, int degreeNumber)
+{
+    const int numIP = degreeNumber;
+
+    int numPoints = 0;
+    for (const auto& triAttr : triAttrAry)
+    {
+        for (int iIP=0; iIP<numIP; ++iIP)
+        {
+            if (triAttr.cutoffCoefficient(iIP) >= 1.0e-12)
+                ++numPoints;
+        }
+    }
+
+    _lpx.resize(numPoints); _lpy.resize(numPoints); _lpz.resize(numPoints);
+    _lnx.resize(numPoints); _lny.resize(numPoints); _lnz.resize(numPoints);
+    _coef.resize(numPoints);
+    _work.inBounds.reset(new bool[numPoints]);
+
+    int index = 0;
+    for (const auto& triAttr : triAttrAry)
+    {
+        // The area and the normal are invariant under the rigid transformation of the link
+        const GaussTriangle3d tri (triAttr.triangle());
+        const bool isDegenerated = !(tri.area() > 0.0);
+
+        for (int iIP=0; iIP<numIP; ++iIP)
+        {
+            const double cutCoef = triAttr.cutoffCoefficient(iIP);
+            if (cutCoef < 1.0e-12)
+                continue;
+
+            const Vector3 posIP = tri.getGaussPoint(iIP,numIP);
+            _lpx[index] = posIP.x();
+            _lpy[index] = posIP.y();
+            _lpz[index] = posIP.z();
+
+            if (isDegenerated)
+            {
+                _lnx[index] = _lny[index] = _lnz[index] = 0.0;
+                _coef[index] = 0.0;
+            }
+            else
+            {
+                _lnx[index] = tri.normal().x();
+                _lny[index] = tri.normal().y();
+                _lnz[index] = tri.normal().z();
+                _coef[index] = cutCoef * tri.getGaussWeight(iIP,numIP) * tri.area();
+            }
+            ++index;
+        }
+    }
+
+    return;
+}
+
+void SurfaceBatch::_setFluidValues (
+    const FluidEnvironment& fluidEnv, const FluidEnvironment::FluidValue& fluidEnvAll, const Vector3& origin)
+{
+    Work& w = _work;
+    const int n = size();
+
+    if (fluidEnv.isNull())
+    {
+        w.density.setConstant(n, fluidEnvAll.density);
+        w.viscosity.setConstant(n, fluidEnvAll.viscosity);
+        w.vx.setConstant(n, fluidEnvAll.velocity.x());
+        w.vy.setConstant(n, fluidEnvAll.velocity.y());
+        w.vz.setConstant(n, fluidEnvAll.velocity.z());
+        w.coef = _coef;
+        return;
+    }
+
+    w.density.resize(n);
+    w.viscosity.resize(n);
+    w.vx.resize(n); w.vy.resize(n); w.vz.resize(n);
+    w.coef.resize(n);
+
+    w.positions.resize(n);
+    w.fluidValues.resize(n);
+    for (int i=0; i<n; ++i)
+    {
+        w.positions[i] << w.rx[i] + origin.x(), w.ry[i] + origin.y(), w.rz[i] + origin.z();
+    }
+    fluidEnv.get (n, w.positions.data(), w.fluidValues.data(), w.inBounds.get());
+
+    for (int i=0; i<n; ++i)
+    {
+        const FluidEnvironment::FluidValue* pFluid = nullptr;
+        if (w.inBounds[i] == true)
+        {
+            if (w.fluidValues[i].isFluid == true)
+                pFluid = &w.fluidValues[i];
+        }
+        else if (fluidEnvAll.isFluid == true)
+        {
+            pFluid = &fluidEnvAll;
+        }
+
+        if (pFluid)
+        {
+            w.density[i]   = pFluid->density;
+            w.viscosity[i] = pFluid->viscosity;
+            w.vx[i] = pFluid->velocity.x();
+            w.vy[i] = pFluid->velocity.y();
+            w.vz[i] = pFluid->velocity.z();
+            w.coef[i] = _coef[i];
+        }
+        else
+        {
+            // The point does not receive any force with these values
+            w.density[i]   = 0.0;
+            w.viscosity[i] = 1.0;
+            w.vx[i] = w.vy[i] = w.vz[i] = 0.0;
+            w.coef[i] = 0.0;
+        }
+    }
+    return;
+}
+
+void SurfaceBatch::calc (
+    const FluidEnvironment& fluidEnv,
+    const FluidEnvironment::FluidValue& fluidEnvAll,
+    const LinkState& linkState,
+    double linkVolume,
+    LinkForce* pLinkForceN, LinkForce* pLinkForceT)
+{
+    const int n = size();
+
+    if (n == 0)
+        return;
+
+    if (fluidEnv.isNull() && fluidEnvAll.isFluid == false)
+        return;
+
+    Work& w = _work;
+
+    const Matrix3 R = linkState.trans().linear();
+    const Vector3 origin = linkState.trans().translation();
+
+    // The positions relative to the link origin and the normals in the global frame
+    w.rx = R(0,0)*_lpx + R(0,1)*_lpy + R(0,2)*_lpz;
+    w.ry = R(1,0)*_lpx + R(1,1)*_lpy + R(1,2)*_lpz;
+    w.rz = R(2,0)*_lpx + R(2,1)*_lpy + R(2,2)*_lpz;
+    w.nx = R(0,0)*_lnx + R(0,1)*_lny + R(0,2)*_lnz;
+    w.ny = R(1,0)*_lnx + R(1,1)*_lny + R(1,2)*_lnz;
+    w.nz = R(2,0)*_lnx + R(2,1)*_lny + R(2,2)*_lnz;
+
+    _setFluidValues (fluidEnv, fluidEnvAll, origin);
+
+    // The fluid velocity relative to the surface
+    const Vector3 v0 = linkState.translationalVelocityAt(origin);
+    const Vector3& om = linkState.rotationalVelocity();
+    w.vx -= v0.x() + (om.y()*w.rz - om.z()*w.ry);
+    w.vy -= v0.y() + (om.z()*w.rx - om.x()*w.rz);
+    w.vz -= v0.z() + (om.x()*w.ry - om.y()*w.rx);
+
+    // Decomposition into the component toward the surface and the component along the surface
+    w.velPerp = -(w.vx*w.nx + w.vy*w.ny + w.vz*w.nz);
+    w.vx += w.nx*w.velPerp;
+    w.vy += w.ny*w.velPerp;
+    w.vz += w.nz*w.velPerp;
+    w.velPara = (w.vx.square() + w.vy.square() + w.vz.square()).sqrt();
+
+    w.velPerp = (w.velPerp > TINY_VELOCITY).select(w.velPerp, 0.0);
+    w.invNormPara = (w.velPara > TINY_VELOCITY).select(w.velPara.inverse(), 0.0);
+    w.velPara = (w.velPara > TINY_VELOCITY).select(w.velPara, 0.0);
+
+    // Pressure
+    w.pressure = 0.5 * w.density * w.velPerp.square() * w.coef;
+
+    // Friction, where the laminar flow is assumed first and the points in the turbulent flow are corrected
+    const double repLength = std::pow (linkVolume, 1.0/3.0);
+    w.forceT = 0.664 * w.velPara * (w.viscosity * w.density * w.velPara / repLength).sqrt();
+
+    for (int i=0; i<n; ++i)
+    {
+        if (w.velPara[i] == 0.0)
+            continue;
+
+        const double coefReynolds = w.density[i] * w.velPara[i] * repLength / w.viscosity[i];
+        if (coefReynolds < 4.0e5)
+            continue;
+
+        double coefResist = 0.455 / std::pow (std::log10(coefReynolds), 2.58) - 1700.0 / coefReynolds;
+        if (coefReynolds < 6.0e5)
+            coefResist = std::max (coefResist, 1.328 / std::sqrt(coefReynolds));
+
+        w.forceT[i] = coefResist * 0.5 * w.density[i] * w.velPara[i] * w.velPara[i];
+    }
+
+    w.forceT *= w.coef * w.invNormPara;
+
+    // The pressure force is (-normal * pressure) and the friction force is (forceT * relative velocity along the surface)
+    const Vector3 forceN (
+        -(w.nx * w.pressure).sum(), -(w.ny * w.pressure).sum(), -(w.nz * w.pressure).sum());
+    const Vector3 forceT (
+        (w.vx * w.forceT).sum(), (w.vy * w.forceT).sum(), (w.vz * w.forceT).sum());
+
+    const Vector3 pointN = pLinkForceN->point() - origin;
+    const Vector3 momentN (
+        -((w.ry - pointN.y()) * w.nz * w.pressure - (w.rz - pointN.z()) * w.ny * w.pressure).sum(),
+        -((w.rz - pointN.z()) * w.nx * w.pressure - (w.rx - pointN.x()) * w.nz * w.pressure).sum(),
+        -((w.rx - pointN.x()) * w.ny * w.pressure - (w.ry - pointN.y()) * w.nx * w.pressure).sum());
+
+    const Vector3 pointT = pLinkForceT->point() - origin;
+    const Vector3 momentT (
+        ((w.ry - pointT.y()) * w.vz * w.forceT - (w.rz - pointT.z()) * w.vy * w.forceT).sum(),
+        ((w.rz - pointT.z()) * w.vx * w.forceT - (w.rx - pointT.x()) * w.vz * w.forceT).sum(),
+        ((w.rx - pointT.x()) * w.vy * w.forceT - (w.ry - pointT.y()) * w.vx * w.forceT).sum());
+
+    pLinkForceN->addForce (forceN, pLinkForceN->point());
+    pLinkForceN->addMoment (momentN);
+    pLinkForceT->addForce (forceT, pLinkForceT->point());
+    pLinkForceT->addMoment (momentT);
+
+    return;
+}
+
+
+}}
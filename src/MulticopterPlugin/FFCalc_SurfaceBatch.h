@@ -0,0 +1,63 @@
+#pragma once
+#include "FFCalc_Common.h"
+
+namespace Multicopter {
+namespace FFCalc {
+
+/**
+   The Gauss points of the surface triangles of a link stored in the structure-of-arrays form.
+   The points, the normals and the coefficients of the points are calculated in the link
+   local frame when the batch is built, and the pressure and friction forces of all the points
+   are evaluated together with the array operations of Eigen.
+
+   The evaluation uses the work arrays owned by the batch, so a batch must not be evaluated by
+   multiple threads at the same time. Different batches can be evaluated in parallel.
+*/
+class SurfaceBatch
+{
+public:
+
+    SurfaceBatch() { }
+
+    //! The Gauss points whose cutoff coefficients are negligible are not stored
+    void build (const std::vector<LinkTriangleAttribute>& triAttrAry, int degreeNumber);
+
+    int size() const
+    {
+        return static_cast<int>(_coef.size());
+    }
+
+    void calc (
+        const FluidEnvironment& fluidEnv,
+        const FluidEnvironment::FluidValue& fluidEnvAll,
+        const LinkState& linkState,
+        double linkVolume,
+        LinkForce* pLinkForceN, LinkForce* pLinkForceT);
+
+private:
+
+    typedef Eigen::ArrayXd Array;
+
+    Array _lpx, _lpy, _lpz;
+    Array _lnx, _lny, _lnz;
+    Array _coef;
+
+    struct Work
+    {
+        Array rx, ry, rz;
+        Array nx, ny, nz;
+        Array density, viscosity, coef;
+        Array vx, vy, vz;
+        Array velPerp, pressure;
+        Array velPara, invNormPara, forceT;
+        std::vector<Vector3> positions;
+        std::vector<FluidEnvironment::FluidValue> fluidValues;
+        std::unique_ptr<bool[]> inBounds;
+    };
+    Work _work;
+
+    void _setFluidValues (const FluidEnvironment& fluidEnv, const FluidEnvironment::FluidValue& fluidEnvAll, const Vector3& origin);
+};
+
+
+}}
@@ -5,6 +5,10 @@
 #include "MulticopterPluginHeader.h"
 #include <fmt/format.h>
 #include <fstream>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
 
 using namespace std;
 using namespace cnoid;
@@ -22,40 +26,221 @@ stringArray2Coordinate(std::vector<std::string>& strAry, double& org, double& le
     size = stoi(strAry[3]);        
 }
 
-bool
-FluidEnvironment::get(const Eigen::Vector3d& pos, FluidValue& val) const{
+namespace Multicopter {
 
-    if(_isNull){
-        return false;
+class FluidEnvironment::SparseGrid
+{
+public:
+    enum {
+        BlockShift = 3,
+        BlockSize = 1 << BlockShift,
+        BlockMask = BlockSize - 1,
+        NumBlockPoints = BlockSize * BlockSize * BlockSize,
+        // The number of the bits of each block index in a key
+        KeyShift = 21
+    };
+
+    // The layout is the same as that of a block in the binary file
+    struct Block
+    {
+        double density[NumBlockPoints];
+        double velocity[3][NumBlockPoints];
+        double viscosity[NumBlockPoints];
+    };
+
+    unordered_map<uint64_t, int> blockIndexMap;
+    vector<unique_ptr<Block>> blocks;
+    vector<Vector3i> blockIndices;
+
+    static int maxGridSize(){
+        return ((1 << KeyShift) - 1) * BlockSize - 1;
+    }
+
+    static uint64_t key(int bx, int by, int bz){
+        return (static_cast<uint64_t>(bx) << (2 * KeyShift)) | (static_cast<uint64_t>(by) << KeyShift) | static_cast<uint64_t>(bz);
+    }
+
+    static int pointIndex(int ix, int iy, int iz){
+        return ((iz & BlockMask) * BlockSize + (iy & BlockMask)) * BlockSize + (ix & BlockMask);
+    }
+
+    const Block* findBlock(int ix, int iy, int iz) const{
+        auto p = blockIndexMap.find(key(ix >> BlockShift, iy >> BlockShift, iz >> BlockShift));
+        return (p != blockIndexMap.end()) ? blocks[p->second].get() : nullptr;
+    }
+
+    Block* findOrCreateBlock(int bx, int by, int bz){
+        auto inserted = blockIndexMap.emplace(key(bx, by, bz), static_cast<int>(blocks.size()));
+        if(inserted.second){
+            blocks.emplace_back(new Block);
+            std::memset(blocks.back().get(), 0, sizeof(Block));
+            blockIndices.emplace_back(bx, by, bz);
+        }
+        return blocks[inserted.first->second].get();
     }
 
-    if( _bnds.contain(pos) == false ){
+    void set(int ix, int iy, int iz, const FluidValue& val){
+        Block* block = findOrCreateBlock(ix >> BlockShift, iy >> BlockShift, iz >> BlockShift);
+        int i = pointIndex(ix, iy, iz);
+        block->density[i] = val.density;
+        block->velocity[0][i] = val.velocity.x();
+        block->velocity[1][i] = val.velocity.y();
+        block->velocity[2][i] = val.velocity.z();
+        block->viscosity[i] = val.viscosity;
+    }
+
+    double density(int ix, int iy, int iz) const{
+        const Block* block = findBlock(ix, iy, iz);
+        return block ? block->density[pointIndex(ix, iy, iz)] : 0.0;
+    }
+
+    /**
+       This class keeps the last block so that the hash map is not searched
+       for the successive accesses to the same block.
+    */
+    class Accessor
+    {
+    public:
+        Accessor(const SparseGrid& grid) : grid(grid), lastKey(~uint64_t(0)), lastBlock(nullptr) { }
+
+        const Block* block(int ix, int iy, int iz){
+            uint64_t k = key(ix >> BlockShift, iy >> BlockShift, iz >> BlockShift);
+            if(k != lastKey){
+                auto p = grid.blockIndexMap.find(k);
+                lastBlock = (p != grid.blockIndexMap.end()) ? grid.blocks[p->second].get() : nullptr;
+                lastKey = k;
+            }
+            return lastBlock;
+        }
+
+        bool get(const FluidEnvironment& env, const Vector3d& pos, FluidValue& val);
+
+    private:
+        const SparseGrid& grid;
+        uint64_t lastKey;
+        const Block* lastBlock;
+
+        void interpolateVelocity(const FluidEnvironment& env, const Vector3d& pos, Vector3d& out_velocity);
+    };
+};
+
+}
+
+
+bool
+FluidEnvironment::SparseGrid::Accessor::get(const FluidEnvironment& env, const Vector3d& pos, FluidValue& val)
+{
+    if( env._bnds.contain(pos) == false ){
         return false;
     }
-    
-    int ix = static_cast<int>(((pos.x()-_orgPos.x())/_gridLen.x())+0.5);
-    int iy = static_cast<int>(((pos.y()-_orgPos.y())/_gridLen.y())+0.5);
-    int iz = static_cast<int>(((pos.z()-_orgPos.z())/_gridLen.z())+0.5);
 
-    bool isFluid= isFluidCell(ix, iy, iz);
+    int ix = static_cast<int>(((pos.x()-env._orgPos.x())/env._gridLen.x())+0.5);
+    int iy = static_cast<int>(((pos.y()-env._orgPos.y())/env._gridLen.y())+0.5);
+    int iz = static_cast<int>(((pos.z()-env._orgPos.z())/env._gridLen.z())+0.5);
+
+    const Block* blk = block(ix, iy, iz);
+    int i = pointIndex(ix, iy, iz);
 
-    if( isFluid == false ){
+    if( blk == nullptr || blk->density[i] == 0.0 ){
         val.density = val.viscosity = 0.0;
         val.velocity = Eigen::Vector3d::Zero();
-        val.isFluid = isFluid;
+        val.isFluid = false;
         return true;
     }
 
-    val=_valAry(ix,iy,iz);
-    val.isFluid = isFluid;
+    val.density = blk->density[i];
+    val.viscosity = blk->viscosity[i];
+    if( env._isVelocityInterpolationEnabled ){
+        interpolateVelocity(env, pos, val.velocity);
+    } else {
+        val.velocity << blk->velocity[0][i], blk->velocity[1][i], blk->velocity[2][i];
+    }
+    val.isFluid = true;
 
-    return true;    
+    return true;
+}
+
+
+void
+FluidEnvironment::SparseGrid::Accessor::interpolateVelocity(const FluidEnvironment& env, const Vector3d& pos, Vector3d& out_velocity)
+{
+    int i0[3];
+    double t[3];
+    for(int k=0 ; k<3 ; ++k){
+        double f = (pos[k] - env._orgPos[k]) / env._gridLen[k];
+        i0[k] = std::max(0, std::min(static_cast<int>(std::floor(f)), env._gridSize[k] - 1));
+        t[k] = std::max(0.0, std::min(f - i0[k], 1.0));
+    }
+
+    // Only the fluid points are used and the weights are normalized with them
+    Vector3d velocity = Vector3d::Zero();
+    double weightSum = 0.0;
+    for(int c=0 ; c<8 ; ++c){
+        int ix = i0[0] + (c & 1);
+        int iy = i0[1] + ((c >> 1) & 1);
+        int iz = i0[2] + ((c >> 2) & 1);
+        const Block* blk = block(ix, iy, iz);
+        if( blk == nullptr ){
+            continue;
+        }
+        int i = pointIndex(ix, iy, iz);
+        if( blk->density[i] == 0.0 ){
+            continue;
+        }
+        double w = ((c & 1) ? t[0] : 1.0 - t[0]) * (((c >> 1) & 1) ? t[1] : 1.0 - t[1]) * (((c >> 2) & 1) ? t[2] : 1.0 - t[2]);
+        velocity += w * Vector3d(blk->velocity[0][i], blk->velocity[1][i], blk->velocity[2][i]);
+        weightSum += w;
+    }
+
+    if( weightSum > 0.0 ){
+        out_velocity = velocity / weightSum;
+    } else {
+        // This happens only when the weights of all the fluid points around the position are zero
+        int ix = static_cast<int>(((pos.x()-env._orgPos.x())/env._gridLen.x())+0.5);
+        int iy = static_cast<int>(((pos.y()-env._orgPos.y())/env._gridLen.y())+0.5);
+        int iz = static_cast<int>(((pos.z()-env._orgPos.z())/env._gridLen.z())+0.5);
+        const Block* blk = block(ix, iy, iz);
+        int i = pointIndex(ix, iy, iz);
+        out_velocity << blk->velocity[0][i], blk->velocity[1][i], blk->velocity[2][i];
+    }
+}
+
+
+bool
+FluidEnvironment::get(const Eigen::Vector3d& pos, FluidValue& val) const{
+
+    if(_isNull){
+        return false;
+    }
+
+    SparseGrid::Accessor accessor(*_grid);
+    return accessor.get(*this, pos, val);
+}
+
+
+int
+FluidEnvironment::get(int n, const Eigen::Vector3d* positions, FluidValue* out_values, bool* out_inBounds) const
+{
+    if(_isNull){
+        std::fill(out_inBounds, out_inBounds + n, false);
+        return 0;
+    }
+
+    SparseGrid::Accessor accessor(*_grid);
+    int numInBounds = 0;
+    for(int i=0 ; i < n ; ++i){
+        out_inBounds[i] = accessor.get(*this, positions[i], out_values[i]);
+        if(out_inBounds[i]){
+            ++numInBounds;
+        }
+    }
+    return numInBounds;
 }
 
 bool
 FluidEnvironment::isFluidCell(int ix, int iy, int iz) const
 {
-    if( _valAry(ix,iy,iz).density == 0.0 ){
+    if( _grid->density(ix,iy,iz) == 0.0 ){
         return false;
     }
     else{
@@ -67,7 +252,7 @@ bool
 FluidEnvironment::load(const string& fileName)
 {
     ifstream in;
-    in.open(fileName.data());
+    in.open(fileName.data(), ios::in | ios::binary);
     if( !in ){
         UtilityImpl::printErrorMessage(format("Air Definition File({}) is not existed", fileName));
         return false;
@@ -77,23 +262,67 @@ FluidEnvironment::load(const string& fileName)
         
     string buff;
     vector<string> buffAry;
-    long int lineCount=0;
 
     getline(in, buff);
-    lineCount++;
     UtilityImpl::splitStringArray(buff, buffAry);
     if( buffAry.size() != 2 ){
-        UtilityImpl::printErrorMessage(format("[Line:{}] Air Definition File is not valid", lineCount));
+        UtilityImpl::printErrorMessage(format("[Line:{}] Air Definition File is not valid", 1));
         return false;
     }
-    if( buffAry[0] != AIR_DEFINITION_FILE_TAG){
-        UtilityImpl::printErrorMessage(format("[Line:{}] Air Definition File is not valid", lineCount));
+
+    bool loaded = false;
+    if( buffAry[0] == AIR_DEFINITION_FILE_TAG && buffAry[1] == AIR_DEFINITION_FILE_VERSION ){
+        loaded = loadText(in, fulEnv);
+    }
+    else if( buffAry[0] == AIR_DEFINITION_BINARY_FILE_TAG && buffAry[1] == AIR_DEFINITION_BINARY_FILE_VERSION ){
+        loaded = loadBinary(in, fulEnv);
+    }
+    else{
+        UtilityImpl::printErrorMessage(format("[Line:{}] Air Definition File is not valid", 1));
+    }
+    if( !loaded ){
         return false;
     }
-    if( buffAry[1] != AIR_DEFINITION_FILE_VERSION){
-        UtilityImpl::printErrorMessage(format("[Line:{}] Air Definition File is not valid", lineCount));
+
+    fulEnv._isNull = false;
+    fulEnv._isVelocityInterpolationEnabled = _isVelocityInterpolationEnabled;
+        
+    *this = fulEnv;
+    
+    return true;
+}
+
+
+bool
+FluidEnvironment::setGridParameters(FluidEnvironment& fulEnv)
+{
+    for(int i=0 ; i<3 ; ++i){
+        if( fulEnv._gridSize[i] > SparseGrid::maxGridSize() ){
+            UtilityImpl::printErrorMessage(
+                format("The grid size of Air Definition File exceeds the limit {}", SparseGrid::maxGridSize()));
+            return false;
+        }
+    }
+
+    Boxd bnds;    
+    bnds.setMin(fulEnv._orgPos);    
+    bnds.setMax(fulEnv._orgPos.array()+fulEnv._gridLen.array()*fulEnv._gridSize.array().cast<double>());
+    if( bnds.isNull() == true ){
+        UtilityImpl::printErrorMessage("Air Definition File is not valid");
         return false;
     }
+    fulEnv._bnds = bnds;
+
+    return true;
+}
+
+
+bool
+FluidEnvironment::loadText(std::istream& in, FluidEnvironment& fulEnv)
+{
+    string buff;
+    vector<string> buffAry;
+    long int lineCount=1;
 
     for(int i=0 ; i<3 ; ++i){
         getline(in, buff);
@@ -110,15 +339,10 @@ FluidEnvironment::load(const string& fileName)
             return false;
         }
     }
-    
-    Boxd bnds;    
-    bnds.setMin(fulEnv._orgPos);    
-    bnds.setMax(fulEnv._orgPos.array()+fulEnv._gridLen.array()*fulEnv._gridSize.array().cast<double>());
-    if( bnds.isNull() == true ){
-        UtilityImpl::printErrorMessage("Air Definition File is not valid");
+
+    if( !setGridParameters(fulEnv) ){
         return false;
     }
-    fulEnv._bnds = bnds;
 
     getline(in, buff);
     lineCount++;
@@ -127,7 +351,7 @@ FluidEnvironment::load(const string& fileName)
     long int ygrid=fulEnv._gridSize.y()+1;
     long int zgrid=fulEnv._gridSize.z()+1;
 
-    fulEnv._valAry.create(xgrid,ygrid,zgrid);
+    auto grid = std::make_shared<SparseGrid>();
     while(in && getline(in,buff)){
         lineCount++;
         UtilityImpl::splitStringArray(buff, buffAry);
@@ -141,26 +365,147 @@ FluidEnvironment::load(const string& fileName)
             UtilityImpl::printErrorMessage(format("[Line:{}] Air Definition File is not valid", lineCount));
             return false;
         }
-        if((idx.x()>=xgrid)||(idx.y()>=ygrid)||(idx.z()>=zgrid)){
+        if((idx.x()>=xgrid)||(idx.y()>=ygrid)||(idx.z()>=zgrid)||(idx.minCoeff()<0)){
             UtilityImpl::printErrorMessage(format("[Line:{}] Air Definition File is not valid", lineCount));
             return false;
         }
 
-        FluidValue tmp=fulEnv._valAry(idx.x(), idx.y(), idx.z());
-        if(tmp.density != 0 && tmp.viscosity!=0){
+        if(grid->density(idx.x(), idx.y(), idx.z()) != 0){
             UtilityImpl::printWarningMessage(format("[Line:{}] That index has already been entered", lineCount));
         }
-        fulEnv._valAry(idx.x(), idx.y(), idx.z()) = dat;
+        grid->set(idx.x(), idx.y(), idx.z(), dat);
     }
 
     if((lineCount-5)!= xgrid*ygrid*zgrid){
         UtilityImpl::printWarningMessage("The number of input data and the number of grid points are defferent.");
     }
 
-    fulEnv._isNull = false;
-        
-    *this = fulEnv;
-    
+    fulEnv._grid = grid;
+
+    return true;
+}
+
+
+bool
+FluidEnvironment::loadBinary(std::istream& in, FluidEnvironment& fulEnv)
+{
+    int32_t gridSize[3];
+    int32_t blockSize;
+    int64_t numBlocks;
+    in.read(reinterpret_cast<char*>(fulEnv._orgPos.data()), sizeof(double) * 3);
+    in.read(reinterpret_cast<char*>(fulEnv._gridLen.data()), sizeof(double) * 3);
+    in.read(reinterpret_cast<char*>(gridSize), sizeof(gridSize));
+    in.read(reinterpret_cast<char*>(&blockSize), sizeof(blockSize));
+    in.read(reinterpret_cast<char*>(&numBlocks), sizeof(numBlocks));
+    if( !in ){
+        UtilityImpl::printErrorMessage("Air Definition File is not valid");
+        return false;
+    }
+    for(int i=0 ; i<3 ; ++i){
+        fulEnv._gridSize[i] = gridSize[i];
+        if(fulEnv._gridLen[i] <=0 || fulEnv._gridSize[i]<= 0 ){
+            UtilityImpl::printErrorMessage("Air Definition File is not valid");
+            return false;
+        }
+    }
+    if( blockSize != SparseGrid::BlockSize ){
+        UtilityImpl::printErrorMessage(
+            format("The block size {} of Air Definition File is not supported", blockSize));
+        return false;
+    }
+    if( !setGridParameters(fulEnv) ){
+        return false;
+    }
+
+    Vector3i numGridBlocks;
+    for(int i=0 ; i<3 ; ++i){
+        numGridBlocks[i] = (fulEnv._gridSize[i] + 1 + SparseGrid::BlockMask) >> SparseGrid::BlockShift;
+    }
+    if( numBlocks < 0 ||
+        numBlocks > static_cast<int64_t>(numGridBlocks.x()) * numGridBlocks.y() * numGridBlocks.z() ){
+        UtilityImpl::printErrorMessage("Air Definition File is not valid");
+        return false;
+    }
+
+    auto grid = std::make_shared<SparseGrid>();
+    grid->blockIndexMap.reserve(numBlocks);
+    for(int64_t i=0 ; i < numBlocks ; ++i){
+        int32_t b[3];
+        in.read(reinterpret_cast<char*>(b), sizeof(b));
+        if( !in || b[0] < 0 || b[1] < 0 || b[2] < 0 ||
+            b[0] >= numGridBlocks.x() || b[1] >= numGridBlocks.y() || b[2] >= numGridBlocks.z() ){
+            UtilityImpl::printErrorMessage(format("[Block:{}] Air Definition File is not valid", i));
+            return false;
+        }
+        SparseGrid::Block* block = grid->findOrCreateBlock(b[0], b[1], b[2]);
+        in.read(reinterpret_cast<char*>(block), sizeof(SparseGrid::Block));
+        if( !in ){
+            UtilityImpl::printErrorMessage(format("[Block:{}] Air Definition File is not valid", i));
+            return false;
+        }
+        for(int j=0 ; j < SparseGrid::NumBlockPoints ; ++j){
+            double density = block->density[j];
+            if( density < 0.0 || (density > 0.0 && block->viscosity[j] <= 0.0) ){
+                UtilityImpl::printErrorMessage(format("[Block:{}] Air Definition File is not valid", i));
+                return false;
+            }
+        }
+    }
+
+    fulEnv._grid = grid;
+
+    return true;
+}
+
+
+bool
+FluidEnvironment::save(const string& fileName) const
+{
+    if(_isNull){
+        return false;
+    }
+
+    ofstream out;
+    out.open(fileName.data(), ios::out | ios::binary);
+    if( !out ){
+        UtilityImpl::printErrorMessage(format("Air Definition File({}) cannot be written", fileName));
+        return false;
+    }
+
+    out << AIR_DEFINITION_BINARY_FILE_TAG << "," << AIR_DEFINITION_BINARY_FILE_VERSION << "\n";
+
+    int32_t gridSize[3] = { _gridSize.x(), _gridSize.y(), _gridSize.z() };
+    int32_t blockSize = SparseGrid::BlockSize;
+    int64_t numBlocks = _grid->blocks.size();
+    out.write(reinterpret_cast<const char*>(_orgPos.data()), sizeof(double) * 3);
+    out.write(reinterpret_cast<const char*>(_gridLen.data()), sizeof(double) * 3);
+    out.write(reinterpret_cast<const char*>(gridSize), sizeof(gridSize));
+    out.write(reinterpret_cast<const char*>(&blockSize), sizeof(blockSize));
+    out.write(reinterpret_cast<const char*>(&numBlocks), sizeof(numBlocks));
+
+    // The blocks are sorted so that the same environment is always saved as the same file
+    vector<int> order(numBlocks);
+    for(int i=0 ; i < numBlocks ; ++i){
+        order[i] = i;
+    }
+    const auto& indices = _grid->blockIndices;
+    std::sort(order.begin(), order.end(), [&indices](int a, int b){
+        const Vector3i& ia = indices[a];
+        const Vector3i& ib = indices[b];
+        return std::lexicographical_compare(ia.data(), ia.data() + 3, ib.data(), ib.data() + 3);
+    });
+
+    for(int i : order){
+        const Vector3i& b = indices[i];
+        int32_t blockIndex[3] = { b.x(), b.y(), b.z() };
+        out.write(reinterpret_cast<const char*>(blockIndex), sizeof(blockIndex));
+        out.write(reinterpret_cast<const char*>(_grid->blocks[i].get()), sizeof(SparseGrid::Block));
+    }
+
+    if( !out ){
+        UtilityImpl::printErrorMessage(format("Air Definition File({}) cannot be written", fileName));
+        return false;
+    }
     return true;
 }
 
@@ -168,6 +513,7 @@ FluidEnvironment::load(const string& fileName)
 FluidEnvironment::FluidEnvironment()
 {
    _isNull = true;
+   _isVelocityInterpolationEnabled = false;
 }
 
 FluidEnvironment::~FluidEnvironment()
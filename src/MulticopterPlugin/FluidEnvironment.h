@@ -4,9 +4,27 @@
 
 #pragma once
 
+#include <memory>
+
 namespace Multicopter{
 class SimulationManager;
 
+/**
+   The fluid values are defined on the points of a uniform grid. Only the blocks of the grid
+   points which contain some fluid points are stored, so a large volume can be defined at a
+   fine resolution as long as the fluid region or the defined region is limited. The points
+   which are not defined are not fluid.
+
+   The values can be loaded from the text format with the AIR_DEFINITION_FILE_TAG header or
+   the binary format with the AIR_DEFINITION_BINARY_FILE_TAG header. The binary format is
+   the header line followed by the data in the little endian byte order:
+   - origin (3 doubles), grid length (3 doubles) and grid size (3 int32s) of the grid
+   - block size (int32), which is the number of the points of a block along each axis
+   - number of the blocks (int64)
+   - for each block, the block index (3 int32s) followed by the arrays of the density,
+     the velocity x, y, z and the viscosity of the points in the block (doubles),
+     where the x index changes fastest. The points with zero density are not fluid.
+*/
 class FluidEnvironment
 {
 friend class SimulationManager;
@@ -46,8 +64,32 @@ public:
 
     bool get(const Eigen::Vector3d& pos, FluidValue& val) const;
 
+    /**
+       This function is faster than calling the above function for each position when the
+       positions are close to each other.
+       \param out_inBounds The flags of whether the positions are in the boundary
+       \return The number of the positions in the boundary
+    */
+    int get(int n, const Eigen::Vector3d* positions, FluidValue* out_values, bool* out_inBounds) const;
+
+    /**
+       The velocity is interpolated trilinearly with the fluid points around the position
+       when this is enabled. Otherwise the values of the nearest grid point are used.
+       The density and the viscosity are always those of the nearest grid point.
+    */
+    void setVelocityInterpolationEnabled(bool on){
+        _isVelocityInterpolationEnabled = on;
+    }
+
+    bool isVelocityInterpolationEnabled() const{
+        return _isVelocityInterpolationEnabled;
+    }
+
     bool load(const std::string& fileName);
 
+    //! The values are saved in the binary format
+    bool save(const std::string& fileName) const;
+
     Boxd boundary() const{
         return _bnds;
     }
@@ -62,8 +104,16 @@ protected:
 
     ~FluidEnvironment();
 
+    class SparseGrid;
+
     bool isFluidCell(int x, int y, int z) const;
 
+    bool loadText(std::istream& in, FluidEnvironment& fluEnv);
+
+    bool loadBinary(std::istream& in, FluidEnvironment& fluEnv);
+
+    bool setGridParameters(FluidEnvironment& fluEnv);
+
     void string2Vector3i(const std::string& line, Eigen::Vector3i& ret);
 
     bool stringArray2Data(const std::vector<std::string>& strAry, Eigen::Vector3i& idx, FluidValue& val);
@@ -74,7 +124,9 @@ private:
     Eigen::Vector3d _gridLen;
     Eigen::Vector3i _gridSize;
     Boxd _bnds;
-    Array3<FluidValue> _valAry;
+    // The grid is shared by the copies because it is not modified after loaded
+    std::shared_ptr<const SparseGrid> _grid;
+    bool _isVelocityInterpolationEnabled;
 
 };
 }
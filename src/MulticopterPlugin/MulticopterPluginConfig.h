@@ -34,11 +34,14 @@ namespace Multicopter{
 
     const std::string AIR_DEFINITION_FILE_TAG = "AirEnvironment";
     const std::string AIR_DEFINITION_FILE_VERSION ="1.0.0";
+    const std::string AIR_DEFINITION_BINARY_FILE_TAG = "AirEnvironmentBinary";
+    const std::string AIR_DEFINITION_BINARY_FILE_VERSION ="1.0.0";
 
     const std::string MULTICOPTER_DENSITY="Fluid Density[kg/m^3]";
     const std::string MULTICOPTER_VISCOSITY="Viscosity[Pa*s]";
     const std::string MULTICOPTER_VELOCITY ="Fluid Velocity[m/s]";
     const std::string MULTICOPTER_AIRDEFINITION="Air Definition File";
+    const std::string MULTICOPTER_VELOCITY_INTERPOLATION="Velocity Interpolation";
     const std::string MULTICOPTER_WALLEFFECT="Wall Effect";
     const std::string MULTICOPTER_GROUNDEFFECT="Ground Effect";
     const std::string MULTICOPTER_OUTPUT="Output Parameter";
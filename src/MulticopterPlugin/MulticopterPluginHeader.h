@@ -24,6 +24,7 @@
 #include <cnoid/YAMLBodyLoader>
 #include <cnoid/EigenArchive>
 #include <cnoid/Tokenizer>
+#include <cnoid/ThreadPool>
 
 #include "gettext.h"
 #include "exportdecl.h"
@@ -51,6 +52,7 @@
 
 #include "FFCalc_LinkForce.h"
 #include "FFCalc_LinkState.h"
+#include "FFCalc_SurfaceBatch.h"
 #include "FFCalc_FFCalculator.h"
 #include "FFCalc_calcFluidForce.h"
 
@@ -30,6 +30,7 @@ MulticopterSimulatorItem::MulticopterSimulatorItem()
     _viscosity=1.7e-5;
     _fluidVelocity = Vector3(0,0,0);
     _airDefinitionFileName="";
+    _velocityInterpolation=false;
     _wallEffect=false;
     _groundEffect=false;
     _outputParam=false;
@@ -43,6 +44,7 @@ MulticopterSimulatorItem::MulticopterSimulatorItem(const MulticopterSimulatorIte
     _viscosity=org._viscosity;
     _fluidVelocity=org._fluidVelocity;
     _airDefinitionFileName=org._airDefinitionFileName;
+    _velocityInterpolation=org._velocityInterpolation;
     _wallEffect=org._wallEffect;
     _groundEffect=org._groundEffect;
     _outputParam=org._outputParam;
@@ -138,6 +140,7 @@ MulticopterSimulatorItem::setParameterToSimulationManager()
         simMgr->setNewFluidEnvironment();
         return;
     }
+    fluEnv->setVelocityInterpolationEnabled(_velocityInterpolation);
 }
 
 
@@ -156,6 +159,7 @@ MulticopterSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(MULTICOPTER_VELOCITY, str(_fluidVelocity), [&](const string& v){ return toVector3(v, _fluidVelocity); });
     putProperty(MULTICOPTER_AIRDEFINITION, moduleProperty,
                 [&](const string& name){ _airDefinitionFileName=name; return true; });
+    putProperty(MULTICOPTER_VELOCITY_INTERPOLATION, _velocityInterpolation, changeProperty(_velocityInterpolation));
 
     putProperty(MULTICOPTER_WALLEFFECT, _wallEffect, changeProperty(_wallEffect));
     putProperty(MULTICOPTER_GROUNDEFFECT, _groundEffect, changeProperty(_groundEffect));
@@ -192,6 +196,7 @@ MulticopterSimulatorItem::store(Archive& archive)
     archive.write(MULTICOPTER_VISCOSITY,_viscosity);
     cnoid::write(archive, MULTICOPTER_VELOCITY,_fluidVelocity);
     archive.write(MULTICOPTER_AIRDEFINITION, _airDefinitionFileName);
+    archive.write(MULTICOPTER_VELOCITY_INTERPOLATION, _velocityInterpolation);
     archive.write(MULTICOPTER_WALLEFFECT,_wallEffect);
     archive.write(MULTICOPTER_GROUNDEFFECT, _groundEffect);
     archive.write(MULTICOPTER_OUTPUT, _outputParam);
@@ -209,6 +214,7 @@ MulticopterSimulatorItem::restore(const Archive& archive)
     archive.read(MULTICOPTER_VISCOSITY,_viscosity);
     cnoid::read(archive, MULTICOPTER_VELOCITY,_fluidVelocity);
     archive.read(MULTICOPTER_AIRDEFINITION, _airDefinitionFileName);
+    archive.read(MULTICOPTER_VELOCITY_INTERPOLATION, _velocityInterpolation);
     archive.read(MULTICOPTER_WALLEFFECT,_wallEffect);
     archive.read(MULTICOPTER_GROUNDEFFECT, _groundEffect);
     archive.read(MULTICOPTER_OUTPUT, _outputParam);
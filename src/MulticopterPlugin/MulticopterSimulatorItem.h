@@ -46,6 +46,7 @@ private:
     Vector3 _fluidVelocity;
     std::string _airDefinitionFileName;
     std::string _airDefinitionFileNameP;
+    bool _velocityInterpolation;
     bool _wallEffect;
     bool _groundEffect;
     bool _outputParam;
@@ -163,6 +163,8 @@ SimulationManager::initializeSimulation(SimulatorItem* simItem, MulticopterSimul
 
     updateLinkState(curTime);
 
+    updateSurfaceForces();
+
     #ifdef ENABLE_MULTICOPTER_PLUGIN_DEBUG
         debugList();
     #endif
@@ -333,6 +335,68 @@ SimulationManager::clearLinkState()
     _linkStateMap.clear();
 }
 
+void
+SimulationManager::updateSurfaceForces()
+{
+    clearSurfaceForces();
+
+    const int numIP = getDegreeNumber();
+
+    for(auto& linkPolygon : _linkPolygonMap){
+        Link* link = linkPolygon.first;
+        const LinkAttribute& linkAttr = get<1>(_fluidLinkBodyMap[link]);
+        if( linkAttr.linkForceApplyFlgAry()[3] == false ){
+            continue;
+        }
+        SurfaceForce& surfaceForce = _surfaceForceMap[link];
+        surfaceForce.link = link;
+        surfaceForce.linkAttr = linkAttr;
+        surfaceForce.linkState = _linkStateMap[link].get();
+        surfaceForce.batch.build(linkPolygon.second, numIP);
+    }
+
+    int numThreads = std::min(static_cast<int>(std::thread::hardware_concurrency()), static_cast<int>(_surfaceForceMap.size()));
+    if( numThreads > 1 ){
+        _surfaceForceThreadPool.reset(new ThreadPool(numThreads));
+    }
+}
+
+void
+SimulationManager::clearSurfaceForces()
+{
+    _surfaceForceThreadPool.reset();
+    _surfaceForceMap.clear();
+}
+
+void
+SimulationManager::calcSurfaceForces()
+{
+    const FluidEnvironment& fluidEnv = *fluidEnvironmentSim();
+
+    auto calc = [&](SurfaceForce& surfaceForce){
+        const Vector3 loadingPoint = Vector3 (0.0, 0.0, 0.0);
+        surfaceForce.linkForce = FFCalc::LinkForce(loadingPoint);
+        FFCalc::FFCalculator ffc (
+            _gravity, fluidEnv, _fluEnvAllSim, *surfaceForce.link, surfaceForce.linkAttr,
+            *surfaceForce.linkState, linkPolygon(surfaceForce.link));
+        ffc.calcSurfaceGeneral(surfaceForce.batch, &surfaceForce.linkForce, &surfaceForce.linkForce);
+    };
+
+    if( !_surfaceForceThreadPool ){
+        for(auto& kv : _surfaceForceMap){
+            calc(kv.second);
+        }
+        return;
+    }
+
+    // The links are evaluated in parallel because the batches and the results are independent of each other
+    for(auto& kv : _surfaceForceMap){
+        SurfaceForce* surfaceForce = &kv.second;
+        _surfaceForceThreadPool->start([&calc, surfaceForce](){ calc(*surfaceForce); });
+    }
+    _surfaceForceThreadPool->wait();
+}
+
 void
 SimulationManager::finalizeSimulation(SimulatorItem* simItem, MulticopterSimulatorItem* multicopterSimItem)
 {
@@ -343,6 +407,7 @@ SimulationManager::finalizeSimulation(SimulatorItem* simItem, MulticopterSimulat
     clearBodyLinkMap();
     clearLinkPolygon();
     clearLinkState();
+    clearSurfaceForces();
 }
 
 void
@@ -520,6 +585,14 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
     _rotorOutValAry.clear();
     _linkOutValAry.clear();
 
+    // The states of all the links are updated first so that the surface forces can be calculated in parallel
+    for(auto& kv : _bodyLinkMap){
+        for(auto& link : kv.second){
+            _linkStateMap[link]->update(simItem->currentTime(), *link);
+        }
+    }
+    calcSurfaceForces();
+
     for(auto itb = begin(_bodyLinkMap) ; itb != end(_bodyLinkMap) ; ++itb){
         std::map<int,std::tuple<double,Vector3>> effectMap;
         bool calFlag=false;
@@ -557,7 +630,6 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
             try{
                 FFCalc::LinkStatePtr pLinkState;
                 pLinkState = _linkStateMap[*itl];
-                pLinkState->update (simItem->currentTime(), **itl);
 
                 std::unique_ptr<FFCalc::LinkForce> pLinkForce = midDynamicFunctionLink (
                     simItem, multicopterSimItem, **itl, *pLinkState,effectMap,calFlag);
@@ -620,7 +692,12 @@ std::unique_ptr<FFCalc::LinkForce> SimulationManager::midDynamicFunctionLink (
         FFCalc::LinkForce lfGenSurface(pLinkForce->point());
 
         if(linkForceApplyTarget[3] == true){
-            ffc.calcSurfaceGeneral (&lfGenSurface, &lfGenSurface,getDegreeNumber());
+            auto it = _surfaceForceMap.find(&link);
+            if(it != _surfaceForceMap.end()){
+                lfGenSurface.add(it->second.linkForce);
+            }else{
+                ffc.calcSurfaceGeneral (&lfGenSurface, &lfGenSurface,getDegreeNumber());
+            }
             lfSurface.add(lfGenSurface);
         }
         pLinkForce->add(lfSurface);
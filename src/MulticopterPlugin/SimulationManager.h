@@ -96,6 +96,16 @@ protected:
         Eigen::Vector3d rotationalAcceleration;
     };
 
+    class SurfaceForce{
+    public:
+        SurfaceForce() : linkForce(Eigen::Vector3d::Zero()) { }
+        cnoid::Link* link;
+        LinkAttribute linkAttr;
+        const FFCalc::LinkState* linkState;
+        FFCalc::SurfaceBatch batch;
+        FFCalc::LinkForce linkForce;
+    };
+
     SimulationManager();
 
     ~SimulationManager();
@@ -112,6 +122,12 @@ protected:
 
     void clearLinkState();
 
+    void updateSurfaceForces();
+
+    void clearSurfaceForces();
+
+    void calcSurfaceForces();
+
     std::list<cnoid::Body*> simulationTargetBodies(cnoid::SimulatorItem* simItem);
 
     std::list<cnoid::Body*> fluidDynamicsTargetBodies(cnoid::SimulatorItem* simItem);
@@ -157,6 +173,8 @@ private:
     std::map<cnoid::Link*, std::tuple<cnoid::Body*, LinkAttribute> > _effectLinkBodyMap;
     std::map<cnoid::Link*, std::vector<LinkTriangleAttribute>>_linkPolygonMap;
     std::map<const cnoid::Link*, FFCalc::LinkStatePtr> _linkStateMap;
+    std::map<const cnoid::Link*, SurfaceForce> _surfaceForceMap;
+    std::unique_ptr<cnoid::ThreadPool> _surfaceForceThreadPool;
 
     std::list<RotorOutValue> _rotorOutValAry;
     std::list<FluidOutValue> _linkOutValAry;
@@ -17,8 +17,11 @@
 #include <cnoid/Sensor>
 #include <cnoid/BasicSensorSimulationHelper>
 #include <cnoid/BodyItem>
+#include <cnoid/MessageView>
 #include <cnoid/BodyCollisionDetector>
+#include <cnoid/SimulationProfiler>
 #include <QElapsedTimer>
+#include <fmt/format.h>
 #include "gettext.h"
 
 #ifdef GAZEBO_ODE
@@ -28,10 +31,12 @@
 #include <ode/ode.h>
 #define ITEM_NAME N_("ODESimulatorItem")
 #endif
+#include <thread>
 #include <iostream>
 
 using namespace std;
 using namespace cnoid;
+using fmt::format;
 
 namespace {
 
@@ -141,6 +146,17 @@ public:
     CrawlerLinkMap crawlerLinks;
 
     Selection stepMode;
+    Selection spaceType;
+    int hashSpaceMinLevel;
+    int hashSpaceMaxLevel;
+    Vector3 quadTreeCenter;
+    Vector3 quadTreeExtents;
+    int quadTreeDepth;
+    int numThreads;
+#ifndef GAZEBO_ODE
+    dThreadingImplementationID threading;
+    dThreadingThreadPoolID threadPool;
+#endif
     Vector3 gravity;
     double friction;
     bool isJointLimitMode;
@@ -160,11 +176,18 @@ public:
     double collisionTime;
     QElapsedTimer collisionTimer;
 
+    SimulationProfiler* profiler;
+    int collisionPhaseId;
+    int dynamicsPhaseId;
+
     ODESimulatorItemImpl(ODESimulatorItem* self);
     ODESimulatorItemImpl(ODESimulatorItem* self, const ODESimulatorItemImpl& org);
     void initialize();
     ~ODESimulatorItemImpl();
     void clear();
+    dSpaceID createTopLevelSpace();
+    void initializeThreading();
+    void finalizeThreading();
     bool initializeSimulation(const std::vector<SimulationBody*>& simBodies);
     void addBody(ODEBody* odeBody);
     bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies);
@@ -870,14 +893,28 @@ ODESimulatorItem::ODESimulatorItem()
 
 ODESimulatorItemImpl::ODESimulatorItemImpl(ODESimulatorItem* self)
     : self(self),
-      stepMode(ODESimulatorItem::NUM_STEP_MODES, CNOID_GETTEXT_DOMAIN_NAME)
-
+      stepMode(ODESimulatorItem::NUM_STEP_MODES, CNOID_GETTEXT_DOMAIN_NAME),
+      spaceType(ODESimulatorItem::NUM_SPACE_TYPES, CNOID_GETTEXT_DOMAIN_NAME)
 {
     initialize();
 
     stepMode.setSymbol(ODESimulatorItem::STEP_ITERATIVE,  N_("Iterative (quick step)"));
     stepMode.setSymbol(ODESimulatorItem::STEP_BIG_MATRIX, N_("Big matrix"));
     stepMode.select(ODESimulatorItem::STEP_ITERATIVE);
+
+    spaceType.setSymbol(ODESimulatorItem::HASH_SPACE, N_("Hash"));
+    spaceType.setSymbol(ODESimulatorItem::SAP_SPACE, N_("Sweep and prune"));
+    spaceType.setSymbol(ODESimulatorItem::QUADTREE_SPACE, N_("Quadtree"));
+    spaceType.setSymbol(ODESimulatorItem::SIMPLE_SPACE, N_("Simple"));
+    spaceType.select(ODESimulatorItem::HASH_SPACE);
+
+    // The default values of ODE
+    hashSpaceMinLevel = -3;
+    hashSpaceMaxLevel = 10;
+    quadTreeCenter.setZero();
+    quadTreeExtents << 20.0, 20.0, 10.0;
+    quadTreeDepth = 6;
+    numThreads = 1;
     
     gravity << 0.0, 0.0, -DEFAULT_GRAVITY_ACCELERATION;
     globalERP = 0.4;
@@ -908,6 +945,13 @@ ODESimulatorItemImpl::ODESimulatorItemImpl(ODESimulatorItem* self, const ODESimu
     initialize();
 
     stepMode = org.stepMode;
+    spaceType = org.spaceType;
+    hashSpaceMinLevel = org.hashSpaceMinLevel;
+    hashSpaceMaxLevel = org.hashSpaceMaxLevel;
+    quadTreeCenter = org.quadTreeCenter;
+    quadTreeExtents = org.quadTreeExtents;
+    quadTreeDepth = org.quadTreeDepth;
+    numThreads = org.numThreads;
     gravity = org.gravity;
     globalERP = org.globalERP;
     globalCFM = org.globalCFM;
@@ -929,6 +973,11 @@ void ODESimulatorItemImpl::initialize()
     worldID = 0;
     spaceID = 0;
     contactJointGroupID = dJointGroupCreate(0);
+#ifndef GAZEBO_ODE
+    threading = nullptr;
+    threadPool = nullptr;
+#endif
+    profiler = nullptr;
     self->SimulatorItem::setAllLinkPositionOutputMode(true);
 }
 
@@ -955,6 +1004,33 @@ void ODESimulatorItem::setStepMode(int value)
 }
 
 
+void ODESimulatorItem::setSpaceType(int type)
+{
+    impl->spaceType.select(type);
+}
+
+
+void ODESimulatorItem::setHashSpaceLevels(int minLevel, int maxLevel)
+{
+    impl->hashSpaceMinLevel = minLevel;
+    impl->hashSpaceMaxLevel = std::max(minLevel, maxLevel);
+}
+
+
+void ODESimulatorItem::setQuadTreeSpaceParameters(const Vector3& center, const Vector3& extents, int depth)
+{
+    impl->quadTreeCenter = center;
+    impl->quadTreeExtents = extents;
+    impl->quadTreeDepth = std::max(1, depth);
+}
+
+
+void ODESimulatorItem::setNumThreads(int n)
+{
+    impl->numThreads = std::max(0, n);
+}
+
+
 void ODESimulatorItem::setGravity(const Vector3& gravity)
 {
     impl->gravity = gravity;
@@ -1045,6 +1121,8 @@ void ODESimulatorItemImpl::clear()
 {
     dJointGroupEmpty(contactJointGroupID);
 
+    finalizeThreading();
+
     if(worldID){
         dWorldDestroy(worldID);
         worldID = 0;
@@ -1092,7 +1170,7 @@ bool ODESimulatorItemImpl::initializeSimulation(const std::vector<SimulationBody
     if(useWorldCollisionDetector){
         bodyCollisionDetector.setCollisionDetector(self->getOrCreateCollisionDetector());
     } else {
-        spaceID = dHashSpaceCreate(0);
+        spaceID = createTopLevelSpace();
         dSpaceSetCleanup(spaceID, 0);
     }
 
@@ -1106,6 +1184,8 @@ bool ODESimulatorItemImpl::initializeSimulation(const std::vector<SimulationBody
     dWorldSetContactMaxCorrectingVel(worldID, enableMaxCorrectingVel ? maxCorrectingVel.value() : dInfinity);
     dWorldSetContactSurfaceLayer(worldID, surfaceLayerDepth);
 
+    initializeThreading();
+
     timeStep = self->worldTimeStep();
 
     for(size_t i=0; i < simBodies.size(); ++i){
@@ -1120,10 +1200,109 @@ bool ODESimulatorItemImpl::initializeSimulation(const std::vector<SimulationBody
         collisionTime = 0;
     }
 
+    profiler = self->profiler();
+    if(profiler){
+        collisionPhaseId = profiler->addPhase("Collision detection");
+        dynamicsPhaseId = profiler->addPhase("Constraint solving and integration");
+    }
+
     return true;
 }
 
 
+dSpaceID ODESimulatorItemImpl::createTopLevelSpace()
+{
+    dSpaceID space;
+    
+    switch(spaceType.which()){
+
+    case ODESimulatorItem::SAP_SPACE:
+        space = dSweepAndPruneSpaceCreate(0, dSAP_AXES_XYZ);
+        break;
+
+    case ODESimulatorItem::QUADTREE_SPACE:
+    {
+        Vector3 center = quadTreeCenter;
+        Vector3 extents = quadTreeExtents;
+        if(flipYZ){
+            toInternal(quadTreeCenter, center);
+            toInternal(quadTreeExtents, extents);
+            extents = extents.cwiseAbs();
+        }
+        dVector3 c = { center.x(), center.y(), center.z(), 0.0 };
+        dVector3 e = { extents.x(), extents.y(), extents.z(), 0.0 };
+        space = dQuadTreeSpaceCreate(0, c, e, quadTreeDepth);
+        break;
+    }
+
+    case ODESimulatorItem::SIMPLE_SPACE:
+        space = dSimpleSpaceCreate(0);
+        break;
+
+    case ODESimulatorItem::HASH_SPACE:
+    default:
+        space = dHashSpaceCreate(0);
+        dHashSpaceSetLevels(space, hashSpaceMinLevel, hashSpaceMaxLevel);
+        break;
+    }
+
+    return space;
+}
+
+
+void ODESimulatorItemImpl::initializeThreading()
+{
+    int n = numThreads;
+    if(n == 0){
+        n = std::thread::hardware_concurrency();
+    }
+    if(n <= 1){
+        return;
+    }
+    
+#ifdef GAZEBO_ODE
+    MessageView::instance()->putln(
+        format(_("{0}: Multithreaded stepping is not supported by Gazebo ODE. The simulation is done in a single thread."),
+               self->displayName()), MessageView::Warning);
+#else
+    threading = dThreadingAllocateMultiThreadedImplementation();
+    if(!threading){
+        MessageView::instance()->putln(
+            format(_("{0}: The ODE library does not support multithreading. The simulation is done in a single thread."),
+                   self->displayName()), MessageView::Warning);
+        return;
+    }
+    threadPool = dThreadingAllocateThreadPool(n, 0, dAllocateFlagBasicData, nullptr);
+    if(!threadPool){
+        dThreadingFreeImplementation(threading);
+        threading = nullptr;
+        return;
+    }
+    dThreadingThreadPoolServeMultiThreadedImplementation(threadPool, threading);
+    dWorldSetStepIslandsProcessingMaxThreadCount(worldID, n);
+    dWorldSetStepThreadingImplementation(
+        worldID, dThreadingImplementationGetFunctions(threading), threading);
+#endif
+}
+
+
+void ODESimulatorItemImpl::finalizeThreading()
+{
+#ifndef GAZEBO_ODE
+    if(threading){
+        dThreadingImplementationShutdownProcessing(threading);
+        dThreadingFreeThreadPool(threadPool);
+        threadPool = nullptr;
+        if(worldID){
+            dWorldSetStepThreadingImplementation(worldID, nullptr, nullptr);
+        }
+        dThreadingFreeImplementation(threading);
+        threading = nullptr;
+    }
+#endif
+}
+
+
 void ODESimulatorItemImpl::addBody(ODEBody* odeBody)
 {
     Body& body = *odeBody->body();
@@ -1255,6 +1434,10 @@ bool ODESimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& ac
 
     dJointGroupEmpty(contactJointGroupID);
 
+    if(profiler){
+        profiler->beginPhase(collisionPhaseId);
+    }
+
     if(useWorldCollisionDetector){
         bodyCollisionDetector.updatePositions(
             [&](Referenced* object, Isometry3*& out_Position){
@@ -1273,12 +1456,21 @@ bool ODESimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& ac
         }
     }
 
+    if(profiler){
+        profiler->endPhase(collisionPhaseId);
+        profiler->beginPhase(dynamicsPhaseId);
+    }
+
     if(stepMode.is(ODESimulatorItem::STEP_ITERATIVE)){
         dWorldQuickStep(worldID, timeStep);
     } else {
         dWorldStep(worldID, timeStep);
     }
 
+    if(profiler){
+        profiler->endPhase(dynamicsPhaseId);
+    }
+
     if(MEASURE_PHYSICS_CALCULATION_TIME){
         physicsTime += physicsTimer.nsecsElapsed();
     }
@@ -1391,6 +1583,31 @@ void ODESimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
 {
     putProperty(_("Step mode"), stepMode, changeProperty(stepMode));
 
+    putProperty.min(0)(_("Threads"), numThreads, changeProperty(numThreads));
+
+    if(!useWorldCollisionDetector){
+        putProperty(_("Space type"), spaceType, changeProperty(spaceType));
+        if(spaceType.is(ODESimulatorItem::HASH_SPACE)){
+            putProperty(_("Hash space min level"), hashSpaceMinLevel,
+                        [&](int level){
+                            if(level > hashSpaceMaxLevel){ return false; }
+                            hashSpaceMinLevel = level;
+                            return true; });
+            putProperty(_("Hash space max level"), hashSpaceMaxLevel,
+                        [&](int level){
+                            if(level < hashSpaceMinLevel){ return false; }
+                            hashSpaceMaxLevel = level;
+                            return true; });
+        } else if(spaceType.is(ODESimulatorItem::QUADTREE_SPACE)){
+            putProperty(_("Quadtree center"), str(quadTreeCenter),
+                        [&](const string& v){ return toVector3(v, quadTreeCenter); });
+            putProperty(_("Quadtree extents"), str(quadTreeExtents),
+                        [&](const string& v){ return toVector3(v, quadTreeExtents); });
+            putProperty.min(1).max(12)
+                (_("Quadtree depth"), quadTreeDepth, changeProperty(quadTreeDepth));
+        }
+    }
+
     putProperty(_("Gravity"), str(gravity), [&](const string& v){ return toVector3(v, gravity); });
 
     putProperty.decimals(2).min(0.0)
@@ -1433,6 +1650,16 @@ bool ODESimulatorItem::store(Archive& archive)
 void ODESimulatorItemImpl::store(Archive& archive)
 {
     archive.write("stepMode", stepMode.selectedSymbol());
+    archive.write("numThreads", numThreads);
+    archive.write("spaceType", spaceType.selectedSymbol());
+    if(spaceType.is(ODESimulatorItem::HASH_SPACE)){
+        archive.write("hashSpaceMinLevel", hashSpaceMinLevel);
+        archive.write("hashSpaceMaxLevel", hashSpaceMaxLevel);
+    } else if(spaceType.is(ODESimulatorItem::QUADTREE_SPACE)){
+        write(archive, "quadTreeCenter", quadTreeCenter);
+        write(archive, "quadTreeExtents", quadTreeExtents);
+        archive.write("quadTreeDepth", quadTreeDepth);
+    }
     write(archive, "gravity", gravity);
     archive.write("friction", friction);
     archive.write("jointLimitMode", isJointLimitMode);
@@ -1461,6 +1688,15 @@ void ODESimulatorItemImpl::restore(const Archive& archive)
     if(archive.read("stepMode", symbol)){
         stepMode.select(symbol);
     }
+    archive.read("numThreads", numThreads);
+    if(archive.read("spaceType", symbol)){
+        spaceType.select(symbol);
+    }
+    archive.read("hashSpaceMinLevel", hashSpaceMinLevel);
+    archive.read("hashSpaceMaxLevel", hashSpaceMaxLevel);
+    read(archive, "quadTreeCenter", quadTreeCenter);
+    read(archive, "quadTreeExtents", quadTreeExtents);
+    archive.read("quadTreeDepth", quadTreeDepth);
     read(archive, "gravity", gravity);
     archive.read("friction", friction);
     archive.read("jointLimitMode", isJointLimitMode);
@@ -27,8 +27,19 @@ public:
     virtual ~ODESimulatorItem();
 
     enum StepMode { STEP_ITERATIVE, STEP_BIG_MATRIX, NUM_STEP_MODES };
+    enum SpaceType { HASH_SPACE, SAP_SPACE, QUADTREE_SPACE, SIMPLE_SPACE, NUM_SPACE_TYPES };
 
     void setStepMode(int value);
+    void setSpaceType(int type);
+    void setHashSpaceLevels(int minLevel, int maxLevel);
+    void setQuadTreeSpaceParameters(const Vector3& center, const Vector3& extents, int depth);
+
+    /**
+       The number of threads used to step the islands of the world in parallel.
+       Zero means the number of the hardware threads.
+    */
+    void setNumThreads(int n);
+
     void setGravity(const Vector3& gravity);
     void setFriction(double friction);
     void setJointLimitMode(bool on);
@@ -17,6 +17,10 @@ PYBIND11_MODULE(ODEPlugin, m)
     odeSimulatorItemScope
         .def(py::init<>())
         .def("setStepMode", &ODESimulatorItem::setStepMode)
+        .def("setSpaceType", &ODESimulatorItem::setSpaceType)
+        .def("setHashSpaceLevels", &ODESimulatorItem::setHashSpaceLevels)
+        .def("setQuadTreeSpaceParameters", &ODESimulatorItem::setQuadTreeSpaceParameters)
+        .def("setNumThreads", &ODESimulatorItem::setNumThreads)
         .def("setGravity", &ODESimulatorItem::setGravity)
         .def("setFriction", &ODESimulatorItem::setFriction)
         .def("setJointLimitMode", &ODESimulatorItem::setJointLimitMode)
@@ -37,5 +41,13 @@ PYBIND11_MODULE(ODEPlugin, m)
         .value("NUM_STEP_MODES", ODESimulatorItem::StepMode::NUM_STEP_MODES)
         .export_values();
 
+    py::enum_<ODESimulatorItem::SpaceType>(odeSimulatorItemScope, "SpaceType")
+        .value("HASH_SPACE", ODESimulatorItem::SpaceType::HASH_SPACE)
+        .value("SAP_SPACE", ODESimulatorItem::SpaceType::SAP_SPACE)
+        .value("QUADTREE_SPACE", ODESimulatorItem::SpaceType::QUADTREE_SPACE)
+        .value("SIMPLE_SPACE", ODESimulatorItem::SpaceType::SIMPLE_SPACE)
+        .value("NUM_SPACE_TYPES", ODESimulatorItem::SpaceType::NUM_SPACE_TYPES)
+        .export_values();
+
     PyItemList<ODESimulatorItem>(m, "ODESimulatorItemList");
 }
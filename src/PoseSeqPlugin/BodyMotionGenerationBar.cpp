@@ -22,11 +22,14 @@
 #include <cnoid/CheckBox>
 #include <cnoid/Dialog>
 #include <QDialogButtonBox>
+#include <QProgressDialog>
+#include <fmt/format.h>
 #include <set>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
+using fmt::format;
 
 namespace {
 const bool TRACE_FUNCTIONS = false;
@@ -60,6 +63,7 @@ public:
         
     CheckBox se3Check;
     CheckBox lipSyncMixCheck;
+    CheckBox parallelGenerationCheck;
 
     void addSeparator(QVBoxLayout* vbox){
         vbox->addSpacing(4);
@@ -128,6 +132,12 @@ public:
             newBodyItemCheck.setText(_("Make a new body item"));
             newBodyItemCheck.setChecked(true);
             hbox->addWidget(&newBodyItemCheck);
+
+            parallelGenerationCheck.setText(_("Parallel generation"));
+            parallelGenerationCheck.setToolTip(
+                _("Generate the frames in multiple threads when the generation is executed explicitly"));
+            parallelGenerationCheck.setChecked(true);
+            hbox->addWidget(&parallelGenerationCheck);
             hbox->addStretch();
 
             addSeparator(vbox, &stealthyStepCheck);
@@ -273,6 +283,7 @@ public:
         archive.write("zmpMaxDistanceFromCenter", zmpMaxDistanceFromCenterSpin.value());
         archive.write("allLinkPositions", se3Check.isChecked());
         archive.write("lipSyncMix", lipSyncMixCheck.isChecked());
+        archive.write("parallelGeneration", parallelGenerationCheck.isChecked());
     }
 
     void restoreState(const Archive& archive){
@@ -296,6 +307,7 @@ public:
             
         se3Check.setChecked(archive.get("allLinkPositions", se3Check.isChecked()));
         lipSyncMixCheck.setChecked(archive.get("lipSyncMix", lipSyncMixCheck.isChecked()));
+        parallelGenerationCheck.setChecked(archive.get("parallelGeneration", parallelGenerationCheck.isChecked()));
     }
 };
 
@@ -508,15 +520,20 @@ bool BodyMotionGenerationBar::shapeBodyMotion
     if(balancerToggle->isChecked() && balancer){
         result = balancer->apply(body, provider, motionItem, putMessages);
     } else {
-        result = shapeBodyMotionWithSimpleInterpolation(body, provider, motionItem);
+        result = shapeBodyMotionWithSimpleInterpolation(body, provider, motionItem, putMessages);
     }
 
     return result;
 }
         
 
+/**
+   The explicit generation is executed in multiple threads with a progress dialog. The automatic
+   generation after editing a pose sequence is executed on the given provider itself so that
+   the provider can reuse the results of the previous generation.
+*/
 bool BodyMotionGenerationBar::shapeBodyMotionWithSimpleInterpolation
-(BodyPtr& body, PoseProvider* provider, BodyMotionItemPtr motionItem)
+(BodyPtr& body, PoseProvider* provider, BodyMotionItemPtr motionItem, bool isExplicitGeneration)
 {
     if(setup->onlyTimeBarRangeCheck.isChecked()){
         poseProviderToBodyMotionConverter->setTimeRange(timeBar->minTime(), timeBar->maxTime());
@@ -528,7 +545,33 @@ bool BodyMotionGenerationBar::shapeBodyMotionWithSimpleInterpolation
     auto motion = motionItem->motion();
     motion->setFrameRate(timeBar->frameRate());
 
-    bool result = poseProviderToBodyMotionConverter->convert(body, provider, *motion);
+    bool result;
+    if(!isExplicitGeneration){
+        poseProviderToBodyMotionConverter->setNumThreads(1);
+        poseProviderToBodyMotionConverter->setProgressCallback(nullptr);
+        result = poseProviderToBodyMotionConverter->convert(body, provider, *motion);
+
+    } else {
+        poseProviderToBodyMotionConverter->setNumThreads(setup->parallelGenerationCheck.isChecked() ? 0 : 1);
+        QProgressDialog progress(
+            _("Generating the body motion..."), _("Cancel"), 0, 1000, MainWindow::instance());
+        progress.setWindowTitle(_("Body Motion Generation"));
+        progress.setWindowModality(Qt::WindowModal);
+        poseProviderToBodyMotionConverter->setProgressCallback(
+            [&progress](double ratio){
+                progress.setValue(static_cast<int>(ratio * 1000.0));
+                return !progress.wasCanceled();
+            });
+        result = poseProviderToBodyMotionConverter->convert(body, provider, *motion);
+        poseProviderToBodyMotionConverter->setProgressCallback(nullptr);
+        if(!result){
+            MessageView::instance()->putln(
+                format(_("The generation of {} has been canceled."), motionItem->displayName()),
+                MessageView::Warning);
+            // The frames generated before the cancellation are kept
+            motionItem->notifyUpdate();
+        }
+    }
     
     if(result){
         motionItem->notifyUpdate();
@@ -109,7 +109,7 @@ private:
     void onGenerationButtonClicked();
 
     bool shapeBodyMotionWithSimpleInterpolation
-        (BodyPtr& body, PoseProvider* provider, BodyMotionItemPtr motionItem);
+        (BodyPtr& body, PoseProvider* provider, BodyMotionItemPtr motionItem, bool isExplicitGeneration);
             
     virtual bool storeState(Archive& archive);
     virtual bool restoreState(const Archive& archive);
@@ -19,6 +19,7 @@
 #include <iostream>
 #include <algorithm>
 #include <unordered_map>
+#include <cmath>
 
 using namespace std;
 using namespace cnoid;
@@ -36,10 +37,10 @@ struct Coeff
 {
     double y;    // sample value
     double yp;   // derivative value
-    double a;
-    double a_end;
-    double b;
-    double c;
+    double a = 0.0;
+    double a_end = 0.0;
+    double b = 0.0;
+    double c = 0.0;
 };
 
 struct LinkSample
@@ -331,6 +332,24 @@ public:
 
     Signal<void()> sigUpdated;
 
+    /*
+      The joint positions solved by calcIkJointPositions are cached for each interpolation time.
+      When the samples are updated, only the entries in the time range of the segments whose
+      samples have been changed are removed. An entry also keeps the IK configuration, which is
+      the base link and the IK links, and it is only used when the configuration is the same.
+      The whole cache is cleared when a setting which affects the samples is changed.
+    */
+    struct IkSolution {
+        int baseLinkIndex;
+        vector<int> ikLinkIndices;
+        vector<double> q;
+    };
+    typedef map<double, IkSolution> IkSolutionCache;
+    IkSolutionCache ikSolutionCache;
+    vector<int> currentIkLinkIndices;
+    bool isIkConfigurationChanged;
+
+    void copyConfiguration(const PSIImpl* org);
     void setBody(Body* body0);
     void setLinearInterpolationJoint(int jointId);
     void addFootLink(int linkIndex, const Vector3& soleCenter);
@@ -346,6 +365,8 @@ public:
     bool mixLipSyncShape();
     void calcIkJointPositions();
     void calcIkJointPositionsSub(Link* link, Link* baseLink, LinkInfo* baseLinkInfo, bool doUpward, Link* prevLink);
+    void calcIkJointPositionsWithCache();
+    void removeIkSolutionCache(double time0, double time1);
     void appendPronun(PoseSeq::iterator poseIter);
     void appendLinkSamples(PoseSeq::iterator poseIter, PosePtr& pose);
 
@@ -779,6 +800,84 @@ void appendSample(typename SampleType::Seq& samples, const SampleType& sample)
     samples.push_back(sample);
 }
 
+
+template <class SampleType>
+bool hasSameAttributes(const SampleType& s0, const SampleType& s1)
+{
+    return true;
+}
+
+
+template <>
+bool hasSameAttributes<LinkSample>(const LinkSample& s0, const LinkSample& s1)
+{
+    return (s0.isBaseLink == s1.isBaseLink &&
+            s0.isTouching == s1.isTouching &&
+            s0.isSlave == s1.isSlave &&
+            s0.isAux == s1.isAux);
+}
+
+
+template <int dim, class SampleType>
+bool isSameSample(const SampleType& s0, const SampleType& s1)
+{
+    if(s0.x != s1.x || s0.segmentType != s1.segmentType ||
+       s0.isEndPoint != s1.isEndPoint || s0.isDirty != s1.isDirty ||
+       !hasSameAttributes(s0, s1)){
+        return false;
+    }
+    for(int i=0; i < dim; ++i){
+        const Coeff& c0 = s0.c[i];
+        const Coeff& c1 = s1.c[i];
+        if(c0.y != c1.y || c0.yp != c1.yp || c0.a != c1.a || c0.a_end != c1.a_end || c0.b != c1.b || c0.c != c1.c){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+   Expand the time range so that it covers the segments of which the interpolation results may
+   differ between the two sample sequences. The samples are compared from both the ends of the
+   sequences and the segments adjacent to the differing samples are included in the range.
+*/
+template <int dim, class SampleType>
+void expandChangedTimeRange
+(const typename SampleType::Seq& samples0, const typename SampleType::Seq& samples1, double& io_time0, double& io_time1)
+{
+    auto p0 = samples0.begin();
+    auto p1 = samples1.begin();
+    double time0 = -std::numeric_limits<double>::max();
+    size_t numRemaining0 = samples0.size();
+    size_t numRemaining1 = samples1.size();
+    
+    while(p0 != samples0.end() && p1 != samples1.end() && isSameSample<dim>(*p0, *p1)){
+        time0 = p0->x;
+        ++p0;
+        ++p1;
+        --numRemaining0;
+        --numRemaining1;
+    }
+    if(p0 == samples0.end() && p1 == samples1.end()){
+        return;
+    }
+
+    auto q0 = samples0.rbegin();
+    auto q1 = samples1.rbegin();
+    double time1 = std::numeric_limits<double>::max();
+    size_t n = std::min(numRemaining0, numRemaining1);
+    while(n > 0 && isSameSample<dim>(*q0, *q1)){
+        time1 = q0->x;
+        ++q0;
+        ++q1;
+        --n;
+    }
+
+    io_time0 = std::min(io_time0, time0);
+    io_time1 = std::max(io_time1, time1);
+}
+
 }
 
 
@@ -802,6 +901,7 @@ PSIImpl::PSIImpl(PoseSeqInterpolator* self)
     setStealthyStepParameters(2.0, 0.005, 0.005, 0.012, 0.3);
 
     isLipSyncMixEnabled = false;
+    isIkConfigurationChanged = false;
     
     needUpdate = true;
 }
@@ -821,6 +921,7 @@ void PSIImpl::setBody(Body* body0)
     soleCenters.clear();
     ikJointPathMap.clear();
     validIkLinkFlag.clear();
+    ikSolutionCache.clear();
     clearLipSyncShapes();
         
     if(!body0){
@@ -836,6 +937,58 @@ void PSIImpl::setBody(Body* body0)
 }
 
 
+PoseSeqInterpolator* PoseSeqInterpolator::clone() const
+{
+    auto interpolator = new PoseSeqInterpolator;
+    interpolator->impl->copyConfiguration(impl);
+    if(interpolator->impl->body && interpolator->impl->poseSeq){
+        interpolator->impl->update();
+    }
+    return interpolator;
+}
+
+
+void PSIImpl::copyConfiguration(const PSIImpl* org)
+{
+    setBody(org->body);
+
+    for(size_t i=0; i < jointInfos.size(); ++i){
+        jointInfos[i].useLinearInterpolation = org->jointInfos[i].useLinearInterpolation;
+    }
+    footLinkIndices = org->footLinkIndices;
+    soleCenters = org->soleCenters;
+
+    lipSyncJoints = org->lipSyncJoints;
+    lipSyncLinkIndices = org->lipSyncLinkIndices;
+    lipSyncShapes = org->lipSyncShapes;
+    lipSyncMaxTransitionTime = org->lipSyncMaxTransitionTime;
+    isLipSyncMixEnabled = org->isLipSyncMixEnabled;
+
+    isAutoZmpAdjustmentMode = org->isAutoZmpAdjustmentMode;
+    minZmpTransitionTime = org->minZmpTransitionTime;
+    zmpCenteringTimeThresh = org->zmpCenteringTimeThresh;
+    zmpTimeMarginBeforeLifting = org->zmpTimeMarginBeforeLifting;
+    zmpMaxDistanceFromCenterSqr = org->zmpMaxDistanceFromCenterSqr;
+            
+    isStealthyStepMode = org->isStealthyStepMode;
+    stealthyHeightRatioThresh = org->stealthyHeightRatioThresh;
+    flatLiftingHeight = org->flatLiftingHeight;
+    flatLandingHeight = org->flatLandingHeight;
+    impactReductionHeight = org->impactReductionHeight;
+    impactReductionTime = org->impactReductionTime;
+    impactReductionVelocity = org->impactReductionVelocity;
+
+    timeScaleRatio = org->timeScaleRatio;
+
+    isIkConfigurationChanged = true;
+
+    // The signals of the pose sequence are not connected
+    poseSeq = org->poseSeq;
+    invalidateCurrentInterpolation();
+    needUpdate = true;
+}
+
+
 Body* PoseSeqInterpolator::body() const
 {
     return impl->body;
@@ -852,6 +1005,8 @@ void PSIImpl::setLinearInterpolationJoint(int jointId)
 {
     if(jointId < (int)jointInfos.size()){
         jointInfos[jointId].useLinearInterpolation = true;
+        isIkConfigurationChanged = true;
+        needUpdate = true;
     }
 }
 
@@ -866,6 +1021,7 @@ void PSIImpl::addFootLink(int linkIndex, const Vector3& soleCenter)
 {
     footLinkIndices.push_back(linkIndex);
     soleCenters.push_back(soleCenter);
+    isIkConfigurationChanged = true;
     needUpdate = true;
 }
 
@@ -977,6 +1133,7 @@ void PSIImpl::setPoseSeq(PoseSeqPtr seq)
 {
     poseSeqConnections.disconnect();
     poseSeq = seq;
+    ikSolutionCache.clear();
 
     // for auto update mode (not implemented yet)
     poseSeqConnections = seq->connectSignalSet(
@@ -1014,6 +1171,7 @@ double PoseSeqInterpolator::endingTime() const
 void PoseSeqInterpolator::enableAutoZmpAdjustmentMode(bool on)
 {
     impl->isAutoZmpAdjustmentMode = on;
+    impl->isIkConfigurationChanged = true;
     impl->needUpdate = true;
 }
 
@@ -1025,6 +1183,7 @@ void PoseSeqInterpolator::setZmpAdjustmentParameters
     impl->zmpCenteringTimeThresh = centeringTimeThresh;
     impl->zmpTimeMarginBeforeLifting = timeMarginBeforeLifting;
     impl->zmpMaxDistanceFromCenterSqr = maxDistanceFromCenter * maxDistanceFromCenter;
+    impl->isIkConfigurationChanged = true;
     impl->needUpdate = true;
 }
 
@@ -1032,6 +1191,7 @@ void PoseSeqInterpolator::setZmpAdjustmentParameters
 void PoseSeqInterpolator::enableStealthyStepMode(bool on)
 {
     impl->isStealthyStepMode = on;
+    impl->isIkConfigurationChanged = true;
     impl->needUpdate = true;
 }
 
@@ -1059,6 +1219,7 @@ void PSIImpl::setStealthyStepParameters
     this->impactReductionTime = impactReductionTime;
     this->impactReductionVelocity = -2.0 * impactReductionHeight / impactReductionTime;
 
+    isIkConfigurationChanged = true;
     needUpdate = true;
 }
 
@@ -1246,7 +1407,12 @@ bool PSIImpl::interpolate(double time, int waistLinkIndex, const Vector3& waistT
         jointInfos[i].q = stdx::nullopt;
     }
 
-    calcIkJointPositions();
+    // The solutions with the waist translation are not cached because the translation varies continuously
+    if(waistTranslation.isZero()){
+        calcIkJointPositionsWithCache();
+    } else {
+        calcIkJointPositions();
+    }
 
     if(waistLinkIndex >= 0 && !waistTranslationDone){
         /// \todo write a code here to translate the waist when the waist link is not an ik link
@@ -1358,6 +1524,63 @@ void PSIImpl::calcIkJointPositions()
 }
 
 
+void PSIImpl::calcIkJointPositionsWithCache()
+{
+    const int n = jointInfos.size();
+
+    const int baseLinkIndex =
+        (currentBaseLinkInfoIter != ikLinkInfos.end()) ? currentBaseLinkInfoIter->first : -1;
+    currentIkLinkIndices.clear();
+    for(auto& kv : ikLinkInfos){
+        if(validIkLinkFlag[kv.first]){
+            currentIkLinkIndices.push_back(kv.first);
+        }
+    }
+    
+    auto p = ikSolutionCache.find(currentTime);
+    if(p != ikSolutionCache.end()){
+        const IkSolution& solution = p->second;
+        if(solution.baseLinkIndex == baseLinkIndex && solution.ikLinkIndices == currentIkLinkIndices){
+            const vector<double>& qs = solution.q;
+            for(int i=0; i < n; ++i){
+                const double q = qs[i];
+                if(!std::isnan(q)){
+                    jointInfos[i].q = q;
+                    // The joint positions are also the initial values of the numerical IK of the next time
+                    body->joint(i)->q() = q;
+                }
+            }
+            return;
+        }
+    }
+
+    calcIkJointPositions();
+
+    // Limit the memory used by the cache to about 80MB
+    if(p == ikSolutionCache.end() && ikSolutionCache.size() * n >= 10000000){
+        ikSolutionCache.clear();
+        p = ikSolutionCache.end();
+    }
+    IkSolution& solution = (p != ikSolutionCache.end()) ? p->second : ikSolutionCache[currentTime];
+    solution.baseLinkIndex = baseLinkIndex;
+    solution.ikLinkIndices = currentIkLinkIndices;
+    solution.q.resize(n);
+    for(int i=0; i < n; ++i){
+        auto& q = jointInfos[i].q;
+        solution.q[i] = q ? *q : std::numeric_limits<double>::quiet_NaN();
+    }
+}
+
+
+void PSIImpl::removeIkSolutionCache(double time0, double time1)
+{
+    if(time0 > time1){
+        return;
+    }
+    ikSolutionCache.erase(ikSolutionCache.lower_bound(time0), ikSolutionCache.upper_bound(time1));
+}
+
+
 /**
    \todo search an analytical IK path even if the base link of the path is not an ik link
 */
@@ -1513,11 +1736,15 @@ bool PSIImpl::update()
     if(!body || !poseSeq){
         return false;
     }
-    
+
+    // The previous samples are kept to detect the changed segments
+    vector<JointSample::Seq> prevJointSamples(jointInfos.size());
     for(size_t i=0; i < jointInfos.size(); ++i){
+        prevJointSamples[i].swap(jointInfos[i].samples);
         jointInfos[i].clear();
     }
-    ikLinkInfos.clear();
+    LinkInfoMap prevIkLinkInfos;
+    prevIkLinkInfos.swap(ikLinkInfos);
     zmpSamples.clear();
 
     lipSyncSeq.clear();
@@ -1602,6 +1829,41 @@ bool PSIImpl::update()
     initializeInterpolation<3, ZmpSample, false>(zmpSamples);
     zmpIter = zmpSamples.begin();
 
+    double changedTime0 = std::numeric_limits<double>::max();
+    double changedTime1 = -std::numeric_limits<double>::max();
+    for(size_t i=0; i < jointInfos.size(); ++i){
+        expandChangedTimeRange<1, JointSample>(
+            prevJointSamples[i], jointInfos[i].samples, changedTime0, changedTime1);
+    }
+    auto p = ikLinkInfos.begin();
+    auto q = prevIkLinkInfos.begin();
+    while(p != ikLinkInfos.end() || q != prevIkLinkInfos.end()){
+        static const LinkSample::Seq emptyLinkSamples;
+        static const LinkZSample::Seq emptyLinkZSamples;
+        if(q == prevIkLinkInfos.end() || (p != ikLinkInfos.end() && p->first < q->first)){
+            expandChangedTimeRange<6, LinkSample>(emptyLinkSamples, p->second.samples, changedTime0, changedTime1);
+            ++p;
+        } else if(p == ikLinkInfos.end() || q->first < p->first){
+            expandChangedTimeRange<6, LinkSample>(q->second.samples, emptyLinkSamples, changedTime0, changedTime1);
+            ++q;
+        } else {
+            expandChangedTimeRange<6, LinkSample>(
+                q->second.samples, p->second.samples, changedTime0, changedTime1);
+            expandChangedTimeRange<1, LinkZSample>(
+                q->second.isFootLink ? q->second.zSamples : emptyLinkZSamples,
+                p->second.isFootLink ? p->second.zSamples : emptyLinkZSamples,
+                changedTime0, changedTime1);
+            ++p;
+            ++q;
+        }
+    }
+    if(isIkConfigurationChanged){
+        ikSolutionCache.clear();
+        isIkConfigurationChanged = false;
+    } else {
+        removeIkSolutionCache(changedTime0, changedTime1);
+    }
+
     lipSyncIter = lipSyncSeq.begin();
 
     invalidateCurrentInterpolation();
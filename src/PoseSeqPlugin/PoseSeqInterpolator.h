@@ -78,6 +78,12 @@ public:
 
     virtual void getJointPositions(std::vector<stdx::optional<double>>& out_q) const;
 
+    /**
+       The created interpolator has the same body, pose sequence and parameters, and it has
+       already been updated. It does not track the changes of the pose sequence.
+    */
+    virtual PoseSeqInterpolator* clone() const override;
+
 private:
 
     PSIImpl* impl;
@@ -0,0 +1,253 @@
+#include "ParticleSimulator.h"
+#include <cnoid/SceneGraph>
+#include <cnoid/SceneDrawables>
+#include <cstdint>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+typedef Eigen::Map<Eigen::ArrayXf, Eigen::Aligned16> ArrayMap;
+
+// The number of the float arrays of the particles including the vertex array of three elements per particle
+constexpr int NumFloatArrays = 3 + 3 + 3 + 1 + 3;
+
+void collectObstaclesIter
+(SgNode* node, const Affine3& T, const BoundingBox& region, const Affine3& Tinv, vector<BoundingBoxf>& boxes)
+{
+    BoundingBox bbox = node->boundingBox();
+    if(bbox.empty()){
+        return;
+    }
+    bbox.transform(T);
+    for(int i=0; i < 3; ++i){
+        if(bbox.max()[i] < region.min()[i] || bbox.min()[i] > region.max()[i]){
+            return;
+        }
+    }
+    if(auto group = dynamic_cast<SgGroup*>(node)){
+        if(auto switchable = dynamic_cast<SgSwitchableGroup*>(group)){
+            if(!switchable->isTurnedOn()){
+                return;
+            }
+        }
+        if(auto transform = dynamic_cast<SgTransform*>(group)){
+            Affine3 T_local;
+            transform->getTransform(T_local);
+            Affine3 T_child = T * T_local;
+            for(auto& child : *group){
+                collectObstaclesIter(child, T_child, region, Tinv, boxes);
+            }
+        } else {
+            for(auto& child : *group){
+                collectObstaclesIter(child, T, region, Tinv, boxes);
+            }
+        }
+    } else if(dynamic_cast<SgShape*>(node)){
+        bbox.transform(Tinv);
+        boxes.emplace_back(bbox);
+    }
+}
+
+}
+
+
+ParticleArena::ParticleArena()
+{
+    alignedTop = nullptr;
+    capacity_ = 0;
+    usedSize_ = 0;
+}
+
+
+size_t ParticleArena::requiredSize(int numFloatArrays, int arraySize)
+{
+    size_t arrayBytes = (arraySize * sizeof(float) + Alignment - 1) / Alignment * Alignment;
+    return numFloatArrays * arrayBytes;
+}
+
+
+void ParticleArena::reserve(size_t size)
+{
+    if(size > capacity_){
+        buffer.reset(new char[size + Alignment]);
+        auto address = reinterpret_cast<std::uintptr_t>(buffer.get());
+        alignedTop = buffer.get() + (Alignment - address % Alignment) % Alignment;
+        capacity_ = size;
+    }
+    usedSize_ = 0;
+}
+
+
+float* ParticleArena::allocate(int numFloats)
+{
+    size_t size = (numFloats * sizeof(float) + Alignment - 1) / Alignment * Alignment;
+    if(usedSize_ + size > capacity_){
+        return nullptr;
+    }
+    float* p = reinterpret_cast<float*>(alignedTop + usedSize_);
+    usedSize_ += size;
+    return p;
+}
+
+
+ParticleSimulator::ParticleSimulator()
+{
+    numParticles_ = 0;
+    lifeTime_ = 1.0f;
+    restitution_ = 0.0f;
+    acceleration_.setZero();
+    vertices_ = nullptr;
+}
+
+
+bool ParticleSimulator::initialize(int numParticles, float lifeTime, const Emitter& emitter)
+{
+    numParticles_ = 0;
+    if(numParticles <= 0 || !(lifeTime > 0.0f)){
+        return false;
+    }
+
+    arena.reserve(ParticleArena::requiredSize(NumFloatArrays, numParticles));
+    for(int i=0; i < 3; ++i){
+        position[i] = arena.allocate(numParticles);
+        velocity[i] = arena.allocate(numParticles);
+        prevPosition[i] = arena.allocate(numParticles);
+    }
+    age = arena.allocate(numParticles);
+    vertices_ = arena.allocate(numParticles * 3);
+
+    numParticles_ = numParticles;
+    lifeTime_ = lifeTime;
+    this->emitter = emitter;
+
+    reset();
+
+    return true;
+}
+
+
+void ParticleSimulator::emit(int index, float initialAge)
+{
+    Vector3f p, v;
+    emitter(p, v);
+    for(int i=0; i < 3; ++i){
+        position[i][index] = p[i] + (v[i] + 0.5f * acceleration_[i] * initialAge) * initialAge;
+        velocity[i][index] = v[i] + acceleration_[i] * initialAge;
+    }
+    age[index] = initialAge;
+}
+
+
+void ParticleSimulator::reset()
+{
+    const float rate = lifeTime_ / numParticles_;
+    for(int i=0; i < numParticles_; ++i){
+        emit(i, i * rate);
+    }
+}
+
+
+void ParticleSimulator::step(float dt)
+{
+    const int n = numParticles_;
+    if(n == 0){
+        return;
+    }
+
+    for(int i=0; i < 3; ++i){
+        ArrayMap p(position[i], n);
+        ArrayMap v(velocity[i], n);
+        ArrayMap(prevPosition[i], n) = p;
+        v += acceleration_[i] * dt;
+        p += v * dt;
+    }
+    ArrayMap(age, n) += dt;
+
+    ArrayMap px(position[0], n);
+    ArrayMap py(position[1], n);
+    ArrayMap pz(position[2], n);
+    for(auto& box : obstacles_){
+        const Vector3f& b0 = box.min();
+        const Vector3f& b1 = box.max();
+        auto inside =
+            (px > b0.x()) && (px < b1.x()) &&
+            (py > b0.y()) && (py < b1.y()) &&
+            (pz > b0.z()) && (pz < b1.z());
+        if(!inside.any()){
+            continue;
+        }
+        for(int i=0; i < n; ++i){
+            if(inside.coeff(i)){
+                collide(i, box);
+            }
+        }
+    }
+
+    for(int i=0; i < n; ++i){
+        if(age[i] >= lifeTime_){
+            emit(i, 0.0f);
+        }
+    }
+}
+
+
+void ParticleSimulator::collide(int index, const BoundingBoxf& box)
+{
+    // The face through which the particle entered the box is the one with the latest entry time
+    int axis = -1;
+    float face = 0.0f;
+    float latestEntryTime = -1.0f;
+    for(int i=0; i < 3; ++i){
+        const float p0 = prevPosition[i][index];
+        const float p1 = position[i][index];
+        float f;
+        if(p0 <= box.min()[i]){
+            f = box.min()[i];
+        } else if(p0 >= box.max()[i]){
+            f = box.max()[i];
+        } else {
+            continue;
+        }
+        float t = (f - p0) / (p1 - p0);
+        if(t > latestEntryTime){
+            latestEntryTime = t;
+            axis = i;
+            face = f;
+        }
+    }
+
+    if(axis < 0 || restitution_ <= 0.0f){
+        age[index] = lifeTime_;
+    } else {
+        position[axis][index] = face;
+        velocity[axis][index] = -restitution_ * velocity[axis][index];
+    }
+}
+
+
+void ParticleSimulator::updateVertices()
+{
+    const float* px = position[0];
+    const float* py = position[1];
+    const float* pz = position[2];
+    float* v = vertices_;
+    for(int i=0; i < numParticles_; ++i){
+        *v++ = px[i];
+        *v++ = py[i];
+        *v++ = pz[i];
+    }
+}
+
+
+void ParticleSimulator::collectObstacles
+(SgNode* scene, const Affine3& T, const BoundingBox& region, std::vector<BoundingBoxf>& out_boxes)
+{
+    out_boxes.clear();
+
+    BoundingBox globalRegion = region;
+    globalRegion.transform(T);
+
+    collectObstaclesIter(scene, Affine3::Identity(), globalRegion, T.inverse(), out_boxes);
+}
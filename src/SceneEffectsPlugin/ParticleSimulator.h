@@ -0,0 +1,116 @@
+#ifndef CNOID_SCENE_EFFECTS_PLUGIN_PARTICLE_SIMULATOR_H
+#define CNOID_SCENE_EFFECTS_PLUGIN_PARTICLE_SIMULATOR_H
+
+#include <cnoid/EigenTypes>
+#include <cnoid/BoundingBox>
+#include <functional>
+#include <vector>
+#include <memory>
+
+namespace cnoid {
+
+class SgNode;
+
+/**
+   A fixed-size memory arena for the particle arrays.
+   The whole memory is allocated by the reserve function and it is not expanded after that,
+   so the memory used by the particles is bounded by the reserved size.
+*/
+class ParticleArena
+{
+public:
+    enum { Alignment = 32 };
+
+    ParticleArena();
+    ParticleArena(const ParticleArena&) = delete;
+    ParticleArena& operator=(const ParticleArena&) = delete;
+
+    //! The size includes the padding for the alignment of each array
+    static size_t requiredSize(int numFloatArrays, int arraySize);
+
+    void reserve(size_t size);
+    //! \return nullptr if the arena does not have enough space
+    float* allocate(int numFloats);
+    //! The allocated arrays are released but the reserved memory is kept
+    void clear() { usedSize_ = 0; }
+
+    size_t capacity() const { return capacity_; }
+    size_t usedSize() const { return usedSize_; }
+
+private:
+    std::unique_ptr<char[]> buffer;
+    char* alignedTop;
+    size_t capacity_;
+    size_t usedSize_;
+};
+
+
+/**
+   This class simulates the particles on CPU. The particles are stored in the structure of
+   arrays in a ParticleArena and they are integrated with the array operations of Eigen.
+   The particles collide with the axis-aligned boxes given as the obstacles, and they are
+   emitted again when their life time is over or when they are absorbed by an obstacle.
+*/
+class ParticleSimulator
+{
+public:
+    typedef std::function<void(Vector3f& out_position, Vector3f& out_velocity)> Emitter;
+
+    ParticleSimulator();
+
+    bool initialize(int numParticles, float lifeTime, const Emitter& emitter);
+
+    int numParticles() const { return numParticles_; }
+    float lifeTime() const { return lifeTime_; }
+
+    void setAcceleration(const Vector3f& a) { acceleration_ = a; }
+
+    /**
+       The particles bounce with this coefficient when they hit the obstacles.
+       The particles are absorbed by the obstacles when the coefficient is zero.
+    */
+    void setRestitution(float r) { restitution_ = r; }
+
+    std::vector<BoundingBoxf>& obstacles() { return obstacles_; }
+
+    /**
+       Collect the bounding boxes of the shapes in a scene which intersect with a region.
+       \param T The position of the frame where the particles are simulated
+       \param region The region of the particles in the frame
+       \param out_boxes The boxes are given in the frame
+    */
+    static void collectObstacles(
+        SgNode* scene, const Affine3& T, const BoundingBox& region, std::vector<BoundingBoxf>& out_boxes);
+
+    //! The particles are distributed over their life time as if they had been emitted continuously
+    void reset();
+
+    void step(float dt);
+
+    //! The positions are stored in the vertices as the sequence of (x, y, z)
+    void updateVertices();
+    const float* vertices() const { return vertices_; }
+
+private:
+    ParticleArena arena;
+    int numParticles_;
+    float lifeTime_;
+    float restitution_;
+    Vector3f acceleration_;
+    Emitter emitter;
+    std::vector<BoundingBoxf> obstacles_;
+
+    // The arrays allocated in the arena
+    float* position[3];
+    float* velocity[3];
+    float* prevPosition[3];
+    float* age;
+    float* vertices_;
+
+    void emit(int index, float initialAge);
+    void collide(int index, const BoundingBoxf& box);
+};
+
+}
+
+#endif
@@ -22,6 +22,8 @@ ParticleSystem::ParticleSystem()
     initialSpeedVariation_ = 0.1f;
     emissionRange_ = PI / 3.0f;
     acceleration_.setZero();
+    isCpuSimulationEnabled_ = false;
+    restitution_ = 0.0f;
 }
 
 
@@ -36,6 +38,8 @@ ParticleSystem::ParticleSystem(const ParticleSystem& org)
     initialSpeedVariation_ = org.initialSpeedVariation_;
     emissionRange_ = org.emissionRange_;
     acceleration_ = org.acceleration_;
+    isCpuSimulationEnabled_ = org.isCpuSimulationEnabled_;
+    restitution_ = org.restitution_;
 }
 
 
@@ -55,4 +59,6 @@ void ParticleSystem::readParameters(const YAMLSceneReader& reader, const Mapping
     node.read("initialSpeedVariation", initialSpeedVariation_);
     reader.readAngle(node, "emissionRange", emissionRange_);
     read(node, "acceleration", acceleration_);
+    node.read("cpuSimulation", isCpuSimulationEnabled_);
+    node.read("restitution", restitution_);
 }
@@ -46,6 +46,17 @@ public:
     const Vector3f& acceleration() const { return acceleration_; }
     void setAcceleration(const Vector3f& a){ acceleration_ = a; }
 
+    /**
+       When this is enabled, the particles are simulated on CPU so that they can collide with
+       the objects in the scene. The effects which do not support it ignore this flag.
+    */
+    bool isCpuSimulationEnabled() const { return isCpuSimulationEnabled_; }
+    void setCpuSimulationEnabled(bool on) { isCpuSimulationEnabled_ = on; }
+
+    //! Zero means that the particles are absorbed by the objects they hit
+    float restitution() const { return restitution_; }
+    void setRestitution(float r) { restitution_ = r; }
+
     void readParameters(const YAMLSceneReader& reader, const Mapping& node);
 
 private:
@@ -58,6 +69,8 @@ private:
     float initialSpeedVariation_;
     float emissionRange_;
     Vector3f acceleration_;
+    bool isCpuSimulationEnabled_;
+    float restitution_;
 };
 
 }
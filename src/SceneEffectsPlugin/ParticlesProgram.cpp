@@ -20,6 +20,7 @@ ParticlesProgramBase::ParticlesProgramBase(GLSLSceneRenderer* renderer)
 {
     
     initializationState = NOT_INITIALIZED;
+    globalPosition_ = nullptr;
 }
 
 
@@ -136,7 +137,9 @@ void ParticlesProgramBase::render
     glUniform1i(particleTexLocation, 0);
 
     globalAttitude_ = position.linear().cast<float>();
+    globalPosition_ = &position;
     renderingFunction();
+    globalPosition_ = nullptr;
 
     renderer_->popShaderProgram();
 }
@@ -33,6 +33,8 @@ protected:
     virtual ShaderProgram* shaderProgram() = 0;
     GLSLSceneRenderer* renderer() { return renderer_; }
     const Matrix3f& globalAttitude() const { return globalAttitude_; }
+    //! This is only valid in the rendering function
+    const Affine3& globalPosition() const { return *globalPosition_; }
 
 private:
     enum State { NOT_INITIALIZED, INITIALIZED, FAILED } initializationState;
@@ -45,6 +47,7 @@ private:
     GLint particleTexLocation;
     GLuint textureId;
     Matrix3f globalAttitude_;
+    const Affine3* globalPosition_;
     std::mt19937 randomNumberGenerator;
     typedef std::uniform_real_distribution<float> FloatDistribution;
     FloatDistribution floatDistribution;
@@ -6,9 +6,11 @@
 #include "SceneEffectsPlugin.h"
 #include "SceneRainSnow.h"
 #include "ParticlesProgram.h"
+#include "ParticleSimulator.h"
 #include <cnoid/SceneNodeClassRegistry>
 #include <cnoid/EigenUtil>
 #include <cnoid/GLSLProgram>
+#include <random>
 
 using namespace std;
 using namespace cnoid;
@@ -19,17 +21,28 @@ class RainSnowProgram : public ParticlesProgram
 {
 public:
     RainSnowProgram(GLSLSceneRenderer* renderer);
+    ~RainSnowProgram();
     virtual bool initializeRendering(SceneParticles* particles) override;
     void render(SceneRainSnowBase* particles);
+    void initializeCpuSimulation(SceneRainSnowBase* particles);
+    void releaseCpuSimulation();
+    void updateCpuSimulation(SceneRainSnowBase* particles);
 
     GLint velocityLocation;
     GLint lifeTimeLocation;
+    GLint isCpuSimulationLocation;
 
     GLfloat lifeTime;
     GLuint numParticles;
     GLuint initPosBuffer;
     GLuint offsetTimeBuffer;
     GLuint vertexArray;
+
+    // Used when the particles are simulated on CPU
+    unique_ptr<ParticleSimulator> simulator;
+    float lastSimulationTime;
+    GLuint streamBuffer;
+    GLuint streamVertexArray;
 };
 
 struct Registration {
@@ -125,6 +138,12 @@ RainSnowProgram::RainSnowProgram(GLSLSceneRenderer* renderer)
 }
 
 
+RainSnowProgram::~RainSnowProgram()
+{
+    releaseCpuSimulation();
+}
+
+
 bool RainSnowProgram::initializeRendering(SceneParticles* particles)
 {
     if(!ParticlesProgramBase::initializeRendering(particles)){
@@ -183,17 +202,131 @@ bool RainSnowProgram::initializeRendering(SceneParticles* particles)
     auto& glsl = glslProgram();
     velocityLocation = glsl.getUniformLocation("velocity");
     lifeTimeLocation = glsl.getUniformLocation("lifeTime");
+    isCpuSimulationLocation = glsl.getUniformLocation("isCpuSimulation");
+
+    if(ps.isCpuSimulationEnabled()){
+        initializeCpuSimulation(rs);
+    }
 
     return true;
 }
 
 
+void RainSnowProgram::initializeCpuSimulation(SceneRainSnowBase* rs)
+{
+    releaseCpuSimulation();
+
+    auto& ps = rs->particleSystem();
+    const float r = rs->radius();
+    const float r2 = r * 4;
+    const float top = rs->top();
+    const Vector3f velocity = rs->velocity();
+    // The emitter has its own random number generator so that it does not refer to this program
+    std::mt19937 random;
+    std::uniform_real_distribution<float> distribution(-r, r);
+
+    simulator.reset(new ParticleSimulator);
+    simulator->setAcceleration(ps.acceleration());
+    simulator->setRestitution(ps.restitution());
+    bool initialized = simulator->initialize(
+        ps.numParticles(), lifeTime,
+        [r2, top, velocity, random, distribution](Vector3f& out_position, Vector3f& out_velocity) mutable {
+            float x, y;
+            while(true){
+                x = distribution(random);
+                y = distribution(random);
+                if(x * x + y * y <= r2){
+                    break;
+                }
+            }
+            out_position << x, y, top;
+            out_velocity = velocity;
+        });
+    if(!initialized){
+        simulator.reset();
+        return;
+    }
+    lastSimulationTime = 0.0f;
+
+    // The positions are streamed to this buffer every frame
+    glGenBuffers(1, &streamBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+    glBufferData(GL_ARRAY_BUFFER, ps.numParticles() * 3 * sizeof(float), NULL, GL_STREAM_DRAW);
+
+    glGenVertexArrays(1, &streamVertexArray);
+    glBindVertexArray(streamVertexArray);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+    glEnableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void RainSnowProgram::releaseCpuSimulation()
+{
+    // The stream buffers are created only when the simulator is initialized
+    if(simulator){
+        glDeleteVertexArrays(1, &streamVertexArray);
+        glDeleteBuffers(1, &streamBuffer);
+        simulator.reset();
+    }
+}
+
+
+void RainSnowProgram::updateCpuSimulation(SceneRainSnowBase* particles)
+{
+    const float time = particles->time() + particles->particleSystem().offsetTime();
+    float dt = time - lastSimulationTime;
+    lastSimulationTime = time;
+
+    if(dt < 0.0f || dt > 1.0f){
+        // The time has jumped
+        simulator->reset();
+
+    } else if(dt > 0.0f){
+        BoundingBox region(
+            Vector3(-particles->radius(), -particles->radius(), particles->bottom()),
+            Vector3(particles->radius(), particles->radius(), particles->top()));
+        ParticleSimulator::collectObstacles(
+            renderer()->sceneRoot(), globalPosition(), region, simulator->obstacles());
+
+        // Sub steps keep the particles from passing through thin objects
+        const float maxStep = 1.0f / 60.0f;
+        int n = static_cast<int>(ceilf(dt / maxStep));
+        const float h = dt / n;
+        for(int i=0; i < n; ++i){
+            simulator->step(h);
+        }
+    }
+
+    simulator->updateVertices();
+
+    const GLsizeiptr size = simulator->numParticles() * 3 * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, streamBuffer);
+    // Orphan the buffer so that the driver does not have to wait for the previous drawing
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, simulator->vertices());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
 void RainSnowProgram::render(SceneRainSnowBase* particles)
 {
     auto& ps = particles->particleSystem();
 
+    if(simulator){
+        updateCpuSimulation(particles);
+        glUniform1i(isCpuSimulationLocation, true);
+        glVertexAttrib1f(1, 0.0f);
+        glBindVertexArray(streamVertexArray);
+        glDrawArrays(GL_POINTS, 0, simulator->numParticles());
+        return;
+    }
+
     setTime(particles->time() + ps.offsetTime());
 
+    glUniform1i(isCpuSimulationLocation, false);
     glUniform1f(lifeTimeLocation, lifeTime);
     glUniform3fv(velocityLocation, 1, particles->velocity().data());
 
@@ -9,6 +9,8 @@ out float alpha;
 uniform float time;
 uniform float lifeTime;
 uniform vec3 velocity;
+// The vertex positions are given as the current positions when the particles are simulated on CPU
+uniform bool isCpuSimulation = false;
 
 uniform mat4 modelViewMatrix;
 uniform mat4 projectionMatrix;
@@ -20,8 +22,10 @@ void main()
     vec3 pos = vertexInitPos;
     alpha = 0.0;
     float t = time - offsetTime;
-    //if(t > 0){
-    if(true){
+    if(isCpuSimulation){
+        alpha = 1.0;
+    //} else if(t > 0){
+    } else if(true){
         t = mod(t, lifeTime);
         pos = vertexInitPos + velocity * t;
         alpha = 1.0;
@@ -0,0 +1,577 @@
+#include <cnoid/DyWorld>
+#include <cnoid/DyBody>
+#include <cnoid/ForwardDynamicsCBM>
+#include <cnoid/ConstraintForceSolver>
+#include <cnoid/SimulationProfiler>
+#include <cnoid/BodyLoader>
+#include <cnoid/MaterialTable>
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/YAMLReader>
+#include <cnoid/YAMLWriter>
+#include <cnoid/EigenArchive>
+#include <cnoid/EigenUtil>
+#include <cnoid/FilePathVariableProcessor>
+#include <cnoid/ExecutablePath>
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+struct BodySpec
+{
+    string modelFile;
+    Vector3 rootPosition;
+    Matrix3 rootAttitude;
+    vector<double> jointPositions;
+    bool isHighGainMode;
+};
+
+struct WorldSpec
+{
+    string name;
+    double timeStep;
+    int numSteps;
+    vector<BodySpec> bodies;
+};
+
+struct Result
+{
+    string worldName;
+    string engineName;
+    bool isValid;
+    int numSteps;
+    double timeStep;
+    double loadingTime;
+    double initializationTime;
+    double stepsPerSecond;
+    double realtimeFactor;
+    double meanStepTime;
+    double percentile99StepTime;
+    double maxStepTime;
+    // The mean times of the phases. A negative value means that the phase is not recorded.
+    double meanCollisionDetectionTime;
+    double meanConstraintSolvingTime;
+    double meanIntegrationTime;
+    double meanNumContacts;
+    int maxNumContacts;
+    // Memory usages in kilobytes. Zero means that the value is not available.
+    // The peak is measured from the beginning of the run of each world.
+    long residentMemory;
+    long peakResidentMemory;
+};
+
+struct EngineInfo
+{
+    const char* name;
+    bool isRungeKuttaMode;
+};
+
+const EngineInfo engines[] = {
+    { "AIST", false },
+    { "AIST-RK4", true }
+};
+
+const char* usage =
+    "Usage: cnoid-bench [options] [world-file]\n"
+    "\n"
+    "Run the simulation of the reference worlds without GUI and report the performance.\n"
+    "The reference worlds in the share directory are used if the world file is not given.\n"
+    "\n"
+    "Options:\n"
+    "  --world <name>              Run the specified world only. Can be given multiple times.\n"
+    "  --engine <name>             Use the specified engine only. Can be given multiple times.\n"
+    "  --steps <n>                 Override the number of steps of each world.\n"
+    "  --collision-detector <name> Collision detector used in the simulation (default: AISTCollisionDetector)\n"
+    "  --format <text|yaml|csv>    Output format (default: text)\n"
+    "  --output <file>             Write the result to the file instead of the standard output\n"
+    "  --list                      List the worlds and the engines\n"
+    "  --help                      Show this message\n";
+
+
+bool readWorldSpecs(const string& filename, vector<WorldSpec>& out_worlds)
+{
+    YAMLReader reader;
+
+    try {
+        auto topNode = reader.loadDocument(filename)->toMapping();
+
+        FilePathVariableProcessorPtr pathProcessor = new FilePathVariableProcessor;
+        pathProcessor->setSystemVariablesEnabled(true);
+        pathProcessor->setBaseDirectory(filesystem::path(filename).parent_path().string());
+
+        double defaultTimeStep = topNode->get("timeStep", 0.001);
+        int defaultNumSteps = topNode->get("numSteps", 1000);
+
+        auto worldNodes = topNode->findListing("worlds");
+        if(!worldNodes->isValid()){
+            cerr << format("\"worlds\" is not defined in {}.", filename) << endl;
+            return false;
+        }
+        for(int i=0; i < worldNodes->size(); ++i){
+            auto worldNode = worldNodes->at(i)->toMapping();
+            WorldSpec world;
+            world.name = worldNode->get<string>("name");
+            world.timeStep = worldNode->get("timeStep", defaultTimeStep);
+            world.numSteps = worldNode->get("numSteps", defaultNumSteps);
+
+            auto bodyNodes = worldNode->findListing("bodies");
+            for(int j=0; j < bodyNodes->size(); ++j){
+                auto bodyNode = bodyNodes->at(j)->toMapping();
+                BodySpec body;
+                body.modelFile = pathProcessor->expand(bodyNode->get<string>("modelFile"), true);
+                if(body.modelFile.empty()){
+                    bodyNode->throwException(pathProcessor->errorMessage());
+                }
+                if(!read(bodyNode, "rootPosition", body.rootPosition)){
+                    body.rootPosition.setZero();
+                }
+                if(!read(bodyNode, "rootAttitude", body.rootAttitude)){
+                    body.rootAttitude.setIdentity();
+                }
+                auto qs = bodyNode->findListing("jointPositions");
+                for(int k=0; k < qs->size(); ++k){
+                    body.jointPositions.push_back(qs->at(k)->toDouble());
+                }
+                body.isHighGainMode = bodyNode->get("highGainJoints", false);
+                world.bodies.push_back(body);
+            }
+            out_worlds.push_back(world);
+        }
+    }
+    catch(const ValueNode::Exception& ex){
+        cerr << ex.message() << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+/*
+  The peak resident memory (VmHWM) of the process never decreases, so it is reset to the current
+  resident memory before each run. Writing "5" to clear_refs is supported since Linux 4.0.
+*/
+bool resetPeakResidentMemory()
+{
+#ifdef __linux__
+    ofstream ofs("/proc/self/clear_refs");
+    ofs << "5";
+    ofs.flush();
+    return static_cast<bool>(ofs);
+#else
+    return false;
+#endif
+}
+
+
+void getResidentMemory(long& out_current, long& out_peak)
+{
+    out_current = 0;
+    out_peak = 0;
+#ifdef __linux__
+    ifstream ifs("/proc/self/status");
+    string line;
+    while(getline(ifs, line)){
+        if(line.compare(0, 6, "VmRSS:") == 0){
+            out_current = std::stol(line.substr(6));
+        } else if(line.compare(0, 6, "VmHWM:") == 0){
+            out_peak = std::stol(line.substr(6));
+        }
+    }
+#endif
+}
+
+
+double elapsedTime(const chrono::steady_clock::time_point& startTime)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+
+double getMeanPhaseTime(const SimulationProfiler& profiler, const char* name)
+{
+    // The id of a missing phase is -1, which is the same as StepTime
+    int phaseId = profiler.findPhase(name);
+    return (phaseId >= 0) ? profiler.meanTime(phaseId) : -1.0;
+}
+
+
+string formatPhaseTime(double time, const char* format)
+{
+    return (time >= 0.0) ? fmt::format(format, time) : string("n/a");
+}
+
+
+bool runAISTWorld
+(const WorldSpec& spec, const EngineInfo& engine, const string& collisionDetectorName, Result& result)
+{
+    CollisionDetectorPtr collisionDetector;
+    if(collisionDetectorName == "AISTCollisionDetector"){
+        // Directly created so that the detector library is surely linked
+        collisionDetector = new AISTCollisionDetector;
+    } else {
+        int detectorIndex = CollisionDetector::factoryIndex(collisionDetectorName);
+        if(detectorIndex >= 0){
+            collisionDetector = CollisionDetector::create(detectorIndex);
+        }
+    }
+    if(!collisionDetector){
+        cerr << format("Collision detector \"{}\" is not available.", collisionDetectorName) << endl;
+        return false;
+    }
+
+    const bool isPeakResidentMemoryAvailable = resetPeakResidentMemory();
+
+    auto loadingStartTime = chrono::steady_clock::now();
+
+    World<ConstraintForceSolver> world;
+    ConstraintForceSolver& cfs = world.constraintForceSolver;
+    vector<shared_ptr<ForwardDynamicsCBM>> highGainDynamicsList;
+    BodyLoader loader;
+    ostringstream loaderMessages;
+    loader.setMessageSink(loaderMessages);
+
+    for(auto& bodySpec : spec.bodies){
+        BodyPtr orgBody = loader.load(bodySpec.modelFile);
+        if(!orgBody){
+            cerr << loaderMessages.str() << format("{} cannot be loaded.", bodySpec.modelFile) << endl;
+            return false;
+        }
+        // Copied to make all the links including the ones of sub bodies DyLink objects
+        DyBodyPtr body = new DyBody;
+        body->copyFrom(orgBody);
+        body->initializeState();
+        body->rootLink()->setTranslation(bodySpec.rootPosition);
+        body->rootLink()->setRotation(bodySpec.rootAttitude);
+        const int n = std::min(body->numJoints(), static_cast<int>(bodySpec.jointPositions.size()));
+        for(int i=0; i < n; ++i){
+            body->joint(i)->q() = bodySpec.jointPositions[i];
+        }
+        body->calcForwardKinematics();
+
+        bool hasHighGainJoints = false;
+        if(bodySpec.isHighGainMode){
+            for(auto& joint : body->joints()){
+                if(joint->isRevoluteJoint() || joint->isPrismaticJoint()){
+                    joint->setActuationMode(Link::JointDisplacement);
+                    joint->q_target() = joint->q();
+                    joint->dq_target() = 0.0;
+                    hasHighGainJoints = true;
+                }
+            }
+        }
+        int bodyIndex;
+        if(hasHighGainJoints){
+            auto dynamics = make_shared_aligned<ForwardDynamicsCBM>(body);
+            highGainDynamicsList.push_back(dynamics);
+            bodyIndex = world.addBody(body, dynamics);
+        } else {
+            bodyIndex = world.addBody(body);
+        }
+        cfs.setSelfCollisionDetectionEnabled(bodyIndex, false);
+    }
+    result.loadingTime = elapsedTime(loadingStartTime);
+
+    auto initializationStartTime = chrono::steady_clock::now();
+
+    if(engine.isRungeKuttaMode){
+        world.setRungeKuttaMethod();
+    } else {
+        world.setEulerMethod();
+    }
+    world.setGravityAcceleration(Vector3(0.0, 0.0, -9.80665));
+    world.enableSensors(true);
+    world.setTimeStep(spec.timeStep);
+    world.setCurrentTime(0.0);
+
+    MaterialTablePtr materialTable = new MaterialTable;
+    materialTable->load((shareDirPath() / "default" / "materials.yaml").string());
+    cfs.setMaterialTable(materialTable);
+    cfs.setCollisionDetector(collisionDetector);
+
+    SimulationProfiler profiler;
+    profiler.setMaxNumSteps(spec.numSteps);
+    cfs.setProfiler(&profiler);
+    world.setProfiler(&profiler);
+
+    world.initialize();
+
+    result.initializationTime = elapsedTime(initializationStartTime);
+
+    long totalNumContacts = 0;
+    result.maxNumContacts = 0;
+
+    for(int i=0; i < spec.numSteps; ++i){
+        profiler.beginStep();
+        world.calcNextState();
+        profiler.endStep();
+        cfs.clearExternalForces();
+
+        // Contacts are counted outside the measured step
+        int numContacts = 0;
+        auto collisionPairs = cfs.getCollisions();
+        for(auto& pair : *collisionPairs){
+            numContacts += pair->collisions.size();
+        }
+        totalNumContacts += numContacts;
+        result.maxNumContacts = std::max(result.maxNumContacts, numContacts);
+    }
+
+    result.numSteps = spec.numSteps;
+    result.timeStep = spec.timeStep;
+    result.meanStepTime = profiler.meanTime(SimulationProfiler::StepTime);
+    result.percentile99StepTime = profiler.percentileTime(SimulationProfiler::StepTime, 99.0);
+    result.maxStepTime = profiler.maxTime(SimulationProfiler::StepTime);
+    result.stepsPerSecond = (result.meanStepTime > 0.0) ? (1.0 / result.meanStepTime) : 0.0;
+    result.realtimeFactor = result.stepsPerSecond * spec.timeStep;
+    result.meanCollisionDetectionTime = getMeanPhaseTime(profiler, "Collision detection");
+    result.meanConstraintSolvingTime = getMeanPhaseTime(profiler, "Constraint solving");
+    result.meanIntegrationTime = getMeanPhaseTime(profiler, "Integration");
+    result.meanNumContacts = (spec.numSteps > 0) ? (double(totalNumContacts) / spec.numSteps) : 0.0;
+    getResidentMemory(result.residentMemory, result.peakResidentMemory);
+    if(!isPeakResidentMemoryAvailable){
+        result.peakResidentMemory = 0;
+    }
+
+    return true;
+}
+
+
+void putTextResults(ostream& os, const vector<Result>& results)
+{
+    os << format("{:<16} {:<10} {:>7} {:>11} {:>8} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9} {:>8} {:>9}\n",
+                 "World", "Engine", "Steps", "Steps/s", "RTF", "Mean[ms]", "99%[ms]", "Max[ms]",
+                 "Coll[ms]", "Cons[ms]", "Intg[ms]", "Contacts", "RSS[MB]");
+    for(auto& r : results){
+        if(!r.isValid){
+            os << format("{:<16} {:<10} failed\n", r.worldName, r.engineName);
+            continue;
+        }
+        os << format("{:<16} {:<10} {:>7} {:>11.1f} {:>8.2f} {:>9.4f} {:>9.4f} {:>9.4f} {:>9} {:>9} {:>9} {:>8.1f} {:>9.1f}\n",
+                     r.worldName, r.engineName, r.numSteps, r.stepsPerSecond, r.realtimeFactor,
+                     r.meanStepTime * 1000.0, r.percentile99StepTime * 1000.0, r.maxStepTime * 1000.0,
+                     formatPhaseTime(r.meanCollisionDetectionTime * 1000.0, "{:.4f}"),
+                     formatPhaseTime(r.meanConstraintSolvingTime * 1000.0, "{:.4f}"),
+                     formatPhaseTime(r.meanIntegrationTime * 1000.0, "{:.4f}"),
+                     r.meanNumContacts, r.residentMemory / 1024.0);
+    }
+    os.flush();
+}
+
+
+void writePhaseTime(Mapping* node, const char* key, double time)
+{
+    if(time >= 0.0){
+        node->write(key, time);
+    } else {
+        node->write(key, "n/a");
+    }
+}
+
+
+void putYamlResults(ostream& os, const vector<Result>& results)
+{
+    MappingPtr top = new Mapping;
+    top->write("format", "ChoreonoidSimulationBenchmark");
+    top->write("formatVersion", "1.0");
+    auto resultNodes = top->createListing("results");
+    for(auto& r : results){
+        MappingPtr node = new Mapping;
+        node->write("world", r.worldName);
+        node->write("engine", r.engineName);
+        node->write("isValid", r.isValid);
+        if(r.isValid){
+            node->write("numSteps", r.numSteps);
+            node->write("timeStep", r.timeStep);
+            node->write("loadingTime", r.loadingTime);
+            node->write("initializationTime", r.initializationTime);
+            node->write("stepsPerSecond", r.stepsPerSecond);
+            node->write("realtimeFactor", r.realtimeFactor);
+            node->write("meanStepTime", r.meanStepTime);
+            node->write("percentile99StepTime", r.percentile99StepTime);
+            node->write("maxStepTime", r.maxStepTime);
+            writePhaseTime(node, "meanCollisionDetectionTime", r.meanCollisionDetectionTime);
+            writePhaseTime(node, "meanConstraintSolvingTime", r.meanConstraintSolvingTime);
+            writePhaseTime(node, "meanIntegrationTime", r.meanIntegrationTime);
+            node->write("meanNumContacts", r.meanNumContacts);
+            node->write("maxNumContacts", r.maxNumContacts);
+            node->write("residentMemoryKB", static_cast<int>(r.residentMemory));
+            node->write("peakResidentMemoryKB", static_cast<int>(r.peakResidentMemory));
+        }
+        resultNodes->append(node);
+    }
+    YAMLWriter writer(os);
+    writer.setKeyOrderPreservationMode(true);
+    writer.putNode(top);
+}
+
+
+void putCsvResults(ostream& os, const vector<Result>& results)
+{
+    os << "world,engine,valid,steps,time_step,loading_time,initialization_time,steps_per_second,"
+        "realtime_factor,mean_step_time,p99_step_time,max_step_time,mean_collision_detection_time,"
+        "mean_constraint_solving_time,mean_integration_time,mean_contacts,max_contacts,rss_kb,peak_rss_kb\n";
+    for(auto& r : results){
+        if(!r.isValid){
+            os << format("{},{},0\n", r.worldName, r.engineName);
+            continue;
+        }
+        os << format("{},{},1,{},{},{:.6f},{:.6f},{:.3f},{:.6f},{:.9f},{:.9f},{:.9f},{},{},{},{:.3f},{},{},{}\n",
+                     r.worldName, r.engineName, r.numSteps, r.timeStep, r.loadingTime, r.initializationTime,
+                     r.stepsPerSecond, r.realtimeFactor, r.meanStepTime, r.percentile99StepTime, r.maxStepTime,
+                     formatPhaseTime(r.meanCollisionDetectionTime, "{:.9f}"),
+                     formatPhaseTime(r.meanConstraintSolvingTime, "{:.9f}"),
+                     formatPhaseTime(r.meanIntegrationTime, "{:.9f}"),
+                     r.meanNumContacts, r.maxNumContacts, r.residentMemory, r.peakResidentMemory);
+    }
+    os.flush();
+}
+
+
+bool contains(const vector<string>& names, const string& name)
+{
+    return names.empty() || std::find(names.begin(), names.end(), name) != names.end();
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    string worldFile;
+    vector<string> worldNames;
+    vector<string> engineNames;
+    int numSteps = -1;
+    string collisionDetectorName = "AISTCollisionDetector";
+    string outputFormat = "text";
+    string outputFile;
+    bool isListMode = false;
+
+    for(int i=1; i < argc; ++i){
+        string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if(arg == "--help" || arg == "-h"){
+            cout << usage;
+            return 0;
+        } else if(arg == "--list"){
+            isListMode = true;
+        } else if(arg == "--world" && hasValue){
+            worldNames.push_back(argv[++i]);
+        } else if(arg == "--engine" && hasValue){
+            engineNames.push_back(argv[++i]);
+        } else if(arg == "--steps" && hasValue){
+            const char* value = argv[++i];
+            try {
+                size_t pos;
+                numSteps = std::stoi(value, &pos);
+                if(value[pos] != '\0'){
+                    numSteps = 0;
+                }
+            }
+            catch(const std::exception&){
+                numSteps = 0;
+            }
+            if(numSteps <= 0){
+                cerr << format("Invalid number of steps: {}\n\n", value) << usage;
+                return 1;
+            }
+        } else if(arg == "--collision-detector" && hasValue){
+            collisionDetectorName = argv[++i];
+        } else if(arg == "--format" && hasValue){
+            outputFormat = argv[++i];
+        } else if(arg == "--output" && hasValue){
+            outputFile = argv[++i];
+        } else if(arg.compare(0, 1, "-") != 0 && worldFile.empty()){
+            worldFile = arg;
+        } else {
+            cerr << format("Invalid argument: {}\n\n", arg) << usage;
+            return 1;
+        }
+    }
+
+    if(outputFormat != "text" && outputFormat != "yaml" && outputFormat != "csv"){
+        cerr << format("Unknown output format: {}", outputFormat) << endl;
+        return 1;
+    }
+
+    if(worldFile.empty()){
+        worldFile = (shareDirPath() / "benchmark" / "reference-worlds.yaml").string();
+    }
+    vector<WorldSpec> worlds;
+    if(!readWorldSpecs(worldFile, worlds)){
+        return 1;
+    }
+
+    if(isListMode){
+        cout << "Worlds:\n";
+        for(auto& world : worlds){
+            cout << format("  {} ({} bodies, {} steps)\n", world.name, world.bodies.size(), world.numSteps);
+        }
+        cout << "Engines:\n";
+        for(auto& engine : engines){
+            cout << format("  {}\n", engine.name);
+        }
+        return 0;
+    }
+
+    vector<Result> results;
+    bool failed = false;
+
+    for(auto& world : worlds){
+        if(!contains(worldNames, world.name)){
+            continue;
+        }
+        if(numSteps >= 0){
+            world.numSteps = numSteps;
+        }
+        for(auto& engine : engines){
+            if(!contains(engineNames, engine.name)){
+                continue;
+            }
+            cerr << format("Running {} with {} ...", world.name, engine.name) << endl;
+            Result result;
+            result.worldName = world.name;
+            result.engineName = engine.name;
+            result.isValid = runAISTWorld(world, engine, collisionDetectorName, result);
+            if(!result.isValid){
+                failed = true;
+            }
+            results.push_back(result);
+        }
+    }
+
+    if(results.empty()){
+        cerr << "No world and engine to run." << endl;
+        return 1;
+    }
+
+    ofstream ofs;
+    if(!outputFile.empty()){
+        ofs.open(outputFile);
+        if(!ofs){
+            cerr << format("{} cannot be opened.", outputFile) << endl;
+            return 1;
+        }
+    }
+    ostream& os = outputFile.empty() ? cout : ofs;
+
+    if(outputFormat == "yaml"){
+        putYamlResults(os, results);
+    } else if(outputFormat == "csv"){
+        putCsvResults(os, results);
+    } else {
+        putTextResults(os, results);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,739 @@
+#include "CollisionProxyGenerator.h"
+#include "MeshSimplifier.h"
+#include "MeshExtractor.h"
+#include "MeshGenerator.h"
+#include "SceneDrawables.h"
+#include "SceneFileCache.h"
+#include <unordered_map>
+#include <array>
+#include <map>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const char* proxyTypeSymbols[] = { "none", "simplified", "convexHull", "box", "sphere" };
+
+// Increment this when the algorithms which generate the cached meshes are changed
+const int CacheFormatVersion = 1;
+
+// The proxies of the meshes with fewer triangles are generated without the cache
+const int MinNumTrianglesToCache = 10000;
+
+/**
+   The convex hull of a point set computed by the quickhull algorithm.
+   Each face has the list of the points outside it, and the farthest one is added to the hull
+   by replacing the faces visible from the point with the fan of the faces on the horizon.
+*/
+class ConvexHull
+{
+public:
+    bool compute(const vector<Vector3>& points);
+    SgMesh* createMesh() const;
+
+private:
+    struct Face
+    {
+        std::array<int, 3> v;
+        // The neighbor i is the face sharing the edge from v[i] to v[(i + 1) % 3]
+        std::array<int, 3> neighbors;
+        Vector3 normal;
+        double offset;
+        vector<int> outsidePoints;
+        int visitId;
+        bool isAlive;
+    };
+
+    const vector<Vector3>* points;
+    vector<Face> faces;
+    double eps;
+    int currentVisitId;
+
+    double distance(const Face& face, int pointIndex) const {
+        return face.normal.dot((*points)[pointIndex]) - face.offset;
+    }
+    int addFace(int v0, int v1, int v2);
+    bool findInitialSimplex(std::array<int, 4>& out_vertices);
+    void assignPoint(int pointIndex, const vector<int>& faceIndices);
+    bool addPoint(int faceIndex);
+};
+
+}
+
+namespace cnoid {
+
+class CollisionProxyGenerator::Impl
+{
+public:
+    int proxyType;
+    int minNumTriangles;
+    bool isCacheEnabled;
+    MeshSimplifier simplifier;
+    MeshGenerator meshGenerator;
+    unordered_map<SgMesh*, SgMeshPtr> meshToProxyMap;
+
+    Impl();
+    Impl(const Impl& org);
+    SgNode* generate(SgNode* node);
+    SgNode* generateSimplifiedNode(SgNode* node);
+    SgMesh* getSimplifiedMesh(SgMesh* mesh);
+    bool collectPoints(SgNode* node, vector<Vector3>& out_points, int& out_numTriangles);
+    SgMesh* generateConvexHull(SgNode* node);
+    SgNode* generateBoundingBox(const vector<Vector3>& points);
+    SgNode* generateBoundingSphere(const vector<Vector3>& points);
+    std::unique_ptr<FileCache::Key> makeCacheKey(int type);
+    SgMesh* loadCachedMesh(const FileCache::Key& key);
+    void storeCachedMesh(const FileCache::Key& key, SgMesh* mesh);
+};
+
+}
+
+
+const char* CollisionProxyGenerator::proxyTypeSymbol(int type)
+{
+    if(type >= 0 && type < N_PROXY_TYPES){
+        return proxyTypeSymbols[type];
+    }
+    return "";
+}
+
+
+int CollisionProxyGenerator::findProxyType(const std::string& symbol)
+{
+    for(int i=0; i < N_PROXY_TYPES; ++i){
+        if(symbol == proxyTypeSymbols[i]){
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+CollisionProxyGenerator::CollisionProxyGenerator()
+{
+    impl = new Impl;
+}
+
+
+CollisionProxyGenerator::Impl::Impl()
+{
+    proxyType = NO_PROXY;
+    minNumTriangles = 500;
+    isCacheEnabled = true;
+}
+
+
+CollisionProxyGenerator::CollisionProxyGenerator(const CollisionProxyGenerator& org)
+{
+    impl = new Impl(*org.impl);
+}
+
+
+CollisionProxyGenerator::Impl::Impl(const Impl& org)
+    : simplifier(org.simplifier)
+{
+    proxyType = org.proxyType;
+    minNumTriangles = org.minNumTriangles;
+    isCacheEnabled = org.isCacheEnabled;
+}
+
+
+CollisionProxyGenerator::~CollisionProxyGenerator()
+{
+    delete impl;
+}
+
+
+void CollisionProxyGenerator::setProxyType(int type)
+{
+    impl->proxyType = type;
+}
+
+
+int CollisionProxyGenerator::proxyType() const
+{
+    return impl->proxyType;
+}
+
+
+void CollisionProxyGenerator::setTargetRatio(double ratio)
+{
+    impl->simplifier.setTargetRatio(ratio);
+}
+
+
+double CollisionProxyGenerator::targetRatio() const
+{
+    return impl->simplifier.targetRatio();
+}
+
+
+void CollisionProxyGenerator::setMaxNumTriangles(int n)
+{
+    impl->simplifier.setMaxNumTriangles(n);
+}
+
+
+int CollisionProxyGenerator::maxNumTriangles() const
+{
+    return impl->simplifier.maxNumTriangles();
+}
+
+
+void CollisionProxyGenerator::setMinNumTriangles(int n)
+{
+    impl->minNumTriangles = n;
+}
+
+
+int CollisionProxyGenerator::minNumTriangles() const
+{
+    return impl->minNumTriangles;
+}
+
+
+void CollisionProxyGenerator::setCacheEnabled(bool on)
+{
+    impl->isCacheEnabled = on;
+}
+
+
+bool CollisionProxyGenerator::isCacheEnabled() const
+{
+    return impl->isCacheEnabled;
+}
+
+
+SgNode* CollisionProxyGenerator::generate(SgNode* node)
+{
+    SgNode* proxy = impl->generate(node);
+    impl->meshToProxyMap.clear();
+    return proxy;
+}
+
+
+SgNode* CollisionProxyGenerator::Impl::generate(SgNode* node)
+{
+    if(!node){
+        return nullptr;
+    }
+    if(proxyType == SIMPLIFIED_MESH){
+        return generateSimplifiedNode(node);
+
+    } else if(proxyType == CONVEX_HULL){
+        if(auto hull = generateConvexHull(node)){
+            auto shape = new SgShape;
+            shape->setMesh(hull);
+            return shape;
+        }
+        // The points are on a plane or a line
+        vector<Vector3> points;
+        int numTriangles;
+        if(collectPoints(node, points, numTriangles)){
+            return generateBoundingBox(points);
+        }
+        return nullptr;
+
+    } else if(proxyType == BOUNDING_BOX || proxyType == BOUNDING_SPHERE){
+        vector<Vector3> points;
+        int numTriangles;
+        if(!collectPoints(node, points, numTriangles)){
+            return nullptr;
+        }
+        if(proxyType == BOUNDING_BOX){
+            return generateBoundingBox(points);
+        } else {
+            return generateBoundingSphere(points);
+        }
+    }
+
+    return node;
+}
+
+
+SgNode* CollisionProxyGenerator::Impl::generateSimplifiedNode(SgNode* node)
+{
+    if(auto shape = dynamic_cast<SgShape*>(node)){
+        auto mesh = shape->mesh();
+        if(!mesh){
+            return nullptr;
+        }
+        auto proxyShape = new SgShape;
+        proxyShape->setName(shape->name());
+        proxyShape->setMesh(getSimplifiedMesh(mesh));
+        proxyShape->setMaterial(shape->material());
+        return proxyShape;
+    }
+
+    auto group = dynamic_cast<SgGroup*>(node);
+    if(!group){
+        return nullptr;
+    }
+    SgGroupPtr proxyGroup;
+    if(auto transform = dynamic_cast<SgPosTransform*>(group)){
+        proxyGroup = new SgPosTransform(transform->T());
+    } else if(auto transform = dynamic_cast<SgScaleTransform*>(group)){
+        proxyGroup = new SgScaleTransform(transform->scale());
+    } else if(auto transform = dynamic_cast<SgAffineTransform*>(group)){
+        proxyGroup = new SgAffineTransform(transform->T());
+    } else {
+        proxyGroup = new SgGroup;
+    }
+    proxyGroup->setName(group->name());
+    for(auto& child : *group){
+        if(auto proxyChild = generateSimplifiedNode(child)){
+            proxyGroup->addChild(proxyChild);
+        }
+    }
+    if(proxyGroup->empty()){
+        return nullptr;
+    }
+    return proxyGroup.retn();
+}
+
+
+SgMesh* CollisionProxyGenerator::Impl::getSimplifiedMesh(SgMesh* mesh)
+{
+    auto p = meshToProxyMap.find(mesh);
+    if(p != meshToProxyMap.end()){
+        return p->second;
+    }
+
+    SgMeshPtr proxy;
+    const int numTriangles = mesh->numTriangles();
+    if(mesh->primitiveType() != SgMesh::MESH || numTriangles < minNumTriangles){
+        proxy = mesh;
+    } else {
+        std::unique_ptr<FileCache::Key> key;
+        if(numTriangles >= MinNumTrianglesToCache){
+            key = makeCacheKey(SIMPLIFIED_MESH);
+            if(key){
+                key->add(mesh->vertices()->data(), mesh->vertices()->size() * sizeof(Vector3f));
+                key->add(mesh->triangleVertices());
+                proxy = loadCachedMesh(*key);
+            }
+        }
+        if(!proxy){
+            proxy = simplifier.simplify(mesh);
+            if(!proxy){
+                proxy = mesh;
+            } else if(key){
+                storeCachedMesh(*key, proxy);
+            }
+        }
+    }
+    meshToProxyMap[mesh] = proxy;
+    return proxy;
+}
+
+
+bool CollisionProxyGenerator::Impl::collectPoints
+(SgNode* node, vector<Vector3>& out_points, int& out_numTriangles)
+{
+    out_points.clear();
+    out_numTriangles = 0;
+    MeshExtractor extractor;
+    extractor.extract(
+        node,
+        [&](SgMesh* mesh){
+            if(auto vertices = mesh->vertices()){
+                const Affine3& T = extractor.currentTransform();
+                for(auto& v : *vertices){
+                    out_points.push_back(T * v.cast<double>());
+                }
+                out_numTriangles += mesh->numTriangles();
+            }
+        });
+    return !out_points.empty();
+}
+
+
+SgMesh* CollisionProxyGenerator::generateConvexHull(SgNode* node)
+{
+    return impl->generateConvexHull(node);
+}
+
+
+SgMesh* CollisionProxyGenerator::Impl::generateConvexHull(SgNode* node)
+{
+    vector<Vector3> points;
+    int numTriangles;
+    if(!collectPoints(node, points, numTriangles)){
+        return nullptr;
+    }
+
+    std::unique_ptr<FileCache::Key> key;
+    if(numTriangles >= MinNumTrianglesToCache){
+        key = makeCacheKey(CONVEX_HULL);
+        if(key){
+            key->add(points.data(), points.size() * sizeof(Vector3));
+            if(auto mesh = loadCachedMesh(*key)){
+                return mesh;
+            }
+        }
+    }
+
+    ConvexHull hull;
+    if(!hull.compute(points)){
+        return nullptr;
+    }
+    SgMeshPtr mesh = hull.createMesh();
+    if(key){
+        storeCachedMesh(*key, mesh);
+    }
+    return mesh.retn();
+}
+
+
+SgNode* CollisionProxyGenerator::Impl::generateBoundingBox(const vector<Vector3>& points)
+{
+    Vector3 lower = points.front();
+    Vector3 upper = points.front();
+    for(auto& p : points){
+        lower = lower.cwiseMin(p);
+        upper = upper.cwiseMax(p);
+    }
+    auto shape = new SgShape;
+    shape->setMesh(meshGenerator.generateBox(upper - lower));
+    auto transform = new SgPosTransform;
+    transform->setTranslation((lower + upper) / 2.0);
+    transform->addChild(shape);
+    return transform;
+}
+
+
+SgNode* CollisionProxyGenerator::Impl::generateBoundingSphere(const vector<Vector3>& points)
+{
+    Vector3 lower = points.front();
+    Vector3 upper = points.front();
+    for(auto& p : points){
+        lower = lower.cwiseMin(p);
+        upper = upper.cwiseMax(p);
+    }
+    const Vector3 center = (lower + upper) / 2.0;
+    double maxSquaredDistance = 0.0;
+    for(auto& p : points){
+        maxSquaredDistance = std::max(maxSquaredDistance, (p - center).squaredNorm());
+    }
+    auto shape = new SgShape;
+    shape->setMesh(meshGenerator.generateSphere(sqrt(maxSquaredDistance)));
+    auto transform = new SgPosTransform;
+    transform->setTranslation(center);
+    transform->addChild(shape);
+    return transform;
+}
+
+
+std::unique_ptr<FileCache::Key> CollisionProxyGenerator::Impl::makeCacheKey(int type)
+{
+    if(!isCacheEnabled || !SceneFileCache::instance()->isEnabled()){
+        return nullptr;
+    }
+    std::unique_ptr<FileCache::Key> key(new FileCache::Key("collision-proxy", CacheFormatVersion));
+    key->add(&type, sizeof(type));
+    if(type == SIMPLIFIED_MESH){
+        const double ratio = simplifier.targetRatio();
+        const int maxNumTriangles = simplifier.maxNumTriangles();
+        const double maxError = simplifier.maxError();
+        key->add(&ratio, sizeof(ratio));
+        key->add(&maxNumTriangles, sizeof(maxNumTriangles));
+        key->add(&maxError, sizeof(maxError));
+    }
+    return key;
+}
+
+
+SgMesh* CollisionProxyGenerator::Impl::loadCachedMesh(const FileCache::Key& key)
+{
+    SgNodePtr node = SceneFileCache::instance()->loadScene(key, string());
+    SgMeshPtr mesh;
+    if(auto shape = dynamic_cast<SgShape*>(node.get())){
+        mesh = shape->mesh();
+    }
+    node.reset();
+    return mesh.retn();
+}
+
+
+void CollisionProxyGenerator::Impl::storeCachedMesh(const FileCache::Key& key, SgMesh* mesh)
+{
+    SgShapePtr shape = new SgShape;
+    shape->setMesh(mesh);
+    SceneFileCache::instance()->storeScene(key, shape, string());
+}
+
+
+bool ConvexHull::compute(const vector<Vector3>& points)
+{
+    this->points = &points;
+    faces.clear();
+    currentVisitId = 0;
+
+    if(points.size() < 4){
+        return false;
+    }
+
+    Vector3 maxAbs = Vector3::Zero();
+    for(auto& p : points){
+        maxAbs = maxAbs.cwiseMax(p.cwiseAbs());
+    }
+    // The tolerance of the single precision vertices. The points closer to a face than this
+    // are regarded as being on the face, which avoids the thin faces made from the noise.
+    eps = 3.0 * FLT_EPSILON * (maxAbs.x() + maxAbs.y() + maxAbs.z());
+
+    std::array<int, 4> s = {{ -1, -1, -1, -1 }};
+    if(!findInitialSimplex(s)){
+        return false;
+    }
+
+    const Vector3& p0 = points[s[0]];
+    const Vector3 n = (points[s[1]] - p0).cross(points[s[2]] - p0);
+    if(n.dot(points[s[3]] - p0) > 0.0){
+        std::swap(s[1], s[2]);
+    }
+    addFace(s[0], s[1], s[2]);
+    addFace(s[0], s[3], s[1]);
+    addFace(s[1], s[3], s[2]);
+    addFace(s[0], s[2], s[3]);
+
+    map<pair<int, int>, int> edgeToFaceMap;
+    for(int i=0; i < 4; ++i){
+        auto& v = faces[i].v;
+        for(int j=0; j < 3; ++j){
+            edgeToFaceMap[make_pair(v[j], v[(j + 1) % 3])] = i;
+        }
+    }
+    for(int i=0; i < 4; ++i){
+        auto& face = faces[i];
+        for(int j=0; j < 3; ++j){
+            face.neighbors[j] = edgeToFaceMap[make_pair(face.v[(j + 1) % 3], face.v[j])];
+        }
+    }
+
+    const vector<int> initialFaces = { 0, 1, 2, 3 };
+    const int numPoints = points.size();
+    for(int i=0; i < numPoints; ++i){
+        if(i != s[0] && i != s[1] && i != s[2] && i != s[3]){
+            assignPoint(i, initialFaces);
+        }
+    }
+
+    // The faces added in the loop are appended to the array and processed later in the loop
+    for(size_t i=0; i < faces.size(); ++i){
+        if(faces[i].isAlive && !faces[i].outsidePoints.empty()){
+            if(!addPoint(i)){
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+int ConvexHull::addFace(int v0, int v1, int v2)
+{
+    int index = faces.size();
+    faces.emplace_back();
+    auto& face = faces.back();
+    face.v = { v0, v1, v2 };
+    face.neighbors = { -1, -1, -1 };
+    const Vector3& p0 = (*points)[v0];
+    Vector3 n = ((*points)[v1] - p0).cross((*points)[v2] - p0);
+    double norm = n.norm();
+    if(norm > 0.0){
+        n /= norm;
+    }
+    face.normal = n;
+    face.offset = n.dot(p0);
+    face.visitId = 0;
+    face.isAlive = true;
+    return index;
+}
+
+
+bool ConvexHull::findInitialSimplex(std::array<int, 4>& out_vertices)
+{
+    auto& pts = *points;
+    const int numPoints = pts.size();
+    out_vertices.fill(-1);
+
+    // The most distant pair of the extreme points on the axes
+    int extremes[6] = { 0, 0, 0, 0, 0, 0 };
+    for(int i=1; i < numPoints; ++i){
+        for(int j=0; j < 3; ++j){
+            if(pts[i][j] < pts[extremes[j * 2]][j]){
+                extremes[j * 2] = i;
+            }
+            if(pts[i][j] > pts[extremes[j * 2 + 1]][j]){
+                extremes[j * 2 + 1] = i;
+            }
+        }
+    }
+    double maxDistance = -1.0;
+    for(int i=0; i < 6; ++i){
+        for(int j=i + 1; j < 6; ++j){
+            double d = (pts[extremes[i]] - pts[extremes[j]]).squaredNorm();
+            if(d > maxDistance){
+                maxDistance = d;
+                out_vertices[0] = extremes[i];
+                out_vertices[1] = extremes[j];
+            }
+        }
+    }
+    // The negated comparisons also reject NaN values
+    if(out_vertices[1] < 0 || !(sqrt(maxDistance) > eps)){
+        return false;
+    }
+
+    // The point most distant from the line
+    const Vector3& p0 = pts[out_vertices[0]];
+    const Vector3 u = (pts[out_vertices[1]] - p0).normalized();
+    maxDistance = 0.0;
+    for(int i=0; i < numPoints; ++i){
+        double d = u.cross(pts[i] - p0).squaredNorm();
+        if(d > maxDistance){
+            maxDistance = d;
+            out_vertices[2] = i;
+        }
+    }
+    if(out_vertices[2] < 0 || !(sqrt(maxDistance) > eps)){
+        return false;
+    }
+
+    // The point most distant from the plane
+    const Vector3 n = u.cross(pts[out_vertices[2]] - p0).normalized();
+    maxDistance = 0.0;
+    for(int i=0; i < numPoints; ++i){
+        double d = fabs(n.dot(pts[i] - p0));
+        if(d > maxDistance){
+            maxDistance = d;
+            out_vertices[3] = i;
+        }
+    }
+    return out_vertices[3] >= 0 && maxDistance > eps;
+}
+
+
+void ConvexHull::assignPoint(int pointIndex, const vector<int>& faceIndices)
+{
+    for(auto& faceIndex : faceIndices){
+        auto& face = faces[faceIndex];
+        if(distance(face, pointIndex) > eps){
+            face.outsidePoints.push_back(pointIndex);
+            return;
+        }
+    }
+}
+
+
+bool ConvexHull::addPoint(int faceIndex)
+{
+    int eyePoint = -1;
+    double maxDistance = -1.0;
+    for(auto& p : faces[faceIndex].outsidePoints){
+        double d = distance(faces[faceIndex], p);
+        if(d > maxDistance){
+            maxDistance = d;
+            eyePoint = p;
+        }
+    }
+
+    // Find the faces visible from the eye point and the edges on the horizon
+    ++currentVisitId;
+    vector<int> visibleFaces;
+    vector<pair<int, int>> horizon; // The face and the index of the edge
+    vector<int> stack = { faceIndex };
+    faces[faceIndex].visitId = currentVisitId;
+    while(!stack.empty()){
+        int f = stack.back();
+        stack.pop_back();
+        visibleFaces.push_back(f);
+        for(int i=0; i < 3; ++i){
+            int neighbor = faces[f].neighbors[i];
+            auto& neighborFace = faces[neighbor];
+            if(neighborFace.visitId == currentVisitId){
+                continue;
+            }
+            if(distance(neighborFace, eyePoint) > eps){
+                neighborFace.visitId = currentVisitId;
+                stack.push_back(neighbor);
+            } else {
+                horizon.emplace_back(f, i);
+            }
+        }
+    }
+
+    for(auto& f : visibleFaces){
+        faces[f].isAlive = false;
+    }
+
+    // Make the cone of the new faces from the horizon to the eye point
+    vector<int> newFaces;
+    unordered_map<int, int> startVertexToNewFaceMap;
+    for(auto& edge : horizon){
+        const int a = faces[edge.first].v[edge.second];
+        const int b = faces[edge.first].v[(edge.second + 1) % 3];
+        const int neighbor = faces[edge.first].neighbors[edge.second];
+        int newFace = addFace(a, b, eyePoint);
+        faces[newFace].neighbors[0] = neighbor;
+        auto& neighborFace = faces[neighbor];
+        for(int i=0; i < 3; ++i){
+            if(neighborFace.v[i] == b && neighborFace.v[(i + 1) % 3] == a){
+                neighborFace.neighbors[i] = newFace;
+                break;
+            }
+        }
+        if(!startVertexToNewFaceMap.emplace(a, newFace).second){
+            // The horizon is not a simple loop due to the numerical error
+            return false;
+        }
+        newFaces.push_back(newFace);
+    }
+    for(auto& f : newFaces){
+        auto& face = faces[f];
+        auto p = startVertexToNewFaceMap.find(face.v[1]);
+        if(p == startVertexToNewFaceMap.end()){
+            return false;
+        }
+        face.neighbors[1] = p->second;
+        faces[p->second].neighbors[2] = f;
+    }
+
+    for(auto& f : visibleFaces){
+        vector<int> outsidePoints;
+        outsidePoints.swap(faces[f].outsidePoints);
+        for(auto& p : outsidePoints){
+            if(p != eyePoint){
+                assignPoint(p, newFaces);
+            }
+        }
+    }
+
+    return true;
+}
+
+
+SgMesh* ConvexHull::createMesh() const
+{
+    auto mesh = new SgMesh;
+    auto vertices = mesh->getOrCreateVertices();
+    auto& triangles = mesh->triangleVertices();
+    unordered_map<int, int> pointToVertexMap;
+    for(auto& face : faces){
+        if(face.isAlive){
+            for(int i=0; i < 3; ++i){
+                auto inserted = pointToVertexMap.emplace(face.v[i], vertices->size());
+                if(inserted.second){
+                    vertices->push_back((*points)[face.v[i]].cast<float>());
+                }
+                triangles.push_back(inserted.first->second);
+            }
+        }
+    }
+    mesh->updateBoundingBox();
+    return mesh;
+}
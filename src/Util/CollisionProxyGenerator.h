@@ -0,0 +1,82 @@
+#ifndef CNOID_UTIL_COLLISION_PROXY_GENERATOR_H
+#define CNOID_UTIL_COLLISION_PROXY_GENERATOR_H
+
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgNode;
+class SgMesh;
+
+/**
+   This class generates the lightweight shapes used for the collision detection from
+   the detailed shapes such as the visual shapes converted from CAD models.
+
+   - SIMPLIFIED_MESH: Each mesh is simplified by MeshSimplifier. The scene structure is kept.
+   - CONVEX_HULL: The convex hull of all the vertices of the scene
+   - BOUNDING_BOX: The axis-aligned bounding box of the scene as a box primitive
+   - BOUNDING_SPHERE: A sphere primitive enclosing the scene
+
+   When the scene cache (SceneFileCache) is enabled, the simplified meshes and the convex hulls
+   of the large meshes are stored in it so that they are not generated again when the same
+   model is loaded.
+*/
+class CNOID_EXPORT CollisionProxyGenerator
+{
+public:
+    enum ProxyType {
+        NO_PROXY,
+        SIMPLIFIED_MESH,
+        CONVEX_HULL,
+        BOUNDING_BOX,
+        BOUNDING_SPHERE,
+        N_PROXY_TYPES
+    };
+
+    //! The symbols used in the model files: "none", "simplified", "convexHull", "box" and "sphere"
+    static const char* proxyTypeSymbol(int type);
+    //! \return -1 if the symbol is unknown
+    static int findProxyType(const std::string& symbol);
+
+    CollisionProxyGenerator();
+    CollisionProxyGenerator(const CollisionProxyGenerator& org);
+    ~CollisionProxyGenerator();
+
+    CollisionProxyGenerator& operator=(const CollisionProxyGenerator&) = delete;
+
+    void setProxyType(int type);
+    int proxyType() const;
+
+    //! The ratio of the number of the triangles of a simplified mesh to that of the original mesh
+    void setTargetRatio(double ratio);
+    double targetRatio() const;
+
+    //! The maximum number of the triangles of a simplified mesh. Zero means no limit.
+    void setMaxNumTriangles(int n);
+    int maxNumTriangles() const;
+
+    //! The meshes with fewer triangles than this number are not simplified
+    void setMinNumTriangles(int n);
+    int minNumTriangles() const;
+
+    void setCacheEnabled(bool on);
+    bool isCacheEnabled() const;
+
+    /**
+       \return The proxy node, which is the given node itself if the proxy type is NO_PROXY,
+       or nullptr if the given node has no mesh
+    */
+    SgNode* generate(SgNode* node);
+
+    //! \return A new mesh or nullptr if the convex hull cannot be made from the vertices
+    SgMesh* generateConvexHull(SgNode* node);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
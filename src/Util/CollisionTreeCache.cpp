@@ -0,0 +1,17 @@
+#include "CollisionTreeCache.h"
+
+using namespace cnoid;
+
+
+CollisionTreeCache* CollisionTreeCache::instance()
+{
+    static CollisionTreeCache cache;
+    return &cache;
+}
+
+
+CollisionTreeCache::CollisionTreeCache()
+    : FileCache("collision-trees", "CNOID_COLLISION_TREE_CACHE_DIR", 2048ull * 1024 * 1024)
+{
+
+}
@@ -0,0 +1,27 @@
+#ifndef CNOID_UTIL_COLLISION_TREE_CACHE_H
+#define CNOID_UTIL_COLLISION_TREE_CACHE_H
+
+#include "FileCache.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   The cache of the bounding volume hierarchies built by collision detectors.
+   The key should be made from the tree type and the vertices and the triangles of the mesh.
+
+   The default directory is "choreonoid/collision-trees" in the user cache directory,
+   which can be changed by the CNOID_COLLISION_TREE_CACHE_DIR environment variable.
+*/
+class CNOID_EXPORT CollisionTreeCache : public FileCache
+{
+public:
+    static CollisionTreeCache* instance();
+
+private:
+    CollisionTreeCache();
+};
+
+}
+
+#endif
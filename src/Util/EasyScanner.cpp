@@ -14,6 +14,11 @@
 #include <iostream>
 #include <fmt/format.h>
 #include <errno.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "gettext.h"
 
 using namespace std;
@@ -58,6 +63,7 @@ void EasyScanner::init()
     textBuf = 0;
     size = 0;
     textBufEnd = 0;
+    isTextMapped = false;
     lineNumber = 0;
     lineNumberOffset = 1;
     
@@ -90,6 +96,7 @@ EasyScanner::EasyScanner(const EasyScanner& org, bool copyText) :
     lineNumberOffset = org.lineNumberOffset;
 
     symbols = org.symbols;
+    isTextMapped = false;
 
     if(copyText && org.textBuf){
         size = org.size;
@@ -108,7 +115,7 @@ EasyScanner::EasyScanner(const EasyScanner& org, bool copyText) :
 /*! This function directly sets a text in the main memory */
 void EasyScanner::setText(const char* text, size_t len)
 {
-    if(textBuf) delete[] textBuf;
+    releaseText();
 
     size = len;
     textBuf = new char[size + 1];
@@ -123,7 +130,25 @@ void EasyScanner::setText(const char* text, size_t len)
 
 EasyScanner::~EasyScanner()
 {
-    if(textBuf) delete[] textBuf;
+    releaseText();
+}
+
+
+void EasyScanner::releaseText()
+{
+    if(textBuf){
+#ifndef _WIN32
+        if(isTextMapped){
+            munmap(textBuf, size);
+        } else {
+            delete[] textBuf;
+        }
+#else
+        delete[] textBuf;
+#endif
+        textBuf = 0;
+    }
+    isTextMapped = false;
 }
 
 
@@ -225,13 +250,37 @@ void EasyScanner::loadFile(const string& filename)
 
     this->filename = filename;
 
-    fseek(file, 0, SEEK_END);
-    size = ftell(file);
-    rewind(file);
-    if(textBuf) delete[] textBuf;
-    textBuf = new char[size + 1];
-    size = fread(textBuf, sizeof(char), size, file);
-    textBuf[size] = 0;
+    releaseText();
+
+#ifndef _WIN32
+    /*
+      The file is memory-mapped instead of being copied into a buffer when its size is not a multiple
+      of the page size. In that case the rest of the last page is filled with zeros, which terminate
+      the text.
+    */
+    struct stat status;
+    if(fstat(fileno(file), &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0){
+        const size_t fileSize = status.st_size;
+        if(fileSize % sysconf(_SC_PAGESIZE) != 0){
+            void* mapped = mmap(0, fileSize, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+            if(mapped != MAP_FAILED){
+                madvise(mapped, fileSize, MADV_SEQUENTIAL);
+                textBuf = static_cast<char*>(mapped);
+                size = fileSize;
+                isTextMapped = true;
+            }
+        }
+    }
+#endif
+
+    if(!isTextMapped){
+        fseek(file, 0, SEEK_END);
+        size = ftell(file);
+        rewind(file);
+        textBuf = new char[size + 1];
+        size = fread(textBuf, sizeof(char), size, file);
+        textBuf[size] = 0;
+    }
     fclose(file);
     text = textBuf;
     textBufEnd = textBuf + size;
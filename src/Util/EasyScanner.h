@@ -258,10 +258,12 @@ private:
     bool readLF0();
     bool readWord0();
     bool readString0(const int delimiterChar);
+    void releaseText();
     
     char* textBuf;
     size_t size;
     char* textBufEnd;
+    bool isTextMapped;
     int lineNumberOffset;
     int commentChar;
     int quoteChar;
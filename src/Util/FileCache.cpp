@@ -0,0 +1,542 @@
+#include "FileCache.h"
+#include "UTF8.h"
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <ctime>
+#include <cstring>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const char Magic[4] = { 'C', 'N', 'T', 'C' };
+
+//! The version of the file layout including the header
+const uint32_t FileFormatVersion = 1;
+
+// Files are removed until the total size becomes smaller than this ratio of the limit
+const double RemovalTargetRatio = 0.8;
+
+struct FileHeader
+{
+    char magic[4];
+    uint32_t fileFormatVersion;
+    uint64_t dataSize;
+    uint64_t checksum;
+};
+
+inline uint64_t rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+const uint64_t Prime1 = 0x87c37b91114253d5ull;
+const uint64_t Prime2 = 0x4cf5ad432745937full;
+
+/**
+   Update the two independent 64 bit hash values. The data is processed by words
+   to make the hashing of large meshes fast.
+*/
+void updateHash(uint64_t& h1, uint64_t& h2, const void* data, size_t size)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+    const size_t numWords = size / 8;
+    for(size_t i=0; i < numWords; ++i){
+        uint64_t k;
+        memcpy(&k, bytes + i * 8, 8);
+        h1 ^= rotl(k * Prime1, 31) * Prime2;
+        h1 = rotl(h1, 27) * 5 + 0x52dce729;
+        h2 ^= rotl(k * Prime2, 33) * Prime1;
+        h2 = rotl(h2, 31) * 5 + 0x38495ab5;
+    }
+    uint64_t k = 0;
+    const size_t remainder = size % 8;
+    if(remainder > 0){
+        memcpy(&k, bytes + numWords * 8, remainder);
+        h1 ^= rotl(k * Prime1, 31) * Prime2;
+        h2 ^= rotl(k * Prime2, 33) * Prime1;
+    }
+}
+
+uint64_t calcChecksum(const char* data, size_t size)
+{
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+    updateHash(h1, h2, data, size);
+    return fmix(h1 ^ size);
+}
+
+bool checkHeader(const FileHeader& header)
+{
+    return (memcmp(header.magic, Magic, sizeof(Magic)) == 0 &&
+            header.fileFormatVersion == FileFormatVersion);
+}
+
+string getDefaultDirectory(const string& name)
+{
+    filesystem::path base;
+#ifdef _WIN32
+    if(const char* dir = getenv("LOCALAPPDATA")){
+        base = filesystem::path(fromUTF8(dir));
+    }
+#else
+    if(const char* dir = getenv("XDG_CACHE_HOME")){
+        base = filesystem::path(dir);
+    } else if(const char* home = getenv("HOME")){
+        base = filesystem::path(home) / ".cache";
+    }
+#endif
+    if(base.empty()){
+        return string();
+    }
+    return toUTF8((base / "choreonoid" / name).string());
+}
+
+}
+
+namespace cnoid {
+
+class FileCache::Impl
+{
+public:
+    mutable std::mutex mutex;
+    bool isEnabled;
+    filesystem::path directory;
+    uint64_t maxTotalSize;
+    bool isDirectoryReady;
+    std::atomic<int> tmpFileCounter;
+
+    Impl(const string& name, const string& directoryEnvironmentVariable, uint64_t defaultMaxTotalSize,
+         bool isEnabledByDefault);
+    bool getFilePath(const Key& key, filesystem::path& out_path);
+    void touch(const filesystem::path& path);
+    bool prepareDirectory();
+    void removeOldFiles();
+};
+
+}
+
+
+FileCache::FileCache
+(const std::string& name, const std::string& directoryEnvironmentVariable, uint64_t defaultMaxTotalSize,
+ bool isEnabledByDefault)
+{
+    impl = new Impl(name, directoryEnvironmentVariable, defaultMaxTotalSize, isEnabledByDefault);
+}
+
+
+FileCache::Impl::Impl
+(const string& name, const string& directoryEnvironmentVariable, uint64_t defaultMaxTotalSize,
+ bool isEnabledByDefault)
+    : tmpFileCounter(0)
+{
+    string dir;
+    const char* specifiedDir = getenv(directoryEnvironmentVariable.c_str());
+    if(specifiedDir && *specifiedDir){
+        dir = specifiedDir;
+        isEnabled = true;
+    } else {
+        // The default directory is also used when the cache is enabled by setEnabled()
+        dir = getDefaultDirectory(name);
+        isEnabled = isEnabledByDefault;
+    }
+    if(dir.empty() || dir == "off"){
+        isEnabled = false;
+    } else {
+        directory = filesystem::path(fromUTF8(dir));
+    }
+    maxTotalSize = defaultMaxTotalSize;
+    isDirectoryReady = false;
+}
+
+
+FileCache::~FileCache()
+{
+    delete impl;
+}
+
+
+FileCache::Key::Key(const std::string& dataType, int formatVersion)
+    : dataType(dataType),
+      formatVersion(formatVersion)
+{
+    hash1 = 0x9e3779b97f4a7c15ull;
+    hash2 = 0x6a09e667f3bcc909ull;
+    size = 0;
+    updateHash(hash1, hash2, dataType.data(), dataType.size());
+    updateHash(hash1, hash2, &formatVersion, sizeof(formatVersion));
+}
+
+
+void FileCache::Key::add(const void* data, size_t size)
+{
+    // The size is also hashed so that the boundaries of the data blocks are taken into account
+    uint64_t size64 = size;
+    updateHash(hash1, hash2, &size64, sizeof(size64));
+    updateHash(hash1, hash2, data, size);
+    this->size += size;
+}
+
+
+std::string FileCache::Key::fileName() const
+{
+    return format("{0}-v{1}-{2:016x}{3:016x}.bin",
+                  dataType, formatVersion, fmix(hash1 ^ size), fmix(hash2 ^ size));
+}
+
+
+void FileCache::setEnabled(bool on)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->isEnabled = on && !impl->directory.empty();
+}
+
+
+bool FileCache::isEnabled() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->isEnabled;
+}
+
+
+void FileCache::setDirectory(const std::string& directory)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->directory = filesystem::path(fromUTF8(directory));
+    impl->isDirectoryReady = false;
+    if(directory.empty()){
+        impl->isEnabled = false;
+    }
+}
+
+
+std::string FileCache::directory() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return toUTF8(impl->directory.string());
+}
+
+
+void FileCache::setMaxTotalSize(uint64_t size)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->maxTotalSize = size;
+}
+
+
+uint64_t FileCache::maxTotalSize() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->maxTotalSize;
+}
+
+
+bool FileCache::Impl::prepareDirectory()
+{
+    if(!isDirectoryReady){
+        try {
+            if(!filesystem::exists(directory)){
+                filesystem::create_directories(directory);
+            }
+            isDirectoryReady = filesystem::is_directory(directory);
+        }
+        catch(const std::exception&){
+            isDirectoryReady = false;
+        }
+        if(!isDirectoryReady){
+            // Avoid trying to create the directory every time
+            isEnabled = false;
+        }
+    }
+    return isDirectoryReady;
+}
+
+
+bool FileCache::Impl::getFilePath(const Key& key, filesystem::path& out_path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!isEnabled){
+        return false;
+    }
+    out_path = directory / key.fileName();
+    return true;
+}
+
+
+// Update the time stamp to keep the recently used files in removing old files
+void FileCache::Impl::touch(const filesystem::path& path)
+{
+    try {
+#if __cplusplus > 201402L
+        filesystem::last_write_time(path, filesystem::file_time_type::clock::now());
+#else
+        filesystem::last_write_time(path, std::time(nullptr));
+#endif
+    }
+    catch(const std::exception&){ }
+}
+
+
+bool FileCache::load(const Key& key, std::vector<char>& out_data)
+{
+    filesystem::path path;
+    if(!impl->getFilePath(key, path)){
+        return false;
+    }
+
+    ifstream ifs(path.string().c_str(), ios::in | ios::binary);
+    if(!ifs){
+        return false;
+    }
+    FileHeader header;
+    if(!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) || !checkHeader(header)){
+        return false;
+    }
+    try {
+        if(header.dataSize != filesystem::file_size(path) - sizeof(header)){
+            return false;
+        }
+    }
+    catch(const std::exception&){
+        return false;
+    }
+    out_data.resize(header.dataSize);
+    if(!ifs.read(out_data.data(), header.dataSize) ||
+       calcChecksum(out_data.data(), out_data.size()) != header.checksum){
+        out_data.clear();
+        return false;
+    }
+    ifs.close();
+
+    impl->touch(path);
+
+    return true;
+}
+
+
+FileCache::MappedData::MappedData()
+{
+    mappedAddress = nullptr;
+    mappedSize = 0;
+    data_ = nullptr;
+    size_ = 0;
+}
+
+
+FileCache::MappedData::~MappedData()
+{
+#ifndef _WIN32
+    if(mappedAddress){
+        munmap(mappedAddress, mappedSize);
+    }
+#endif
+}
+
+
+std::unique_ptr<FileCache::MappedData> FileCache::map(const Key& key)
+{
+    std::unique_ptr<MappedData> mapped;
+
+#ifdef _WIN32
+    // The data is read into a buffer instead of mapping the file on Windows
+    std::vector<char> buffer;
+    if(load(key, buffer)){
+        mapped.reset(new MappedData);
+        mapped->buffer.swap(buffer);
+        mapped->data_ = mapped->buffer.data();
+        mapped->size_ = mapped->buffer.size();
+    }
+#else
+    filesystem::path path;
+    if(!impl->getFilePath(key, path)){
+        return mapped;
+    }
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if(fd < 0){
+        return mapped;
+    }
+    struct stat status;
+    void* address = MAP_FAILED;
+    size_t fileSize = 0;
+    if(fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(FileHeader)){
+        fileSize = status.st_size;
+        address = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if(address == MAP_FAILED){
+        return mapped;
+    }
+
+    mapped.reset(new MappedData);
+    mapped->mappedAddress = address;
+    mapped->mappedSize = fileSize;
+
+    FileHeader header;
+    memcpy(&header, address, sizeof(header));
+    const char* data = static_cast<const char*>(address) + sizeof(header);
+    if(!checkHeader(header) || header.dataSize != fileSize - sizeof(header) ||
+       calcChecksum(data, header.dataSize) != header.checksum){
+        mapped.reset();
+        return mapped;
+    }
+    mapped->data_ = data;
+    mapped->size_ = header.dataSize;
+
+    impl->touch(path);
+#endif
+
+    return mapped;
+}
+
+
+bool FileCache::store(const Key& key, const std::vector<char>& data)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+
+    if(!impl->isEnabled || !impl->prepareDirectory()){
+        return false;
+    }
+    if(data.size() + sizeof(FileHeader) > impl->maxTotalSize){
+        return false;
+    }
+
+    auto path = impl->directory / key.fileName();
+
+    /*
+      The data is written to a temporary file first and the file is renamed after writing it
+      so that another process does not read the incomplete file.
+    */
+#ifdef _WIN32
+    int pid = _getpid();
+#else
+    int pid = getpid();
+#endif
+    auto tmpPath = impl->directory / format("{0}.{1}.{2}.tmp", key.fileName(), pid, impl->tmpFileCounter++);
+
+    FileHeader header;
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.fileFormatVersion = FileFormatVersion;
+    header.dataSize = data.size();
+    header.checksum = calcChecksum(data.data(), data.size());
+
+    bool stored = false;
+    {
+        ofstream ofs(tmpPath.string().c_str(), ios::out | ios::binary | ios::trunc);
+        if(ofs){
+            ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            ofs.write(data.data(), data.size());
+            ofs.close();
+            stored = !ofs.fail();
+        }
+    }
+    try {
+        if(stored){
+            filesystem::rename(tmpPath, path);
+        } else if(filesystem::exists(tmpPath)){
+            filesystem::remove(tmpPath);
+        }
+    }
+    catch(const std::exception&){
+        stored = false;
+    }
+
+    if(stored){
+        impl->removeOldFiles();
+    }
+
+    return stored;
+}
+
+
+void FileCache::Impl::removeOldFiles()
+{
+    struct FileInfo {
+        filesystem::path path;
+        std::time_t time;
+        uint64_t size;
+    };
+    vector<FileInfo> files;
+    uint64_t totalSize = 0;
+
+    try {
+        for(filesystem::directory_iterator it(directory), end; it != end; ++it){
+            const auto& path = it->path();
+            if(filesystem::is_regular_file(path) && path.extension().string() == ".bin"){
+                FileInfo info;
+                info.path = path;
+                info.time = filesystem::last_write_time_to_time_t(path);
+                info.size = filesystem::file_size(path);
+                totalSize += info.size;
+                files.push_back(info);
+            }
+        }
+        if(totalSize <= maxTotalSize){
+            return;
+        }
+        std::sort(files.begin(), files.end(),
+                  [](const FileInfo& lhs, const FileInfo& rhs){ return lhs.time < rhs.time; });
+
+        const uint64_t targetSize = maxTotalSize * RemovalTargetRatio;
+        for(auto& file : files){
+            if(totalSize <= targetSize){
+                break;
+            }
+            filesystem::remove(file.path);
+            totalSize -= file.size;
+        }
+    }
+    catch(const std::exception&){ }
+}
+
+
+void FileCache::clear()
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+
+    if(impl->directory.empty()){
+        return;
+    }
+    try {
+        if(!filesystem::is_directory(impl->directory)){
+            return;
+        }
+        vector<filesystem::path> files;
+        for(filesystem::directory_iterator it(impl->directory), end; it != end; ++it){
+            auto ext = it->path().extension().string();
+            if(ext == ".bin" || ext == ".tmp"){
+                files.push_back(it->path());
+            }
+        }
+        for(auto& file : files){
+            filesystem::remove(file);
+        }
+    }
+    catch(const std::exception&){ }
+}
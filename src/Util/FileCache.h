@@ -0,0 +1,113 @@
+#ifndef CNOID_UTIL_FILE_CACHE_H
+#define CNOID_UTIL_FILE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class stores the data generated from some source data in files so that the data
+   can be reused without generating it again when the same source data is given.
+
+   A data is identified by a key, which is the hash of the data type, the format version
+   of the data and the source data. The data is stored as an opaque byte sequence and its
+   layout is defined by the user of the cache. Increment the format version when the layout
+   is changed so that the old files are not used any more. Old files are removed when the
+   total size of the files exceeds the size limit, in the order of the last access time.
+
+   The default directory is "choreonoid/<name>" in the user cache directory. It can be
+   changed by the environment variable given to the constructor, and the cache is disabled
+   when the variable is set to "off". A cache which is disabled by default is enabled when
+   the variable specifies a directory.
+
+   \note The functions are thread-safe. The files can also be shared by multiple processes.
+*/
+class CNOID_EXPORT FileCache
+{
+public:
+    class CNOID_EXPORT Key
+    {
+    public:
+        Key(const std::string& dataType, int formatVersion);
+        void add(const void* data, size_t size);
+        template<class T> void add(const std::vector<T>& data) {
+            add(data.data(), data.size() * sizeof(T));
+        }
+        void add(const std::string& data) { add(data.data(), data.size()); }
+        std::string fileName() const;
+
+    private:
+        std::string dataType;
+        int formatVersion;
+        uint64_t hash1;
+        uint64_t hash2;
+        uint64_t size;
+    };
+
+    //! The data of a file mapped into the memory
+    class CNOID_EXPORT MappedData
+    {
+    public:
+        ~MappedData();
+        const char* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        MappedData();
+        void* mappedAddress;
+        size_t mappedSize;
+        std::vector<char> buffer;
+        const char* data_;
+        size_t size_;
+        friend class FileCache;
+    };
+
+    /**
+       \param name The name of the sub directory in the default cache directory
+       \param directoryEnvironmentVariable The environment variable to specify the directory
+       \param defaultMaxTotalSize The default size limit in bytes
+       \param isEnabledByDefault Whether the cache is enabled when the environment variable is not set
+    */
+    FileCache(const std::string& name, const std::string& directoryEnvironmentVariable,
+              uint64_t defaultMaxTotalSize, bool isEnabledByDefault = true);
+    ~FileCache();
+
+    FileCache(const FileCache&) = delete;
+    FileCache& operator=(const FileCache&) = delete;
+
+    void setEnabled(bool on);
+    bool isEnabled() const;
+
+    void setDirectory(const std::string& directory);
+    std::string directory() const;
+
+    //! \param size The maximum total size of the files in bytes
+    void setMaxTotalSize(uint64_t size);
+    uint64_t maxTotalSize() const;
+
+    bool load(const Key& key, std::vector<char>& out_data);
+
+    /**
+       This function maps the file into the memory instead of reading it into a buffer.
+       \return nullptr if the data is not found
+    */
+    std::unique_ptr<MappedData> map(const Key& key);
+
+    bool store(const Key& key, const std::vector<char>& data);
+
+    //! Remove all the files in the cache directory
+    void clear();
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
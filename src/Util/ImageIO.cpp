@@ -10,6 +10,7 @@
 #include <fmt/format.h>
 #include <boost/algorithm/string/predicate.hpp>
 #include <png.h>
+#include <csetjmp>
 
 extern "C" {
 #define XMD_H
@@ -39,6 +40,35 @@ void throwSaveException(const string& filename, const std::string& description)
     BOOST_THROW_EXCEPTION(exception);
 }
 
+
+/*
+  The default error handler of libjpeg terminates the process. This one returns the control
+  to the point set by setjmp so that the error is reported by an exception.
+*/
+struct JpegErrorManager
+{
+    jpeg_error_mgr pub;
+    jmp_buf jmpBuffer;
+    char message[JMSG_LENGTH_MAX];
+};
+
+
+void exitOnJpegError(j_common_ptr cinfo)
+{
+    auto manager = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+    (*cinfo->err->format_message)(cinfo, manager->message);
+    longjmp(manager->jmpBuffer, 1);
+}
+
+
+jpeg_error_mgr* initializeJpegErrorManager(JpegErrorManager& manager)
+{
+    jpeg_std_error(&manager.pub);
+    manager.pub.error_exit = exitOnJpegError;
+    manager.message[0] = '\0';
+    return &manager.pub;
+}
+
     
 void loadPNG(Image& image, const std::string& filename, bool isUpsideDown)
 {
@@ -250,9 +280,16 @@ void loadJPEG(Image& image, const std::string& filename, bool isUpsideDown)
         throwLoadException(filename, strerror(errno));
     }
     struct jpeg_decompress_struct cinfo;
-    struct jpeg_error_mgr jerr;
+    JpegErrorManager jerr;
+    JSAMPARRAY volatile row_pointers = nullptr;
         
-    cinfo.err = jpeg_std_error(&jerr);
+    cinfo.err = initializeJpegErrorManager(jerr);
+    if(setjmp(jerr.jmpBuffer)){
+        free(row_pointers);
+        jpeg_destroy_decompress(&cinfo);
+        fclose(fp);
+        throwLoadException(filename, jerr.message);
+    }
     jpeg_create_decompress(&cinfo);
     jpeg_stdio_src(&cinfo, fp);
         
@@ -264,7 +301,7 @@ void loadJPEG(Image& image, const std::string& filename, bool isUpsideDown)
     const int h = image.height();
     const int w = image.width();
         
-    JSAMPARRAY row_pointers = (JSAMPARRAY)malloc(sizeof(JSAMPROW) * image.height());
+    row_pointers = (JSAMPARRAY)malloc(sizeof(JSAMPROW) * image.height());
     if(isUpsideDown){
         for(int i = 0; i < h; ++i) { 
             row_pointers[i] = &(pixels[(h - i - 1) * cinfo.output_components * w]);
@@ -278,14 +315,66 @@ void loadJPEG(Image& image, const std::string& filename, bool isUpsideDown)
         jpeg_read_scanlines(&cinfo, row_pointers + cinfo.output_scanline, cinfo.output_height - cinfo.output_scanline);
     }
         
-    free(row_pointers);
     (void)jpeg_finish_decompress(&cinfo);
+    free(row_pointers);
     jpeg_destroy_decompress(&cinfo);
         
     fclose(fp);
 }
 
 
+void saveJPEG(const Image& image, const std::string& filename, bool isUpsideDown)
+{
+    const int nc = image.numComponents();
+    if(nc != 1 && nc != 3){
+        throwSaveException(filename, "The JPEG format does not support the alpha component.");
+    }
+    
+    FILE* fp = fopen(fromUTF8(filename).c_str(), "wb");
+    if(!fp){
+        throwSaveException(filename, strerror(errno));
+    }
+    struct jpeg_compress_struct cinfo;
+    JpegErrorManager jerr;
+
+    cinfo.err = initializeJpegErrorManager(jerr);
+    if(setjmp(jerr.jmpBuffer)){
+        jpeg_destroy_compress(&cinfo);
+        fclose(fp);
+        throwSaveException(filename, jerr.message);
+    }
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, fp);
+
+    cinfo.image_width = image.width();
+    cinfo.image_height = image.height();
+    cinfo.input_components = nc;
+    cinfo.in_color_space = (nc == 3) ? JCS_RGB : JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 90, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    const unsigned char* pixels = image.pixels();
+    const int h = image.height();
+    const int w = image.width();
+    while(cinfo.next_scanline < cinfo.image_height){
+        int row = cinfo.next_scanline;
+        if(isUpsideDown){
+            row = h - row - 1;
+        }
+        JSAMPROW row_pointer = const_cast<unsigned char*>(&pixels[row * nc * w]);
+        jpeg_write_scanlines(&cinfo, &row_pointer, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    if(fclose(fp) != 0){
+        throwSaveException(filename, strerror(errno));
+    }
+}
+
+
 void loadTGA(Image& image, const std::string& filename, bool isUpsideDown)
 {
     FILE* fp = 0;
@@ -375,6 +464,8 @@ void ImageIO::save(const Image& image, const std::string& filename)
 {
     if(iends_with(filename, "png")){
         savePNG(image, filename, isUpsideDown_);
+    } else if(iends_with(filename, "jpg") || iends_with(filename, "jpeg")) {
+        saveJPEG(image, filename, isUpsideDown_);
     } else {
         throwSaveException(filename, "unsupported image format.");
     }
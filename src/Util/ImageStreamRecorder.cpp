@@ -0,0 +1,683 @@
+#include "ImageStreamRecorder.h"
+#include "ImageIO.h"
+#include "Exception.h"
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
+#include <zlib.h>
+#include <fstream>
+#include <sstream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const char* formatExtensions[] = { "png", "jpg", "raw" };
+
+struct Job
+{
+    int streamId;
+    int frame;
+    double time;
+    std::shared_ptr<const Image> image;
+    std::shared_ptr<const ImageStreamRecorder::PointData> points;
+};
+
+struct Stream
+{
+    string name;
+    bool isPointStream;
+    int numFrames;
+    filesystem::path imageDirectory;
+    ofstream indexFile;
+    ofstream rawFile;
+    int64_t rawFileSize;
+    std::mutex mutex;
+};
+
+bool makeDirectory(const filesystem::path& path)
+{
+    if(!filesystem::is_directory(path)){
+        try {
+            filesystem::create_directories(path);
+        }
+        catch(const std::exception&){
+
+        }
+    }
+    return filesystem::is_directory(path);
+}
+
+
+bool compressData(const unsigned char* data, size_t size, vector<unsigned char>& out_buf)
+{
+    uLongf compressedSize = compressBound(size);
+    out_buf.resize(compressedSize);
+    if(compress2(&out_buf.front(), &compressedSize, data, size, Z_BEST_SPEED) != Z_OK){
+        return false;
+    }
+    out_buf.resize(compressedSize);
+    return true;
+}
+
+bool uncompressData(const vector<unsigned char>& buf, unsigned char* out_data, size_t size)
+{
+    uLongf uncompressedSize = size;
+    if(uncompress(out_data, &uncompressedSize, &buf.front(), buf.size()) != Z_OK){
+        return false;
+    }
+    return uncompressedSize == size;
+}
+
+}
+
+namespace cnoid {
+
+class ImageStreamRecorder::Impl
+{
+public:
+    string directory;
+    int imageFormat;
+    int numThreads;
+    int maxQueueSize;
+    bool isBlockingEnabled;
+    bool isActive;
+
+    vector<unique_ptr<Stream>> streams;
+
+    std::deque<Job> queue;
+    std::mutex queueMutex;
+    std::condition_variable jobCondition;
+    std::condition_variable spaceCondition;
+    bool isFinishing;
+    vector<std::thread> workers;
+
+    std::atomic<int> numDroppedFrames;
+    string errorMessage;
+    mutable std::mutex errorMutex;
+
+    Impl();
+    int addStream(const string& name, bool isPointStream);
+    bool start();
+    bool push(Job&& job);
+    void encodingLoop();
+    void encode(Job& job, ImageIO& imageIO, vector<unsigned char>& buf);
+    void writeRawData(Stream* stream, const Job& job, const unsigned char* data, size_t size,
+                      int width, int height, int numComponents, vector<unsigned char>& buf);
+    void putError(const string& message);
+    void finish();
+};
+
+}
+
+
+ImageStreamRecorder::ImageStreamRecorder()
+{
+    impl = new Impl;
+}
+
+
+ImageStreamRecorder::Impl::Impl()
+{
+    imageFormat = PNG_FORMAT;
+    numThreads = 0;
+    maxQueueSize = 16;
+    isBlockingEnabled = true;
+    isActive = false;
+    isFinishing = false;
+    numDroppedFrames = 0;
+}
+
+
+ImageStreamRecorder::~ImageStreamRecorder()
+{
+    impl->finish();
+    delete impl;
+}
+
+
+void ImageStreamRecorder::setDirectory(const std::string& directory)
+{
+    impl->directory = directory;
+}
+
+
+void ImageStreamRecorder::setFormat(int format)
+{
+    if(format >= 0 && format < N_FORMATS){
+        impl->imageFormat = format;
+    }
+}
+
+
+void ImageStreamRecorder::setNumThreads(int n)
+{
+    impl->numThreads = n;
+}
+
+
+void ImageStreamRecorder::setMaxQueueSize(int n)
+{
+    impl->maxQueueSize = std::max(1, n);
+}
+
+
+void ImageStreamRecorder::setBlockingEnabled(bool on)
+{
+    impl->isBlockingEnabled = on;
+}
+
+
+int ImageStreamRecorder::addImageStream(const std::string& name)
+{
+    return impl->addStream(name, false);
+}
+
+
+int ImageStreamRecorder::addPointStream(const std::string& name)
+{
+    return impl->addStream(name, true);
+}
+
+
+int ImageStreamRecorder::Impl::addStream(const string& name, bool isPointStream)
+{
+    if(isActive){
+        return -1;
+    }
+    auto stream = new Stream;
+    stream->name = name;
+    stream->isPointStream = isPointStream;
+    streams.emplace_back(stream);
+    return streams.size() - 1;
+}
+
+
+bool ImageStreamRecorder::start()
+{
+    return impl->start();
+}
+
+
+bool ImageStreamRecorder::Impl::start()
+{
+    if(isActive){
+        return true;
+    }
+
+    errorMessage.clear();
+    numDroppedFrames = 0;
+
+    filesystem::path directoryPath(directory);
+    if(!makeDirectory(directoryPath)){
+        errorMessage = format("Directory \"{0}\" cannot be created.", directory);
+        return false;
+    }
+
+    for(auto& stream : streams){
+        stream->numFrames = 0;
+        stream->rawFileSize = 0;
+        auto indexPath = directoryPath / (stream->name + ".index");
+        stream->indexFile.open(indexPath.string(), ios::out | ios::trunc);
+        if(!stream->indexFile){
+            errorMessage = format("Index file \"{0}\" cannot be created.", indexPath.string());
+            return false;
+        }
+        stream->indexFile << "# frame\ttime\tfile\toffset\tsize\twidth\theight\tcomponents\n";
+
+        if(stream->isPointStream || imageFormat == RAW_FORMAT){
+            auto rawPath = directoryPath / (stream->name + ".raw");
+            stream->rawFile.open(rawPath.string(), ios::out | ios::binary | ios::trunc);
+            if(!stream->rawFile){
+                errorMessage = format("Data file \"{0}\" cannot be created.", rawPath.string());
+                return false;
+            }
+        } else {
+            stream->imageDirectory = directoryPath / stream->name;
+            if(!makeDirectory(stream->imageDirectory)){
+                errorMessage = format("Directory \"{0}\" cannot be created.", stream->imageDirectory.string());
+                return false;
+            }
+        }
+    }
+
+    int n = numThreads;
+    if(n <= 0){
+        n = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    isFinishing = false;
+    for(int i=0; i < n; ++i){
+        workers.emplace_back([this](){ encodingLoop(); });
+    }
+    isActive = true;
+
+    return true;
+}
+
+
+bool ImageStreamRecorder::isActive() const
+{
+    return impl->isActive;
+}
+
+
+bool ImageStreamRecorder::pushImage(int streamId, double time, std::shared_ptr<const Image> image)
+{
+    if(!impl->isActive || streamId < 0 || streamId >= static_cast<int>(impl->streams.size()) || !image){
+        return false;
+    }
+    Job job;
+    job.streamId = streamId;
+    job.time = time;
+    job.image = std::move(image);
+    return impl->push(std::move(job));
+}
+
+
+bool ImageStreamRecorder::pushPoints(int streamId, double time, std::shared_ptr<const PointData> points)
+{
+    if(!impl->isActive || streamId < 0 || streamId >= static_cast<int>(impl->streams.size()) || !points){
+        return false;
+    }
+    Job job;
+    job.streamId = streamId;
+    job.time = time;
+    job.points = std::move(points);
+    return impl->push(std::move(job));
+}
+
+
+bool ImageStreamRecorder::Impl::push(Job&& job)
+{
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if(static_cast<int>(queue.size()) >= maxQueueSize){
+            if(!isBlockingEnabled){
+                ++numDroppedFrames;
+                return false;
+            }
+            spaceCondition.wait(lock, [&](){ return static_cast<int>(queue.size()) < maxQueueSize; });
+        }
+        // The frame number is given in the pushed order
+        job.frame = streams[job.streamId]->numFrames++;
+        queue.push_back(std::move(job));
+    }
+    jobCondition.notify_one();
+    return true;
+}
+
+
+void ImageStreamRecorder::Impl::encodingLoop()
+{
+    ImageIO imageIO;
+    vector<unsigned char> buf;
+
+    while(true){
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            jobCondition.wait(lock, [&](){ return !queue.empty() || isFinishing; });
+            if(queue.empty()){
+                break;
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        spaceCondition.notify_one();
+
+        encode(job, imageIO, buf);
+    }
+}
+
+
+void ImageStreamRecorder::Impl::encode(Job& job, ImageIO& imageIO, vector<unsigned char>& buf)
+{
+    Stream* stream = streams[job.streamId].get();
+
+    if(job.points){
+        auto& points = *job.points;
+        writeRawData(
+            stream, job, reinterpret_cast<const unsigned char*>(points.data()), points.size() * sizeof(Vector3f),
+            points.size(), 1, 3, buf);
+
+    } else if(job.image){
+        auto& image = *job.image;
+        if(image.empty()){
+            return;
+        }
+        if(imageFormat == RAW_FORMAT){
+            writeRawData(
+                stream, job, image.pixels(), image.width() * image.height() * image.numComponents(),
+                image.width(), image.height(), image.numComponents(), buf);
+        } else {
+            auto filename = format("{0:06d}.{1}", job.frame, formatExtensions[imageFormat]);
+            auto path = stream->imageDirectory / filename;
+            try {
+                imageIO.save(image, path.string());
+            }
+            catch(const exception_base& ex){
+                putError(*boost::get_error_info<error_info_message>(ex));
+                return;
+            }
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            stream->indexFile << format("{0}\t{1}\t{2}/{3}\t0\t0\t{4}\t{5}\t{6}\n",
+                                        job.frame, job.time, stream->name, filename,
+                                        image.width(), image.height(), image.numComponents());
+        }
+    }
+}
+
+
+void ImageStreamRecorder::Impl::writeRawData
+(Stream* stream, const Job& job, const unsigned char* data, size_t size,
+ int width, int height, int numComponents, vector<unsigned char>& buf)
+{
+    if(size > 0 && !compressData(data, size, buf)){
+        putError(format("Frame {0} of {1} cannot be compressed.", job.frame, stream->name));
+        return;
+    }
+    if(size == 0){
+        buf.clear();
+    }
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    int64_t offset = stream->rawFileSize;
+    if(!buf.empty()){
+        stream->rawFile.write(reinterpret_cast<const char*>(&buf.front()), buf.size());
+    }
+    if(!stream->rawFile){
+        putError(format("Frame {0} of {1} cannot be written.", job.frame, stream->name));
+        return;
+    }
+    stream->rawFileSize += buf.size();
+    stream->indexFile << format("{0}\t{1}\t{2}.raw\t{3}\t{4}\t{5}\t{6}\t{7}\n",
+                                job.frame, job.time, stream->name, offset, buf.size(),
+                                width, height, numComponents);
+}
+
+
+void ImageStreamRecorder::Impl::putError(const string& message)
+{
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if(errorMessage.empty()){
+        errorMessage = message;
+    }
+}
+
+
+void ImageStreamRecorder::finish()
+{
+    impl->finish();
+}
+
+
+void ImageStreamRecorder::Impl::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        isFinishing = true;
+    }
+    jobCondition.notify_all();
+    for(auto& worker : workers){
+        worker.join();
+    }
+    workers.clear();
+
+    for(auto& stream : streams){
+        if(stream->indexFile.is_open()){
+            stream->indexFile.close();
+        }
+        if(stream->rawFile.is_open()){
+            stream->rawFile.close();
+        }
+    }
+    isActive = false;
+}
+
+
+int ImageStreamRecorder::numDroppedFrames() const
+{
+    return impl->numDroppedFrames;
+}
+
+
+std::string ImageStreamRecorder::errorMessage() const
+{
+    std::lock_guard<std::mutex> lock(impl->errorMutex);
+    return impl->errorMessage;
+}
+
+
+namespace {
+
+struct IndexEntry
+{
+    int frame;
+    double time;
+    string file;
+    int64_t offset;
+    int64_t size;
+    int width;
+    int height;
+    int numComponents;
+};
+
+/*
+  The fields of an index line are separated by tabs because the file names, which contain the
+  stream names made from the body and device names, may contain spaces.
+*/
+bool parseIndexLine(const string& line, IndexEntry& entry)
+{
+    vector<string> fields;
+    size_t pos = 0;
+    while(true){
+        size_t next = line.find('\t', pos);
+        fields.push_back(line.substr(pos, next - pos));
+        if(next == string::npos){
+            break;
+        }
+        pos = next + 1;
+    }
+    if(fields.size() != 8 || fields[2].empty()){
+        return false;
+    }
+    entry.file = fields[2];
+
+    istringstream is(fields[0] + ' ' + fields[1] + ' ' + fields[3] + ' ' + fields[4] + ' ' +
+                     fields[5] + ' ' + fields[6] + ' ' + fields[7]);
+    is >> entry.frame >> entry.time >> entry.offset >> entry.size
+       >> entry.width >> entry.height >> entry.numComponents;
+    if(!is){
+        return false;
+    }
+    is >> std::ws;
+    return is.eof();
+}
+
+}
+
+namespace cnoid {
+
+class ImageStreamReader::Impl
+{
+public:
+    filesystem::path directory;
+    vector<IndexEntry> entries;
+    ifstream rawFile;
+    string rawFilename;
+    vector<unsigned char> buf;
+    string errorMessage;
+
+    bool open(const string& directory, const string& streamName);
+    bool readRawData(const IndexEntry& entry, unsigned char* out_data, size_t size);
+};
+
+}
+
+
+ImageStreamReader::ImageStreamReader()
+{
+    impl = new Impl;
+}
+
+
+ImageStreamReader::~ImageStreamReader()
+{
+    delete impl;
+}
+
+
+bool ImageStreamReader::open(const std::string& directory, const std::string& streamName)
+{
+    return impl->open(directory, streamName);
+}
+
+
+bool ImageStreamReader::Impl::open(const string& directory_, const string& streamName)
+{
+    directory = directory_;
+    entries.clear();
+    rawFile.close();
+    rawFilename.clear();
+    errorMessage.clear();
+
+    auto indexPath = directory / (streamName + ".index");
+    ifstream indexFile(indexPath.string());
+    if(!indexFile){
+        errorMessage = format("Index file \"{0}\" cannot be opened.", indexPath.string());
+        return false;
+    }
+    string line;
+    int lineNumber = 0;
+    while(getline(indexFile, line)){
+        ++lineNumber;
+        if(!line.empty() && line.back() == '\r'){
+            line.pop_back();
+        }
+        if(line.empty() || line[0] == '#'){
+            continue;
+        }
+        IndexEntry entry;
+        if(!parseIndexLine(line, entry)){
+            errorMessage = format("Line {0} of index file \"{1}\" is malformed.", lineNumber, indexPath.string());
+            entries.clear();
+            return false;
+        }
+        entries.push_back(entry);
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const IndexEntry& e1, const IndexEntry& e2){ return e1.frame < e2.frame; });
+    return true;
+}
+
+
+int ImageStreamReader::numFrames() const
+{
+    return impl->entries.size();
+}
+
+
+int ImageStreamReader::frameNumber(int index) const
+{
+    return impl->entries[index].frame;
+}
+
+
+double ImageStreamReader::frameTime(int index) const
+{
+    return impl->entries[index].time;
+}
+
+
+int ImageStreamReader::findFrame(double time) const
+{
+    auto& entries = impl->entries;
+    auto p = std::upper_bound(
+        entries.begin(), entries.end(), time,
+        [](double t, const IndexEntry& entry){ return t < entry.time; });
+    return static_cast<int>(p - entries.begin()) - 1;
+}
+
+
+bool ImageStreamReader::Impl::readRawData(const IndexEntry& entry, unsigned char* out_data, size_t size)
+{
+    if(entry.file != rawFilename){
+        rawFile.close();
+        rawFile.clear();
+        rawFile.open((directory / entry.file).string(), ios::in | ios::binary);
+        if(!rawFile){
+            errorMessage = format("Data file \"{0}\" cannot be opened.", entry.file);
+            rawFilename.clear();
+            return false;
+        }
+        rawFilename = entry.file;
+    }
+    if(size == 0){
+        return true;
+    }
+    buf.resize(entry.size);
+    rawFile.clear();
+    rawFile.seekg(entry.offset);
+    rawFile.read(reinterpret_cast<char*>(buf.data()), entry.size);
+    if(!rawFile || !uncompressData(buf, out_data, size)){
+        errorMessage = format("Frame {0} cannot be read from \"{1}\".", entry.frame, entry.file);
+        return false;
+    }
+    return true;
+}
+
+
+bool ImageStreamReader::readImage(int index, Image& out_image)
+{
+    if(index < 0 || index >= static_cast<int>(impl->entries.size())){
+        return false;
+    }
+    auto& entry = impl->entries[index];
+    auto extension = filesystem::path(entry.file).extension().string();
+    if(extension == ".raw"){
+        out_image.setSize(entry.width, entry.height, entry.numComponents);
+        if(out_image.empty()){
+            return true;
+        }
+        return impl->readRawData(
+            entry, out_image.pixels(), entry.width * entry.height * entry.numComponents);
+    }
+    try {
+        ImageIO imageIO;
+        imageIO.load(out_image, (impl->directory / entry.file).string());
+    }
+    catch(const exception_base& ex){
+        impl->errorMessage = *boost::get_error_info<error_info_message>(ex);
+        return false;
+    }
+    return true;
+}
+
+
+bool ImageStreamReader::readPoints(int index, std::vector<Vector3f>& out_points)
+{
+    if(index < 0 || index >= static_cast<int>(impl->entries.size())){
+        return false;
+    }
+    auto& entry = impl->entries[index];
+    out_points.resize(entry.width);
+    if(out_points.empty()){
+        return true;
+    }
+    return impl->readRawData(
+        entry, reinterpret_cast<unsigned char*>(out_points.data()), out_points.size() * sizeof(Vector3f));
+}
+
+
+const std::string& ImageStreamReader::errorMessage() const
+{
+    return impl->errorMessage;
+}
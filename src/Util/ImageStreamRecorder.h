@@ -0,0 +1,116 @@
+#ifndef CNOID_UTIL_IMAGE_STREAM_RECORDER_H
+#define CNOID_UTIL_IMAGE_STREAM_RECORDER_H
+
+#include "Image.h"
+#include "EigenTypes.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class writes the streams of images and point clouds to files with a pool of encoder threads.
+   The frames are passed to the threads through a bounded queue, so the memory used for the frames
+   waiting to be written is limited by the size of the queue.
+
+   Each stream has an index file "<stream name>.index" in the output directory. A line of the index
+   file has the frame number, the time, the file name, the offset and the size of the data in the file,
+   and the width, the height and the number of the components of the frame, separated by tabs. The images are saved as
+   the PNG or JPEG files in the directory of the stream or appended to the "<stream name>.raw" file
+   after being compressed with the deflate algorithm. The point clouds are always stored in the raw format,
+   where the width is the number of the points. The lines of the index file may not be sorted by the frame
+   number because the frames are encoded in parallel.
+*/
+class CNOID_EXPORT ImageStreamRecorder
+{
+public:
+    typedef std::vector<Vector3f> PointData;
+
+    enum Format { PNG_FORMAT, JPEG_FORMAT, RAW_FORMAT, N_FORMATS };
+
+    ImageStreamRecorder();
+    ~ImageStreamRecorder();
+
+    ImageStreamRecorder(const ImageStreamRecorder&) = delete;
+    ImageStreamRecorder& operator=(const ImageStreamRecorder&) = delete;
+
+    void setDirectory(const std::string& directory);
+    void setFormat(int format);
+
+    //! The number of the encoder threads. Zero means the number of the hardware threads.
+    void setNumThreads(int n);
+
+    //! The maximum number of the frames waiting to be encoded
+    void setMaxQueueSize(int n);
+
+    /**
+       When this is enabled, the push functions wait for the space of the queue if the queue is full.
+       Otherwise the frames which cannot be queued are dropped. This is enabled by default.
+    */
+    void setBlockingEnabled(bool on);
+
+    //! \return The stream id. The streams must be added before calling the start function.
+    int addImageStream(const std::string& name);
+    int addPointStream(const std::string& name);
+
+    bool start();
+    bool isActive() const;
+
+    //! The image is shared with the encoder thread and it must not be modified after this function is called.
+    bool pushImage(int streamId, double time, std::shared_ptr<const Image> image);
+    bool pushPoints(int streamId, double time, std::shared_ptr<const PointData> points);
+
+    //! Wait for all the queued frames to be written and close the files.
+    void finish();
+
+    int numDroppedFrames() const;
+
+    //! The message of the first error that has occurred
+    std::string errorMessage() const;
+
+    class Impl;
+
+private:
+    Impl* impl;
+};
+
+
+/**
+   This class reads the frames of a stream written by ImageStreamRecorder.
+*/
+class CNOID_EXPORT ImageStreamReader
+{
+public:
+    ImageStreamReader();
+    ~ImageStreamReader();
+
+    ImageStreamReader(const ImageStreamReader&) = delete;
+    ImageStreamReader& operator=(const ImageStreamReader&) = delete;
+
+    //! \return false if the index file cannot be opened or it has a malformed line
+    bool open(const std::string& directory, const std::string& streamName);
+
+    //! The frames are sorted by the frame number
+    int numFrames() const;
+    int frameNumber(int index) const;
+    double frameTime(int index) const;
+
+    //! \return The index of the last frame whose time is not greater than the given time, or -1 if there is no such frame
+    int findFrame(double time) const;
+
+    bool readImage(int index, Image& out_image);
+    bool readPoints(int index, std::vector<Vector3f>& out_points);
+
+    const std::string& errorMessage() const;
+
+    class Impl;
+
+private:
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef CNOID_UTIL_LOCK_FREE_RING_BUFFER_H
+#define CNOID_UTIL_LOCK_FREE_RING_BUFFER_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+
+namespace cnoid {
+
+/**
+   A fixed capacity ring buffer for a single producer thread and a single consumer thread.
+
+   The elements are allocated when the capacity is set and they are reused after that,
+   so the producer can write a new element by overwriting the members of an existing
+   element without any memory allocation. Neither the producer nor the consumer blocks
+   the other thread. When the buffer is full, the producer fails to obtain a slot to write
+   and the element should be discarded by the producer.
+
+   \note The capacity must not be changed while the producer or the consumer is using the buffer.
+*/
+template <typename ElementType, typename Allocator = std::allocator<ElementType>>
+class LockFreeRingBuffer
+{
+public:
+    typedef ElementType value_type;
+
+    LockFreeRingBuffer() : head(0), tail(0) { }
+
+    LockFreeRingBuffer(size_t capacity) : head(0), tail(0) {
+        setCapacity(capacity);
+    }
+
+    LockFreeRingBuffer(const LockFreeRingBuffer&) = delete;
+    LockFreeRingBuffer& operator=(const LockFreeRingBuffer&) = delete;
+
+    size_t capacity() const { return elements.empty() ? 0 : elements.size() - 1; }
+
+    //! This function clears the buffer.
+    void setCapacity(size_t capacity) {
+        elements.clear();
+        // One element is kept unused to distinguish the full state from the empty state
+        elements.resize(capacity + 1);
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    //! Use this function to preallocate the members of each element
+    template <class Function>
+    void initializeElements(Function func) {
+        for(auto& element : elements){
+            func(element);
+        }
+    }
+
+    //! This function can only be called from the consumer thread or when the threads are not running.
+    void clear() {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    size_t size() const {
+        const size_t h = head.load(std::memory_order_acquire);
+        const size_t t = tail.load(std::memory_order_acquire);
+        return (h >= t) ? (h - t) : (h + elements.size() - t);
+    }
+
+    /**
+       Producer side function.
+       \return The pointer to the element to write or nullptr if the buffer is full.
+       The written element is published by calling commitWriting().
+    */
+    ElementType* beginWriting() {
+        if(elements.empty()){
+            return nullptr;
+        }
+        const size_t h = head.load(std::memory_order_relaxed);
+        if(next(h) == tail.load(std::memory_order_acquire)){
+            return nullptr;
+        }
+        return &elements[h];
+    }
+
+    //! Producer side function.
+    void commitWriting() {
+        head.store(next(head.load(std::memory_order_relaxed)), std::memory_order_release);
+    }
+
+    /**
+       Consumer side function.
+       \return The pointer to the oldest element or nullptr if the buffer is empty.
+       The element must not be accessed after calling pop().
+    */
+    ElementType* front() {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if(t == head.load(std::memory_order_acquire)){
+            return nullptr;
+        }
+        return &elements[t];
+    }
+
+    //! Consumer side function.
+    void pop() {
+        tail.store(next(tail.load(std::memory_order_relaxed)), std::memory_order_release);
+    }
+
+private:
+    std::vector<ElementType, Allocator> elements;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+
+    size_t next(size_t index) const {
+        ++index;
+        return (index == elements.size()) ? 0 : index;
+    }
+};
+
+}
+
+#endif
@@ -8,9 +8,15 @@
 #include "SceneDrawables.h"
 #include "IdPair.h"
 #include "EigenUtil.h"
+#include "ThreadPool.h"
 #include <unordered_map>
 #include <unordered_set>
 #include <array>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+#include <limits>
 
 using namespace std;
 using namespace cnoid;
@@ -69,6 +75,186 @@ struct EdgeId : public IdPair<int>
         }
     }
 };
+
+
+/**
+   Open addressing hash table whose keys are the integer coordinates of the cells of a uniform grid.
+   Each cell has the head of the linked list of the elements in the cell.
+*/
+class GridCellTable
+{
+public:
+    struct Cell
+    {
+        int64_t x, y, z;
+        int head;
+    };
+
+    void reset(int maxNumCells){
+        size_t capacity = 16;
+        while(capacity < static_cast<size_t>(maxNumCells) * 2){
+            capacity <<= 1;
+        }
+        cells.assign(capacity, Cell{ 0, 0, 0, -1 });
+        mask = capacity - 1;
+    }
+
+    Cell* find(int64_t x, int64_t y, int64_t z){
+        size_t index = hash(x, y, z);
+        while(true){
+            Cell& cell = cells[index];
+            if(cell.head < 0){
+                return nullptr;
+            }
+            if(cell.x == x && cell.y == y && cell.z == z){
+                return &cell;
+            }
+            index = (index + 1) & mask;
+        }
+    }
+
+    //! The head of a new cell is -1
+    Cell& findOrInsert(int64_t x, int64_t y, int64_t z){
+        size_t index = hash(x, y, z);
+        while(true){
+            Cell& cell = cells[index];
+            if(cell.head < 0){
+                cell.x = x;
+                cell.y = y;
+                cell.z = z;
+                return cell;
+            }
+            if(cell.x == x && cell.y == y && cell.z == z){
+                return cell;
+            }
+            index = (index + 1) & mask;
+        }
+    }
+
+private:
+    vector<Cell> cells;
+    size_t mask;
+
+    size_t hash(int64_t x, int64_t y, int64_t z) const {
+        uint64_t h = static_cast<uint64_t>(x) * 0x9e3779b97f4a7c15ULL;
+        h = (h ^ static_cast<uint64_t>(y)) * 0xc2b2ae3d27d4eb4fULL;
+        h = (h ^ static_cast<uint64_t>(z)) * 0x165667b19e3779f9ULL;
+        h ^= h >> 32;
+        return h & mask;
+    }
+};
+
+
+/**
+   \param out_neighborOffset The offset to the adjacent cell which is closer to the value
+*/
+int64_t getCellCoordinate(float x, double cellSize, int64_t& out_neighborOffset)
+{
+    // Non-finite values never match other values, so any cell can be used for them
+    const double limit = 1.0e18;
+    const double q = x / cellSize;
+    const double fq = std::floor(q);
+    if(fq >= -limit && fq <= limit){
+        out_neighborOffset = (q - fq < 0.5) ? -1 : 1;
+        return static_cast<int64_t>(fq);
+    }
+    out_neighborOffset = 0;
+    return fq > limit ? static_cast<int64_t>(limit) : static_cast<int64_t>(-limit);
+}
+
+
+/**
+   Merge the used elements of a vector array into the unique vectors.
+   An element is merged into the first unique vector that is the same as the element.
+   When the tolerance is zero, two vectors are regarded as the same if they satisfy the isApprox function
+   of Eigen. Otherwise they are the same if their distance is not greater than the tolerance.
+   A uniform grid whose cell is twice as large as the maximum distance between the same vectors
+   is used to find the candidates in the eight cells around each element, so the processing time
+   is linear in the number of elements.
+   
+   \param out_indexMap The index of the unique vector of each used element is stored
+*/
+void mergeSameVectors
+(const SgVectorArray<Vector3f>& vectors, const vector<char>& usedFlags, float tolerance,
+ SgVectorArray<Vector3f>& out_uniqueVectors, vector<int>& out_indexMap)
+{
+    const int numVectors = vectors.size();
+    out_indexMap.resize(numVectors);
+
+    double cellSize;
+    if(tolerance > 0.0f){
+        cellSize = tolerance;
+    } else {
+        float maxNorm = 0.0f;
+        for(int i=0; i < numVectors; ++i){
+            if(usedFlags[i]){
+                const float norm = vectors[i].norm();
+                if(norm > maxNorm && std::isfinite(norm)){
+                    maxNorm = norm;
+                }
+            }
+        }
+        cellSize = static_cast<double>(Eigen::NumTraits<float>::dummy_precision()) * maxNorm;
+    }
+    // The margin absorbs the rounding errors in calculating the cell coordinates
+    cellSize *= 2.02;
+    if(!(cellSize > std::numeric_limits<float>::min())){
+        cellSize = 1.0;
+    }
+    const float squaredTolerance = tolerance * tolerance;
+
+    GridCellTable cellTable;
+    cellTable.reset(numVectors);
+    vector<int> nextIndices;
+    nextIndices.reserve(numVectors);
+    
+    for(int i=0; i < numVectors; ++i){
+        if(!usedFlags[i]){
+            continue;
+        }
+        const Vector3f& v = vectors[i];
+        int64_t ox, oy, oz;
+        const int64_t x = getCellCoordinate(v.x(), cellSize, ox);
+        const int64_t y = getCellCoordinate(v.y(), cellSize, oy);
+        const int64_t z = getCellCoordinate(v.z(), cellSize, oz);
+
+        int found = -1;
+        for(int ix = 0; ix < (ox ? 2 : 1); ++ix){
+            for(int iy = 0; iy < (oy ? 2 : 1); ++iy){
+                for(int iz = 0; iz < (oz ? 2 : 1); ++iz){
+                    auto cell = cellTable.find(x + ix * ox, y + iy * oy, z + iz * oz);
+                    if(!cell){
+                        continue;
+                    }
+                    for(int j = cell->head; j >= 0; j = nextIndices[j]){
+                        if(found < 0 || j < found){
+                            const Vector3f& u = out_uniqueVectors[j];
+                            bool isSame;
+                            if(tolerance > 0.0f){
+                                isSame = (v - u).squaredNorm() <= squaredTolerance;
+                            } else {
+                                isSame = v.isApprox(u);
+                            }
+                            if(isSame){
+                                found = j;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        if(found >= 0){
+            out_indexMap[i] = found;
+        } else {
+            const int index = out_uniqueVectors.size();
+            out_uniqueVectors.push_back(v);
+            auto& cell = cellTable.findOrInsert(x, y, z);
+            nextIndices.push_back(cell.head);
+            cell.head = index;
+            out_indexMap[i] = index;
+        }
+    }
+}
     
 }
 
@@ -105,12 +291,25 @@ class MeshFilterImpl
 public:
     unique_ptr<MeshExtractor> meshExtractor;
     vector<Vector3f> faceNormals;
-    vector<vector<int>> facesOfVertexMap;
+
+    /*
+      The faces and the normals of each vertex are stored in the flat arrays.
+      The elements of a vertex start at vertexElementOffsets[vertexIndex], and the capacity for
+      the vertex is the number of the faces sharing the vertex.
+    */
+    vector<int> vertexElementOffsets;
+    vector<int> facesOfVertices;
+    vector<int> numFacesOfVertices;
+    vector<int> normalsOfVertices;
+    vector<int> numNormalsOfVertices;
+    
     unordered_map<EdgeId, vector<int>> facesOfEdgeMap;
-    vector<vector<int>> normalsOfVertexMap;
     float minCreaseAngle;
     float maxCreaseAngle;
+    float vertexMergeDistance;
     bool isNormalOverwritingEnabled;
+    int maxNumThreads;
+    unique_ptr<ThreadPool> threadPool;
 
     MeshFilterImpl();
     MeshFilterImpl(const MeshFilterImpl& org);
@@ -139,6 +338,8 @@ MeshFilterImpl::MeshFilterImpl()
     isNormalOverwritingEnabled = false;
     minCreaseAngle = 0.0f;
     maxCreaseAngle = PI;
+    vertexMergeDistance = 0.0f;
+    maxNumThreads = 1;
 }
 
 
@@ -153,6 +354,8 @@ MeshFilterImpl::MeshFilterImpl(const MeshFilterImpl& org)
     isNormalOverwritingEnabled = org.isNormalOverwritingEnabled;
     minCreaseAngle = org.minCreaseAngle;
     maxCreaseAngle = org.maxCreaseAngle;
+    vertexMergeDistance = org.vertexMergeDistance;
+    maxNumThreads = org.maxNumThreads;
 }
 
 
@@ -162,12 +365,94 @@ MeshFilter::~MeshFilter()
 }
 
 
+/**
+   The callback is called once for each mesh even if the mesh is shared by multiple shapes.
+   When multiple threads are used, the callback must not modify anything other than the given mesh
+   and its arrays. The meshes sharing any array are processed by the same thread in the traversal order.
+*/
 void MeshFilterImpl::forAllMeshes(SgNode* node, function<void(SgMesh* mesh)> callback)
 {
     if(!meshExtractor){
         meshExtractor.reset(new MeshExtractor);
     }
-    meshExtractor->extract(node, callback);
+    vector<SgMesh*> meshes;
+    unordered_set<SgMesh*> extractedMeshes;
+    meshExtractor->extract(
+        node,
+        [&](SgMesh* mesh){
+            if(extractedMeshes.insert(mesh).second){
+                meshes.push_back(mesh);
+            }
+        });
+
+    const int numMeshes = meshes.size();
+    int numThreads = maxNumThreads;
+    if(numThreads <= 0){
+        numThreads = std::max(1u, thread::hardware_concurrency());
+    }
+    numThreads = std::min(numThreads, numMeshes);
+    if(numThreads < 2){
+        for(auto& mesh : meshes){
+            callback(mesh);
+        }
+        return;
+    }
+
+    // Group the meshes sharing the arrays with a union-find structure
+    vector<int> parents(numMeshes);
+    for(int i=0; i < numMeshes; ++i){
+        parents[i] = i;
+    }
+    auto findRoot = [&](int i){
+        while(parents[i] != i){
+            parents[i] = parents[parents[i]];
+            i = parents[i];
+        }
+        return i;
+    };
+    unordered_map<const void*, int> arrayOwners;
+    for(int i=0; i < numMeshes; ++i){
+        SgMesh* mesh = meshes[i];
+        const void* arrays[] = { mesh->vertices(), mesh->normals(), mesh->colors(), mesh->texCoords() };
+        for(auto array : arrays){
+            if(array){
+                auto inserted = arrayOwners.insert(make_pair(array, i));
+                if(!inserted.second){
+                    parents[findRoot(i)] = findRoot(inserted.first->second);
+                }
+            }
+        }
+    }
+    vector<vector<SgMesh*>> meshGroups;
+    vector<int> groupIndices(numMeshes, -1);
+    for(int i=0; i < numMeshes; ++i){
+        int& groupIndex = groupIndices[findRoot(i)];
+        if(groupIndex < 0){
+            groupIndex = meshGroups.size();
+            meshGroups.emplace_back();
+        }
+        meshGroups[groupIndex].push_back(meshes[i]);
+    }
+
+    const int numGroups = meshGroups.size();
+    numThreads = std::min(numThreads, numGroups);
+    std::atomic<int> nextGroupIndex(0);
+    auto processMeshGroups = [&](){
+        int index;
+        while((index = nextGroupIndex++) < numGroups){
+            for(auto& mesh : meshGroups[index]){
+                callback(mesh);
+            }
+        }
+    };
+    if(!threadPool || threadPool->size() < numThreads - 1){
+        threadPool.reset(new ThreadPool(numThreads - 1));
+    }
+    for(int i=1; i < numThreads; ++i){
+        threadPool->start(processMeshGroups);
+    }
+    processMeshGroups();
+    threadPool->wait();
 }
 
 
@@ -232,33 +517,15 @@ void MeshFilterImpl::removeRedundantVertices(SgMesh* mesh)
     const size_t numOrgVertices = pOrgVertices->size();
     SgVertexArray& vertices = *mesh->vertices();
     vertices.clear();
-    vector<int> indexMap(numOrgVertices);
+    vector<int> indexMap;
     auto& triangleVertices = mesh->triangleVertices();
 
-    vector<bool> usedVertexFlags(numOrgVertices, false);
+    vector<char> usedVertexFlags(numOrgVertices, false);
     for(size_t i=0; i < triangleVertices.size(); ++i){
         usedVertexFlags[triangleVertices[i]] = true;
     }
 
-    for(size_t i=0; i < numOrgVertices; ++i){
-        if(!usedVertexFlags[i]){
-            continue;
-        }
-        const auto& vertex = pOrgVertices->at(i);
-        bool found = false;
-        size_t index = 0;
-        while(index < vertices.size()){
-            if(vertex.isApprox(vertices[index])){
-                found = true;
-                break;
-            }
-            ++index;
-        }
-        indexMap[i] = index;
-        if(!found){
-            vertices.push_back(vertex);
-        }
-    }
+    mergeSameVectors(*pOrgVertices, usedVertexFlags, vertexMergeDistance, vertices, indexMap);
     vertices.shrink_to_fit();
 
     if(vertices.size() == numOrgVertices){
@@ -312,50 +579,47 @@ void MeshFilterImpl::removeRedundantFaces(SgMesh* mesh, int reductionMode)
     triangles.clear();
 
     vector<int> validFaceIndices;
-    bool checkValidFaceIndices;
+    bool checkValidFaceIndices = false;
     if(mesh->hasNormals() || mesh->hasColors() || mesh->hasTexCoords()){
         checkValidFaceIndices = true;
         validFaceIndices.reserve(numOrgTriangles);
     }
 
-    if(reductionMode != MeshFilter::KEEP_LAST_OVERLAPPING_FACES){
-        unordered_set<FaceId> existingFaces;
-        existingFaces.reserve(numOrgTriangles);
-        for(int i=0; i < numOrgTriangles; ++i){
-            SgMesh::ConstTriangleRef triangle(&orgTriangles[i*3]);
-            FaceId id;
-            if(reductionMode == MeshFilter::KEEP_OVERLAPPING_FACES_WTIH_DIFFERENT_DIRECTIONS){
-                id = getExactFaceId(triangle);
-            } else {
-                id = getOverlappingFaceId(triangle);
-            }
-            bool inserted = existingFaces.insert(id).second;
-            if(inserted){
-                mesh->newTriangle() = triangle;
-                if(checkValidFaceIndices){
-                    validFaceIndices.push_back(i);
-                }
-            }
+    // Open addressing hash table of the indices of the remaining faces
+    size_t capacity = 16;
+    while(capacity < static_cast<size_t>(numOrgTriangles) * 2){
+        capacity <<= 1;
+    }
+    const size_t mask = capacity - 1;
+    vector<int> faceTable(capacity, -1);
+    vector<FaceId> faceIds;
+    faceIds.reserve(numOrgTriangles);
+    std::hash<FaceId> hashFaceId;
+    
+    for(int i=0; i < numOrgTriangles; ++i){
+        SgMesh::ConstTriangleRef triangle(&orgTriangles[i*3]);
+        FaceId id;
+        if(reductionMode == MeshFilter::KEEP_OVERLAPPING_FACES_WTIH_DIFFERENT_DIRECTIONS){
+            id = getExactFaceId(triangle);
+        } else {
+            id = getOverlappingFaceId(triangle);
         }
-    } else {
-        unordered_map<FaceId, int> existingFaceMap;
-        existingFaceMap.reserve(numOrgTriangles);
-        for(int i=0; i < numOrgTriangles; ++i){
-            SgMesh::ConstTriangleRef triangle(&orgTriangles[i*3]);
-            FaceId id = getOverlappingFaceId(triangle);
-            int faceIndex = mesh->numTriangles();
-            auto inserted = existingFaceMap.insert(make_pair(id, faceIndex));
-            if(inserted.second){
-                mesh->newTriangle() = triangle;
-                if(checkValidFaceIndices){
-                    validFaceIndices.push_back(i);
-                }
-            } else {
-                faceIndex = inserted.first->second;
-                mesh->triangle(faceIndex) = triangle;
-                if(checkValidFaceIndices){
-                    validFaceIndices[faceIndex] = i;
-                }
+        size_t slot = hashFaceId(id) & mask;
+        while(faceTable[slot] >= 0 && faceIds[faceTable[slot]] != id){
+            slot = (slot + 1) & mask;
+        }
+        const int faceIndex = faceTable[slot];
+        if(faceIndex < 0){
+            faceTable[slot] = faceIds.size();
+            faceIds.push_back(id);
+            mesh->newTriangle() = triangle;
+            if(checkValidFaceIndices){
+                validFaceIndices.push_back(i);
+            }
+        } else if(reductionMode == MeshFilter::KEEP_LAST_OVERLAPPING_FACES){
+            mesh->triangle(faceIndex) = triangle;
+            if(checkValidFaceIndices){
+                validFaceIndices[faceIndex] = i;
             }
         }
     }
@@ -413,34 +677,15 @@ void MeshFilterImpl::removeRedundantNormals(SgMesh* mesh)
         }
     }
 
-    vector<bool> usedNormalFlags(numOrgNormals, false);
+    vector<char> usedNormalFlags(numOrgNormals, false);
     for(size_t i=0; i < normalIndices.size(); ++i){
         usedNormalFlags[normalIndices[i]] = true;
     }
 
     SgVertexArray& normals = *mesh->normals();
     normals.clear();
-    vector<int> indexMap(numOrgNormals);
-
-    for(size_t i=0; i< numOrgNormals; ++i){
-        if(!usedNormalFlags[i]){
-            continue;
-        }
-        const auto& normal = pOrgNormals->at(i);
-        bool found = false;
-        size_t index = 0;
-        while(index < normals.size()){
-            if(normal.isApprox(normals[index])){
-                found = true;
-                break;
-            }
-            ++index;
-        }
-        indexMap[i] = index;
-        if(!found){
-            normals.push_back(normal);
-        }
-    }
+    vector<int> indexMap;
+    mergeSameVectors(*pOrgNormals, usedNormalFlags, 0.0f, normals, indexMap);
     normals.shrink_to_fit();
 
     if(normals.size() == numOrgNormals){
@@ -497,6 +742,18 @@ void MeshFilter::setMaxCreaseAngle(float angle)
 }
 
 
+void MeshFilter::setVertexMergeDistance(float distance)
+{
+    impl->vertexMergeDistance = distance;
+}
+
+
+void MeshFilter::setMaxNumThreads(int n)
+{
+    impl->maxNumThreads = n;
+}
+
+
 void MeshFilterImpl::calculateFaceNormals(SgMesh* mesh, bool ignoreZeroNormals)
 {
     const SgVertexArray& vertices = *mesh->vertices();
@@ -526,16 +783,28 @@ void MeshFilterImpl::calculateFaceNormals(SgMesh* mesh, bool ignoreZeroNormals)
 
 void MeshFilterImpl::makeFacesOfVertexMap(SgMesh* mesh, bool removeSameNormalFaces)
 {
-    facesOfVertexMap.clear();
-    facesOfVertexMap.resize(mesh->vertices()->size());
+    const int numVertices = mesh->vertices()->size();
     const int numTriangles = mesh->numTriangles();
+    const auto& triangleVertices = mesh->triangleVertices();
+
+    vertexElementOffsets.assign(numVertices + 1, 0);
+    for(auto& vertexIndex : triangleVertices){
+        ++vertexElementOffsets[vertexIndex + 1];
+    }
+    for(int i=0; i < numVertices; ++i){
+        vertexElementOffsets[i + 1] += vertexElementOffsets[i];
+    }
+    facesOfVertices.resize(triangleVertices.size());
+    numFacesOfVertices.assign(numVertices, 0);
     
     for(int i=0; i < numTriangles; ++i){
         SgMesh::TriangleRef triangle = mesh->triangle(i);
         for(int j=0; j < 3; ++j){
-            auto& faceIndicesOfVertex = facesOfVertexMap[triangle[j]];
+            const int vertexIndex = triangle[j];
+            int* faceIndicesOfVertex = &facesOfVertices[vertexElementOffsets[vertexIndex]];
+            int& numFaces = numFacesOfVertices[vertexIndex];
             if(!removeSameNormalFaces){
-                faceIndicesOfVertex.push_back(i);
+                faceIndicesOfVertex[numFaces++] = i;
             } else {
                 /**
                    \todo Angle between adjacent edges should be taken into account
@@ -543,7 +812,7 @@ void MeshFilterImpl::makeFacesOfVertexMap(SgMesh* mesh, bool removeSameNormalFac
                 */
                 const auto& normal = faceNormals[i];
                 bool isSameNormalFaceFound = false;
-                for(size_t k=0; k < faceIndicesOfVertex.size(); ++k){
+                for(int k=0; k < numFaces; ++k){
                     const auto& adjacentFaceNormal = faceNormals[faceIndicesOfVertex[k]];
                     // the same face is not appended
                     if(adjacentFaceNormal.isApprox(normal, 5.0e-4)){
@@ -552,7 +821,7 @@ void MeshFilterImpl::makeFacesOfVertexMap(SgMesh* mesh, bool removeSameNormalFac
                     }
                 }
                 if(!isSameNormalFaceFound){
-                    faceIndicesOfVertex.push_back(i);
+                    faceIndicesOfVertex[numFaces++] = i;
                 }
             }
         }
@@ -587,8 +856,8 @@ void MeshFilterImpl::setVertexNormals(SgMesh* mesh, float givenCreaseAngle)
     normalIndices.clear();
     normalIndices.reserve(mesh->triangleVertices().size());
 
-    normalsOfVertexMap.clear();
-    normalsOfVertexMap.resize(numVertices);
+    normalsOfVertices.resize(facesOfVertices.size());
+    numNormalsOfVertices.assign(numVertices, 0);
 
     for(int faceIndex=0; faceIndex < numTriangles; ++faceIndex){
 
@@ -597,13 +866,14 @@ void MeshFilterImpl::setVertexNormals(SgMesh* mesh, float givenCreaseAngle)
         for(int i=0; i < 3; ++i){
 
             const int vertexIndex = triangle[i];
-            const auto& faceIndicesOfVertex = facesOfVertexMap[vertexIndex];
+            const int* faceIndicesOfVertex = &facesOfVertices[vertexElementOffsets[vertexIndex]];
+            const int numFacesOfVertex = numFacesOfVertices[vertexIndex];
             const Vector3f& currentFaceNormal = faceNormals[faceIndex];
             Vector3f normal = currentFaceNormal;
             bool normalIsFaceNormal = true;
                 
             // avarage normals of the faces whose crease angle is below the 'creaseAngle' variable
-            for(size_t j=0; j < faceIndicesOfVertex.size(); ++j){
+            for(int j=0; j < numFacesOfVertex; ++j){
                 const int adjacentFaceIndex = faceIndicesOfVertex[j];
                 const Vector3f& adjacentFaceNormal = faceNormals[adjacentFaceIndex];
                 float cosAngle = currentFaceNormal.dot(adjacentFaceNormal)
@@ -625,8 +895,9 @@ void MeshFilterImpl::setVertexNormals(SgMesh* mesh, float givenCreaseAngle)
             
             for(int j=0; j < 3; ++j){
                 const int vertexIndex2 = triangle[j];
-                const vector<int>& normalIndicesOfVertex = normalsOfVertexMap[vertexIndex2];
-                for(size_t k=0; k < normalIndicesOfVertex.size(); ++k){
+                const int* normalIndicesOfVertex = &normalsOfVertices[vertexElementOffsets[vertexIndex2]];
+                const int numNormalsOfVertex = numNormalsOfVertices[vertexIndex2];
+                for(int k=0; k < numNormalsOfVertex; ++k){
                     int index = normalIndicesOfVertex[k];
                     if(normals[index].isApprox(normal)){
                         normalIndex = index;
@@ -637,7 +908,7 @@ void MeshFilterImpl::setVertexNormals(SgMesh* mesh, float givenCreaseAngle)
             if(normalIndex < 0){
                 normalIndex = normals.size();
                 normals.push_back(normal);
-                normalsOfVertexMap[vertexIndex].push_back(normalIndex);
+                normalsOfVertices[vertexElementOffsets[vertexIndex] + numNormalsOfVertices[vertexIndex]++] = normalIndex;
             }
             
     normalIndexFound:
@@ -45,6 +45,21 @@ public:
     void setNormalOverwritingEnabled(bool on);
     void setMinCreaseAngle(float angle);
     void setMaxCreaseAngle(float angle);
+
+    /**
+       Vertices whose distance is not greater than this value are merged by removeRedundantVertices.
+       When the distance is zero, which is the default, vertices are merged if they are approximately equal
+       in the relative precision of the single-precision floating point numbers.
+    */
+    void setVertexMergeDistance(float distance);
+
+    /**
+       The maximum number of the threads used to process the meshes of a scene in the functions taking a scene.
+       Each mesh is processed by a single thread. The default value is one, which processes the meshes in the
+       calling thread. Zero means the number of the hardware threads. The threads are kept by the filter
+       and reused in the following calls.
+    */
+    void setMaxNumThreads(int n);
     
     // Deprecated. Use enableNormalOverwriting()
     void setOverwritingEnabled(bool on);
@@ -0,0 +1,565 @@
+#include "MeshSimplifier.h"
+#include "MeshFilter.h"
+#include "SceneDrawables.h"
+#include <queue>
+#include <array>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// The weight of the planes which keep the boundary edges
+const double BoundaryWeight = 1000.0;
+
+// A collapse is rejected when the normal of a face rotates more than about 78 degrees
+const double MinNormalDotProduct = 0.2;
+
+/**
+   The symmetric 4x4 matrix of the quadric error stored as the upper triangular elements
+*/
+struct Quadric
+{
+    double q[10];
+
+    Quadric() { std::fill(q, q + 10, 0.0); }
+
+    void addPlane(const Vector3d& n, double d, double w){
+        q[0] += w * n.x() * n.x();
+        q[1] += w * n.x() * n.y();
+        q[2] += w * n.x() * n.z();
+        q[3] += w * n.x() * d;
+        q[4] += w * n.y() * n.y();
+        q[5] += w * n.y() * n.z();
+        q[6] += w * n.y() * d;
+        q[7] += w * n.z() * n.z();
+        q[8] += w * n.z() * d;
+        q[9] += w * d * d;
+    }
+
+    Quadric& operator+=(const Quadric& rhs){
+        for(int i=0; i < 10; ++i){
+            q[i] += rhs.q[i];
+        }
+        return *this;
+    }
+
+    double evaluate(const Vector3d& v) const {
+        const double x = v.x(), y = v.y(), z = v.z();
+        return q[0]*x*x + 2.0*q[1]*x*y + 2.0*q[2]*x*z + 2.0*q[3]*x
+            + q[4]*y*y + 2.0*q[5]*y*z + 2.0*q[6]*y
+            + q[7]*z*z + 2.0*q[8]*z + q[9];
+    }
+
+    //! Find the position which minimizes the error
+    bool optimize(Vector3d& out_v) const {
+        Matrix3d A;
+        A << q[0], q[1], q[2],
+             q[1], q[4], q[5],
+             q[2], q[5], q[7];
+        const double det = A.determinant();
+        const double scale = A.cwiseAbs().maxCoeff();
+        if(std::fabs(det) <= 1.0e-12 * scale * scale * scale){
+            return false;
+        }
+        out_v = A.inverse() * Vector3d(-q[3], -q[6], -q[8]);
+        return true;
+    }
+};
+
+struct Candidate
+{
+    double cost;
+    int v1;
+    int v2;
+    int version1;
+    int version2;
+    Vector3d position;
+
+    bool operator<(const Candidate& rhs) const {
+        // The top of the priority queue is the candidate with the minimum cost
+        return cost > rhs.cost;
+    }
+};
+
+}
+
+namespace cnoid {
+
+class MeshSimplifier::Impl
+{
+public:
+    double targetRatio;
+    int maxNumTriangles;
+    double maxError;
+
+    vector<Vector3d> positions;
+    vector<Quadric> quadrics;
+    vector<int> versions;
+    vector<array<int, 3>> faces;
+    vector<char> faceRemovedFlags;
+    vector<vector<int>> facesOfVertices;
+    priority_queue<Candidate> candidates;
+    vector<int> neighbors1;
+    vector<int> neighbors2;
+
+    Impl();
+    Impl(const Impl& org);
+    SgMesh* simplify(SgMesh* mesh);
+    bool initialize(SgMesh* mesh);
+    void initializeQuadrics();
+    void addCandidate(int v1, int v2);
+    void collectNeighbors(int v, vector<int>& out_neighbors);
+    bool isCollapsible(int v1, int v2, const Vector3d& p);
+    bool checkFaceFlips(int v, int other, const Vector3d& p);
+    int collapse(int v1, int v2, const Vector3d& p);
+    SgMesh* createSimplifiedMesh();
+};
+
+}
+
+
+MeshSimplifier::MeshSimplifier()
+{
+    impl = new Impl;
+}
+
+
+MeshSimplifier::Impl::Impl()
+{
+    targetRatio = 0.1;
+    maxNumTriangles = 0;
+    maxError = 0.0;
+}
+
+
+MeshSimplifier::MeshSimplifier(const MeshSimplifier& org)
+{
+    impl = new Impl(*org.impl);
+}
+
+
+MeshSimplifier::Impl::Impl(const Impl& org)
+{
+    targetRatio = org.targetRatio;
+    maxNumTriangles = org.maxNumTriangles;
+    maxError = org.maxError;
+}
+
+
+MeshSimplifier::~MeshSimplifier()
+{
+    delete impl;
+}
+
+
+void MeshSimplifier::setTargetRatio(double ratio)
+{
+    impl->targetRatio = ratio;
+}
+
+
+double MeshSimplifier::targetRatio() const
+{
+    return impl->targetRatio;
+}
+
+
+void MeshSimplifier::setMaxNumTriangles(int n)
+{
+    impl->maxNumTriangles = n;
+}
+
+
+int MeshSimplifier::maxNumTriangles() const
+{
+    return impl->maxNumTriangles;
+}
+
+
+void MeshSimplifier::setMaxError(double error)
+{
+    impl->maxError = error;
+}
+
+
+double MeshSimplifier::maxError() const
+{
+    return impl->maxError;
+}
+
+
+SgMesh* MeshSimplifier::simplify(SgMesh* mesh)
+{
+    return impl->simplify(mesh);
+}
+
+
+SgMesh* MeshSimplifier::Impl::simplify(SgMesh* mesh)
+{
+    if(!initialize(mesh)){
+        return nullptr;
+    }
+
+    int numFaces = faces.size();
+    int targetNumFaces = std::max(0, static_cast<int>(std::ceil(numFaces * targetRatio)));
+    if(maxNumTriangles > 0){
+        targetNumFaces = std::min(targetNumFaces, maxNumTriangles);
+    }
+    const double maxCost = (maxError > 0.0) ? (maxError * maxError) : std::numeric_limits<double>::max();
+
+    while(numFaces > targetNumFaces && !candidates.empty()){
+        Candidate c = candidates.top();
+        candidates.pop();
+        if(versions[c.v1] != c.version1 || versions[c.v2] != c.version2){
+            continue; // outdated
+        }
+        if(c.cost > maxCost){
+            break;
+        }
+        if(!isCollapsible(c.v1, c.v2, c.position)){
+            continue;
+        }
+        numFaces -= collapse(c.v1, c.v2, c.position);
+    }
+
+    SgMesh* simplified = createSimplifiedMesh();
+
+    positions.clear();
+    quadrics.clear();
+    versions.clear();
+    faces.clear();
+    faceRemovedFlags.clear();
+    facesOfVertices.clear();
+    candidates = priority_queue<Candidate>();
+
+    return simplified;
+}
+
+
+bool MeshSimplifier::Impl::initialize(SgMesh* mesh)
+{
+    if(!mesh->hasVertices() || mesh->numTriangles() == 0){
+        return false;
+    }
+
+    // The vertices at the same position are merged so that the faces are connected
+    SgMeshPtr welded = new SgMesh;
+    welded->setVertices(new SgVertexArray(*mesh->vertices()));
+    welded->triangleVertices() = mesh->triangleVertices();
+    MeshFilter().removeRedundantVertices(welded);
+
+    const auto& vertices = *welded->vertices();
+    const int numVertices = vertices.size();
+    positions.resize(numVertices);
+    for(int i=0; i < numVertices; ++i){
+        positions[i] = vertices[i].cast<double>();
+    }
+    quadrics.assign(numVertices, Quadric());
+    versions.assign(numVertices, 0);
+    facesOfVertices.assign(numVertices, vector<int>());
+
+    faces.clear();
+    const int numTriangles = welded->numTriangles();
+    faces.reserve(numTriangles);
+    for(int i=0; i < numTriangles; ++i){
+        auto triangle = welded->triangle(i);
+        if(triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]){
+            continue;
+        }
+        const int faceIndex = faces.size();
+        faces.push_back({ triangle[0], triangle[1], triangle[2] });
+        for(int j=0; j < 3; ++j){
+            facesOfVertices[triangle[j]].push_back(faceIndex);
+        }
+    }
+    faceRemovedFlags.assign(faces.size(), false);
+
+    if(faces.empty()){
+        return false;
+    }
+
+    initializeQuadrics();
+
+    vector<pair<int, int>> edges;
+    edges.reserve(faces.size() * 3);
+    for(auto& face : faces){
+        for(int j=0; j < 3; ++j){
+            const int v1 = face[j];
+            const int v2 = face[(j + 1) % 3];
+            edges.emplace_back(std::min(v1, v2), std::max(v1, v2));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    for(auto& edge : edges){
+        addCandidate(edge.first, edge.second);
+    }
+
+    return true;
+}
+
+
+void MeshSimplifier::Impl::initializeQuadrics()
+{
+    // The edges which belong to only one face are the boundary edges
+    vector<pair<pair<int, int>, int>> edgeFaces;
+    edgeFaces.reserve(faces.size() * 3);
+
+    for(size_t i=0; i < faces.size(); ++i){
+        auto& face = faces[i];
+        const Vector3d& p0 = positions[face[0]];
+        const Vector3d& p1 = positions[face[1]];
+        const Vector3d& p2 = positions[face[2]];
+        Vector3d n = (p1 - p0).cross(p2 - p0);
+        const double norm = n.norm();
+        if(norm > 0.0){
+            n /= norm;
+            const double d = -n.dot(p0);
+            for(int j=0; j < 3; ++j){
+                quadrics[face[j]].addPlane(n, d, 1.0);
+            }
+        }
+        for(int j=0; j < 3; ++j){
+            const int v1 = face[j];
+            const int v2 = face[(j + 1) % 3];
+            edgeFaces.emplace_back(make_pair(std::min(v1, v2), std::max(v1, v2)), i);
+        }
+    }
+
+    std::sort(edgeFaces.begin(), edgeFaces.end());
+    const size_t numEdgeFaces = edgeFaces.size();
+    size_t i = 0;
+    while(i < numEdgeFaces){
+        size_t j = i + 1;
+        while(j < numEdgeFaces && edgeFaces[j].first == edgeFaces[i].first){
+            ++j;
+        }
+        if(j - i == 1){
+            const int v1 = edgeFaces[i].first.first;
+            const int v2 = edgeFaces[i].first.second;
+            auto& face = faces[edgeFaces[i].second];
+            const Vector3d& p0 = positions[face[0]];
+            const Vector3d faceNormal = (positions[face[1]] - p0).cross(positions[face[2]] - p0);
+            const Vector3d edge = positions[v2] - positions[v1];
+            Vector3d n = edge.cross(faceNormal);
+            const double norm = n.norm();
+            if(norm > 0.0){
+                n /= norm;
+                const double d = -n.dot(positions[v1]);
+                quadrics[v1].addPlane(n, d, BoundaryWeight);
+                quadrics[v2].addPlane(n, d, BoundaryWeight);
+            }
+        }
+        i = j;
+    }
+}
+
+
+void MeshSimplifier::Impl::addCandidate(int v1, int v2)
+{
+    Quadric q = quadrics[v1];
+    q += quadrics[v2];
+
+    Candidate c;
+    c.v1 = v1;
+    c.v2 = v2;
+    c.version1 = versions[v1];
+    c.version2 = versions[v2];
+
+    if(q.optimize(c.position)){
+        c.cost = q.evaluate(c.position);
+    } else {
+        const Vector3d& p1 = positions[v1];
+        const Vector3d& p2 = positions[v2];
+        const Vector3d pm = (p1 + p2) * 0.5;
+        const double e1 = q.evaluate(p1);
+        const double e2 = q.evaluate(p2);
+        const double em = q.evaluate(pm);
+        if(e1 <= e2 && e1 <= em){
+            c.position = p1;
+            c.cost = e1;
+        } else if(e2 <= em){
+            c.position = p2;
+            c.cost = e2;
+        } else {
+            c.position = pm;
+            c.cost = em;
+        }
+    }
+    // The rounding error may make the cost slightly negative
+    c.cost = std::max(0.0, c.cost);
+
+    candidates.push(c);
+}
+
+
+void MeshSimplifier::Impl::collectNeighbors(int v, vector<int>& out_neighbors)
+{
+    out_neighbors.clear();
+    for(auto& faceIndex : facesOfVertices[v]){
+        if(!faceRemovedFlags[faceIndex]){
+            for(auto& u : faces[faceIndex]){
+                if(u != v){
+                    out_neighbors.push_back(u);
+                }
+            }
+        }
+    }
+    std::sort(out_neighbors.begin(), out_neighbors.end());
+    out_neighbors.erase(std::unique(out_neighbors.begin(), out_neighbors.end()), out_neighbors.end());
+}
+
+
+bool MeshSimplifier::Impl::isCollapsible(int v1, int v2, const Vector3d& p)
+{
+    // The link condition: the common neighbors must be the opposite vertices of the faces sharing the edge
+    int numSharedFaces = 0;
+    for(auto& faceIndex : facesOfVertices[v1]){
+        if(!faceRemovedFlags[faceIndex]){
+            auto& face = faces[faceIndex];
+            if(face[0] == v2 || face[1] == v2 || face[2] == v2){
+                ++numSharedFaces;
+            }
+        }
+    }
+    if(numSharedFaces == 0){
+        return false;
+    }
+    collectNeighbors(v1, neighbors1);
+    collectNeighbors(v2, neighbors2);
+    int numCommonNeighbors = 0;
+    auto p1 = neighbors1.begin();
+    auto p2 = neighbors2.begin();
+    while(p1 != neighbors1.end() && p2 != neighbors2.end()){
+        if(*p1 < *p2){
+            ++p1;
+        } else if(*p2 < *p1){
+            ++p2;
+        } else {
+            ++numCommonNeighbors;
+            ++p1;
+            ++p2;
+        }
+    }
+    if(numCommonNeighbors != numSharedFaces){
+        return false;
+    }
+
+    return checkFaceFlips(v1, v2, p) && checkFaceFlips(v2, v1, p);
+}
+
+
+/**
+   Check if the faces of vertex v which remain after the collapse are not flipped
+   when the vertex is moved to the position p.
+*/
+bool MeshSimplifier::Impl::checkFaceFlips(int v, int other, const Vector3d& p)
+{
+    for(auto& faceIndex : facesOfVertices[v]){
+        if(faceRemovedFlags[faceIndex]){
+            continue;
+        }
+        auto& face = faces[faceIndex];
+        if(face[0] == other || face[1] == other || face[2] == other){
+            continue;
+        }
+        Vector3d q[3];
+        for(int j=0; j < 3; ++j){
+            q[j] = positions[face[j]];
+        }
+        const Vector3d n0 = (q[1] - q[0]).cross(q[2] - q[0]);
+        for(int j=0; j < 3; ++j){
+            if(face[j] == v){
+                q[j] = p;
+            }
+        }
+        const Vector3d n1 = (q[1] - q[0]).cross(q[2] - q[0]);
+        const double l0 = n0.norm();
+        const double l1 = n1.norm();
+        if(l1 == 0.0){
+            return false;
+        }
+        if(l0 > 0.0 && n0.dot(n1) < MinNormalDotProduct * l0 * l1){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+   Vertex v2 is merged into vertex v1.
+   \return The number of the removed faces
+*/
+int MeshSimplifier::Impl::collapse(int v1, int v2, const Vector3d& p)
+{
+    positions[v1] = p;
+    quadrics[v1] += quadrics[v2];
+    ++versions[v1];
+    ++versions[v2];
+
+    int numRemovedFaces = 0;
+    auto& faces1 = facesOfVertices[v1];
+    for(auto& faceIndex : facesOfVertices[v2]){
+        if(faceRemovedFlags[faceIndex]){
+            continue;
+        }
+        auto& face = faces[faceIndex];
+        if(face[0] == v1 || face[1] == v1 || face[2] == v1){
+            faceRemovedFlags[faceIndex] = true;
+            ++numRemovedFaces;
+        } else {
+            for(auto& v : face){
+                if(v == v2){
+                    v = v1;
+                }
+            }
+            faces1.push_back(faceIndex);
+        }
+    }
+    facesOfVertices[v2].clear();
+    facesOfVertices[v2].shrink_to_fit();
+
+    faces1.erase(
+        std::remove_if(faces1.begin(), faces1.end(), [&](int index){ return faceRemovedFlags[index]; }),
+        faces1.end());
+
+    collectNeighbors(v1, neighbors1);
+    for(auto& neighbor : neighbors1){
+        addCandidate(v1, neighbor);
+    }
+
+    return numRemovedFaces;
+}
+
+
+SgMesh* MeshSimplifier::Impl::createSimplifiedMesh()
+{
+    auto mesh = new SgMesh;
+    auto& vertices = *mesh->getOrCreateVertices();
+    vector<int> indexMap(positions.size(), -1);
+
+    for(size_t i=0; i < faces.size(); ++i){
+        if(faceRemovedFlags[i]){
+            continue;
+        }
+        auto& face = faces[i];
+        int indices[3];
+        for(int j=0; j < 3; ++j){
+            int& index = indexMap[face[j]];
+            if(index < 0){
+                index = vertices.size();
+                vertices.push_back(positions[face[j]].cast<float>());
+            }
+            indices[j] = index;
+        }
+        mesh->addTriangle(indices[0], indices[1], indices[2]);
+    }
+    mesh->updateBoundingBox();
+
+    return mesh;
+}
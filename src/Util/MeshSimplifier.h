@@ -0,0 +1,54 @@
+#ifndef CNOID_UTIL_MESH_SIMPLIFIER_H
+#define CNOID_UTIL_MESH_SIMPLIFIER_H
+
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgMesh;
+
+/**
+   This class reduces the triangles of a mesh by collapsing the edges in the order of the quadric
+   error of the collapsed vertices, which is the sum of the squared distances between the vertex
+   and the planes of the original faces around it. The boundary edges are preserved as much as
+   possible, and the collapses which flip a face or make the mesh non-manifold are not performed.
+
+   The simplified mesh only has the vertices and the triangles, so it is suitable for the collision
+   detection. The normals, the colors and the texture coordinates of the original mesh are discarded.
+*/
+class CNOID_EXPORT MeshSimplifier
+{
+public:
+    MeshSimplifier();
+    MeshSimplifier(const MeshSimplifier& org);
+    ~MeshSimplifier();
+
+    MeshSimplifier& operator=(const MeshSimplifier&) = delete;
+
+    //! The ratio of the number of the triangles of the simplified mesh to that of the original mesh
+    void setTargetRatio(double ratio);
+    double targetRatio() const;
+
+    //! The maximum number of the triangles of the simplified mesh. Zero means no limit.
+    void setMaxNumTriangles(int n);
+    int maxNumTriangles() const;
+
+    /**
+       The simplification stops before the square root of the quadric error of a collapsed vertex
+       exceeds this value even if the number of the triangles does not reach the target.
+       Zero means no limit.
+    */
+    void setMaxError(double error);
+    double maxError() const;
+
+    //! \return A new mesh or nullptr if the given mesh has no triangles
+    SgMesh* simplify(SgMesh* mesh);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
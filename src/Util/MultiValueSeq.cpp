@@ -72,12 +72,7 @@ bool MultiValueSeq::doWriteSeq(YAMLWriter& writer, std::function<void()> additio
             const int n = numFrames();
             const int m = numParts();
             for(int i=0; i < n; ++i){
-                writer.startFlowStyleListing();
-                Frame v = frame(i);
-                for(int j=0; j < m; ++j){
-                    writer.putScalar(v[j]);
-                }
-                writer.endListing();
+                writer.putFlowStyleListing(frame(i).begin(), m);
             }
             writer.endListing();
         });
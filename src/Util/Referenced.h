@@ -92,11 +92,11 @@ protected:
     Referenced() : refCount_(0), weakCounter_(nullptr) { }
     Referenced(const Referenced&) : refCount_(0), weakCounter_(nullptr) { }
 
-    //int refCount() const { return refCount_.load(std::memory_order_relaxed); }
-    int refCount() const { return refCount_.load(); }
-    
 public:
     virtual ~Referenced();
+
+    //int refCount() const { return refCount_.load(std::memory_order_relaxed); }
+    int refCount() const { return refCount_.load(); }
 };
 
     
@@ -0,0 +1,675 @@
+#include "SceneFileCache.h"
+#include "SceneDrawables.h"
+#include "UTF8.h"
+#include <cnoid/stdx/filesystem>
+#include <fstream>
+#include <unordered_map>
+#include <typeinfo>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+//! Increment this when the layout of the stored scene is changed
+const int FormatVersion = 1;
+
+enum ObjectType : uint8_t {
+    ReferenceType, // The object stored before
+    GroupType,
+    PosTransformType,
+    ScaleTransformType,
+    AffineTransformType,
+    ShapeType,
+    MeshType,
+    MaterialType,
+    VectorArrayType,
+    TexCoordArrayType,
+    NullType
+};
+
+// The uri of an object is usually the filename of the loaded file, which is not stored
+enum UriType : uint8_t { EmptyUri, FilenameUri, FilenamePrefixedUri, OtherUri };
+
+class SceneWriter
+{
+public:
+    vector<char>& buf;
+    const string& filename;
+    unordered_map<const SgObject*, uint32_t> objectIdMap;
+
+    SceneWriter(vector<char>& buf, const string& filename)
+        : buf(buf), filename(filename) { }
+
+    template<class T> void write(const T& value) {
+        const size_t pos = buf.size();
+        buf.resize(pos + sizeof(T));
+        memcpy(&buf[pos], &value, sizeof(T));
+    }
+    void writeBytes(const void* data, size_t size) {
+        if(size > 0){
+            const size_t pos = buf.size();
+            buf.resize(pos + size);
+            memcpy(&buf[pos], data, size);
+        }
+    }
+    void writeString(const string& s) {
+        write<uint32_t>(s.size());
+        writeBytes(s.data(), s.size());
+    }
+    void writeIndexArray(const SgIndexArray& indices) {
+        write<uint32_t>(indices.size());
+        writeBytes(indices.data(), indices.size() * sizeof(int));
+    }
+    template<class Array> void writeVectorArray(const Array& array) {
+        write<uint32_t>(array.size());
+        if(!array.empty()){
+            writeBytes(array.data(), array.size() * sizeof(typename Array::value_type));
+        }
+    }
+    bool writeObjectHeader(const SgObject* object, ObjectType type);
+    bool writeNode(SgNode* node);
+    bool writeGroupChildren(SgGroup* group);
+    bool writeMesh(SgMesh* mesh);
+    void writeMaterial(SgMaterial* material);
+    template<class Array> void writeArray(const Array* array, ObjectType type);
+};
+
+class SceneReader
+{
+public:
+    const char* pos;
+    const char* end;
+    const string& filename;
+    vector<SgObjectPtr> objects;
+    bool hasError;
+
+    SceneReader(const char* data, size_t size, const string& filename)
+        : pos(data), end(data + size), filename(filename), hasError(false) { }
+
+    template<class T> T read() {
+        T value;
+        readBytes(&value, sizeof(T));
+        return value;
+    }
+    void readBytes(void* out_data, size_t size) {
+        if(static_cast<size_t>(end - pos) < size){
+            hasError = true;
+            memset(out_data, 0, size);
+        } else {
+            if(size > 0){
+                memcpy(out_data, pos, size);
+            }
+            pos += size;
+        }
+    }
+    bool checkRemainingSize(size_t size) {
+        if(static_cast<size_t>(end - pos) < size){
+            hasError = true;
+        }
+        return !hasError;
+    }
+    string readString() {
+        uint32_t size = read<uint32_t>();
+        string s;
+        if(checkRemainingSize(size)){
+            s.assign(pos, size);
+            pos += size;
+        }
+        return s;
+    }
+    void readIndexArray(SgIndexArray& indices) {
+        uint32_t size = read<uint32_t>();
+        if(checkRemainingSize(size * sizeof(int))){
+            indices.resize(size);
+            readBytes(indices.data(), size * sizeof(int));
+        }
+    }
+    template<class Array> void readVectorArray(Array& array) {
+        uint32_t size = read<uint32_t>();
+        if(checkRemainingSize(size * sizeof(typename Array::value_type))){
+            array.resize(size);
+            if(size > 0){
+                readBytes(array.data(), size * sizeof(typename Array::value_type));
+            }
+        }
+    }
+    void readObjectAttributes(SgObject* object);
+    SgObject* findStoredObject(ObjectType type);
+    SgNode* readNode();
+    void readGroupChildren(SgGroup* group);
+    SgMesh* readMesh();
+    SgMaterial* readMaterial();
+    template<class Array> Array* readArray(ObjectType type);
+};
+
+}
+
+
+SceneFileCache* SceneFileCache::instance()
+{
+    static SceneFileCache cache;
+    return &cache;
+}
+
+
+SceneFileCache::SceneFileCache()
+    : FileCache("scenes", "CNOID_SCENE_CACHE_DIR", 4096ull * 1024 * 1024, false)
+{
+    minFileSize_ = 256 * 1024;
+}
+
+
+void SceneFileCache::setMinFileSize(size_t size)
+{
+    minFileSize_ = size;
+}
+
+
+std::unique_ptr<FileCache::Key> SceneFileCache::makeKey
+(const std::string& filename, const std::string& format, const std::string& loaderOptions)
+{
+    std::unique_ptr<Key> key;
+
+    string path;
+    uint64_t fileSize;
+    int64_t modificationTime;
+    try {
+        auto fpath = filesystem::absolute(filesystem::path(fromUTF8(filename)));
+        fileSize = filesystem::file_size(fpath);
+        modificationTime = filesystem::last_write_time_to_time_t(fpath);
+        path = toUTF8(fpath.string());
+    }
+    catch(const std::exception&){
+        return key;
+    }
+    if(fileSize < minFileSize_){
+        return key;
+    }
+
+    key.reset(new Key("scene-" + format, FormatVersion));
+    key->add(loaderOptions);
+    key->add(path);
+    key->add(&fileSize, sizeof(fileSize));
+    key->add(&modificationTime, sizeof(modificationTime));
+
+    return key;
+}
+
+
+SgNode* SceneFileCache::loadScene(const Key& key, const std::string& filename, bool* out_isFound)
+{
+    if(out_isFound){
+        *out_isFound = false;
+    }
+    auto data = map(key);
+    if(!data){
+        return nullptr;
+    }
+    if(data->size() == 0){
+        // Marked by markUnstorable()
+        if(out_isFound){
+            *out_isFound = true;
+        }
+        return nullptr;
+    }
+    SceneReader reader(data->data(), data->size(), filename);
+    SgNodePtr scene = reader.readNode();
+    if(reader.hasError || reader.pos != reader.end){
+        return nullptr;
+    }
+    reader.objects.clear();
+    if(out_isFound){
+        *out_isFound = true;
+    }
+    return scene.retn();
+}
+
+
+bool SceneFileCache::storeScene(const Key& key, SgNode* scene, const std::string& filename)
+{
+    vector<char> buf;
+    SceneWriter writer(buf, filename);
+    if(!writer.writeNode(scene)){
+        return false;
+    }
+    return store(key, buf);
+}
+
+
+void SceneFileCache::markUnstorable(const Key& key)
+{
+    store(key, vector<char>());
+}
+
+
+bool SceneFileCache::containsKeywords(const std::string& filename, const std::vector<std::string>& keywords)
+{
+    ifstream ifs(fromUTF8(filename).c_str(), ios::in | ios::binary);
+    if(!ifs){
+        return false;
+    }
+    size_t maxKeywordSize = 0;
+    for(auto& keyword : keywords){
+        maxKeywordSize = std::max(maxKeywordSize, keyword.size());
+    }
+    if(maxKeywordSize == 0){
+        return false;
+    }
+
+    // The file is scanned by blocks that overlap so that a keyword across the blocks is found
+    vector<char> buf(std::max(size_t(64 * 1024), maxKeywordSize * 2));
+    size_t overlap = 0;
+    while(true){
+        ifs.read(buf.data() + overlap, buf.size() - overlap);
+        const size_t size = overlap + ifs.gcount();
+        if(size == overlap){
+            break;
+        }
+        for(auto& keyword : keywords){
+            if(std::search(buf.begin(), buf.begin() + size, keyword.begin(), keyword.end()) != buf.begin() + size){
+                return true;
+            }
+        }
+        overlap = std::min(size, maxKeywordSize - 1);
+        std::copy(buf.begin() + (size - overlap), buf.begin() + size, buf.begin());
+    }
+    return false;
+}
+
+
+/**
+   \return false if the object has been written before. The reference to the object is
+   written instead in that case.
+*/
+bool SceneWriter::writeObjectHeader(const SgObject* object, ObjectType type)
+{
+    auto inserted = objectIdMap.insert(make_pair(object, static_cast<uint32_t>(objectIdMap.size())));
+    if(!inserted.second){
+        write(ReferenceType);
+        write(inserted.first->second);
+        return false;
+    }
+
+    write(type);
+    writeString(object->name());
+
+    const string& uri = object->uri();
+    if(uri.empty()){
+        write(EmptyUri);
+    } else if(uri == filename){
+        write(FilenameUri);
+    } else if(uri.compare(0, filename.size(), filename) == 0){
+        write(FilenamePrefixedUri);
+        writeString(uri.substr(filename.size()));
+    } else {
+        write(OtherUri);
+        writeString(uri);
+    }
+    return true;
+}
+
+
+bool SceneWriter::writeNode(SgNode* node)
+{
+    // The exact types are checked because the derived types cannot be restored
+    const type_info& type = typeid(*node);
+
+    if(type == typeid(SgGroup)){
+        if(writeObjectHeader(node, GroupType)){
+            return writeGroupChildren(static_cast<SgGroup*>(node));
+        }
+    } else if(type == typeid(SgPosTransform)){
+        auto transform = static_cast<SgPosTransform*>(node);
+        if(writeObjectHeader(node, PosTransformType)){
+            write(transform->T().matrix());
+            return writeGroupChildren(transform);
+        }
+    } else if(type == typeid(SgScaleTransform)){
+        auto transform = static_cast<SgScaleTransform*>(node);
+        if(writeObjectHeader(node, ScaleTransformType)){
+            write(transform->scale());
+            return writeGroupChildren(transform);
+        }
+    } else if(type == typeid(SgAffineTransform)){
+        auto transform = static_cast<SgAffineTransform*>(node);
+        if(writeObjectHeader(node, AffineTransformType)){
+            write(transform->T().matrix());
+            return writeGroupChildren(transform);
+        }
+    } else if(type == typeid(SgShape)){
+        auto shape = static_cast<SgShape*>(node);
+        if(shape->texture()){
+            return false;
+        }
+        if(writeObjectHeader(node, ShapeType)){
+            if(!writeMesh(shape->mesh())){
+                return false;
+            }
+            writeMaterial(shape->material());
+        }
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+
+bool SceneWriter::writeGroupChildren(SgGroup* group)
+{
+    write<uint32_t>(group->numChildren());
+    for(auto& child : *group){
+        if(!writeNode(child)){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool SceneWriter::writeMesh(SgMesh* mesh)
+{
+    if(!mesh){
+        write(NullType);
+        return true;
+    }
+    if(typeid(*mesh) != typeid(SgMesh)){
+        return false;
+    }
+    if(writeObjectHeader(mesh, MeshType)){
+        writeArray(mesh->vertices(), VectorArrayType);
+        writeArray(mesh->normals(), VectorArrayType);
+        writeIndexArray(mesh->normalIndices());
+        writeArray(mesh->colors(), VectorArrayType);
+        writeIndexArray(mesh->colorIndices());
+        writeArray(mesh->texCoords(), TexCoordArrayType);
+        writeIndexArray(mesh->texCoordIndices());
+        writeIndexArray(mesh->triangleVertices());
+        write(mesh->creaseAngle());
+        write<uint8_t>(mesh->isSolid());
+
+        const int primitiveType = mesh->primitiveType();
+        write<uint8_t>(primitiveType);
+        switch(primitiveType){
+        case SgMesh::BOX:
+            write(mesh->primitive<SgMesh::Box>());
+            break;
+        case SgMesh::SPHERE:
+            write(mesh->primitive<SgMesh::Sphere>());
+            break;
+        case SgMesh::CYLINDER:
+            write(mesh->primitive<SgMesh::Cylinder>());
+            break;
+        case SgMesh::CONE:
+            write(mesh->primitive<SgMesh::Cone>());
+            break;
+        case SgMesh::CAPSULE:
+            write(mesh->primitive<SgMesh::Capsule>());
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+
+void SceneWriter::writeMaterial(SgMaterial* material)
+{
+    if(!material){
+        write(NullType);
+    } else if(writeObjectHeader(material, MaterialType)){
+        write(material->diffuseColor());
+        write(material->emissiveColor());
+        write(material->specularColor());
+        write(material->ambientIntensity());
+        write(material->transparency());
+        write(material->shininess());
+    }
+}
+
+
+template<class Array> void SceneWriter::writeArray(const Array* array, ObjectType type)
+{
+    if(!array){
+        write(NullType);
+    } else if(writeObjectHeader(array, type)){
+        writeVectorArray(*array);
+    }
+}
+
+
+void SceneReader::readObjectAttributes(SgObject* object)
+{
+    objects.push_back(object);
+
+    object->setName(readString());
+
+    switch(read<UriType>()){
+    case FilenameUri:
+        object->setUri(filename);
+        break;
+    case FilenamePrefixedUri:
+        object->setUri(filename + readString());
+        break;
+    case OtherUri:
+        object->setUri(readString());
+        break;
+    default:
+        break;
+    }
+}
+
+
+SgObject* SceneReader::findStoredObject(ObjectType type)
+{
+    uint32_t id = read<uint32_t>();
+    if(id >= objects.size()){
+        hasError = true;
+        return nullptr;
+    }
+    return objects[id];
+}
+
+
+SgNode* SceneReader::readNode()
+{
+    const auto type = read<ObjectType>();
+    if(hasError){
+        return nullptr;
+    }
+
+    SgNode* node = nullptr;
+
+    switch(type){
+    case ReferenceType:
+        node = dynamic_cast<SgNode*>(findStoredObject(type));
+        if(!node){
+            hasError = true;
+        }
+        break;
+
+    case GroupType: {
+        auto group = new SgGroup;
+        readObjectAttributes(group);
+        readGroupChildren(group);
+        node = group;
+        break;
+    }
+    case PosTransformType: {
+        auto transform = new SgPosTransform;
+        readObjectAttributes(transform);
+        transform->T().matrix() = read<Isometry3::MatrixType>();
+        readGroupChildren(transform);
+        node = transform;
+        break;
+    }
+    case ScaleTransformType: {
+        auto transform = new SgScaleTransform;
+        readObjectAttributes(transform);
+        transform->setScale(read<Vector3>());
+        readGroupChildren(transform);
+        node = transform;
+        break;
+    }
+    case AffineTransformType: {
+        auto transform = new SgAffineTransform;
+        readObjectAttributes(transform);
+        transform->T().matrix() = read<Affine3::MatrixType>();
+        readGroupChildren(transform);
+        node = transform;
+        break;
+    }
+    case ShapeType: {
+        auto shape = new SgShape;
+        readObjectAttributes(shape);
+        shape->setMesh(readMesh());
+        shape->setMaterial(readMaterial());
+        node = shape;
+        break;
+    }
+    default:
+        hasError = true;
+        break;
+    }
+
+    return node;
+}
+
+
+void SceneReader::readGroupChildren(SgGroup* group)
+{
+    const uint32_t numChildren = read<uint32_t>();
+    for(uint32_t i=0; i < numChildren && !hasError; ++i){
+        if(auto child = readNode()){
+            group->addChild(child);
+        }
+    }
+}
+
+
+SgMesh* SceneReader::readMesh()
+{
+    const auto type = read<ObjectType>();
+    if(type == NullType || hasError){
+        return nullptr;
+    }
+    if(type == ReferenceType){
+        auto mesh = dynamic_cast<SgMesh*>(findStoredObject(type));
+        if(!mesh){
+            hasError = true;
+        }
+        return mesh;
+    }
+    if(type != MeshType){
+        hasError = true;
+        return nullptr;
+    }
+
+    auto mesh = new SgMesh;
+    readObjectAttributes(mesh);
+    mesh->setVertices(readArray<SgVertexArray>(VectorArrayType));
+    mesh->setNormals(readArray<SgNormalArray>(VectorArrayType));
+    readIndexArray(mesh->normalIndices());
+    mesh->setColors(readArray<SgColorArray>(VectorArrayType));
+    readIndexArray(mesh->colorIndices());
+    mesh->setTexCoords(readArray<SgTexCoordArray>(TexCoordArrayType));
+    readIndexArray(mesh->texCoordIndices());
+    readIndexArray(mesh->triangleVertices());
+    mesh->setCreaseAngle(read<float>());
+    mesh->setSolid(read<uint8_t>());
+
+    switch(read<uint8_t>()){
+    case SgMesh::MESH:
+        break;
+    case SgMesh::BOX:
+        mesh->setPrimitive(read<SgMesh::Box>());
+        break;
+    case SgMesh::SPHERE:
+        mesh->setPrimitive(read<SgMesh::Sphere>());
+        break;
+    case SgMesh::CYLINDER:
+        mesh->setPrimitive(read<SgMesh::Cylinder>());
+        break;
+    case SgMesh::CONE:
+        mesh->setPrimitive(read<SgMesh::Cone>());
+        break;
+    case SgMesh::CAPSULE:
+        mesh->setPrimitive(read<SgMesh::Capsule>());
+        break;
+    default:
+        hasError = true;
+        break;
+    }
+
+    if(!hasError){
+        // The indices are checked so that a broken file does not cause an invalid access
+        const int numVertices = mesh->vertices() ? mesh->vertices()->size() : 0;
+        for(auto& index : mesh->triangleVertices()){
+            if(index < 0 || index >= numVertices){
+                hasError = true;
+                break;
+            }
+        }
+        mesh->updateBoundingBox();
+    }
+
+    return mesh;
+}
+
+
+SgMaterial* SceneReader::readMaterial()
+{
+    const auto type = read<ObjectType>();
+    if(type == NullType || hasError){
+        return nullptr;
+    }
+    if(type == ReferenceType){
+        auto material = dynamic_cast<SgMaterial*>(findStoredObject(type));
+        if(!material){
+            hasError = true;
+        }
+        return material;
+    }
+    if(type != MaterialType){
+        hasError = true;
+        return nullptr;
+    }
+    auto material = new SgMaterial;
+    readObjectAttributes(material);
+    material->setDiffuseColor(read<Vector3f>());
+    material->setEmissiveColor(read<Vector3f>());
+    material->setSpecularColor(read<Vector3f>());
+    material->setAmbientIntensity(read<float>());
+    material->setTransparency(read<float>());
+    material->setShininess(read<float>());
+    return material;
+}
+
+
+template<class Array> Array* SceneReader::readArray(ObjectType type)
+{
+    const auto storedType = read<ObjectType>();
+    if(storedType == NullType || hasError){
+        return nullptr;
+    }
+    if(storedType == ReferenceType){
+        auto array = dynamic_cast<Array*>(findStoredObject(storedType));
+        if(!array){
+            hasError = true;
+        }
+        return array;
+    }
+    if(storedType != type){
+        hasError = true;
+        return nullptr;
+    }
+    auto array = new Array;
+    readObjectAttributes(array);
+    readVectorArray(*array);
+    return array;
+}
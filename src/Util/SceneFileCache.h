@@ -0,0 +1,73 @@
+#ifndef CNOID_UTIL_SCENE_FILE_CACHE_H
+#define CNOID_UTIL_SCENE_FILE_CACHE_H
+
+#include "FileCache.h"
+#include "SceneGraph.h"
+#include <memory>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   The cache of the scenes loaded from model files by scene loaders.
+
+   The key is made from the absolute path, the size and the modification time of the file,
+   the loader options and the format of the file, so the source file itself is not read to
+   check the cache. The scene is stored in a binary form that keeps the mesh data (vertices,
+   normals, colors, texture coordinates and their indices) as they are, and it is mapped into
+   the memory when it is restored. Only the scenes which consist of the groups, the transforms
+   and the shapes with meshes and materials can be stored. The scenes with other nodes such as
+   textures are not stored.
+
+   The cache is disabled by default. It is enabled when the CNOID_SCENE_CACHE_DIR environment
+   variable specifies the directory of the cache, or when setEnabled(true) is called, in which
+   case the directory is "choreonoid/scenes" in the user cache directory.
+*/
+class CNOID_EXPORT SceneFileCache : public FileCache
+{
+public:
+    static SceneFileCache* instance();
+
+    //! The files smaller than this size are not cached because loading them is fast enough
+    void setMinFileSize(size_t size);
+    size_t minFileSize() const { return minFileSize_; }
+
+    /**
+       \param format The file format such as the extension of the file
+       \param loaderOptions The options of the loader which affect the loaded scene
+       \return nullptr if the file is not found or the file is not cached
+    */
+    std::unique_ptr<Key> makeKey(
+        const std::string& filename, const std::string& format, const std::string& loaderOptions);
+
+    /**
+       \param out_isFound True is set when the key has been stored, which includes the case
+       where the key is marked by markUnstorable().
+       \return nullptr if the scene is not found or the key is marked by markUnstorable()
+    */
+    SgNode* loadScene(const Key& key, const std::string& filename, bool* out_isFound = nullptr);
+
+    //! \return false if the scene contains an object which cannot be stored
+    bool storeScene(const Key& key, SgNode* scene, const std::string& filename);
+
+    /**
+       This function records that the scene of the key cannot be stored so that the file is
+       not checked again until it is modified.
+    */
+    void markUnstorable(const Key& key);
+
+    /**
+       \return true if the file contains one of the keywords, which is used to find the files
+       that refer to other files. The scenes of such files must not be stored because the
+       changes of the referred files cannot be detected.
+    */
+    static bool containsKeywords(const std::string& filename, const std::vector<std::string>& keywords);
+
+private:
+    SceneFileCache();
+    size_t minFileSize_;
+};
+
+}
+
+#endif
@@ -3,6 +3,7 @@
 */
 
 #include "SceneLoader.h"
+#include "SceneFileCache.h"
 #include "NullOut.h"
 #include "UTF8.h"
 #include <cnoid/stdx/filesystem>
@@ -24,6 +25,15 @@ LoaderIdMap loaderIdMap;
 vector<LoaderFactory> loaderFactories;
 mutex loaderMutex;
 
+/*
+  The formats whose scenes are stored in the scene file cache.
+  The second element is the keywords with which the format refers to other files.
+*/
+const map<string, vector<string>> cacheableFormats = {
+    { "stl", { } },
+    { "wrl", { "Inline", "EXTERNPROTO" } }
+};
+
 }
 
 namespace cnoid {
@@ -41,6 +51,7 @@ public:
     SceneLoaderImpl();
     AbstractSceneLoaderPtr findLoader(string ext);
     SgNode* load(const std::string& filename, bool* out_isSupportedFormat);
+    SgNode* loadWithCache(AbstractSceneLoader* loader, const std::string& filename, string ext);
 };
 
 }
@@ -186,9 +197,53 @@ SgNode* SceneLoaderImpl::load(const std::string& filename, bool* out_isSupported
         if(defaultCreaseAngle >= 0.0){
             loader->setDefaultCreaseAngle(defaultCreaseAngle);
         }
-        node = loader->load(filename);
+        node = loadWithCache(loader.get(), filename, ext);
         os().flush();
     }
 
     return node;
 }
+
+
+SgNode* SceneLoaderImpl::loadWithCache
+(AbstractSceneLoader* loader, const std::string& filename, string ext)
+{
+    auto cache = SceneFileCache::instance();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    auto p = cacheableFormats.find(ext);
+    if(p == cacheableFormats.end() || !cache->isEnabled()){
+        return loader->load(filename);
+    }
+
+    auto key = cache->makeKey(
+        filename, ext, fmt::format("{} {}", defaultDivisionNumber, defaultCreaseAngle));
+    if(!key){
+        return loader->load(filename);
+    }
+
+    bool isFound;
+    SgNode* node = cache->loadScene(*key, filename, &isFound);
+    if(isFound){
+        return node ? node : loader->load(filename);
+    }
+
+    /*
+      The file is scanned for the references only when it is not in the cache yet. The result
+      is also recorded in the cache so that the file is read only by the loader after that.
+    */
+    const auto& referenceKeywords = p->second;
+    if(!referenceKeywords.empty() && SceneFileCache::containsKeywords(filename, referenceKeywords)){
+        cache->markUnstorable(*key);
+        return loader->load(filename);
+    }
+
+    node = loader->load(filename);
+    if(node){
+        SgNodePtr holder = node;
+        if(!cache->storeScene(*key, node, filename)){
+            cache->markUnstorable(*key);
+        }
+        node = holder.retn();
+    }
+    return node;
+}
@@ -13,8 +13,11 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <list>
 #include <cmath>
+#include <cstdlib>
 #include <vector>
 #include <mutex>
+#include <thread>
+#include "strtofloat.h"
 
 using namespace std;
 using namespace cnoid;
@@ -58,6 +61,97 @@ bool isFileProtocol(const string& ref)
     return ret;
 }
 
+/*
+  The numbers of a large MF field block are directly parsed into an array without the tokenizer.
+  The block is pre-scanned to find its closing bracket, and it is split into chunks at line ends,
+  which are parsed by separate threads when the block is large enough. A line end is never in a
+  number or a comment, so the chunks can be parsed independently.
+*/
+const size_t MinNumberBlockSize = 4096;
+const size_t NumberBlockChunkSize = 256 * 1024;
+
+int parseInt32(const char* nptr, char** endptr)
+{
+    return strtol(nptr, endptr, 0);
+}
+
+double parseDouble(const char* nptr, char** endptr)
+{
+    return cnoid::strtod(nptr, endptr);
+}
+
+float parseFloat(const char* nptr, char** endptr)
+{
+    return cnoid::strtof(nptr, endptr);
+}
+
+float parseColorElement(const char* nptr, char** endptr)
+{
+    return static_cast<float>(cnoid::strtod(nptr, endptr));
+}
+
+/**
+   \return The position of the closing bracket or nullptr if the text ends before it
+*/
+const char* findNumberBlockEnd(const char* text, int& out_numLines)
+{
+    int numLines = 0;
+    const char* p = text;
+    while(true){
+        const char c = *p;
+        if(c == ']'){
+            break;
+        } else if(c == '\0'){
+            return nullptr;
+        } else if(c == '#'){
+            while(*p != '\n' && *p != '\r' && *p != '\0'){
+                ++p;
+            }
+            continue;
+        } else if(c == '\n'){
+            ++numLines;
+        } else if(c == '\r'){
+            if(p[1] != '\n'){
+                ++numLines;
+            }
+        }
+        ++p;
+    }
+    out_numLines = numLines;
+    return p;
+}
+
+template<class ScalarType, class ParseFunction>
+bool parseNumberChunk(const char* begin, const char* end, vector<ScalarType>& out_numbers, ParseFunction parse)
+{
+    out_numbers.reserve((end - begin) / 4);
+    const char* p = begin;
+    while(true){
+        while(p < end){
+            const char c = *p;
+            if(c == ' ' || c == '\t' || c == ',' || c == '\n' || c == '\r'){
+                ++p;
+            } else if(c == '#'){
+                while(p < end && *p != '\n' && *p != '\r'){
+                    ++p;
+                }
+            } else {
+                break;
+            }
+        }
+        if(p >= end){
+            return true;
+        }
+        char* tail;
+        ScalarType value = parse(p, &tail);
+        if(tail == p || tail > end){
+            return false;
+        }
+        out_numbers.push_back(value);
+        p = tail;
+    }
+}
+
 /**
    The definition of the reserved word IDs
 */
@@ -406,6 +500,8 @@ public:
   
     VRMLVariantField& readProtoField(VRMLFieldTypeId fieldTypeId);
   
+    template<class ScalarType, class ContainerType, class ParseFunction>
+    bool readNumberBlock(ContainerType& out_values, int dimension, ParseFunction parse);
     void readSFInt32(SFInt32& out_value);
     void readMFInt32(MFInt32& out_value);
     void readSFFloat(SFFloat& out_value);
@@ -2002,6 +2098,86 @@ VRMLVariantField& VRMLParserImpl::readProtoField(VRMLFieldTypeId fieldTypeId)
 }
 
 
+/**
+   This function is called just after the opening bracket of a MF field is read.
+   \return false if the block is small or it cannot be parsed as a sequence of the values of the
+   given dimension. The scanner position is not moved in that case, and the block should be read
+   by the tokenizer, which reports the error if any.
+*/
+template<class ScalarType, class ContainerType, class ParseFunction>
+bool VRMLParserImpl::readNumberBlock(ContainerType& out_values, int dimension, ParseFunction parse)
+{
+    const char* begin = scanner->text;
+    int numLines;
+    const char* end = findNumberBlockEnd(begin, numLines);
+    if(!end){
+        return false;
+    }
+    const size_t size = end - begin;
+    if(size < MinNumberBlockSize){
+        return false;
+    }
+
+    size_t numChunks = std::max(size_t(1), size / NumberBlockChunkSize);
+    numChunks = std::min(numChunks, size_t(std::max(1u, thread::hardware_concurrency())));
+    vector<const char*> borders;
+    borders.push_back(begin);
+    for(size_t i=1; i < numChunks; ++i){
+        const char* p = std::max(borders.back(), begin + i * size / numChunks);
+        while(p < end && *p != '\n'){
+            ++p;
+        }
+        if(p < end){
+            borders.push_back(p + 1);
+        }
+    }
+    borders.push_back(end);
+    numChunks = borders.size() - 1;
+
+    vector<vector<ScalarType>> chunks(numChunks);
+    vector<char> results(numChunks, false);
+    auto parseChunk = [&](size_t index){
+        try {
+            results[index] = parseNumberChunk(borders[index], borders[index + 1], chunks[index], parse);
+        }
+        catch(const std::bad_alloc&){
+            results[index] = false;
+        }
+    };
+    vector<thread> threads;
+    for(size_t i=1; i < numChunks; ++i){
+        threads.emplace_back(parseChunk, i);
+    }
+    parseChunk(0);
+    for(auto& t : threads){
+        t.join();
+    }
+
+    size_t numValues = 0;
+    for(size_t i=0; i < numChunks; ++i){
+        if(!results[i]){
+            return false;
+        }
+        numValues += chunks[i].size();
+    }
+    if(numValues % dimension != 0){
+        return false;
+    }
+
+    out_values.resize(numValues / dimension);
+    if(numValues > 0){
+        ScalarType* dest = reinterpret_cast<ScalarType*>(&out_values.front());
+        for(auto& chunk : chunks){
+            dest = std::copy(chunk.begin(), chunk.end(), dest);
+        }
+    }
+
+    scanner->text = const_cast<char*>(end) + 1;
+    scanner->lineNumber += numLines;
+    return true;
+}
+
+
 void VRMLParserImpl::readSFInt32(SFInt32& out_value)
 {
     if(scanner->readSymbol(F_IS)){
@@ -2020,7 +2196,7 @@ void VRMLParserImpl::readMFInt32(MFInt32& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(scanner->readIntEx("illegal int value"));
-        } else {
+        } else if(!readNumberBlock<SFInt32>(out_value, 1, parseInt32)){
             while(!scanner->readChar(']')){
                 out_value.push_back(scanner->readIntEx("illegal int value"));
             }
@@ -2047,7 +2223,7 @@ void VRMLParserImpl::readMFFloat(MFFloat& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(scanner->readDoubleEx("illegal float value"));
-        } else {
+        } else if(!readNumberBlock<SFFloat>(out_value, 1, parseDouble)){
             while(!scanner->readChar(']')){
                 out_value.push_back(scanner->readDoubleEx("illegal float value"));
             }
@@ -2084,7 +2260,7 @@ void VRMLParserImpl::readMFColor(MFColor& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFColor(scanner));
-        } else {
+        } else if(!readNumberBlock<SFColor::Scalar>(out_value, 3, parseColorElement)){
             while(!scanner->readChar(']')){
                 out_value.push_back(::readSFColor(scanner));
             }
@@ -2148,7 +2324,7 @@ void VRMLParserImpl::readMFVec2f(MFVec2f& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec2f(scanner));
-        } else {
+        } else if(!readNumberBlock<SFVec2f::Scalar>(out_value, 2, parseDouble)){
             while(!scanner->readChar(']')){
                 out_value.push_back(::readSFVec2f(scanner));
             }
@@ -2190,7 +2366,7 @@ void VRMLParserImpl::readMFVec2s(MFVec2s& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec2s(scanner));
-        } else {
+        } else if(!readNumberBlock<SFVec2s::Scalar>(out_value, 2, parseFloat)){
             while(!scanner->readChar(']')){
                 out_value.push_back(::readSFVec2s(scanner));
             }
@@ -2227,7 +2403,7 @@ void VRMLParserImpl::readMFVec3f(MFVec3f& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec3f(scanner));
-        } else {
+        } else if(!readNumberBlock<SFVec3f::Scalar>(out_value, 3, parseDouble)){
             while(!scanner->readChar(']')){
                 out_value.push_back(::readSFVec3f(scanner));
             }
@@ -2269,7 +2445,7 @@ void VRMLParserImpl::readMFVec3s(MFVec3s& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec3s(scanner));
-        } else {
+        } else if(!readNumberBlock<SFVec3s::Scalar>(out_value, 3, parseFloat)){
             while(!scanner->readChar(']')){
                 out_value.push_back(::readSFVec3s(scanner));
             }
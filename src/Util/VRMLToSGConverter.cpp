@@ -15,9 +15,13 @@
 #include "Exception.h"
 #include "NullOut.h"
 #include "EigenUtil.h"
+#include "ThreadPool.h"
 #include <fmt/format.h>
 #include <boost/algorithm/string.hpp>
 #include <tuple>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
 
 using namespace std;
 using namespace cnoid;
@@ -35,6 +39,8 @@ public:
 
     bool isTriangulationEnabled;
     bool isNormalGenerationEnabled;
+    int maxNumThreads;
+    unique_ptr<ThreadPool> threadPool;
 
     vector<int> removedFaceIndices;
     vector<int> removedFaceVertexIndices;
@@ -80,6 +86,9 @@ public:
         
     VRMLToSGConverterImpl(VRMLToSGConverter* self);
     void putMessage(const std::string& message);
+    void convertIndexedFaceSetsInParallel(VRMLNode* vnode);
+    void collectIndexedFaceSets(
+        VRMLNode* vnode, vector<VRMLIndexedFaceSet*>& out_faceSets, unordered_set<VRMLNode*>& visitedNodes);
     SgNode* convertNode(VRMLNode* vnode);
     SgNode* convertGroupNode(AbstractVRMLGroup* vgroup);
     pair<SgNode*, SgGroup*> createTransformNodeSet(VRMLTransform* vt);
@@ -87,7 +96,9 @@ public:
     SgMeshPtr createMeshFromIndexedFaceSet(VRMLIndexedFaceSet* vface);
     bool setIndicesForPerTriangleData(SgIndexArray& indices, int dataSize);
     bool convertIndicesForTriangles(SgIndexArray& indices, const MFInt32& orgIndices, const bool perVertex, const bool ccw);
-    SgPolygonMeshPtr createPolygonMeshFromIndexedFaceSet(VRMLIndexedFaceSet* vface);
+    SgMeshPtr createTriangleMeshFromIndexedFaceSet(
+        VRMLIndexedFaceSet* vface, PolygonMeshTriangulator& triangulator, MeshFilter& filter, string& out_message);
+    SgPolygonMeshPtr createPolygonMeshFromIndexedFaceSet(VRMLIndexedFaceSet* vface, string& out_message);
     void setIndicesForPerPolygonData(SgIndexArray& indices, int dataSize, const MFInt32& orgCoordIndices);
     void convertIndicesForPolygons(
         SgIndexArray& indices, const MFInt32& orgIndices, const MFInt32& orgCoordIndices, const bool perVertex, const bool ccw);
@@ -124,6 +135,7 @@ VRMLToSGConverterImpl::VRMLToSGConverterImpl(VRMLToSGConverter* self)
     os_ = &nullout();
     isTriangulationEnabled = true;
     isNormalGenerationEnabled = true;
+    maxNumThreads = 1;
     imageIO.setUpsideDown(true);
     defaultMaterial = new VRMLMaterial();
 }
@@ -181,6 +193,12 @@ void VRMLToSGConverter::setMaxCreaseAngle(double angle)
 }
 
 
+void VRMLToSGConverter::setMaxNumThreads(int n)
+{
+    impl->maxNumThreads = n;
+}
+
+
 void VRMLToSGConverter::clearConvertedNodeMap()
 {
     impl->vrmlNodeToSgNodeMap.clear();
@@ -196,12 +214,107 @@ void VRMLToSGConverter::clearConvertedNodeMap()
 SgNodePtr VRMLToSGConverter::convert(VRMLNodePtr vrmlNode)
 {
     if(vrmlNode){
+        if(impl->isTriangulationEnabled){
+            impl->convertIndexedFaceSetsInParallel(vrmlNode.get());
+        }
         return impl->convertNode(vrmlNode.get());
     }
     return 0;
 }
 
 
+/**
+   The IndexedFaceSet nodes are independent of each other, so they are triangulated and their normals are
+   generated by multiple threads before the scene graph is constructed. The converted meshes are registered
+   in the mesh map in the traversal order, and the scene graph is constructed by the ordinary conversion,
+   which finds the meshes in the map. Note that a null mesh is also registered for a node that cannot be
+   converted so that the node is not converted again.
+*/
+void VRMLToSGConverterImpl::convertIndexedFaceSetsInParallel(VRMLNode* vnode)
+{
+    int numThreads = maxNumThreads;
+    if(numThreads <= 0){
+        numThreads = std::max(1u, thread::hardware_concurrency());
+    }
+    if(numThreads < 2){
+        return;
+    }
+    
+    vector<VRMLIndexedFaceSet*> faceSets;
+    unordered_set<VRMLNode*> visitedNodes;
+    collectIndexedFaceSets(vnode, faceSets, visitedNodes);
+    const int numFaceSets = faceSets.size();
+    if(numFaceSets < 2){
+        return;
+    }
+    numThreads = std::min(numThreads, numFaceSets);
+
+    vector<SgMeshPtr> meshes(numFaceSets);
+    vector<string> messages(numFaceSets);
+    std::atomic<int> nextFaceSetIndex(0);
+    auto convertFaceSets = [&](){
+        PolygonMeshTriangulator triangulator;
+        MeshFilter filter(meshFilter);
+        int index;
+        while((index = nextFaceSetIndex++) < numFaceSets){
+            meshes[index] = createTriangleMeshFromIndexedFaceSet(faceSets[index], triangulator, filter, messages[index]);
+        }
+    };
+    if(!threadPool || threadPool->size() < numThreads - 1){
+        threadPool.reset(new ThreadPool(numThreads - 1));
+    }
+    for(int i=1; i < numThreads; ++i){
+        threadPool->start(convertFaceSets);
+    }
+    convertFaceSets();
+    threadPool->wait();
+
+    for(int i=0; i < numFaceSets; ++i){
+        if(!messages[i].empty()){
+            putMessage(messages[i]);
+        }
+        VRMLIndexedFaceSet* faceSet = faceSets[i];
+        if(meshes[i]){
+            meshes[i]->setName(faceSet->defName);
+        }
+        vrmlGeometryToSgMeshMap[faceSet] = meshes[i];
+    }
+}
+
+
+void VRMLToSGConverterImpl::collectIndexedFaceSets
+(VRMLNode* vnode, vector<VRMLIndexedFaceSet*>& out_faceSets, unordered_set<VRMLNode*>& visitedNodes)
+{
+    if(!vnode || !visitedNodes.insert(vnode).second || vrmlNodeToSgNodeMap.find(vnode) != vrmlNodeToSgNodeMap.end()){
+        return;
+    }
+    if(VRMLProtoInstance* protoInstance = dynamic_cast<VRMLProtoInstance*>(vnode)){
+        vnode = protoInstance->actualNode.get();
+        if(!vnode){
+            return;
+        }
+    }
+    if(VRMLSwitch* switchNode = dynamic_cast<VRMLSwitch*>(vnode)){
+        // The other choices are left to the ordinary conversion because they are usually not shown
+        const int which = switchNode->whichChoice;
+        if(which >= 0 && which < switchNode->countChildren()){
+            collectIndexedFaceSets(switchNode->getChild(which), out_faceSets, visitedNodes);
+        }
+    } else if(AbstractVRMLGroup* group = dynamic_cast<AbstractVRMLGroup*>(vnode)){
+        int num = group->countChildren();
+        for(int i=0; i < num; ++i){
+            collectIndexedFaceSets(group->getChild(i), out_faceSets, visitedNodes);
+        }
+    } else if(VRMLShape* shape = dynamic_cast<VRMLShape*>(vnode)){
+        VRMLIndexedFaceSet* faceSet = dynamic_node_cast<VRMLIndexedFaceSet>(shape->geometry).get();
+        if(faceSet && visitedNodes.insert(faceSet).second &&
+           vrmlGeometryToSgMeshMap.find(faceSet) == vrmlGeometryToSgMeshMap.end()){
+            out_faceSets.push_back(faceSet);
+        }
+    }
+}
+
+
 void VRMLToSGConverterImpl::putMessage(const std::string& message)
 {
     os() << message << endl;
@@ -330,25 +443,16 @@ SgNode* VRMLToSGConverterImpl::convertShapeNode(VRMLShape* vshape)
             if(VRMLIndexedFaceSet* faceSet = dynamic_cast<VRMLIndexedFaceSet*>(vrmlGeometry)){
                 if(!isTriangulationEnabled){
                     mesh = createMeshFromIndexedFaceSet(faceSet);
+                    if(mesh && isNormalGenerationEnabled){
+                        meshFilter.generateNormals(mesh, faceSet->creaseAngle);
+                    }
                 } else {
-                    SgPolygonMeshPtr polygonMesh = createPolygonMeshFromIndexedFaceSet(faceSet);
-                    if(polygonMesh){
-                        mesh = polygonMeshTriangulator.triangulate(polygonMesh);
-                        const string& errorMessage = polygonMeshTriangulator.errorMessage();
-                        if(!errorMessage.empty()){
-                            string message;
-                            if(faceSet->defName.empty()){
-                                message = "Error of an IndexedFaceSet node: \n";
-                            } else {
-                                message = format("Error of IndexedFaceSet node \"{}\": \n", faceSet->defName);
-                            }
-                            putMessage(message + errorMessage);
-                        }
+                    string message;
+                    mesh = createTriangleMeshFromIndexedFaceSet(faceSet, polygonMeshTriangulator, meshFilter, message);
+                    if(!message.empty()){
+                        putMessage(message);
                     }
                 }
-                if(mesh && isNormalGenerationEnabled){
-                    meshFilter.generateNormals(mesh, faceSet->creaseAngle);
-                }
                     
             } else if(VRMLBox* box = dynamic_cast<VRMLBox*>(vrmlGeometry)){
                 mesh = meshGenerator.generateBox(
@@ -643,18 +747,46 @@ bool VRMLToSGConverterImpl::convertIndicesForTriangles
 }
 
 
-SgPolygonMeshPtr VRMLToSGConverterImpl::createPolygonMeshFromIndexedFaceSet(VRMLIndexedFaceSet* vface)
+/**
+   This function can be executed by multiple threads for different nodes with different triangulators and filters.
+   The message is returned instead of being output.
+*/
+SgMeshPtr VRMLToSGConverterImpl::createTriangleMeshFromIndexedFaceSet
+(VRMLIndexedFaceSet* vface, PolygonMeshTriangulator& triangulator, MeshFilter& filter, string& out_message)
+{
+    SgPolygonMeshPtr polygonMesh = createPolygonMeshFromIndexedFaceSet(vface, out_message);
+    if(!polygonMesh){
+        return nullptr;
+    }
+    SgMeshPtr mesh = triangulator.triangulate(polygonMesh);
+    const string& errorMessage = triangulator.errorMessage();
+    if(!errorMessage.empty()){
+        if(vface->defName.empty()){
+            out_message = "Error of an IndexedFaceSet node: \n";
+        } else {
+            out_message = format("Error of IndexedFaceSet node \"{}\": \n", vface->defName);
+        }
+        out_message += errorMessage;
+    }
+    if(mesh && isNormalGenerationEnabled){
+        filter.generateNormals(mesh, vface->creaseAngle);
+    }
+    return mesh;
+}
+
+
+SgPolygonMeshPtr VRMLToSGConverterImpl::createPolygonMeshFromIndexedFaceSet(VRMLIndexedFaceSet* vface, string& out_message)
 {
     if(!vface->coord){
-        putMessage("VRMLIndexedFaceSet: The coord field is not defined." );
+        out_message = "VRMLIndexedFaceSet: The coord field is not defined.";
         return nullptr;
     }
     if(vface->coord->point.empty()){
-        putMessage("VRMLIndexedFaceSet: The point field is empty." );
+        out_message = "VRMLIndexedFaceSet: The point field is empty.";
         return nullptr;
     }
     if(vface->coordIndex.empty()){
-        putMessage("VRMLIndexedFaceSet: The coordIndex field is empty." );
+        out_message = "VRMLIndexedFaceSet: The coordIndex field is empty.";
         return nullptr;
     }
     
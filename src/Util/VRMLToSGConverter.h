@@ -28,6 +28,12 @@ public:
     void setMinCreaseAngle(double angle);
     void setMaxCreaseAngle(double angle);
 
+    /**
+       The maximum number of the threads used to convert the IndexedFaceSet nodes. The default value is one,
+       which converts the nodes in the calling thread. Zero means the number of the hardware threads.
+    */
+    void setMaxNumThreads(int n);
+
     void clearConvertedNodeMap();
         
     SgNodePtr convert(VRMLNodePtr vrmlNode);
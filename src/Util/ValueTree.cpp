@@ -4,14 +4,21 @@
 
 #include "ValueTree.h"
 #include "UTF8.h"
+#include "strtofloat.h"
 #include <stack>
 #include <iostream>
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <cstdint>
+#include <cstdlib>
 #include <yaml.h>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
 #include "gettext.h"
 
 #ifdef _WIN32
+#include <malloc.h>
 #define snprintf _snprintf_s
 #endif
 
@@ -45,6 +52,298 @@ ListingPtr invalidListing;
 constexpr double PI = 3.141592653589793238462643383279502884;
 constexpr double TO_RADIAN = PI / 180.0;
 
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+double parseDouble(const char* nptr, char** endptr)
+{
+    double value;
+    if(convertDecimalNumberExactly(nptr, endptr, value)){
+        return value;
+    }
+    return std::strtod(nptr, endptr);
+}
+
+float parseFloat(const char* nptr, char** endptr)
+{
+    float value;
+    if(convertDecimalNumberExactly(nptr, endptr, value)){
+        return value;
+    }
+    return std::strtof(nptr, endptr);
+}
+
+int parseInt(const char* nptr, char** endptr)
+{
+    const char* p = nptr;
+    bool isNegative = false;
+    if(*p == '-'){
+        isNegative = true;
+        ++p;
+    } else if(*p == '+'){
+        ++p;
+    }
+    int value = 0;
+    int numDigits = 0;
+    while(isDigit(*p)){
+        // Larger values are converted by strtol to keep its clamping behavior
+        if(++numDigits > 9){
+            return strtol(nptr, endptr, 10);
+        }
+        value = value * 10 + (*p - '0');
+        ++p;
+    }
+    if(numDigits == 0){
+        return strtol(nptr, endptr, 10);
+    }
+    *endptr = const_cast<char*>(p);
+    return isNegative ? -value : value;
+}
+
+/*
+  The memory blocks of the nodes are carved from slabs, each of which is used for the blocks of a
+  single size class. A slab is aligned to its size so that the slab of a block is given by the
+  address of the block, and it is returned to the system when all of its blocks are freed.
+
+  Each thread keeps a small number of free blocks of each size class so that most of the nodes
+  are allocated and freed without any lock. The blocks are moved between the thread and the slabs
+  in batches, and the blocks of a thread are returned to the slabs when the thread exits.
+*/
+constexpr size_t NodeBlockAlignment = 16;
+constexpr size_t MaxPooledNodeSize = 256;
+constexpr int NumNodeSizeClasses = MaxPooledNodeSize / NodeBlockAlignment;
+constexpr size_t NodeSlabSize = 64 * 1024;
+constexpr int NodeBlockBatchSize = 32;
+constexpr int MaxNumThreadNodeBlocks = 2 * NodeBlockBatchSize;
+
+struct FreeNodeBlock
+{
+    FreeNodeBlock* next;
+};
+
+struct NodeSlab
+{
+    NodeSlab* prev;
+    NodeSlab* next;
+    FreeNodeBlock* freeBlocks;
+    char* unusedPosition;
+    size_t blockSize;
+    // The number of the blocks that are allocated or kept by threads
+    int numUsedBlocks;
+};
+
+constexpr size_t NodeSlabHeaderSize =
+    (sizeof(NodeSlab) + NodeBlockAlignment - 1) / NodeBlockAlignment * NodeBlockAlignment;
+
+void* allocateAlignedMemory(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+    void* p = _aligned_malloc(size, alignment);
+#else
+    void* p;
+    if(posix_memalign(&p, alignment, size) != 0){
+        p = nullptr;
+    }
+#endif
+    if(!p){
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void freeAlignedMemory(void* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+inline NodeSlab* getNodeSlab(void* block)
+{
+    return reinterpret_cast<NodeSlab*>(reinterpret_cast<uintptr_t>(block) & ~(NodeSlabSize - 1));
+}
+
+struct GlobalNodePool
+{
+    std::mutex mutex;
+    // The slabs that have blocks available in each size class
+    NodeSlab* availableSlabs[NumNodeSizeClasses];
+
+    void linkSlab(NodeSlab* slab, int sizeClass){
+        slab->prev = nullptr;
+        slab->next = availableSlabs[sizeClass];
+        if(slab->next){
+            slab->next->prev = slab;
+        }
+        availableSlabs[sizeClass] = slab;
+    }
+
+    void unlinkSlab(NodeSlab* slab, int sizeClass){
+        if(slab->prev){
+            slab->prev->next = slab->next;
+        } else {
+            availableSlabs[sizeClass] = slab->next;
+        }
+        if(slab->next){
+            slab->next->prev = slab->prev;
+        }
+        slab->prev = nullptr;
+        slab->next = nullptr;
+    }
+
+    static bool isSlabFull(NodeSlab* slab){
+        return !slab->freeBlocks &&
+            reinterpret_cast<char*>(slab) + NodeSlabSize - slab->unusedPosition < static_cast<ptrdiff_t>(slab->blockSize);
+    }
+
+    // The mutex must be locked
+    FreeNodeBlock* takeBlock(int sizeClass){
+        NodeSlab* slab = availableSlabs[sizeClass];
+        if(!slab){
+            slab = static_cast<NodeSlab*>(allocateAlignedMemory(NodeSlabSize, NodeSlabSize));
+            slab->freeBlocks = nullptr;
+            slab->unusedPosition = reinterpret_cast<char*>(slab) + NodeSlabHeaderSize;
+            slab->blockSize = (sizeClass + 1) * NodeBlockAlignment;
+            slab->numUsedBlocks = 0;
+            linkSlab(slab, sizeClass);
+        }
+        FreeNodeBlock* block = slab->freeBlocks;
+        if(block){
+            slab->freeBlocks = block->next;
+        } else {
+            block = reinterpret_cast<FreeNodeBlock*>(slab->unusedPosition);
+            slab->unusedPosition += slab->blockSize;
+        }
+        ++slab->numUsedBlocks;
+        if(isSlabFull(slab)){
+            unlinkSlab(slab, sizeClass);
+        }
+        return block;
+    }
+
+    // The mutex must be locked
+    void returnBlock(FreeNodeBlock* block, int sizeClass){
+        NodeSlab* slab = getNodeSlab(block);
+        const bool wasFull = isSlabFull(slab);
+        block->next = slab->freeBlocks;
+        slab->freeBlocks = block;
+        if(--slab->numUsedBlocks == 0){
+            if(!wasFull){
+                unlinkSlab(slab, sizeClass);
+            }
+            freeAlignedMemory(slab);
+        } else if(wasFull){
+            linkSlab(slab, sizeClass);
+        }
+    }
+};
+
+GlobalNodePool& globalNodePool()
+{
+    // The pool is never destroyed because nodes may be freed in the destructors of static objects
+    static GlobalNodePool* pool = new GlobalNodePool();
+    return *pool;
+}
+
+struct ThreadNodeBlockList
+{
+    FreeNodeBlock* head;
+    int size;
+};
+
+// This must be trivially destructible so that it is available until the thread exits
+struct ThreadNodeCache
+{
+    ThreadNodeBlockList freeLists[NumNodeSizeClasses];
+    bool isInitialized;
+    bool isReleased;
+};
+
+thread_local ThreadNodeCache threadNodeCache;
+
+void returnThreadNodeBlocks(ThreadNodeBlockList& list, int sizeClass, int n)
+{
+    auto& pool = globalNodePool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    for(int i=0; i < n; ++i){
+        FreeNodeBlock* block = list.head;
+        list.head = block->next;
+        pool.returnBlock(block, sizeClass);
+    }
+    list.size -= n;
+}
+
+struct ThreadNodeCacheReleaser
+{
+    bool isRegistered;
+    ~ThreadNodeCacheReleaser();
+};
+
+thread_local ThreadNodeCacheReleaser threadNodeCacheReleaser;
+
+ThreadNodeCacheReleaser::~ThreadNodeCacheReleaser()
+{
+    auto& cache = threadNodeCache;
+    for(int i=0; i < NumNodeSizeClasses; ++i){
+        returnThreadNodeBlocks(cache.freeLists[i], i, cache.freeLists[i].size);
+    }
+    cache.isReleased = true;
+}
+
+void* allocateNodeBlock(size_t size)
+{
+    const int sizeClass = (size - 1) / NodeBlockAlignment;
+    auto& cache = threadNodeCache;
+    auto& pool = globalNodePool();
+
+    if(cache.isReleased){
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        return pool.takeBlock(sizeClass);
+    }
+    if(!cache.isInitialized){
+        threadNodeCacheReleaser.isRegistered = true;
+        cache.isInitialized = true;
+    }
+    auto& list = cache.freeLists[sizeClass];
+    if(!list.head){
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        for(int i=0; i < NodeBlockBatchSize; ++i){
+            FreeNodeBlock* block = pool.takeBlock(sizeClass);
+            block->next = list.head;
+            list.head = block;
+            ++list.size;
+        }
+    }
+    FreeNodeBlock* block = list.head;
+    list.head = block->next;
+    --list.size;
+    return block;
+}
+
+void freeNodeBlock(void* p, size_t size)
+{
+    const int sizeClass = (size - 1) / NodeBlockAlignment;
+    auto block = static_cast<FreeNodeBlock*>(p);
+    auto& cache = threadNodeCache;
+
+    if(cache.isReleased){
+        auto& pool = globalNodePool();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.returnBlock(block, sizeClass);
+        return;
+    }
+    auto& list = cache.freeLists[sizeClass];
+    block->next = list.head;
+    list.head = block;
+    if(++list.size > MaxNumThreadNodeBlocks){
+        returnThreadNodeBlocks(list, sizeClass, NodeBlockBatchSize);
+    }
+}
+
 }
 
 ValueNode::Initializer ValueNode::initializer;
@@ -113,6 +412,28 @@ ValueNode* ValueNode::clone() const
 }
 
 
+void* ValueNode::operator new(std::size_t size)
+{
+    if(size > MaxPooledNodeSize){
+        return ::operator new(size);
+    }
+    return allocateNodeBlock(size);
+}
+
+
+void ValueNode::operator delete(void* p, std::size_t size)
+{
+    if(!p){
+        return;
+    }
+    if(size > MaxPooledNodeSize){
+        ::operator delete(p);
+    } else {
+        freeNodeBlock(p, size);
+    }
+}
+
+
 // disabled
 ValueNode& ValueNode::operator=(const ValueNode&)
 {
@@ -153,7 +474,7 @@ bool ValueNode::read(int &out_value) const
     if(isScalar()){
         const char* nptr = &(static_cast<const ScalarNode* const>(this)->stringValue_[0]);
         char* endptr;
-        out_value = strtol(nptr, &endptr, 10);
+        out_value = parseInt(nptr, &endptr);
         if(endptr > nptr){
             return true;
         }
@@ -172,7 +493,7 @@ int ValueNode::toInt() const
     
     const char* nptr = &(scalar->stringValue_[0]);
     char* endptr;
-    const int value = strtol(nptr, &endptr, 10);
+    const int value = parseInt(nptr, &endptr);
 
     if(endptr == nptr){
         ScalarTypeMismatchException ex;
@@ -190,7 +511,7 @@ bool ValueNode::read(double& out_value) const
     if(isScalar()){
         const char* nptr = &(static_cast<const ScalarNode* const>(this)->stringValue_[0]);
         char* endptr;
-        out_value = strtod(nptr, &endptr);
+        out_value = parseDouble(nptr, &endptr);
         if(endptr > nptr){
             return true;
         }
@@ -204,7 +525,7 @@ bool ValueNode::read(float& out_value) const
     if(isScalar()){
         const char* nptr = &(static_cast<const ScalarNode* const>(this)->stringValue_[0]);
         char* endptr;
-        out_value = strtof(nptr, &endptr);
+        out_value = parseFloat(nptr, &endptr);
         if(endptr > nptr){
             return true;
         }
@@ -223,7 +544,7 @@ double ValueNode::toDouble() const
 
     const char* nptr = &(scalar->stringValue_[0]);
     char* endptr;
-    const double value = strtod(nptr, &endptr);
+    const double value = parseDouble(nptr, &endptr);
 
     if(endptr == nptr){
         ScalarTypeMismatchException ex;
@@ -467,6 +788,7 @@ Mapping::Mapping(int line, int column)
     column_ = column;
     mode = READ_MODE;
     indexCounter = 0;
+    keyStringStyle_ = PLAIN_STRING;
     isFlowStyle_ = false;
     doubleFormat_ = defaultDoubleFormat;
 }
@@ -476,6 +798,7 @@ Mapping::Mapping(const Mapping& org)
     : ValueNode(org),
       values(org.values),
       mode(org.mode),
+      indexCounter(org.indexCounter),
       doubleFormat_(org.doubleFormat_),
       isFlowStyle_(org.isFlowStyle_),
       keyStringStyle_(org.keyStringStyle_)
@@ -521,12 +844,57 @@ void Mapping::setKeyQuoteStyle(StringStyle style)
 }
 
 
+namespace {
+
+struct KeyLess
+{
+    template<class Element>
+    bool operator()(const Element& element, const std::string& key) const {
+        return element.first < key;
+    }
+};
+
+}
+
+
+Mapping::iterator Mapping::lowerBound(const std::string& key)
+{
+    return std::lower_bound(values.begin(), values.end(), key, KeyLess());
+}
+
+
+Mapping::const_iterator Mapping::lowerBound(const std::string& key) const
+{
+    return std::lower_bound(values.begin(), values.end(), key, KeyLess());
+}
+
+
+Mapping::iterator Mapping::findElement(const std::string& key)
+{
+    auto p = lowerBound(key);
+    if(p != values.end() && p->first == key){
+        return p;
+    }
+    return values.end();
+}
+
+
+Mapping::const_iterator Mapping::findElement(const std::string& key) const
+{
+    auto p = lowerBound(key);
+    if(p != values.end() && p->first == key){
+        return p;
+    }
+    return values.end();
+}
+
+
 ValueNode* Mapping::find(const std::string& key) const
 {
     if(!isValid()){
         throwNotMappingException();
     }
-    const_iterator p = values.find(key);
+    const_iterator p = findElement(key);
     if(p != values.end()){
         return p->second.get();
     } else {
@@ -540,7 +908,7 @@ Mapping* Mapping::findMapping(const std::string& key) const
     if(!isValid()){
         throwNotMappingException();
     }
-    const_iterator p = values.find(key);
+    const_iterator p = findElement(key);
     if(p != values.end()){
         ValueNode* node = p->second.get();
         if(node->isMapping()){
@@ -556,7 +924,7 @@ Listing* Mapping::findListing(const std::string& key) const
     if(!isValid()){
         throwNotMappingException();
     }
-    const_iterator p = values.find(key);
+    const_iterator p = findElement(key);
     if(p != values.end()){
         ValueNode* node = p->second.get();
         if(node->isListing()){
@@ -572,7 +940,7 @@ ValueNodePtr Mapping::extract(const std::string& key)
     if(!isValid()){
         throwNotMappingException();
     }
-    iterator p = values.find(key);
+    iterator p = findElement(key);
     if(p != values.end()){
         ValueNodePtr value = p->second;
         values.erase(p);
@@ -609,7 +977,7 @@ ValueNode& Mapping::get(const std::string& key) const
     if(!isValid()){
         throwNotMappingException();
     }
-    const_iterator p = values.find(key);
+    const_iterator p = findElement(key);
     if(p == values.end()){
         throwKeyNotFoundException(key);
     }
@@ -633,12 +1001,64 @@ inline void Mapping::insertSub(const std::string& key, ValueNode* node)
         EmptyKeyException ex;
         throw ex;
     }
-    //values.insert(make_pair(key, node));
-    values[key] = node;
+    auto p = lowerBound(key);
+    if(p != values.end() && p->first == key){
+        p->second = node;
+    } else {
+        values.emplace(p, key, node);
+    }
     node->indexInMapping_ = indexCounter++;
 }
 
 
+void Mapping::appendUnsorted(const std::string& key, ValueNode* node)
+{
+    if(key.empty()){
+        EmptyKeyException ex;
+        throw ex;
+    }
+    values.emplace_back(key, node);
+    node->indexInMapping_ = indexCounter++;
+}
+
+
+/**
+   Sort the elements appended by appendUnsorted. The last one of the elements with the same key
+   is kept, which is the same result as inserting the elements one by one.
+*/
+void Mapping::sortElements()
+{
+    auto isKeyLess = [](const Container::value_type& e1, const Container::value_type& e2){
+        return e1.first < e2.first; };
+
+    bool isSorted = true;
+    for(size_t i=1; i < values.size(); ++i){
+        if(!isKeyLess(values[i-1], values[i])){
+            isSorted = false;
+            break;
+        }
+    }
+    if(isSorted){
+        return;
+    }
+
+    std::stable_sort(values.begin(), values.end(), isKeyLess);
+
+    auto q = values.begin();
+    for(auto p = values.begin(); p != values.end(); ++p){
+        if(q != values.begin() && (q - 1)->first == p->first){
+            (q - 1)->second = std::move(p->second);
+        } else {
+            if(q != p){
+                *q = std::move(*p);
+            }
+            ++q;
+        }
+    }
+    values.erase(q, values.end());
+}
+
+
 void Mapping::insert(const std::string& key, ValueNode* node)
 {
     if(!isValid()){
@@ -657,7 +1077,16 @@ void Mapping::insert(const Mapping* other)
     if(!isValid()){
         throwNotMappingException();
     }
-    values.insert(other->values.begin(), other->values.end());
+    if(other == this){
+        return;
+    }
+    // The existing elements are not overwritten
+    for(auto& element : other->values){
+        auto p = lowerBound(element.first);
+        if(p == values.end() || p->first != element.first){
+            values.emplace(p, element.first, element.second);
+        }
+    }
 }
 
 
@@ -669,7 +1098,7 @@ Mapping* Mapping::openMapping_(const std::string& key, bool doOverwrite)
 
     Mapping* mapping = nullptr;
     const string uKey(key);
-    iterator p = values.find(uKey);
+    iterator p = findElement(uKey);
     if(p != values.end()){
         ValueNode* node = p->second.get();
         if(!node->isMapping()){
@@ -709,7 +1138,7 @@ Listing* Mapping::openListing_(const std::string& key, bool doOverwrite)
 
     Listing* sequence = nullptr;
     const string uKey(key);
-    iterator p = values.find(uKey);
+    iterator p = findElement(uKey);
     if(p != values.end()){
         ValueNode* node = p->second.get();
         if(!node->isListing()){
@@ -743,7 +1172,12 @@ Listing* Mapping::openFlowStyleListing_(const std::string& key, bool doOverwrite
 
 bool Mapping::remove(const std::string& key)
 {
-    return (values.erase(key) > 0);
+    auto p = findElement(key);
+    if(p != values.end()){
+        values.erase(p);
+        return true;
+    }
+    return false;
 }
 
 
@@ -799,7 +1233,7 @@ bool Mapping::read(const std::string &key, float &out_value) const
 
 void Mapping::write(const std::string &key, const std::string& value, StringStyle stringStyle)
 {
-    iterator p = values.find(key);
+    iterator p = findElement(key);
     if(p == values.end()){
         insertSub(key, new ScalarNode(value, stringStyle));
     } else {
@@ -818,7 +1252,7 @@ void Mapping::write(const std::string &key, const std::string& value, StringStyl
 
 void Mapping::writeSub(const std::string &key, const char* text, size_t length, StringStyle stringStyle)
 {
-    iterator p = values.find(key);
+    iterator p = findElement(key);
     if(p == values.end()){
         insertSub(key, new ScalarNode(text, length, stringStyle));
     } else {
@@ -979,6 +1413,33 @@ void Listing::appendLF()
 }
 
 
+void Listing::toNumbers(int index, int size, double* out_values) const
+{
+    auto p = values.begin() + index;
+    for(int i=0; i < size; ++i){
+        out_values[i] = (*p++)->toDouble();
+    }
+}
+
+
+void Listing::toNumbers(int index, int size, float* out_values) const
+{
+    auto p = values.begin() + index;
+    for(int i=0; i < size; ++i){
+        out_values[i] = static_cast<float>((*p++)->toDouble());
+    }
+}
+
+
+void Listing::toNumbers(int index, int size, int* out_values) const
+{
+    auto p = values.begin() + index;
+    for(int i=0; i < size; ++i){
+        out_values[i] = (*p++)->toInt();
+    }
+}
+
+
 Mapping* Listing::newMapping()
 {
     Mapping* mapping = new Mapping;
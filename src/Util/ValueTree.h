@@ -102,6 +102,13 @@ public:
 
     void throwException(const std::string& message) const;
 
+    /**
+       The nodes are allocated from the pooled slabs shared by all the nodes of the same size
+       because a YAML document consists of a large number of small nodes.
+    */
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
+
     /**
        \todo integrate the exception classes with the common ones defined in Exception.h
     */
@@ -227,9 +234,17 @@ private:
 };
 
 
+/**
+   The elements of a mapping are stored in a flat array sorted by the keys. The iteration order is
+   the same as the order of the keys compared as strings.
+
+   \note The iterators are the ones of std::vector of the key and node pairs, which had been the ones
+   of std::map before. Inserting or removing an element invalidates all the iterators and the
+   references to the elements of the mapping.
+*/
 class CNOID_EXPORT Mapping : public ValueNode
 {
-    typedef std::map<std::string, ValueNodePtr> Container;
+    typedef std::vector<std::pair<std::string, ValueNodePtr>> Container;
         
 public:
 
@@ -401,8 +416,16 @@ private:
     Listing* openListing_(const std::string& key, bool doOverwrite);
     Listing* openFlowStyleListing_(const std::string& key, bool doOverwrite);
 
+    iterator lowerBound(const std::string& key);
+    const_iterator lowerBound(const std::string& key) const;
+    iterator findElement(const std::string& key);
+    const_iterator findElement(const std::string& key) const;
     inline void insertSub(const std::string& key, ValueNode* node);
 
+    // Used by YAMLReader to insert the elements in the document order and sort them at once
+    void appendUnsorted(const std::string& key, ValueNode* node);
+    void sortElements();
+
     void writeSub(const std::string &key, const char* text, size_t length, StringStyle stringStyle);
 
     Container values;
@@ -479,6 +502,15 @@ public:
         return *values[i];
     }
 
+    /**
+       Convert the elements in the range [index, index + size) to numbers and store them in a
+       contiguous array. The exceptions thrown for invalid elements are the same as the ones
+       of toDouble and toInt.
+    */
+    void toNumbers(int index, int size, double* out_values) const;
+    void toNumbers(int index, int size, float* out_values) const;
+    void toNumbers(int index, int size, int* out_values) const;
+
     /// \todo implement the following funcion (ticket #35)
     //MappingPtr extractMapping(const std::string& key) const;
 
@@ -76,12 +76,7 @@ bool Vector3Seq::doWriteSeq(YAMLWriter& writer, std::function<void()> additional
             writer.startListing();
             const int n = numFrames();
             for(int i=0; i < n; ++i){
-                writer.startFlowStyleListing();
-                const Vector3& v = (*this)[i];
-                for(int j=0; j < 3; ++j){
-                    writer.putScalar(v[j]);
-                }
-                writer.endListing();
+                writer.putFlowStyleListing((*this)[i].data(), 3);
             }
             writer.endListing();
         });
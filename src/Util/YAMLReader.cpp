@@ -331,6 +331,8 @@ void YAMLReaderImpl::addNode(ValueNode* node, yaml_event_t& event)
         Mapping* mapping = static_cast<Mapping*>(parent);
 
         if(info.key == "<<"){
+            // The merged elements are not inserted if the keys are already in the mapping
+            mapping->sortElements();
             if(node->isMapping()){
                 mapping->insert(static_cast<Mapping*>(node));
             } else if(node->isListing()){
@@ -355,7 +357,7 @@ void YAMLReaderImpl::addNode(ValueNode* node, yaml_event_t& event)
             }
         }
         
-        mapping->insert(info.key, node);
+        mapping->appendUnsorted(info.key, node);
         info.key.clear();
     }
 }
@@ -416,6 +418,7 @@ void YAMLReaderImpl::onMappingEnd(yaml_event_t& event)
         cout << "YAMLReaderImpl::onMappingEnd()" << endl;
     }
 
+    static_cast<Mapping*>(nodeStack.top().node.get())->sortElements();
     popNode(event);
 }
 
@@ -492,7 +495,7 @@ void YAMLReaderImpl::onScalar(yaml_event_t& event)
      
     if(parent->isMapping()){
         if(info.key.empty()){
-            info.key = string((char*)value, length);
+            info.key.assign((char*)value, length);
             if(info.key.empty()){
                 ValueNode::SyntaxException ex;
                 ex.setMessage(_("empty key"));
@@ -868,11 +868,8 @@ SgMesh* YAMLSceneReaderImpl::readIndexedFaceSet(Mapping& info)
         const int size = coordinateNode.size() / 3;
         SgVertexArray& vertices = *polygonMesh->setVertices(new SgVertexArray());
         vertices.resize(size);
-        for(int i=0; i < size; ++i){
-            Vector3f& s = vertices[i];
-            for(int j=0; j < 3; ++j){
-                s[j] = coordinateNode[i*3+j].toDouble();
-            }
+        if(size > 0){
+            coordinateNode.toNumbers(0, size * 3, vertices.data());
         }
     }
 
@@ -880,10 +877,8 @@ SgMesh* YAMLSceneReaderImpl::readIndexedFaceSet(Mapping& info)
     if(coordIndexNode.isValid()){
         SgIndexArray& polygonVertices = polygonMesh->polygonVertices();
         const int size = coordIndexNode.size();
-        polygonVertices.reserve(size);
-        for(int i=0; i<size; i++){
-            polygonVertices.push_back(coordIndexNode[i].toInt());
-        }
+        polygonVertices.resize(size);
+        coordIndexNode.toNumbers(0, size, polygonVertices.data());
     }
 
     Listing& texCoordNode = *info.findListing("texCoord");
@@ -891,11 +886,8 @@ SgMesh* YAMLSceneReaderImpl::readIndexedFaceSet(Mapping& info)
         const int size = texCoordNode.size() / 2;
         SgTexCoordArray& texCoord = *polygonMesh->setTexCoords(new SgTexCoordArray());
         texCoord.resize(size);
-        for(int i=0; i < size; ++i){
-            Vector2f& s = texCoord[i];
-            for(int j=0; j < 2; ++j){
-                s[j] = texCoordNode[i*2+j].toDouble();
-            }
+        if(size > 0){
+            texCoordNode.toNumbers(0, size * 2, texCoord.data());
         }
     }
 
@@ -903,10 +895,8 @@ SgMesh* YAMLSceneReaderImpl::readIndexedFaceSet(Mapping& info)
     if(texCoordIndexNode.isValid()){
         SgIndexArray& texCoordIndices = polygonMesh->texCoordIndices();
         const int size = texCoordIndexNode.size();
-        texCoordIndices.reserve(size);
-        for(int i=0; i<size; i++){
-            texCoordIndices.push_back(texCoordIndexNode[i].toInt());
-        }
+        texCoordIndices.resize(size);
+        texCoordIndexNode.toNumbers(0, size, texCoordIndices.data());
     }
 
     //polygonMeshTriangulator.setDeepCopyEnabled(true);
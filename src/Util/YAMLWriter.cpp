@@ -47,6 +47,7 @@ public:
     MappingPtr info;
 
     string linebuf;
+    string numberbuf;
 
     YAMLWriterImpl(const std::string filename);
     YAMLWriterImpl(std::ostream& os);
@@ -71,6 +72,9 @@ public:
     void endMapping();
     void startListingSub(bool isFlowStyle);
     void endListing();
+    template<class ValueType> void putFlowStyleListing(const ValueType* values, int size);
+    int formatNumber(char* buf, double value);
+    int formatNumber(char* buf, int value);
     void putNodeMain(const ValueNode* node, bool doCheckLF);
     void putScalarNode(const ScalarNode* scalar);
     void putMappingNode(const Mapping* mapping);
@@ -640,6 +644,70 @@ void YAMLWriter::endListing()
 }
 
 
+int YAMLWriterImpl::formatNumber(char* buf, double value)
+{
+#ifdef _WIN32
+    return _snprintf(buf, 32, doubleFormat, value);
+#else
+    return snprintf(buf, 32, doubleFormat, value);
+#endif
+}
+
+
+int YAMLWriterImpl::formatNumber(char* buf, int value)
+{
+#ifdef _WIN32
+    return _snprintf(buf, 32, "%d", value);
+#else
+    return snprintf(buf, 32, "%d", value);
+#endif
+}
+
+
+template<class ValueType> void YAMLWriterImpl::putFlowStyleListing(const ValueType* values, int size)
+{
+    const size_t numStates = states.size();
+    startListingSub(true);
+    if(states.size() == numStates){
+        return;
+    }
+
+    numberbuf.clear();
+    char buf[32];
+    for(int i=0; i < size; ++i){
+        if(i > 0){
+            numberbuf.append(", ");
+        }
+        int n = formatNumber(buf, values[i]);
+        numberbuf.append(buf, std::min(std::max(n, 0), 31));
+    }
+    if(size > 0){
+        os().write(numberbuf.data(), numberbuf.size());
+        current->hasValuesBeenPut = true;
+    }
+
+    endListing();
+}
+
+
+void YAMLWriter::putFlowStyleListing(const double* values, int size)
+{
+    impl->putFlowStyleListing(values, size);
+}
+
+
+void YAMLWriter::putFlowStyleListing(const float* values, int size)
+{
+    impl->putFlowStyleListing(values, size);
+}
+
+
+void YAMLWriter::putFlowStyleListing(const int* values, int size)
+{
+    impl->putFlowStyleListing(values, size);
+}
+
+
 void YAMLWriter::putNode(const ValueNode* node)
 {
     impl->putNodeMain(node, false);
@@ -57,6 +57,14 @@ public:
     void putScalar(double value);
     void putScalar(const char* value) { putString(value); }
     void putScalar(const std::string& value){ putString(value); }
+
+    /**
+       Put a flow-style listing of numbers. The output is the same as putting each value with
+       putScalar between startFlowStyleListing and endListing, but the text is written at once.
+    */
+    void putFlowStyleListing(const double* values, int size);
+    void putFlowStyleListing(const float* values, int size);
+    void putFlowStyleListing(const int* values, int size);
     void setDoubleFormat(const char* format);
 
     void startMapping();
@@ -2,15 +2,155 @@
 // This is neccessary because the implementation of VC++6.0 uses 'strlen()' in the function,
 // so that it becomes too slow for a string buffer which has long length.
 
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+
 namespace cnoid {
 
+// A plain decimal number whose mantissa and power of ten are both exactly representable in the
+// floating point type is converted by a single multiplication or division, whose result is correctly
+// rounded and the same as the one of the standard functions. The fast path is not taken for the
+// other numbers, including the hexadecimal numbers and the infinity and NaN symbols.
+
+struct DecimalNumberText
+{
+    unsigned long long mantissa;
+    int numDigits;
+    int exponent;
+    bool isNegative;
+    const char* end;
+};
+
+inline bool scanDecimalNumberText(const char* nptr, DecimalNumberText& out_number)
+{
+    const char* p = nptr;
+    out_number.isNegative = false;
+    if(*p == '-'){
+        out_number.isNegative = true;
+        ++p;
+    } else if(*p == '+'){
+        ++p;
+    }
+    unsigned long long mantissa = 0;
+    int numDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    while(*p >= '0' && *p <= '9'){
+        if(mantissa || *p != '0'){
+            if(++numDigits > 19){
+                return false;
+            }
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+        hasDigits = true;
+        ++p;
+    }
+    if(*p == '.'){
+        ++p;
+        while(*p >= '0' && *p <= '9'){
+            if(mantissa || *p != '0'){
+                if(++numDigits > 19){
+                    return false;
+                }
+                mantissa = mantissa * 10 + (*p - '0');
+            }
+            --exponent;
+            hasDigits = true;
+            ++p;
+        }
+    }
+    if(!hasDigits || *p == 'x' || *p == 'X'){
+        return false;
+    }
+    if(*p == 'e' || *p == 'E'){
+        const char* q = p + 1;
+        bool isNegativeExponent = false;
+        if(*q == '-'){
+            isNegativeExponent = true;
+            ++q;
+        } else if(*q == '+'){
+            ++q;
+        }
+        if(*q >= '0' && *q <= '9'){
+            int e = 0;
+            while(*q >= '0' && *q <= '9'){
+                if(e < 10000){
+                    e = e * 10 + (*q - '0');
+                }
+                ++q;
+            }
+            exponent += isNegativeExponent ? -e : e;
+            p = q;
+        }
+    }
+    out_number.mantissa = mantissa;
+    out_number.numDigits = numDigits;
+    out_number.exponent = exponent;
+    out_number.end = p;
+    return true;
+}
+
+inline bool convertDecimalNumberExactly(const char* nptr, char** endptr, double& out_value)
+{
+    static const double powersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    DecimalNumberText number;
+    if(!scanDecimalNumberText(nptr, number)){
+        return false;
+    }
+    double value;
+    if(number.mantissa == 0){
+        value = 0.0;
+    } else if(number.numDigits > 15 || number.exponent < -22 || number.exponent > 22){
+        return false;
+    } else if(number.exponent < 0){
+        value = static_cast<double>(number.mantissa) / powersOf10[-number.exponent];
+    } else {
+        value = static_cast<double>(number.mantissa) * powersOf10[number.exponent];
+    }
+    out_value = number.isNegative ? -value : value;
+    *endptr = const_cast<char*>(number.end);
+    return true;
+}
+
+inline bool convertDecimalNumberExactly(const char* nptr, char** endptr, float& out_value)
+{
+    static const float powersOf10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+    DecimalNumberText number;
+    if(!scanDecimalNumberText(nptr, number)){
+        return false;
+    }
+    float value;
+    if(number.mantissa == 0){
+        value = 0.0f;
+    } else if(number.mantissa > (1 << 24) || number.exponent < -10 || number.exponent > 10){
+        return false;
+    } else if(number.exponent < 0){
+        value = static_cast<float>(number.mantissa) / powersOf10[-number.exponent];
+    } else {
+        value = static_cast<float>(number.mantissa) * powersOf10[number.exponent];
+    }
+    out_value = number.isNegative ? -value : value;
+    *endptr = const_cast<char*>(number.end);
+    return true;
+}
+
 #ifndef _MSC_VER
 
-#include <cstdlib>
 inline float strtof(const char* nptr, char** endptr){
+    float value;
+    if(convertDecimalNumberExactly(nptr, endptr, value)){
+        return value;
+    }
     return std::strtof(nptr, endptr);
 }
 inline double strtod(const char* nptr, char** endptr){
+    double value;
+    if(convertDecimalNumberExactly(nptr, endptr, value)){
+        return value;
+    }
     return std::strtod(nptr, endptr);
 }
 
@@ -77,9 +217,17 @@ template<typename T> T strtofloat(const char* nptr, char** endptr)
     return sign * value;
 }
 inline float strtof(const char* nptr, char** endptr) {
+    float value;
+    if(convertDecimalNumberExactly(nptr, endptr, value)){
+        return value;
+    }
     return strtofloat<float>(nptr, endptr);
 }
 inline double strtod(const char* nptr, char** endptr) {
+    double value;
+    if(convertDecimalNumberExactly(nptr, endptr, value)){
+        return value;
+    }
     return strtofloat<double>(nptr, endptr);
 }
 #endif
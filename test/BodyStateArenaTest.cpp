@@ -0,0 +1,201 @@
+/*
+  This program checks that BodyStateArena and the complete state of BodyState restore the
+  state variables of the links and the states of the devices exactly, and that the data
+  which does not match the body is rejected without modifying the body.
+*/
+
+#include <cnoid/BodyStateArena>
+#include <cnoid/BodyState>
+#include <cnoid/BodyLoader>
+#include <cnoid/Body>
+#include <cnoid/Device>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+std::mt19937 randomEngine;
+
+double randomValue()
+{
+    return std::uniform_real_distribution<double>(-1.0, 1.0)(randomEngine);
+}
+
+Vector3 randomVector3()
+{
+    return Vector3(randomValue(), randomValue(), randomValue());
+}
+
+void setRandomState(Body* body)
+{
+    for(auto& link : body->links()){
+        link->setRotation(AngleAxis(randomValue(), randomVector3().normalized()));
+        link->setTranslation(randomVector3());
+        for(int i=0; i < 6; ++i){
+            link->F_ext()[i] = randomValue();
+        }
+        link->v() = randomVector3();
+        link->w() = randomVector3();
+        link->dv() = randomVector3();
+        link->dw() = randomVector3();
+        link->q() = randomValue();
+        link->dq() = randomValue();
+        link->ddq() = randomValue();
+        link->q_target() = randomValue();
+        link->dq_target() = randomValue();
+        link->u() = randomValue();
+    }
+}
+
+void copyState(Body* from, Body* to)
+{
+    for(int i=0; i < from->numLinks(); ++i){
+        Link* link1 = from->link(i);
+        Link* link2 = to->link(i);
+        link2->T() = link1->T();
+        link2->F_ext() = link1->F_ext();
+        link2->v() = link1->v();
+        link2->w() = link1->w();
+        link2->dv() = link1->dv();
+        link2->dw() = link1->dw();
+        link2->q() = link1->q();
+        link2->dq() = link1->dq();
+        link2->ddq() = link1->ddq();
+        link2->q_target() = link1->q_target();
+        link2->dq_target() = link1->dq_target();
+        link2->u() = link1->u();
+    }
+    for(int i=0; i < from->numDevices(); ++i){
+        to->device(i)->copyStateFrom(*from->device(i));
+    }
+}
+
+bool isSameLinkState(Body* body1, Body* body2)
+{
+    for(int i=0; i < body1->numLinks(); ++i){
+        Link* link1 = body1->link(i);
+        Link* link2 = body2->link(i);
+        if(link1->T().matrix() != link2->T().matrix() ||
+           link1->F_ext() != link2->F_ext() ||
+           link1->v() != link2->v() ||
+           link1->w() != link2->w() ||
+           link1->dv() != link2->dv() ||
+           link1->dw() != link2->dw() ||
+           link1->q() != link2->q() ||
+           link1->dq() != link2->dq() ||
+           link1->ddq() != link2->ddq() ||
+           link1->q_target() != link2->q_target() ||
+           link1->dq_target() != link2->dq_target() ||
+           link1->u() != link2->u()){
+            cerr << "The state of " << link1->name() << " is different." << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isSameDeviceState(Body* body1, Body* body2)
+{
+    for(int i=0; i < body1->numDevices(); ++i){
+        Device* device1 = body1->device(i);
+        Device* device2 = body2->device(i);
+        const int n = device1->stateSize();
+        vector<double> state1(n);
+        vector<double> state2(n);
+        device1->writeState(state1.data());
+        device2->writeState(state2.data());
+        if(state1 != state2){
+            cerr << "The state of " << device1->name() << " is different." << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2){
+        cerr << "Usage: " << argv[0] << " <model file>" << endl;
+        return 1;
+    }
+
+    BodyLoader loader;
+    BodyPtr body = loader.load(argv[1]);
+    if(!body){
+        cerr << "The model file cannot be loaded." << endl;
+        return 1;
+    }
+    BodyPtr reference = body->clone();
+
+    bool ok = true;
+
+    // Gather, store, scatter into the modified body and compare
+    setRandomState(body);
+    copyState(body, reference);
+    BodyStateArena arena(*body);
+    for(int i=0; i < body->numLinks(); ++i){
+        if(arena.q()[i] != body->link(i)->q() || arena.T()[i].matrix() != body->link(i)->T().matrix()){
+            cerr << "The arena does not have the state of " << body->link(i)->name() << "." << endl;
+            ok = false;
+        }
+    }
+    vector<double> data;
+    arena.store(data);
+    if(data.size() != BodyStateArena::calcDataSize(body->numLinks())){
+        cerr << "The size of the stored data is wrong." << endl;
+        ok = false;
+    }
+    setRandomState(body);
+    BodyStateArena arena2;
+    arena2.resize(body->numLinks());
+    if(!arena2.restore(data) || !arena2.scatter(*body)){
+        cerr << "The arena cannot be restored." << endl;
+        ok = false;
+    }
+    ok &= isSameLinkState(body, reference);
+
+    // A copied arena must refer to its own buffer
+    BodyStateArena arena3(arena2);
+    arena2.q()[0] += 1.0;
+    if(arena3.q()[0] != reference->link(0)->q()){
+        cerr << "The copied arena shares the buffer." << endl;
+        ok = false;
+    }
+
+    // The complete state including the device states
+    setRandomState(body);
+    copyState(body, reference);
+    BodyState state;
+    state.storeCompleteState(*body);
+    setRandomState(body);
+    for(auto& device : body->devices()){
+        device->on(!device->on());
+    }
+    if(!state.restoreCompleteState(*body)){
+        cerr << "The complete state cannot be restored." << endl;
+        ok = false;
+    }
+    ok &= isSameLinkState(body, reference);
+    ok &= isSameDeviceState(body, reference);
+
+    // The data for a different body must be rejected
+    BodyPtr other = new Body;
+    other->updateLinkTree();
+    Vector3 p = other->rootLink()->p();
+    if(arena.scatter(*other) || state.checkCompleteState(*other) || state.restoreCompleteState(*other) ||
+       other->rootLink()->p() != p){
+        cerr << "The data for a different body is not rejected." << endl;
+        ok = false;
+    }
+
+    if(ok){
+        cout << "OK" << endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+/*
+  This program checks that the forward kinematics and the Jacobians calculated by
+  CompiledKinematicModel are the same as the ones calculated by Body and JointPath,
+  and that the invalid arguments are rejected.
+*/
+
+#include <cnoid/CompiledKinematicModel>
+#include <cnoid/BodyLoader>
+#include <cnoid/Body>
+#include <cnoid/JointPath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const int NumConfigurations = 20;
+const double Tolerance = 1.0e-9;
+
+template<class Function>
+bool throwsInvalidArgument(Function function)
+{
+    try {
+        function();
+    }
+    catch(const std::invalid_argument&){
+        return true;
+    }
+    return false;
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2){
+        cerr << "Usage: " << argv[0] << " <model file>" << endl;
+        return 1;
+    }
+
+    BodyLoader loader;
+    BodyPtr body = loader.load(argv[1]);
+    if(!body){
+        cerr << "The model file cannot be loaded." << endl;
+        return 1;
+    }
+    const int numJoints = body->numJoints();
+    const int numLinks = body->numLinks();
+
+    CompiledKinematicModel model(body);
+
+    std::mt19937 random;
+    MatrixXd Q(NumConfigurations, numJoints);
+    for(int i=0; i < numJoints; ++i){
+        auto joint = body->joint(i);
+        double lower = std::max(joint->q_lower(), -3.0);
+        double upper = std::min(joint->q_upper(), 3.0);
+        std::uniform_real_distribution<double> distribution(lower, upper);
+        for(int j=0; j < NumConfigurations; ++j){
+            Q(j, i) = distribution(random);
+        }
+    }
+    model.calcForwardKinematics(Q);
+
+    double maxFkError = 0.0;
+    double maxJacobianError = 0.0;
+    vector<MatrixXd> jacobians(numLinks);
+    for(int i=0; i < numLinks; ++i){
+        model.calcJacobians(i, jacobians[i]);
+    }
+
+    for(int j=0; j < NumConfigurations; ++j){
+        for(int i=0; i < numJoints; ++i){
+            body->joint(i)->q() = Q(j, i);
+        }
+        body->calcForwardKinematics();
+
+        for(int i=0; i < numLinks; ++i){
+            Link* link = body->link(i);
+            Isometry3 T = model.linkPosition(i, j);
+            maxFkError = std::max(maxFkError, (T.translation() - link->p()).cwiseAbs().maxCoeff());
+            maxFkError = std::max(maxFkError, (T.linear() - link->R()).cwiseAbs().maxCoeff());
+
+            JointPath path(body->rootLink(), link);
+            MatrixXd J;
+            path.calcJacobian(J);
+            const int n = path.numJoints();
+            if(jacobians[i].cols() != 6 * n){
+                cerr << "The size of the Jacobian of " << link->name() << " is different." << endl;
+                return 1;
+            }
+            const MatrixXd J2 = Eigen::Map<const MatrixXd>(jacobians[i].row(j).eval().data(), 6, n);
+            if(n > 0){
+                maxJacobianError = std::max(maxJacobianError, (J - J2).cwiseAbs().maxCoeff());
+            }
+        }
+    }
+
+    bool ok = true;
+
+    if(maxFkError > Tolerance){
+        cerr << "The maximum error of the link positions is " << maxFkError << "." << endl;
+        ok = false;
+    }
+    if(maxJacobianError > Tolerance){
+        cerr << "The maximum error of the Jacobians is " << maxJacobianError << "." << endl;
+        ok = false;
+    }
+
+    MatrixXd J;
+    MatrixXd invalidQ(NumConfigurations, numJoints + 1);
+    if(!throwsInvalidArgument([&](){ model.calcForwardKinematics(invalidQ); }) ||
+       !throwsInvalidArgument([&](){ model.calcJacobians(numLinks, J); }) ||
+       !throwsInvalidArgument([&](){ model.calcJacobians(-1, J); }) ||
+       !throwsInvalidArgument([&](){ model.linkPosition(0, NumConfigurations); })){
+        cerr << "An invalid argument is not rejected." << endl;
+        ok = false;
+    }
+
+    if(ok){
+        cout << "OK" << endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+/*
+  This program checks that the joint positions given by a PoseSeqInterpolator which has
+  cached the IK solutions are the same as the ones given by a new interpolator after the
+  pose sequence or the IK configuration is changed.
+*/
+
+#include <cnoid/PoseSeqInterpolator>
+#include <cnoid/PoseSeq>
+#include <cnoid/Pose>
+#include <cnoid/BodyLoader>
+#include <cnoid/Body>
+#include <cnoid/EigenUtil>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const double TimeStep = 0.01;
+
+/*
+  The numerical IK of the cached interpolator may start from a different posture at the
+  boundaries of the changed time ranges. The errors within the IK tolerance (1.0e-6 in the
+  link position) are allowed for that.
+*/
+const double Tolerance = 1.0e-4;
+
+Link* waist;
+Link* leftAnkle;
+Link* rightAnkle;
+
+PosePtr createPose(Body* body, double waistHeight, Link* baseLink)
+{
+    PosePtr pose = new Pose(body->numJoints());
+    for(int i=0; i < body->numJoints(); ++i){
+        pose->setJointPosition(i, body->joint(i)->q());
+    }
+    Link* ikLinks[] = { waist, leftAnkle, rightAnkle };
+    for(auto link : ikLinks){
+        Vector3 p = link->p();
+        if(link == waist){
+            p.z() = waistHeight;
+        }
+        if(link == baseLink){
+            pose->setBaseLink(link->index(), p, link->R());
+        } else {
+            auto info = pose->addIkLink(link->index());
+            info->p = p;
+            info->R = link->R();
+        }
+    }
+    return pose;
+}
+
+double compare(PoseSeqInterpolator& cached, PoseSeqInterpolator& fresh, int numJoints)
+{
+    double maxError = 0.0;
+    const double endingTime = fresh.endingTime();
+    for(double time = 0.0; time <= endingTime; time += TimeStep){
+        cached.interpolate(time);
+        fresh.interpolate(time);
+        for(int i=0; i < numJoints; ++i){
+            auto q0 = cached.jointPosition(i);
+            auto q1 = fresh.jointPosition(i);
+            if(bool(q0) != bool(q1)){
+                return std::numeric_limits<double>::max();
+            }
+            if(q0){
+                maxError = std::max(maxError, fabs(*q0 - *q1));
+            }
+        }
+    }
+    return maxError;
+}
+
+bool check(const char* name, PoseSeqInterpolator& cached, Body* body, PoseSeqPtr seq, bool doStealthyStep)
+{
+    PoseSeqInterpolator fresh;
+    fresh.setBody(body);
+    fresh.addFootLink(leftAnkle->index(), Vector3::Zero());
+    fresh.addFootLink(rightAnkle->index(), Vector3::Zero());
+    fresh.enableStealthyStepMode(doStealthyStep);
+    fresh.setPoseSeq(seq);
+
+    cached.update();
+    double error = compare(cached, fresh, body->numJoints());
+    if(error > Tolerance){
+        cerr << name << ": The maximum error of the joint positions is " << error << "." << endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2){
+        cerr << "Usage: " << argv[0] << " <SR1 model file>" << endl;
+        return 1;
+    }
+
+    BodyLoader loader;
+    BodyPtr body = loader.load(argv[1]);
+    if(!body){
+        cerr << "The model file cannot be loaded." << endl;
+        return 1;
+    }
+    waist = body->rootLink();
+    leftAnkle = body->link("LLEG_ANKLE_R");
+    rightAnkle = body->link("RLEG_ANKLE_R");
+    if(!leftAnkle || !rightAnkle){
+        cerr << "The model does not have the ankle links." << endl;
+        return 1;
+    }
+
+    // Bend the knees so that the waist can be moved up and down with the IK
+    const char* bendingJoints[] = { "LLEG_HIP_P", "LLEG_KNEE", "LLEG_ANKLE_P", "RLEG_HIP_P", "RLEG_KNEE", "RLEG_ANKLE_P" };
+    const double bendingAngles[] = { -0.4, 0.8, -0.4, -0.4, 0.8, -0.4 };
+    for(int i=0; i < 6; ++i){
+        if(auto joint = body->link(bendingJoints[i])){
+            joint->q() = bendingAngles[i];
+        }
+    }
+    body->calcForwardKinematics();
+    const double z = waist->p().z();
+
+    PoseSeqPtr seq = new PoseSeq;
+    auto it = seq->begin();
+    for(int i=0; i < 5; ++i){
+        it = seq->insert(it, i * 1.0, createPose(body, z - 0.02 * (i % 2), waist));
+    }
+
+    PoseSeqInterpolator cached;
+    cached.setBody(body);
+    cached.addFootLink(leftAnkle->index(), Vector3::Zero());
+    cached.addFootLink(rightAnkle->index(), Vector3::Zero());
+    cached.setPoseSeq(seq);
+
+    bool ok = check("Initial", cached, body, seq, false);
+
+    // Change the base link of a pose. The base link of the following segments is also changed.
+    it = seq->begin();
+    ++it; ++it;
+    seq->beginPoseModification(it);
+    it->get<Pose>()->setBaseLink(leftAnkle->index());
+    seq->endPoseModification(it);
+    ok &= check("Base link", cached, body, seq, false);
+
+    // Change the waist height of a pose
+    it = seq->begin();
+    ++it;
+    seq->beginPoseModification(it);
+    it->get<Pose>()->ikLinkInfo(waist->index())->p.z() -= 0.01;
+    seq->endPoseModification(it);
+    ok &= check("Waist height", cached, body, seq, false);
+
+    // Change the setting of the interpolator
+    cached.enableStealthyStepMode(true);
+    ok &= check("Stealthy step", cached, body, seq, true);
+
+    if(ok){
+        cout << "OK" << endl;
+    }
+    return ok ? 0 : 1;
+}